@@ -1,6 +1,7 @@
 noinst_HEADERS +=\
 	api/documentvaluelist.h\
-	api/maptermlist.h
+	api/maptermlist.h\
+	api/msetcacheinternal.h
 
 EXTRA_DIST +=\
 	api/dir_contents\
@@ -17,6 +18,7 @@ lib_src +=\
 	api/keymaker.cc\
 	api/leafpostlist.cc\
 	api/matchspy.cc\
+	api/msetcache.cc\
 	api/omdatabase.cc\
 	api/omdocument.cc\
 	api/omenquire.cc\
@@ -86,6 +86,7 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     string destdir;
     bool renumber;
     bool multipass;
+    unsigned threads;
     int compact_to_stub;
     size_t block_size;
     compaction_level compaction;
@@ -104,7 +105,7 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     vector<pair<Xapian::docid, Xapian::docid> > used_ranges;
   public:
     Internal()
-	: renumber(true), multipass(false),
+	: renumber(true), multipass(false), threads(1),
 	  block_size(8192), compaction(FULL), tot_off(0),
 	  last_docid(0), backend(UNKNOWN)
     {
@@ -139,6 +140,12 @@ Compactor::set_multipass(bool multipass)
     internal->multipass = multipass;
 }
 
+void
+Compactor::set_threads(unsigned threads)
+{
+    internal->threads = threads;
+}
+
 void
 Compactor::set_compaction_level(compaction_level compaction)
 {
@@ -451,14 +458,14 @@ Compactor::Internal::compact(Xapian::Compactor & compactor)
     if (backend == CHERT) {
 #ifdef XAPIAN_HAS_CHERT_BACKEND
 	compact_chert(compactor, destdir.c_str(), sources, offset, block_size,
-		      compaction, multipass, last_docid);
+		      compaction, multipass, last_docid, threads);
 #else
 	throw Xapian::FeatureUnavailableError("Chert backend disabled at build time");
 #endif
     } else if (backend == BRASS) {
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	compact_brass(compactor, destdir.c_str(), sources, offset, block_size,
-		      compaction, multipass, last_docid);
+		      compaction, multipass, last_docid, threads);
 #else
 	throw Xapian::FeatureUnavailableError("Brass backend disabled at build time");
 #endif
@@ -295,13 +295,96 @@ get_most_frequent_items(vector<StringAndFrequency> & result,
     }
 }
 
+/// Return a pseudo-random number in the range [0, n).
+static Xapian::doccount
+random_below(unsigned & state, Xapian::doccount n)
+{
+    // Marsaglia's xorshift generator, which is plenty good enough for
+    // picking samples.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return Xapian::doccount(state % n);
+}
+
 void
 ValueCountMatchSpy::operator()(const Document &doc, weight) {
     ++(internal->total);
+    if (internal->sample_interval != 1 &&
+	(internal->total - 1) % internal->sample_interval != 0) {
+	return;
+    }
+    if (internal->max_samples) {
+	// Reservoir sampling: keep the first max_samples documents, then
+	// replace a random one with the Nth with probability max_samples / N,
+	// so that every document is equally likely to end up in the sample.
+	// We only fetch the value if the document is kept.
+	Xapian::doccount n = ++(internal->candidates);
+	if (n > internal->max_samples) {
+	    Xapian::doccount i = random_below(internal->rng_state, n);
+	    if (i >= internal->max_samples) return;
+	    string & val = internal->reservoir[i];
+	    if (!val.empty()) {
+		map<string, doccount>::iterator j = internal->values.find(val);
+		if (--(j->second) == 0) internal->values.erase(j);
+	    }
+	    val = doc.get_value(internal->slot);
+	    if (!val.empty()) ++(internal->values[val]);
+	    return;
+	}
+	internal->reservoir.push_back(doc.get_value(internal->slot));
+	++(internal->sampled);
+	const string & val = internal->reservoir.back();
+	if (!val.empty()) ++(internal->values[val]);
+	return;
+    }
+    ++(internal->sampled);
     string val(doc.get_value(internal->slot));
     if (!val.empty()) ++(internal->values[val]);
 }
 
+void
+ValueCountMatchSpy::set_sampling(Xapian::doccount sample_interval,
+				 Xapian::doccount max_samples)
+{
+    if (sample_interval == 0)
+	throw InvalidArgumentError("sample_interval must be at least 1");
+    internal->sample_interval = sample_interval;
+    internal->max_samples = max_samples;
+}
+
+Xapian::doccount
+ValueCountMatchSpy::get_estimated_count(const string & value,
+					Xapian::doccount matches,
+					Xapian::doccount & error) const
+{
+    LOGCALL(API, Xapian::doccount, "Xapian::ValueCountMatchSpy::get_estimated_count", value | matches | Literal("error"));
+    const Xapian::doccount n = internal->sampled;
+    if (n == 0) {
+	// We've nothing to go on, so the count could be anything.
+	error = matches;
+	RETURN(0);
+    }
+
+    map<string, doccount>::const_iterator i = internal->values.find(value);
+    Xapian::doccount count = (i == internal->values.end()) ? 0 : i->second;
+    double p = double(count) / n;
+    double estimate = p * matches;
+    if (n >= matches) {
+	// We tallied every document (or at least as many as we were asked
+	// about), so the count is exact.
+	error = 0;
+	RETURN(Xapian::doccount(estimate + 0.5));
+    }
+
+    // The standard error of the sampled proportion, with the finite
+    // population correction since we sample without replacement.
+    double var = p * (1.0 - p) / n;
+    var *= double(matches - n) / double(matches - 1);
+    error = Xapian::doccount(1.96 * sqrt(var) * matches + 0.5);
+    RETURN(Xapian::doccount(estimate + 0.5));
+}
+
 TermIterator
 ValueCountMatchSpy::values_begin() const
 {
@@ -320,7 +403,9 @@ ValueCountMatchSpy::top_values_begin(size_t maxvalues) const
 
 MatchSpy *
 ValueCountMatchSpy::clone() const {
-    return new ValueCountMatchSpy(internal->slot);
+    AutoPtr<ValueCountMatchSpy> spy(new ValueCountMatchSpy(internal->slot));
+    spy->set_sampling(internal->sample_interval, internal->max_samples);
+    return spy.release();
 }
 
 string
@@ -332,6 +417,10 @@ string
 ValueCountMatchSpy::serialise() const {
     string result;
     result += encode_length(internal->slot);
+    if (internal->sample_interval != 1 || internal->max_samples != 0) {
+	result += encode_length(internal->sample_interval);
+	result += encode_length(internal->max_samples);
+    }
     return result;
 }
 
@@ -342,11 +431,17 @@ ValueCountMatchSpy::unserialise(const string & s, const Registry &) const
     const char * end = p + s.size();
 
     valueno new_slot = decode_length(&p, end, false);
+    AutoPtr<ValueCountMatchSpy> spy(new ValueCountMatchSpy(new_slot));
+    if (p != end) {
+	doccount sample_interval = decode_length(&p, end, false);
+	doccount max_samples = decode_length(&p, end, false);
+	spy->set_sampling(sample_interval, max_samples);
+    }
     if (p != end) {
 	throw NetworkError("Junk at end of serialised ValueCountMatchSpy");
     }
 
-    return new ValueCountMatchSpy(new_slot);
+    return spy.release();
 }
 
 string
@@ -354,6 +449,7 @@ ValueCountMatchSpy::serialise_results() const {
     LOGCALL(REMOTE, string, "ValueCountMatchSpy::serialise_results", NO_ARGS);
     string result;
     result += encode_length(internal->total);
+    result += encode_length(internal->sampled);
     result += encode_length(internal->values.size());
     for (map<string, doccount>::const_iterator i = internal->values.begin();
 	 i != internal->values.end(); ++i) {
@@ -371,17 +467,19 @@ ValueCountMatchSpy::merge_results(const string & s) {
     const char * end = p + s.size();
 
     internal->total += decode_length(&p, end, false);
+    internal->sampled += decode_length(&p, end, false);
 
     map<string, doccount>::size_type items = decode_length(&p, end, false);
-    while (p != end) {
-	while (items != 0) {
-	    size_t vallen = decode_length(&p, end, true);
-	    string val(p, vallen);
-	    p += vallen;
-	    doccount freq = decode_length(&p, end, false);
-	    internal->values[val] += freq;
-	    --items;
-	}
+    while (items != 0) {
+	size_t vallen = decode_length(&p, end, true);
+	string val(p, vallen);
+	p += vallen;
+	doccount freq = decode_length(&p, end, false);
+	internal->values[val] += freq;
+	--items;
+    }
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised ValueCountMatchSpy results");
     }
 }
 
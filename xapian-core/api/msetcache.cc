@@ -0,0 +1,304 @@
+/** @file msetcache.cc
+ * @brief Cache of match results which can be shared between Enquire objects.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/msetcache.h"
+
+#include "msetcacheinternal.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+namespace Xapian {
+
+MSetCache::MSetCache(const MSetCache & o) : internal(o.internal) { }
+
+MSetCache &
+MSetCache::operator=(const MSetCache & o)
+{
+    internal = o.internal;
+    return *this;
+}
+
+MSetCache::MSetCache(size_t max_memory)
+    : internal(new MSetCache::Internal(max_memory))
+{
+    LOGCALL_CTOR(API, "Xapian::MSetCache", max_memory);
+}
+
+MSetCache::~MSetCache()
+{
+    LOGCALL_DTOR(API, "Xapian::MSetCache");
+}
+
+void
+MSetCache::set_max_memory(size_t max_memory)
+{
+    LOGCALL_VOID(API, "Xapian::MSetCache::set_max_memory", max_memory);
+    internal->set_max_memory(max_memory);
+}
+
+size_t
+MSetCache::get_max_memory() const
+{
+    LOGCALL(API, size_t, "Xapian::MSetCache::get_max_memory", NO_ARGS);
+    RETURN(internal->get_max_memory());
+}
+
+size_t
+MSetCache::get_memory_used() const
+{
+    LOGCALL(API, size_t, "Xapian::MSetCache::get_memory_used", NO_ARGS);
+    RETURN(internal->get_memory_used());
+}
+
+size_t
+MSetCache::size() const
+{
+    LOGCALL(API, size_t, "Xapian::MSetCache::size", NO_ARGS);
+    RETURN(internal->size());
+}
+
+unsigned long
+MSetCache::get_hits() const
+{
+    LOGCALL(API, unsigned long, "Xapian::MSetCache::get_hits", NO_ARGS);
+    RETURN(internal->get_hits());
+}
+
+unsigned long
+MSetCache::get_misses() const
+{
+    LOGCALL(API, unsigned long, "Xapian::MSetCache::get_misses", NO_ARGS);
+    RETURN(internal->get_misses());
+}
+
+void
+MSetCache::clear()
+{
+    LOGCALL_VOID(API, "Xapian::MSetCache::clear", NO_ARGS);
+    internal->clear();
+}
+
+string
+MSetCache::get_description() const
+{
+    string desc = "Xapian::MSetCache(";
+    desc += str(internal->size());
+    desc += " entries, ";
+    desc += str(internal->get_memory_used());
+    desc += '/';
+    desc += str(internal->get_max_memory());
+    desc += " bytes, ";
+    desc += str(internal->get_hits());
+    desc += " hits, ";
+    desc += str(internal->get_misses());
+    desc += " misses)";
+    return desc;
+}
+
+}
+
+// Approximate overhead for each entry in a std::map or std::list, which is
+// a few pointers plus malloc overhead.
+static const size_t NODE_OVERHEAD = 6 * sizeof(void*);
+
+void
+Xapian::MSetCache::Internal::trim()
+{
+    while (memory_used > max_memory) {
+	AssertRel(entries.size(),>,0);
+	const Entry & victim = entries.back();
+	memory_used -= victim.bytes;
+	index.erase(victim.key);
+	entries.pop_back();
+    }
+}
+
+void
+Xapian::MSetCache::Internal::check_revision(const string & dbkey,
+					    const string & revision)
+{
+    map<string, string>::iterator r = revisions.find(dbkey);
+    if (r == revisions.end()) {
+	revisions.insert(make_pair(dbkey, revision));
+	return;
+    }
+    if (r->second == revision) return;
+
+    // We've seen a different revision of these databases, so any results we
+    // have for them are probably out of date.  Even if this is a search
+    // against an older revision than last time, results for the newer
+    // revision will be wanted again soon, so discarding them all is simplest.
+    LOGLINE(API, "MSetCache: new revision, discarding cached results");
+    r->second = revision;
+    lru_list::iterator i = entries.begin();
+    while (i != entries.end()) {
+	if (i->dbkey == dbkey) {
+	    memory_used -= i->bytes;
+	    index.erase(i->key);
+	    i = entries.erase(i);
+	} else {
+	    ++i;
+	}
+    }
+}
+
+bool
+Xapian::MSetCache::Internal::lookup(const string & dbkey,
+				    const string & revision,
+				    const string & key,
+				    Xapian::MSet & mset)
+{
+    LOGCALL(API, bool, "Xapian::MSetCache::Internal::lookup", dbkey | revision | key | mset);
+    MutexLock lock(mutex);
+    check_revision(dbkey, revision);
+    map<string, lru_list::iterator>::const_iterator i = index.find(key);
+    if (i == index.end()) {
+	++misses;
+	RETURN(false);
+    }
+    ++hits;
+    // Move the entry to the front of the LRU list.
+    entries.splice(entries.begin(), entries, i->second);
+    const Entry & e = *(i->second);
+    vector<Xapian::Internal::MSetItem> items(e.items);
+    mset = Xapian::MSet(new Xapian::MSet::Internal(e.firstitem,
+						   e.matches_upper_bound,
+						   e.matches_lower_bound,
+						   e.matches_estimated,
+						   e.uncollapsed_upper_bound,
+						   e.uncollapsed_lower_bound,
+						   e.uncollapsed_estimated,
+						   e.max_possible,
+						   e.max_attained,
+						   items,
+						   e.termfreqandwts,
+						   e.percent_factor));
+    RETURN(true);
+}
+
+void
+Xapian::MSetCache::Internal::store(const string & dbkey,
+				   const string & revision,
+				   const string & key,
+				   const Xapian::MSet & mset)
+{
+    LOGCALL_VOID(API, "Xapian::MSetCache::Internal::store", dbkey | revision | key | mset);
+    const Xapian::MSet::Internal * m = mset.internal.get();
+    if (m == NULL) return;
+
+    size_t bytes = sizeof(Entry) + 2 * NODE_OVERHEAD + 2 * key.size() +
+		   dbkey.size();
+    vector<Xapian::Internal::MSetItem>::const_iterator item;
+    for (item = m->items.begin(); item != m->items.end(); ++item) {
+	bytes += sizeof(*item) + item->collapse_key.size() +
+		 item->sort_key.size();
+    }
+    map<string, Xapian::MSet::Internal::TermFreqAndWeight>::const_iterator t;
+    for (t = m->termfreqandwts.begin(); t != m->termfreqandwts.end(); ++t) {
+	bytes += sizeof(*t) + NODE_OVERHEAD + t->first.size();
+    }
+
+    MutexLock lock(mutex);
+    // Don't cache a result which would push out everything else.
+    if (bytes > max_memory / 2) return;
+    check_revision(dbkey, revision);
+    // Another thread may have stored this result since we looked it up.
+    if (index.find(key) != index.end()) return;
+
+    entries.push_front(Entry());
+    Entry & e = entries.front();
+    e.key = key;
+    e.dbkey = dbkey;
+    e.bytes = bytes;
+    e.percent_factor = m->percent_factor;
+    e.termfreqandwts = m->termfreqandwts;
+    e.items = m->items;
+    e.firstitem = m->firstitem;
+    e.matches_lower_bound = m->matches_lower_bound;
+    e.matches_estimated = m->matches_estimated;
+    e.matches_upper_bound = m->matches_upper_bound;
+    e.uncollapsed_lower_bound = m->uncollapsed_lower_bound;
+    e.uncollapsed_estimated = m->uncollapsed_estimated;
+    e.uncollapsed_upper_bound = m->uncollapsed_upper_bound;
+    e.max_possible = m->max_possible;
+    e.max_attained = m->max_attained;
+    index.insert(make_pair(key, entries.begin()));
+    memory_used += bytes;
+    trim();
+}
+
+void
+Xapian::MSetCache::Internal::set_max_memory(size_t max_memory_)
+{
+    MutexLock lock(mutex);
+    max_memory = max_memory_;
+    trim();
+}
+
+size_t
+Xapian::MSetCache::Internal::get_max_memory() const
+{
+    MutexLock lock(mutex);
+    return max_memory;
+}
+
+size_t
+Xapian::MSetCache::Internal::get_memory_used() const
+{
+    MutexLock lock(mutex);
+    return memory_used;
+}
+
+size_t
+Xapian::MSetCache::Internal::size() const
+{
+    MutexLock lock(mutex);
+    return index.size();
+}
+
+unsigned long
+Xapian::MSetCache::Internal::get_hits() const
+{
+    MutexLock lock(mutex);
+    return hits;
+}
+
+unsigned long
+Xapian::MSetCache::Internal::get_misses() const
+{
+    MutexLock lock(mutex);
+    return misses;
+}
+
+void
+Xapian::MSetCache::Internal::clear()
+{
+    MutexLock lock(mutex);
+    entries.clear();
+    index.clear();
+    revisions.clear();
+    memory_used = 0;
+    hits = misses = 0;
+}
@@ -0,0 +1,133 @@
+/** @file msetcacheinternal.h
+ * @brief Implementation of Xapian::MSetCache.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
+#define XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
+
+#include "xapian/enquire.h"
+#include "xapian/msetcache.h"
+
+#include "mutex.h"
+#include "omenquireinternal.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+class Xapian::MSetCache::Internal : public Xapian::Internal::intrusive_base {
+    /// A cached result.
+    struct Entry {
+	/// The key the entry is stored under.
+	std::string key;
+
+	/// The uuids of the databases searched.
+	std::string dbkey;
+
+	/// Approximate memory used by this entry.
+	size_t bytes;
+
+	double percent_factor;
+	std::map<std::string,
+		 Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
+	std::vector<Xapian::Internal::MSetItem> items;
+	Xapian::doccount firstitem;
+	Xapian::doccount matches_lower_bound;
+	Xapian::doccount matches_estimated;
+	Xapian::doccount matches_upper_bound;
+	Xapian::doccount uncollapsed_lower_bound;
+	Xapian::doccount uncollapsed_estimated;
+	Xapian::doccount uncollapsed_upper_bound;
+	Xapian::weight max_possible;
+	Xapian::weight max_attained;
+    };
+
+    /// Cached results, most recently used first.
+    typedef std::list<Entry> lru_list;
+
+    lru_list entries;
+
+    /// Index of entries by key.
+    std::map<std::string, lru_list::iterator> index;
+
+    /// The last revision seen for each set of databases.
+    std::map<std::string, std::string> revisions;
+
+    size_t max_memory;
+
+    size_t memory_used;
+
+    unsigned long hits;
+
+    unsigned long misses;
+
+    mutable Mutex mutex;
+
+    /// Discard least recently used entries until within the memory limit.
+    void trim();
+
+    /// Discard entries for @a dbkey if @a revision is new.
+    void check_revision(const std::string & dbkey,
+			const std::string & revision);
+
+    /// Copy not allowed.
+    Internal(const Internal &);
+
+    /// Assignment not allowed.
+    void operator=(const Internal &);
+
+  public:
+    explicit Internal(size_t max_memory_)
+	: max_memory(max_memory_), memory_used(0), hits(0), misses(0) { }
+
+    /** Look up a cached result.
+     *
+     *  @param dbkey	Identifies the set of databases being searched.
+     *  @param revision	The revisions of the databases being searched.
+     *  @param key	Identifies the search being run.
+     *  @param mset	Set to the cached result if one is found.
+     *
+     *  @return true if a cached result was found.
+     */
+    bool lookup(const std::string & dbkey, const std::string & revision,
+		const std::string & key, Xapian::MSet & mset);
+
+    /** Store a result.
+     *
+     *  The parameters are as for lookup().
+     */
+    void store(const std::string & dbkey, const std::string & revision,
+	       const std::string & key, const Xapian::MSet & mset);
+
+    void set_max_memory(size_t max_memory_);
+
+    size_t get_max_memory() const;
+
+    size_t get_memory_used() const;
+
+    size_t size() const;
+
+    unsigned long get_hits() const;
+
+    unsigned long get_misses() const;
+
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
@@ -867,6 +867,16 @@ WritableDatabase::add_document(const Document & document)
     RETURN(internal[0]->add_document(document));
 }
 
+Xapian::docid
+WritableDatabase::add_documents(const vector<Document> & documents,
+				unsigned threads)
+{
+    LOGCALL(API, Xapian::docid, "WritableDatabase::add_documents", documents.size() | threads);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    if (documents.empty()) RETURN(0);
+    RETURN(internal[0]->add_documents(documents, threads));
+}
+
 void
 WritableDatabase::delete_document(Xapian::docid did)
 {
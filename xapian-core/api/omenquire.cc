@@ -38,8 +38,11 @@
 #include "debuglog.h"
 #include "esetinternal.h"
 #include "expandweight.h"
+#include "msetcacheinternal.h"
 #include "multimatch.h"
 #include "omenquireinternal.h"
+#include "pack.h"
+#include "serialise-double.h"
 #include "str.h"
 #include "weightinternal.h"
 
@@ -386,21 +389,18 @@ Document
 MSet::Internal::get_doc_by_index(Xapian::doccount index) const
 {
     LOGCALL(MATCH, Document, "Xapian::MSet::Internal::get_doc_by_index", index);
-    index += firstitem; 
     map<Xapian::doccount, Document>::const_iterator doc;
     doc = indexeddocs.find(index);
     if (doc != indexeddocs.end()) {
 	RETURN(doc->second);
     }
-    if (index < firstitem || index >= firstitem + items.size()) {
-	throw RangeError("The mset returned from the match does not contain the document at index " + str(index));
+    if (index >= items.size()) {
+	throw RangeError("The mset returned from the match does not contain the document at index " + str(index + firstitem));
     }
-    fetch_items(index, index); // FIXME: this checks indexeddocs AGAIN!
-    /* Actually read the fetched documents */
-    read_docs();
-    Assert(indexeddocs.find(index) != indexeddocs.end());
-    Assert(indexeddocs.find(index)->first == index); // Paranoid assert
-    RETURN(indexeddocs.find(index)->second);
+    fetch_items(index, index);
+    doc = indexeddocs.find(index);
+    Assert(doc != indexeddocs.end());
+    RETURN(doc->second);
 }
 
 void
@@ -410,20 +410,24 @@ MSet::Internal::fetch_items(Xapian::doccount first, Xapian::doccount last) const
     if (enquire.get() == 0) {
 	throw InvalidOperationError("Can't fetch documents from an MSet which is not derived from a query.");
     }
+    AssertRel(last,<,items.size());
+    vector<Xapian::doccount> indices;
+    vector<Xapian::docid> dids;
     for (Xapian::doccount i = first; i <= last; ++i) {
-	map<Xapian::doccount, Document>::const_iterator doc;
-	doc = indexeddocs.find(i);
-	if (doc == indexeddocs.end()) {
+	if (indexeddocs.find(i) == indexeddocs.end()) {
 	    /* We don't have the document cached */
-	    set<Xapian::doccount>::const_iterator s;
-	    s = requested_docs.find(i);
-	    if (s == requested_docs.end()) {
-		/* We haven't even requested it yet - do so now. */
-		enquire->request_doc(items[i - firstitem]);
-		requested_docs.insert(i);
-	    }
+	    indices.push_back(i);
+	    dids.push_back(items[i].did);
 	}
     }
+    if (dids.empty()) return;
+
+    vector<Document> docs;
+    enquire->read_docs(dids, docs);
+    for (size_t j = 0; j != indices.size(); ++j) {
+	indexeddocs[indices[j]] = docs[j];
+	LOGLINE(MATCH, "stored doc at index " << indices[j] << " is " << docs[j]);
+    }
 }
 
 string
@@ -449,18 +453,6 @@ MSet::Internal::get_description() const
     return description;
 }
 
-void
-MSet::Internal::read_docs() const
-{
-    set<Xapian::doccount>::const_iterator i;
-    for (i = requested_docs.begin(); i != requested_docs.end(); ++i) {
-	indexeddocs[*i] = enquire->read_doc(items[*i - firstitem]);
-	LOGLINE(MATCH, "stored doc at index " << *i << " is " << indexeddocs[*i]);
-    }
-    /* Clear list of requested but not fetched documents. */
-    requested_docs.clear();
-}
-
 // Methods for Xapian::ESet
 
 ESet::ESet() : internal(new Internal) { }
@@ -623,7 +615,7 @@ MSetIterator::get_description() const
 Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
-    sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
+    match_threads(0), sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
     sorter(0), errorhandler(errorhandler_), weight(0)
 {
     if (db.internal.empty()) {
@@ -650,6 +642,80 @@ Enquire::Internal::get_query()
     return query;
 }
 
+bool
+Enquire::Internal::get_cache_key(Xapian::doccount first,
+				 Xapian::doccount maxitems,
+				 Xapian::doccount check_at_least,
+				 const RSet *rset, const MatchDecider *mdecider,
+				 string & dbkey, string & revision,
+				 string & key) const
+{
+    LOGCALL(MATCH, bool, "Enquire::Internal::get_cache_key", first | maxitems | check_at_least | rset | mdecider | dbkey | revision | key);
+
+    // We can't tell if user-supplied functors would give the same results
+    // again, and spies need to see the documents.  If an error handler is
+    // set, a failing sub-database would lead to a partial result which we
+    // mustn't cache.
+    if (mdecider || sorter || !spies.empty() || errorhandler)
+	RETURN(false);
+
+    // Identify the databases and their revisions.  Backends which can't
+    // tell us their revision throw UnimplementedError, and those without a
+    // uuid return an empty string.  Uncommitted changes are searched but
+    // don't change the revision, so we can't cache results which may
+    // include them.
+    try {
+	vector<Xapian::Internal::intrusive_ptr<Database::Internal> >::const_iterator i;
+	for (i = db.internal.begin(); i != db.internal.end(); ++i) {
+	    string uuid = (*i)->get_uuid();
+	    if (uuid.empty() || (*i)->has_uncommitted_changes()) RETURN(false);
+	    pack_string(dbkey, uuid);
+	    pack_string(revision, (*i)->get_revision_info());
+	}
+    } catch (const Xapian::UnimplementedError &) {
+	RETURN(false);
+    }
+
+    // The same query could give a different MSet against a different
+    // revision, so the revision needs to be part of the key too.
+    pack_string(key, dbkey);
+    pack_string(key, revision);
+    try {
+	// This throws UnimplementedError for PostingSource and Weight
+	// subclasses which don't support serialisation.
+	pack_string(key, query.serialise());
+	string wt_name = weight->name();
+	if (wt_name.empty()) RETURN(false);
+	pack_string(key, wt_name);
+	pack_string(key, weight->serialise());
+    } catch (const Xapian::UnimplementedError &) {
+	RETURN(false);
+    }
+    pack_uint(key, qlen);
+    pack_uint(key, collapse_key);
+    pack_uint(key, collapse_max);
+    pack_uint(key, unsigned(order));
+    pack_uint(key, unsigned(percent_cutoff));
+    key += serialise_double(weight_cutoff);
+    pack_uint(key, sort_key);
+    pack_uint(key, unsigned(sort_by));
+    pack_bool(key, sort_value_forward);
+    pack_uint(key, first);
+    pack_uint(key, maxitems);
+    pack_uint(key, check_at_least);
+    if (rset) {
+	const set<Xapian::docid> & items = rset->internal->get_items();
+	pack_uint(key, items.size());
+	set<Xapian::docid>::const_iterator d;
+	for (d = items.begin(); d != items.end(); ++d) {
+	    pack_uint(key, *d);
+	}
+    } else {
+	pack_uint(key, 0u);
+    }
+    RETURN(true);
+}
+
 MSet
 Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    Xapian::doccount check_at_least, const RSet *rset,
@@ -665,6 +731,21 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	weight = new BM25Weight;
     }
 
+    string cache_dbkey, cache_revision, cache_key;
+    bool use_cache = false;
+    if (cache.get()) {
+	use_cache = get_cache_key(first, maxitems, check_at_least, rset,
+				  mdecider, cache_dbkey, cache_revision,
+				  cache_key);
+	if (use_cache) {
+	    MSet retval;
+	    if (cache->lookup(cache_dbkey, cache_revision, cache_key, retval)) {
+		retval.internal->enquire = this;
+		RETURN(retval);
+	    }
+	}
+    }
+
     Xapian::doccount first_orig = first;
     {
 	Xapian::doccount docs = db.get_doccount();
@@ -679,7 +760,7 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		       collapse_max, collapse_key,
 		       percent_cutoff, weight_cutoff,
 		       order, sort_key, sort_by, sort_value_forward,
-		       errorhandler, stats, weight, spies,
+		       match_threads, errorhandler, stats, weight, spies,
 		       (sorter != NULL),
 		       (mdecider != NULL));
     // Run query and put results into supplied Xapian::MSet object.
@@ -692,6 +773,10 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 
     Assert(weight->name() != "bool" || retval.get_max_possible() == 0);
 
+    if (use_cache) {
+	cache->store(cache_dbkey, cache_revision, cache_key, retval);
+    }
+
     // The Xapian::MSet needs to have a pointer to ourselves, so that it can
     // retrieve the documents.  This is set here explicitly to avoid having
     // to pass it into the matcher, which gets messy particularly in the
@@ -826,33 +911,39 @@ Enquire::Internal::get_description() const
 // Private methods for Xapian::Enquire::Internal
 
 void
-Enquire::Internal::request_doc(const Xapian::Internal::MSetItem &item) const
-{
-    try {
-	unsigned int multiplier = db.internal.size();
-
-	Xapian::docid realdid = (item.did - 1) / multiplier + 1;
-	Xapian::doccount dbnumber = (item.did - 1) % multiplier;
-
-	db.internal[dbnumber]->request_document(realdid);
-    } catch (Error & e) {
-	if (errorhandler) (*errorhandler)(e);
-	throw;
-    }
-}
-
-Document
-Enquire::Internal::read_doc(const Xapian::Internal::MSetItem &item) const
+Enquire::Internal::read_docs(const vector<Xapian::docid> & dids,
+			     vector<Xapian::Document> & docs) const
 {
     try {
-	unsigned int multiplier = db.internal.size();
-
-	Xapian::docid realdid = (item.did - 1) / multiplier + 1;
-	Xapian::doccount dbnumber = (item.did - 1) % multiplier;
+	size_t multiplier = db.internal.size();
+	docs.resize(dids.size());
+
+	// Split the docids up by sub-database, and sort them so each
+	// sub-database can read its documents in a single pass.
+	vector<vector<pair<Xapian::docid, size_t> > > subdids(multiplier);
+	for (size_t i = 0; i != dids.size(); ++i) {
+	    Xapian::docid realdid = (dids[i] - 1) / multiplier + 1;
+	    Xapian::doccount dbnumber = (dids[i] - 1) % multiplier;
+	    subdids[dbnumber].push_back(make_pair(realdid, i));
+	}
 
-	Xapian::Document::Internal *doc;
-	doc = db.internal[dbnumber]->collect_document(realdid);
-	return Document(doc);
+	vector<Xapian::docid> realdids;
+	vector<Xapian::Document> subdocs;
+	for (size_t n = 0; n != multiplier; ++n) {
+	    vector<pair<Xapian::docid, size_t> > & sub = subdids[n];
+	    if (sub.empty()) continue;
+	    sort(sub.begin(), sub.end());
+	    realdids.clear();
+	    for (size_t j = 0; j != sub.size(); ++j) {
+		realdids.push_back(sub[j].first);
+	    }
+	    subdocs.clear();
+	    db.internal[n]->open_documents(realdids, subdocs);
+	    AssertEq(subdocs.size(), sub.size());
+	    for (size_t j = 0; j != sub.size(); ++j) {
+		docs[sub[j].second] = subdocs[j];
+	    }
+	}
     } catch (Error & e) {
 	if (errorhandler) (*errorhandler)(e);
 	throw;
@@ -915,6 +1006,20 @@ Enquire::clear_matchspies() {
     internal->spies.clear();
 }
 
+void
+Enquire::set_cache(const MSetCache & cache)
+{
+    LOGCALL_VOID(API, "Xapian::Enquire::set_cache", cache);
+    internal->cache = cache.internal;
+}
+
+void
+Enquire::unset_cache()
+{
+    LOGCALL_VOID(API, "Xapian::Enquire::unset_cache", NO_ARGS);
+    internal->cache = NULL;
+}
+
 void
 Enquire::set_weighting_scheme(const Weight &weight_)
 {
@@ -946,6 +1051,12 @@ Enquire::set_cutoff(Xapian::percent percent_cutoff, Xapian::weight weight_cutoff
     internal->weight_cutoff = weight_cutoff;
 }
 
+void
+Enquire::set_match_threads(unsigned threads)
+{
+    internal->match_threads = threads;
+}
+
 void
 Enquire::set_sort_by_relevance()
 {
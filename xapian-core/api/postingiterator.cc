@@ -148,6 +148,20 @@ PostingIterator::skip_to(Xapian::docid did)
     post_advance(internal->skip_to(did));
 }
 
+Xapian::doccount
+PostingIterator::get_batch(Xapian::doccount n, Xapian::docid * dids,
+			   Xapian::termcount * wdfs, Xapian::termcount * doclens)
+{
+    LOGCALL(API, Xapian::doccount, "PostingIterator::get_batch", n | dids | wdfs | doclens);
+    if (!internal) RETURN(0);
+    Xapian::doccount count = internal->get_batch(n, dids, wdfs, doclens);
+    if (internal->at_end()) {
+	decref();
+	internal = NULL;
+    }
+    RETURN(count);
+}
+
 std::string
 PostingIterator::get_description() const
 {
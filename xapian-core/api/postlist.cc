@@ -71,6 +71,29 @@ PostList::check(Xapian::docid did, Xapian::weight w_min, bool &valid)
     return skip_to(did, w_min);
 }
 
+void
+PostList::prefetch_skip_to(Xapian::docid)
+{
+}
+
+Xapian::doccount
+PostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+		    Xapian::termcount * wdfs, Xapian::termcount * doclens)
+{
+    Xapian::doccount count = 0;
+    while (count != n && !at_end()) {
+	dids[count] = get_docid();
+	if (wdfs) wdfs[count] = get_wdf();
+	if (doclens) doclens[count] = get_doclength();
+	++count;
+	Internal * res = next();
+	// We don't support batches from a PostList which might prune.
+	Assert(res == NULL);
+	(void)res;
+    }
+    return count;
+}
+
 Xapian::termcount
 PostList::count_matching_subqs() const
 {
@@ -1,4 +1,5 @@
 noinst_HEADERS +=\
+	backends/blockcache.h\
 	backends/flint_lock.h\
 	backends/byte_length_strings.h\
 	backends/prefix_compressed_strings.h\
@@ -23,11 +24,13 @@ endif
 
 if BUILD_BACKEND_CHERT
 lib_src +=\
+	backends/blockcache.cc\
         backends/contiguousalldocspostlist.cc\
 	backends/flint_lock.cc
 else
 if BUILD_BACKEND_BRASS
 lib_src +=\
+	backends/blockcache.cc\
         backends/contiguousalldocspostlist.cc\
 	backends/flint_lock.cc
 endif
@@ -0,0 +1,244 @@
+/** @file blockcache.cc
+ * @brief Process-wide cache of B-tree blocks, shared by all tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "blockcache.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+#include "safesysstat.h"
+
+#include <cstdlib> // For getenv() and strtoul().
+#include <cstring> // For memcpy().
+
+using namespace std;
+
+BlockCache::BlockCache(size_t size)
+    : shard_budget(size / SHARDS)
+{
+    LOGCALL_CTOR(DB, "BlockCache", size);
+}
+
+BlockCache::~BlockCache()
+{
+    LOGCALL_DTOR(DB, "BlockCache");
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	Shard & shard = shards[i];
+	vector<Entry>::iterator e;
+	for (e = shard.entries.begin(); e != shard.entries.end(); ++e) {
+	    delete [] e->data;
+	}
+    }
+}
+
+/// Create the process-wide cache, or return NULL if it is disabled.
+static BlockCache *
+create_instance()
+{
+    size_t size = BlockCache::DEFAULT_SIZE;
+    const char * p = getenv("XAPIAN_BLOCK_CACHE_SIZE");
+    if (p && *p) size = strtoul(p, NULL, 10);
+    if (size == 0) return NULL;
+    return new BlockCache(size);
+}
+
+BlockCache *
+BlockCache::get_instance()
+{
+    // The cache is deliberately never deleted, as tables may be destroyed
+    // during static destruction, after a static BlockCache object would have
+    // been.  The compiler ensures the initialisation only happens once, even
+    // if several threads get here at the same time.
+    static BlockCache * instance = create_instance();
+    return instance;
+}
+
+void
+BlockCache::remove_entry(Shard & shard, size_t i)
+{
+    Entry & e = shard.entries[i];
+    shard.used -= e.size;
+    delete [] e.data;
+    shard.index.erase(e.key);
+    size_t last = shard.entries.size() - 1;
+    if (i != last) {
+	// Move the last entry into the gap to keep the ring dense.
+	shard.entries[i] = shard.entries[last];
+	shard.index[shard.entries[i].key] = i;
+    }
+    shard.entries.pop_back();
+    if (shard.hand >= shard.entries.size()) shard.hand = 0;
+}
+
+bool
+BlockCache::make_room(Shard & shard, size_t size)
+{
+    if (size > shard_budget) return false;
+    while (shard.used + size > shard_budget) {
+	Assert(!shard.entries.empty());
+	Entry & e = shard.entries[shard.hand];
+	if (e.referenced) {
+	    // Give this entry a second chance.
+	    e.referenced = false;
+	    if (++shard.hand == shard.entries.size()) shard.hand = 0;
+	    continue;
+	}
+	remove_entry(shard, shard.hand);
+    }
+    return true;
+}
+
+bool
+BlockCache::lookup(const Key & key, unsigned char * p, size_t size)
+{
+    Shard & shard = get_shard(key);
+    MutexLock lock(shard.mutex);
+    unordered_map<Key, size_t, KeyHash>::const_iterator i;
+    i = shard.index.find(key);
+    if (i == shard.index.end()) {
+	++shard.misses;
+	return false;
+    }
+    Entry & e = shard.entries[i->second];
+    if (rare(e.size != size)) {
+	// Shouldn't happen as a file's block size can't change while it keeps
+	// the same inode, but don't return a block of the wrong size.
+	++shard.misses;
+	return false;
+    }
+    memcpy(p, e.data, size);
+    e.referenced = true;
+    ++shard.hits;
+    return true;
+}
+
+void
+BlockCache::insert(const Key & key, const unsigned char * p, size_t size)
+{
+    Shard & shard = get_shard(key);
+    MutexLock lock(shard.mutex);
+    if (shard.index.find(key) != shard.index.end()) return;
+    if (!make_room(shard, size)) return;
+    unsigned char * data = new unsigned char[size];
+    memcpy(data, p, size);
+    shard.index[key] = shard.entries.size();
+    shard.entries.push_back(Entry(key, data, size));
+    shard.used += size;
+}
+
+bool
+BlockCache::get_file_id(int fd, FileId & file)
+{
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) return false;
+    file.dev = sb.st_dev;
+    file.ino = sb.st_ino;
+    file.mtime = sb.st_mtime;
+#if defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    file.mtime_nsec = sb.st_mtim.tv_nsec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+    file.mtime_nsec = sb.st_mtimespec.tv_nsec;
+#else
+    file.mtime_nsec = 0;
+#endif
+    return true;
+}
+
+void
+BlockCache::invalidate_file(const FileId & file)
+{
+    LOGCALL_VOID(DB, "BlockCache::invalidate_file", file.ino);
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	Shard & shard = shards[i];
+	MutexLock lock(shard.mutex);
+	size_t j = 0;
+	while (j < shard.entries.size()) {
+	    if (shard.entries[j].key.file.same_file(file)) {
+		// remove_entry() moves the last entry into slot j.
+		remove_entry(shard, j);
+	    } else {
+		++j;
+	    }
+	}
+    }
+}
+
+void
+BlockCache::set_size(size_t size)
+{
+    LOGCALL_VOID(DB, "BlockCache::set_size", size);
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	Shard & shard = shards[i];
+	MutexLock lock(shard.mutex);
+	// Only the first shard needs to update shard_budget, but it's harmless
+	// to do it under each lock, and means make_room() below sees it.
+	shard_budget = size / SHARDS;
+	while (shard.used > shard_budget) {
+	    remove_entry(shard, shard.entries.size() - 1);
+	}
+    }
+}
+
+size_t
+BlockCache::get_used()
+{
+    size_t total = 0;
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	MutexLock lock(shards[i].mutex);
+	total += shards[i].used;
+    }
+    return total;
+}
+
+unsigned long
+BlockCache::get_hits()
+{
+    unsigned long total = 0;
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	MutexLock lock(shards[i].mutex);
+	total += shards[i].hits;
+    }
+    return total;
+}
+
+unsigned long
+BlockCache::get_misses()
+{
+    unsigned long total = 0;
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	MutexLock lock(shards[i].mutex);
+	total += shards[i].misses;
+    }
+    return total;
+}
+
+void
+BlockCache::clear()
+{
+    LOGCALL_VOID(DB, "BlockCache::clear", NO_ARGS);
+    for (unsigned i = 0; i != SHARDS; ++i) {
+	Shard & shard = shards[i];
+	MutexLock lock(shard.mutex);
+	while (!shard.entries.empty()) {
+	    remove_entry(shard, shard.entries.size() - 1);
+	}
+	shard.hand = 0;
+	shard.hits = shard.misses = 0;
+    }
+}
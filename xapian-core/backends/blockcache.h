@@ -0,0 +1,243 @@
+/** @file blockcache.h
+ * @brief Process-wide cache of B-tree blocks, shared by all tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_BLOCKCACHE_H
+
+#include <xapian/visibility.h>
+
+#include "mutex.h"
+#include "unordered_map.h"
+
+#include <ctime>
+#include <sys/types.h>
+#include <vector>
+
+/** A sized, sharded cache of B-tree blocks.
+ *
+ *  Every read-only BrassTable and ChertTable in the process looks blocks up
+ *  here before calling pread(), so the upper levels of the B-trees which
+ *  every lookup descends through are read from disk once, rather than once
+ *  per Database handle and cursor.
+ *
+ *  Blocks are keyed by the identity of the file they come from (see FileId),
+ *  the block number, and the revision of the table the reader has open.
+ *  Blocks are copied-on-write between revisions, so a block number can be
+ *  reused for different data by a later revision, but whatever a
+ *  reader at a particular revision sees in a block is fixed - keying by the
+ *  revision means we never need to invalidate anything (old entries just age
+ *  out).
+ *
+ *  The cache is split into shards, each with its own lock, so concurrent
+ *  readers in different threads rarely contend.  Within each shard we evict
+ *  using the CLOCK algorithm, which approximates LRU without needing to
+ *  reorder anything on a hit.
+ *
+ *  The size of the cache (in bytes, summed over all shards) defaults to
+ *  DEFAULT_SIZE, and can be set with the environment variable
+ *  XAPIAN_BLOCK_CACHE_SIZE (a value of 0 disables the cache).
+ */
+class XAPIAN_VISIBILITY_DEFAULT BlockCache {
+  public:
+    /** Identifies a particular state of the file a block was read from.
+     *
+     *  As well as the device and inode numbers, this includes the time the
+     *  file was last modified.  Tables find this once when they open the
+     *  file (see get_file_id()), rather than for every block they read, so
+     *  we won't mistake blocks from a deleted database for those of a new
+     *  one whose table files happen to get the same inode numbers.
+     */
+    struct FileId {
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	long mtime_nsec;
+
+	FileId() : dev(0), ino(0), mtime(0), mtime_nsec(0) { }
+
+	bool same_file(const FileId & o) const {
+	    return dev == o.dev && ino == o.ino;
+	}
+
+	bool operator==(const FileId & o) const {
+	    return same_file(o) && mtime == o.mtime &&
+		   mtime_nsec == o.mtime_nsec;
+	}
+
+	size_t hash() const {
+	    size_t h = size_t(ino) * 2654435761u;
+	    h ^= size_t(dev) + (h << 6) + (h >> 2);
+	    h ^= size_t(mtime) + (h << 6) + (h >> 2);
+	    h ^= size_t(mtime_nsec) + (h << 6) + (h >> 2);
+	    return h;
+	}
+    };
+
+    /// The key for a cached block.
+    struct Key {
+	FileId file;
+	unsigned n;
+	unsigned revision;
+
+	Key(const FileId & file_, unsigned n_, unsigned revision_)
+	    : file(file_), n(n_), revision(revision_) { }
+
+	bool operator==(const Key & o) const {
+	    return n == o.n && revision == o.revision && file == o.file;
+	}
+
+	size_t hash() const {
+	    size_t h = file.hash();
+	    h ^= size_t(n) * 40503u + (h << 6) + (h >> 2);
+	    h ^= size_t(revision) + (h << 6) + (h >> 2);
+	    return h;
+	}
+    };
+
+    /// Default cache size in bytes.
+    static const size_t DEFAULT_SIZE = 32 * 1024 * 1024;
+
+    /// Number of shards (a power of 2).
+    static const unsigned SHARDS = 16;
+
+  private:
+    struct KeyHash {
+	size_t operator()(const Key & key) const { return key.hash(); }
+    };
+
+    struct Entry {
+	Key key;
+	unsigned char * data;
+	size_t size;
+	bool referenced;
+
+	Entry(const Key & key_, unsigned char * data_, size_t size_)
+	    : key(key_), data(data_), size(size_), referenced(false) { }
+    };
+
+    struct Shard {
+	Mutex mutex;
+
+	/// Map from a key to its index in entries.
+	std::unordered_map<Key, size_t, KeyHash> index;
+
+	/// The CLOCK ring.
+	std::vector<Entry> entries;
+
+	/// The CLOCK hand - the next candidate for eviction.
+	size_t hand;
+
+	/// Total size of the blocks held in this shard.
+	size_t used;
+
+	unsigned long hits, misses;
+
+	Shard() : hand(0), used(0), hits(0), misses(0) { }
+    };
+
+    Shard shards[SHARDS];
+
+    /// Maximum number of bytes to cache in each shard.
+    size_t shard_budget;
+
+    /// Don't allow copying.
+    BlockCache(const BlockCache &);
+
+    /// Don't allow assignment.
+    void operator=(const BlockCache &);
+
+    Shard & get_shard(const Key & key) {
+	return shards[key.hash() & (SHARDS - 1)];
+    }
+
+    /** Evict entries from @a shard until there's room for @a size bytes.
+     *
+     *  @return false if the block can't fit in the shard at all.
+     */
+    bool make_room(Shard & shard, size_t size);
+
+    /// Remove the entry at index @a i in @a shard.
+    void remove_entry(Shard & shard, size_t i);
+
+  public:
+    /// Construct a cache holding up to @a size bytes.
+    explicit BlockCache(size_t size);
+
+    ~BlockCache();
+
+    /** Return the process-wide cache.
+     *
+     *  Returns NULL if the cache is disabled.
+     */
+    static BlockCache * get_instance();
+
+    /** Look up a block.
+     *
+     *  @param key	The block to look for.
+     *  @param p	Buffer of @a size bytes to copy the block into.
+     *  @param size	The block size.
+     *
+     *  @return true if the block was found (and copied into @a p).
+     */
+    bool lookup(const Key & key, unsigned char * p, size_t size);
+
+    /** Add a block to the cache.
+     *
+     *  If the block is already cached, this does nothing.
+     */
+    void insert(const Key & key, const unsigned char * p, size_t size);
+
+    /** Discard all cached blocks from a file.
+     *
+     *  This is called when a table's file is created or truncated, since any
+     *  blocks cached from a previous incarnation of it are now just wasting
+     *  space.
+     */
+    void invalidate_file(const FileId & file);
+
+    /** Change the size of the cache.
+     *
+     *  If the cache is shrinking, blocks are evicted as needed.  A size of 0
+     *  empties the cache and stops anything further being added.
+     */
+    void set_size(size_t size);
+
+    /// Return the current size limit of the cache in bytes.
+    size_t get_size() const { return shard_budget * SHARDS; }
+
+    /** Fill in @a file to identify the file open as @a fd.
+     *
+     *  @return false if the file couldn't be identified (in which case blocks
+     *		from it shouldn't be cached).
+     */
+    static bool get_file_id(int fd, FileId & file);
+
+    /// Return the number of bytes of blocks currently cached.
+    size_t get_used();
+
+    /// Return the number of lookups which found the block.
+    unsigned long get_hits();
+
+    /// Return the number of lookups which didn't find the block.
+    unsigned long get_misses();
+
+    /// Discard all cached blocks (and reset the hit and miss counts).
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_BLOCKCACHE_H
@@ -13,12 +13,15 @@ noinst_HEADERS +=\
 	backends/brass/brass_database.h\
 	backends/brass/brass_databasereplicator.h\
 	backends/brass/brass_dbstats.h\
+	backends/brass/brass_dictionary.h\
+	backends/brass/brass_doclenarray.h\
 	backends/brass/brass_document.h\
 	backends/brass/brass_inverter.h\
 	backends/brass/brass_lazytable.h\
 	backends/brass/brass_metadata.h\
 	backends/brass/brass_positionlist.h\
 	backends/brass/brass_postlist.h\
+	backends/brass/brass_postlistblock.h\
 	backends/brass/brass_record.h\
 	backends/brass/brass_replicate_internal.h\
 	backends/brass/brass_spelling.h\
@@ -44,6 +47,8 @@ lib_src +=\
 	backends/brass/brass_database.cc\
 	backends/brass/brass_databasereplicator.cc\
 	backends/brass/brass_dbstats.cc\
+	backends/brass/brass_dictionary.cc\
+	backends/brass/brass_doclenarray.cc\
 	backends/brass/brass_document.cc\
 	backends/brass/brass_inverter.cc\
 	backends/brass/brass_metadata.cc\
@@ -22,6 +22,7 @@
 #include <config.h>
 #include "brass_alldocspostlist.h"
 
+#include <algorithm>
 #include <string>
 
 #include "brass_database.h"
@@ -63,6 +64,18 @@ BrassAllDocsPostList::get_wdf() const
     RETURN(1);
 }
 
+Xapian::doccount
+BrassAllDocsPostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+				Xapian::termcount * wdfs,
+				Xapian::termcount * doclens)
+{
+    LOGCALL(DB, Xapian::doccount, "BrassAllDocsPostList::get_batch", n | dids | wdfs | doclens);
+    // The stored "wdfs" are the document lengths.
+    Xapian::doccount count = read_raw_batch(n, dids, doclens);
+    if (wdfs) fill(wdfs, wdfs + count, Xapian::termcount(1));
+    RETURN(count);
+}
+
 PositionList *
 BrassAllDocsPostList::read_position_list()
 {
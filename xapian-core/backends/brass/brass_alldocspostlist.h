@@ -46,6 +46,10 @@ class BrassAllDocsPostList : public BrassPostList {
 
     Xapian::termcount get_wdf() const;
 
+    Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+			       Xapian::termcount * wdfs,
+			       Xapian::termcount * doclens);
+
     PositionList *read_position_list();
 
     PositionList *open_position_list() const;
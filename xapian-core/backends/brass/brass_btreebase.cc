@@ -65,11 +65,18 @@ using namespace std;
  * ITEM_COUNT
  * LAST_BLOCK
  * HAVE_FAKEROOT
+ * SEQUENTIAL
+ * DICT_SIZE	The size of the preset dictionary used to compress tags (0 if
+ * 		there isn't one).
  * REVISION2	A second copy of the revision number, for consistency checks.
+ * DICTIONARY	The preset dictionary.  This will be DICT_SIZE raw bytes.
  * BITMAP	The bitmap.  This will be BIT_MAP_SIZE raw bytes.
  * REVISION3	A third copy of the revision number, for consistency checks.
  */
-#define CURR_FORMAT 5U
+#define CURR_FORMAT 6U
+
+/// The largest preset dictionary zlib can make use of.
+#define MAX_DICT_SIZE 32768U
 
 BrassTable_base::BrassTable_base()
 	: revision(0),
@@ -97,6 +104,7 @@ BrassTable_base::BrassTable_base(const BrassTable_base &other)
 	  last_block(other.last_block),
 	  have_fakeroot(other.have_fakeroot),
 	  sequential(other.sequential),
+	  dictionary(other.dictionary),
 	  bit_map_low(other.bit_map_low),
 	  bit_map0(0),
 	  bit_map(0)
@@ -125,6 +133,7 @@ BrassTable_base::swap(BrassTable_base &other)
     std::swap(last_block, other.last_block);
     std::swap(have_fakeroot, other.have_fakeroot);
     std::swap(sequential, other.sequential);
+    std::swap(dictionary, other.dictionary);
     std::swap(bit_map_low, other.bit_map_low);
     std::swap(bit_map0, other.bit_map0);
     std::swap(bit_map, other.bit_map);
@@ -232,6 +241,13 @@ BrassTable_base::read(const string & name, char ch, bool read_bitmap,
     DO_UNPACK_UINT_ERRCHECK(&start, end, sequential_);
     sequential = sequential_;
 
+    uint4 dict_size;
+    DO_UNPACK_UINT_ERRCHECK(&start, end, dict_size);
+    if (dict_size > MAX_DICT_SIZE) {
+	err_msg += "Dictionary too large in " + basename + "\n";
+	return false;
+    }
+
     if (have_fakeroot && !sequential) {
 	sequential = true; // FIXME : work out why we need this...
 	/*
@@ -252,6 +268,19 @@ BrassTable_base::read(const string & name, char ch, bool read_bitmap,
 	return false;
     }
 
+    // The dictionary is needed to read compressed tags, so we read it even
+    // if we don't want the bitmap.
+    size_t n = end - start;
+    if (n < dict_size) {
+	dictionary.assign(start, n);
+	dictionary.resize(dict_size);
+	(void)io_read(h, &dictionary[n], dict_size - n, dict_size - n);
+	start = end;
+    } else {
+	dictionary.assign(start, dict_size);
+	start += dict_size;
+    }
+
     /* It's ok to delete a zero pointer */
     delete [] bit_map0;
     bit_map0 = 0;
@@ -264,7 +293,7 @@ BrassTable_base::read(const string & name, char ch, bool read_bitmap,
     bit_map0 = new byte[bit_map_size];
     bit_map = new byte[bit_map_size];
 
-    size_t n = end - start;
+    n = end - start;
     if (n < bit_map_size) {
 	memcpy(bit_map0, start, n);
 	(void)io_read(h, reinterpret_cast<char *>(bit_map0) + n,
@@ -323,7 +352,9 @@ BrassTable_base::write_to_file(const string &filename,
     pack_uint(buf, static_cast<uint4>(last_block));
     pack_uint(buf, have_fakeroot);
     pack_uint(buf, sequential);
+    pack_uint(buf, dictionary.size());
     pack_uint(buf, revision);  // REVISION2
+    buf += dictionary;
     if (bit_map_size > 0) {
 	buf.append(reinterpret_cast<const char *>(bit_map), bit_map_size);
     }
@@ -62,6 +62,7 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 	uint4 get_last_block() const { return last_block; }
 	bool get_have_fakeroot() const { return have_fakeroot; }
 	bool get_sequential() const { return sequential; }
+	const std::string & get_dictionary() const { return dictionary; }
 
 	void set_revision(uint4 revision_) {
 	    revision = revision_;
@@ -84,6 +85,9 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 	void set_sequential(bool sequential_) {
 	    sequential = sequential_;
 	}
+	void set_dictionary(const std::string & dictionary_) {
+	    dictionary = dictionary_;
+	}
 
 	/** Write the btree base file to disk. */
 	void write_to_file(const std::string &filename,
@@ -139,6 +143,9 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 	bool have_fakeroot;
 	bool sequential;
 
+	/// Preset dictionary for compressing tags (empty if there isn't one).
+	std::string dictionary;
+
 	/* Data related to the bitmap */
 	/** byte offset into the bit map below which there
 	   are no free blocks */
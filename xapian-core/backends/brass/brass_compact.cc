@@ -35,8 +35,14 @@
 #include "brass_table.h"
 #include "brass_compact.h"
 #include "brass_cursor.h"
+#include "brass_dictionary.h"
+#include "brass_postlist.h"
 #include "internaltypes.h"
+#include "mutex.h"
 #include "pack.h"
+#include "realtime.h"
+#include "str.h"
+#include "threadpool.h"
 #include "utils.h"
 #include "valuestats.h"
 
@@ -74,12 +80,54 @@ is_valuechunk_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xd8';
 }
 
+static inline bool
+is_valuesummary_key(const string & key)
+{
+    return key.size() > 1 && key[0] == '\0' && key[1] == '\xd9';
+}
+
 static inline bool
 is_doclenchunk_key(const string & key)
 {
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xe0';
 }
 
+/// Update the flag in a postlist chunk header saying if it's the last chunk.
+static inline void
+set_is_last_chunk(string & tag, bool is_last)
+{
+    bool old_is_last, is_packed;
+    if (tag.empty() || !Brass::decode_chunk_flag(tag[0], &old_is_last, &is_packed))
+	throw Xapian::DatabaseCorruptError("Bad postlist chunk flag");
+    tag[0] = Brass::encode_chunk_flag(is_last, is_packed);
+}
+
+/** Serialises calls to the Compactor's virtual methods.
+ *
+ *  When tables are merged in parallel, the user's subclass mustn't be called
+ *  from more than one thread at once.
+ */
+class CompactorCallbacks {
+    Xapian::Compactor & compactor;
+
+    Mutex mutex;
+
+  public:
+    explicit CompactorCallbacks(Xapian::Compactor & compactor_)
+	: compactor(compactor_) { }
+
+    void set_status(const string & table, const string & status) {
+	MutexLock lock(mutex);
+	compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string & key,
+				      size_t num_tags, const string tags[]) {
+	MutexLock lock(mutex);
+	return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
 class PostlistCursor : private BrassCursor {
     Xapian::docid offset;
 
@@ -88,11 +136,22 @@ class PostlistCursor : private BrassCursor {
     Xapian::docid firstdid;
     Xapian::termcount tf, cf;
 
-    PostlistCursor(BrassTable *in, Xapian::docid offset_)
+    /** Construct a cursor.
+     *
+     *  @param start	If non-empty, position on the first entry with a key
+     *			>= @a start, rather than on the first entry.
+     */
+    PostlistCursor(BrassTable *in, Xapian::docid offset_,
+		   const string & start = string())
 	: BrassCursor(in), offset(offset_), firstdid(0)
     {
-	find_entry(string());
-	next();
+	if (start.empty()) {
+	    find_entry(string());
+	    next();
+	} else {
+	    find_entry_ge(start);
+	    if (!after_end()) read_entry();
+	}
     }
 
     ~PostlistCursor()
@@ -100,18 +159,28 @@ class PostlistCursor : private BrassCursor {
 	delete BrassCursor::get_table();
     }
 
+    using BrassCursor::after_end;
+
     bool next() {
 	if (!BrassCursor::next()) return false;
+	read_entry();
+	return true;
+    }
+
+  private:
+    void read_entry() {
 	// We put all chunks into the non-initial chunk form here, then fix up
 	// the first chunk for each term in the merged database as we merge.
 	read_tag();
 	key = current_key;
 	tag = current_tag;
 	tf = cf = 0;
-	if (is_metainfo_key(key)) return true;
-	if (is_user_metadata_key(key)) return true;
-	if (is_valuestats_key(key)) return true;
-	if (is_valuechunk_key(key)) {
+	if (is_metainfo_key(key)) return;
+	if (is_user_metadata_key(key)) return;
+	if (is_valuestats_key(key)) return;
+	if (is_valuechunk_key(key) || is_valuesummary_key(key)) {
+	    // Value chunk summaries have keys of the same form as the chunks.
+	    char type = key[1];
 	    const char * p = key.data();
 	    const char * end = p + key.length();
 	    p += 2;
@@ -123,10 +192,11 @@ class PostlistCursor : private BrassCursor {
 		throw Xapian::DatabaseCorruptError("bad value key");
 	    did += offset;
 
-	    key.assign("\0\xd8", 2);
+	    key.assign(1, '\0');
+	    key += type;
 	    pack_uint(key, slot);
 	    pack_uint_preserving_sort(key, did);
-	    return true;
+	    return;
 	}
 
 	// Adjust key if this is *NOT* an initial chunk.
@@ -165,7 +235,6 @@ class PostlistCursor : private BrassCursor {
 	    }
 	}
 	firstdid += offset;
-	return true;
     }
 };
 
@@ -194,12 +263,21 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
+/** Merge postlist tables.
+ *
+ *  If @a start_key or @a end_key is non-empty, only the terms with initial
+ *  chunk keys in the range [start_key, end_key) are merged.  Both must be the
+ *  initial chunk key of a term, and if @a start_key is non-empty nothing
+ *  except term postlists is merged.
+ */
 static void
-merge_postlists(Xapian::Compactor & compactor,
+merge_postlists(CompactorCallbacks & compactor,
 		BrassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<string>::const_iterator b,
 		vector<string>::const_iterator e,
-		Xapian::docid last_docid)
+		Xapian::docid last_docid,
+		const string & start_key = string(),
+		const string & end_key = string())
 {
     totlen_t tot_totlen = 0;
     Xapian::termcount doclen_lbound = static_cast<Xapian::termcount>(-1);
@@ -217,7 +295,17 @@ merge_postlists(Xapian::Compactor & compactor,
 
 	// PostlistCursor takes ownership of BrassTable in and is
 	// responsible for deleting it.
-	PostlistCursor * cur = new PostlistCursor(in, *offset);
+	PostlistCursor * cur = new PostlistCursor(in, *offset, start_key);
+	if (!start_key.empty()) {
+	    // We're starting part way through, so there's no METAINFO to
+	    // merge.
+	    if (cur->after_end()) {
+		delete cur;
+	    } else {
+		pq.push(cur);
+	    }
+	    continue;
+	}
 	// Merge the METAINFO tags from each database into one.
 	// They have a key consisting of a single zero byte.
 	// They may be absent, if the database contains no documents.  If it
@@ -265,7 +353,7 @@ merge_postlists(Xapian::Compactor & compactor,
 	}
     }
 
-    {
+    if (start_key.empty()) {
 	string tag;
 	pack_uint(tag, last_docid);
 	pack_uint(tag, doclen_lbound);
@@ -384,11 +472,11 @@ merge_postlists(Xapian::Compactor & compactor,
 	}
     }
 
-    // Merge valuestream chunks.
+    // Merge valuestream chunks and their summaries.
     while (!pq.empty()) {
 	PostlistCursor * cur = pq.top();
 	const string & key = cur->key;
-	if (!is_valuechunk_key(key)) break;
+	if (!is_valuechunk_key(key) && !is_valuesummary_key(key)) break;
 	Assert(!is_user_metadata_key(key));
 	out->add(key, cur->tag);
 	pq.pop();
@@ -406,6 +494,15 @@ merge_postlists(Xapian::Compactor & compactor,
 	if (!pq.empty()) {
 	    cur = pq.top();
 	    pq.pop();
+	    if (!end_key.empty() && cur->key >= end_key) {
+		// This and everything left in pq is for a later range.
+		delete cur;
+		cur = NULL;
+		while (!pq.empty()) {
+		    delete pq.top();
+		    pq.pop();
+		}
+	    }
 	}
 	Assert(cur == NULL || !is_user_metadata_key(cur->key));
 	if (cur == NULL || cur->key != last_key) {
@@ -415,7 +512,7 @@ merge_postlists(Xapian::Compactor & compactor,
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
-		tag[0] = (tags.size() == 1) ? '1' : '0';
+		set_is_last_chunk(tag, tags.size() == 1);
 		first_tag += tag;
 		out->add(last_key, first_tag);
 
@@ -431,7 +528,7 @@ merge_postlists(Xapian::Compactor & compactor,
 		i = tags.begin();
 		while (++i != tags.end()) {
 		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    set_is_last_chunk(tag, i + 1 == tags.end());
 		    out->add(pack_brass_postlist_key(term, i->first), tag);
 		}
 	    }
@@ -442,6 +539,8 @@ merge_postlists(Xapian::Compactor & compactor,
 	}
 	tf += cur->tf;
 	cf += cur->cf;
+	// Convert to the block-packed encoding, which is faster to read.
+	BrassPostListTable::pack_chunk(cur->tag);
 	tags.push_back(make_pair(cur->firstdid, cur->tag));
 	if (cur->next()) {
 	    pq.push(cur);
@@ -672,7 +771,7 @@ merge_synonyms(BrassTable * out,
 }
 
 static void
-multimerge_postlists(Xapian::Compactor & compactor,
+multimerge_postlists(CompactorCallbacks & compactor,
 		     BrassTable * out, const char * tmpdir,
 		     Xapian::docid last_docid,
 		     vector<string> tmp, vector<Xapian::docid> off)
@@ -697,6 +796,7 @@ multimerge_postlists(Xapian::Compactor & compactor,
 	    BrassTable tmptab("postlist", dest, false);
 	    // Use maximum blocksize for temporary tables.
 	    tmptab.create_and_open(65536);
+	    tmptab.set_bulk_load(true);
 
 	    merge_postlists(compactor, &tmptab, off.begin() + i,
 			    tmp.begin() + i, tmp.begin() + j, 0);
@@ -726,6 +826,205 @@ multimerge_postlists(Xapian::Compactor & compactor,
     }
 }
 
+/** Pick keys to split the merging of term postlists at.
+ *
+ *  We scan the keys (but not the tags) of the largest input and pick terms
+ *  which divide its postlist chunks into roughly equal parts, assuming the
+ *  other inputs have a similar distribution of terms.
+ *
+ *  @param parts	The number of parts wanted.
+ *  @param bounds	Set to the initial chunk keys of the terms to split
+ *			at, in ascending order.  This will have fewer than
+ *			@a parts - 1 entries if there aren't enough terms.
+ */
+static void
+choose_postlist_split(const vector<string> & inputs, unsigned parts,
+		      vector<string> & bounds)
+{
+    bounds.clear();
+    string largest;
+    off_t largest_size = -1;
+    for (size_t i = 0; i != inputs.size(); ++i) {
+	struct stat sb;
+	if (stat(inputs[i] + "DB", &sb) == 0 && sb.st_size > largest_size) {
+	    largest = inputs[i];
+	    largest_size = sb.st_size;
+	}
+    }
+    if (largest_size < 0) return;
+
+    BrassTable in("postlist", largest, true);
+    in.open();
+    if (in.empty()) return;
+
+    // Sample every step-th term chunk key, doubling step and discarding every
+    // other sample whenever we have too many, so we end up with between
+    // SAMPLES and 2 * SAMPLES roughly evenly spaced samples.
+    const size_t SAMPLES = 16 * parts;
+    vector<string> samples;
+    size_t step = 1, count = 0;
+    BrassCursor cur(&in);
+    cur.find_entry(string());
+    while (cur.next()) {
+	const string & key = cur.current_key;
+	// Skip everything which isn't the postlist for a term (terms starting
+	// with a zero byte have keys starting "\0\xff").
+	if (key[0] == '\0' && (key.size() == 1 || key[1] != '\xff')) continue;
+	if (count++ % step) continue;
+	const char * p = key.data();
+	const char * end = p + key.size();
+	string term;
+	if (!unpack_string_preserving_sort(&p, end, term))
+	    throw Xapian::DatabaseCorruptError("Bad postlist key");
+	string term_key = pack_brass_postlist_key(term);
+	// A long postlist may be sampled more than once.
+	if (samples.empty() || samples.back() != term_key)
+	    samples.push_back(term_key);
+	if (samples.size() == 2 * SAMPLES) {
+	    for (size_t i = 1; i != SAMPLES; ++i) swap(samples[i], samples[i * 2]);
+	    samples.resize(SAMPLES);
+	    step *= 2;
+	}
+    }
+
+    if (samples.size() < parts) parts = samples.size();
+    for (unsigned i = 1; i < parts; ++i) {
+	bounds.push_back(samples[i * samples.size() / parts]);
+    }
+}
+
+/// Merge a range of term postlists.
+class PostlistRangeTask : public ThreadPool::CheckedTask {
+    CompactorCallbacks & compactor;
+
+    BrassTable * out;
+
+    const vector<string> & inputs;
+
+    const vector<Xapian::docid> & offset;
+
+    Xapian::docid last_docid;
+
+    string start_key, end_key;
+
+    /// Commit out once the range has been merged?
+    bool commit;
+
+  protected:
+    void perform() {
+	merge_postlists(compactor, out, offset.begin(),
+			inputs.begin(), inputs.end(), last_docid,
+			start_key, end_key);
+	if (commit) {
+	    out->flush_db();
+	    out->commit(1);
+	}
+    }
+
+  public:
+    PostlistRangeTask(CompactorCallbacks & compactor_, BrassTable * out_,
+		      const vector<string> & inputs_,
+		      const vector<Xapian::docid> & offset_,
+		      Xapian::docid last_docid_,
+		      const string & start_key_, const string & end_key_,
+		      bool commit_)
+	: compactor(compactor_), out(out_), inputs(inputs_), offset(offset_),
+	  last_docid(last_docid_), start_key(start_key_), end_key(end_key_),
+	  commit(commit_) { }
+};
+
+/// The temporary tables and tasks for parallel_merge_postlists().
+class PostlistRanges {
+    /// Don't allow copying.
+    PostlistRanges(const PostlistRanges &);
+
+    /// Don't allow assignment.
+    void operator=(const PostlistRanges &);
+
+  public:
+    vector<string> paths;
+
+    vector<BrassTable *> tables;
+
+    vector<ThreadPool::Task *> tasks;
+
+    PostlistRanges() { }
+
+    ~PostlistRanges() {
+	for (size_t i = 0; i != tasks.size(); ++i) delete tasks[i];
+	for (size_t i = 0; i != tables.size(); ++i) delete tables[i];
+	for (size_t i = 0; i != paths.size(); ++i) {
+	    unlink((paths[i] + "DB").c_str());
+	    unlink((paths[i] + "baseA").c_str());
+	    unlink((paths[i] + "baseB").c_str());
+	}
+    }
+};
+
+/** Merge postlist tables, splitting the terms into ranges merged in parallel.
+ *
+ *  The first range is merged directly into @a out, and the others into
+ *  temporary tables which are then appended to @a out in order.
+ */
+static void
+parallel_merge_postlists(CompactorCallbacks & compactor,
+			 BrassTable * out, const char * tmpdir,
+			 Xapian::docid last_docid,
+			 const vector<string> & inputs,
+			 const vector<Xapian::docid> & offset,
+			 ThreadPool & pool)
+{
+    vector<string> bounds;
+    choose_postlist_split(inputs, pool.size(), bounds);
+    if (bounds.empty()) {
+	merge_postlists(compactor, out, offset.begin(),
+			inputs.begin(), inputs.end(), last_docid);
+	return;
+    }
+
+    PostlistRanges ranges;
+    for (size_t i = 0; i != bounds.size(); ++i) {
+	string dest = tmpdir;
+	dest += "/tmprange";
+	dest += str(i);
+	dest += '.';
+	ranges.paths.push_back(dest);
+	// Don't compress temporary tables, even if the final table would be.
+	ranges.tables.push_back(new BrassTable("postlist", dest, false));
+	// Use maximum blocksize for temporary tables.
+	ranges.tables.back()->create_and_open(65536);
+	ranges.tables.back()->set_bulk_load(true);
+    }
+
+    ranges.tasks.push_back(new PostlistRangeTask(compactor, out, inputs,
+						 offset, last_docid,
+						 string(), bounds[0], false));
+    for (size_t i = 0; i != bounds.size(); ++i) {
+	const string & end_key =
+	    (i + 1 == bounds.size()) ? string() : bounds[i + 1];
+	ranges.tasks.push_back(new PostlistRangeTask(compactor,
+						     ranges.tables[i],
+						     inputs, offset,
+						     last_docid,
+						     bounds[i], end_key,
+						     true));
+    }
+    pool.run(ranges.tasks);
+    for (size_t i = 0; i != ranges.tasks.size(); ++i) {
+	static_cast<PostlistRangeTask *>(ranges.tasks[i])->rethrow_error();
+    }
+
+    // Append the other ranges, which are already in key order.
+    for (size_t i = 0; i != ranges.tables.size(); ++i) {
+	BrassCursor cur(ranges.tables[i]);
+	cur.find_entry(string());
+	while (cur.next()) {
+	    bool compressed = cur.read_tag(true);
+	    out->add(cur.current_key, cur.current_tag, compressed);
+	}
+    }
+}
+
 static void
 merge_docid_keyed(const char * tablename,
 		  BrassTable *out, const vector<string> & inputs,
@@ -738,6 +1037,11 @@ merge_docid_keyed(const char * tablename,
 	in.open();
 	if (in.empty()) continue;
 
+	// Compressed tags can only be copied over as they are if they were
+	// compressed with the same preset dictionary we're using.
+	bool keep_compressed = (in.get_compression_dictionary() ==
+				out->get_compression_dictionary());
+
 	BrassCursor cur(&in);
 	cur.find_entry(string());
 
@@ -763,182 +1067,352 @@ merge_docid_keyed(const char * tablename,
 	    } else {
 		key = cur.current_key;
 	    }
-	    bool compressed = cur.read_tag(true);
+	    bool compressed = cur.read_tag(keep_compressed);
 	    out->add(key, cur.current_tag, compressed);
 	}
     }
 }
 
-}
+/// Size of preset dictionary to train for tables which use one.
+static const size_t DICTIONARY_SIZE = 16384;
 
-using namespace BrassCompact;
+/// Roughly how many tags to sample when training a dictionary.
+static const size_t DICTIONARY_SAMPLES = 8192;
 
-void
-compact_brass(Xapian::Compactor & compactor,
-	      const char * destdir, const vector<string> & sources,
-	      const vector<Xapian::docid> & offset, size_t block_size,
-	      Xapian::Compactor::compaction_level compaction, bool multipass,
-	      Xapian::docid last_docid) {
-    enum table_type {
-	POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
-    };
-    struct table_list {
-	// The "base name" of the table.
-	const char * name;
-	// The type.
-	table_type type;
-	// zlib compression strategy to use on tags.
-	int compress_strategy;
-	// Create tables after position lazily.
-	bool lazy;
-    };
+/// Stop sampling tags once we have this much data.
+static const size_t DICTIONARY_SAMPLE_BYTES = 100 * DICTIONARY_SIZE;
 
-    static const table_list tables[] = {
-	// name		type		compress_strategy	lazy
-	{ "postlist",	POSTLIST,	DONT_COMPRESS,		false },
-	{ "record",	RECORD,		Z_DEFAULT_STRATEGY,	false },
-	{ "termlist",	TERMLIST,	Z_DEFAULT_STRATEGY,	false },
-	{ "position",	POSITION,	DONT_COMPRESS,		true },
-	{ "spelling",	SPELLING,	Z_DEFAULT_STRATEGY,	true },
-	{ "synonym",	SYNONYM,	Z_DEFAULT_STRATEGY,	true }
-    };
-    const table_list * tables_end = tables +
-	(sizeof(tables) / sizeof(tables[0]));
+/// Only use this much of each tag sampled, so large tags don't dominate.
+static const size_t DICTIONARY_SAMPLE_MAX_LEN = 4096;
 
-    for (const table_list * t = tables; t < tables_end; ++t) {
-	// The postlist table requires an N-way merge, adjusting the
-	// headers of various blocks.  The spelling and synonym tables also
-	// need special handling.  The other tables have keys sorted in
-	// docid order, so we can merge them by simply copying all the keys
-	// from each source table in turn.
-	compactor.set_status(t->name, string());
-
-	string dest = destdir;
-	dest += '/';
-	dest += t->name;
-	dest += '.';
+/// Train a preset dictionary from tags sampled evenly from the inputs.
+static string
+train_dictionary(const char * tablename, const vector<string> & inputs,
+		 bool lazy)
+{
+    brass_tablesize_t total = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+	BrassTable in(tablename, inputs[i], true, DONT_COMPRESS, lazy);
+	in.open();
+	total += in.get_entry_count();
+    }
+    brass_tablesize_t step = total / DICTIONARY_SAMPLES + 1;
 
-	bool output_will_exist = !t->lazy;
+    vector<string> samples;
+    size_t sample_bytes = 0;
+    brass_tablesize_t n = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+	BrassTable in(tablename, inputs[i], true, DONT_COMPRESS, lazy);
+	in.open();
+	if (in.empty()) continue;
 
-	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
-	// on certain systems).
-	bool bad_stat = false;
+	BrassCursor cur(&in);
+	cur.find_entry(string());
+	while (cur.next()) {
+	    if (n++ % step != 0) continue;
+	    cur.read_tag();
+	    const string & tag = cur.current_tag;
+	    samples.push_back(tag.substr(0, DICTIONARY_SAMPLE_MAX_LEN));
+	    sample_bytes += samples.back().size();
+	    if (sample_bytes >= DICTIONARY_SAMPLE_BYTES) goto done;
+	}
+    }
+done:
+    return brass_train_dictionary(samples, DICTIONARY_SIZE);
+}
 
-	off_t in_size = 0;
+enum table_type {
+    POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
+};
 
-	vector<string> inputs;
-	inputs.reserve(sources.size());
-	size_t inputs_present = 0;
-	for (vector<string>::const_iterator src = sources.begin();
-	     src != sources.end(); ++src) {
-	    string s(*src);
-	    s += t->name;
-	    s += '.';
+struct table_list {
+    // The "base name" of the table.
+    const char * name;
+    // The type.
+    table_type type;
+    // zlib compression strategy to use on tags.
+    int compress_strategy;
+    // Train a preset dictionary for compressing tags?
+    bool dictionary;
+    // Create tables after position lazily.
+    bool lazy;
+};
 
-	    struct stat sb;
-	    if (stat(s + "DB", &sb) == 0) {
-		in_size += sb.st_size / 1024;
-		output_will_exist = true;
-		++inputs_present;
-	    } else if (errno != ENOENT) {
-		// We get ENOENT for an optional table.
-		bad_stat = true;
-		output_will_exist = true;
-		++inputs_present;
-	    }
-	    inputs.push_back(s);
+static void
+compact_table(CompactorCallbacks & compactor, const table_list * t,
+	      const char * destdir, const vector<string> & sources,
+	      const vector<Xapian::docid> & offset, size_t block_size,
+	      Xapian::Compactor::compaction_level compaction, bool multipass,
+	      Xapian::docid last_docid, ThreadPool * pool)
+{
+    // The postlist table requires an N-way merge, adjusting the
+    // headers of various blocks.  The spelling and synonym tables also
+    // need special handling.  The other tables have keys sorted in
+    // docid order, so we can merge them by simply copying all the keys
+    // from each source table in turn.
+    compactor.set_status(t->name, string());
+
+    double start_time = RealTime::now();
+
+    string dest = destdir;
+    dest += '/';
+    dest += t->name;
+    dest += '.';
+
+    bool output_will_exist = !t->lazy;
+
+    // Sometimes stat can fail for benign reasons (e.g. >= 2GB file
+    // on certain systems).
+    bool bad_stat = false;
+
+    off_t in_size = 0;
+
+    vector<string> inputs;
+    inputs.reserve(sources.size());
+    size_t inputs_present = 0;
+    for (vector<string>::const_iterator src = sources.begin();
+	 src != sources.end(); ++src) {
+	string s(*src);
+	s += t->name;
+	s += '.';
+
+	struct stat sb;
+	if (stat(s + "DB", &sb) == 0) {
+	    in_size += sb.st_size / 1024;
+	    output_will_exist = true;
+	    ++inputs_present;
+	} else if (errno != ENOENT) {
+	    // We get ENOENT for an optional table.
+	    bad_stat = true;
+	    output_will_exist = true;
+	    ++inputs_present;
 	}
+	inputs.push_back(s);
+    }
 
-	// If any inputs lack a termlist table, suppress it in the output.
-	if (t->type == TERMLIST && inputs_present != sources.size()) {
-	    if (inputs_present != 0) {
-		string m = str(inputs_present);
-		m += " of ";
-		m += str(sources.size());
-		m += " inputs present, so suppressing output";
-		compactor.set_status(t->name, m);
-		continue;
-	    }
-	    output_will_exist = false;
+    // If any inputs lack a termlist table, suppress it in the output.
+    if (t->type == TERMLIST && inputs_present != sources.size()) {
+	if (inputs_present != 0) {
+	    string m = str(inputs_present);
+	    m += " of ";
+	    m += str(sources.size());
+	    m += " inputs present, so suppressing output";
+	    compactor.set_status(t->name, m);
+	    return;
 	}
+	output_will_exist = false;
+    }
 
-	if (!output_will_exist) {
-	    compactor.set_status(t->name, "doesn't exist");
-	    continue;
-	}
+    if (!output_will_exist) {
+	compactor.set_status(t->name, "doesn't exist");
+	return;
+    }
 
-	BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
-	if (!t->lazy) {
-	    out.create_and_open(block_size);
-	} else {
-	    out.erase();
-	    out.set_block_size(block_size);
-	}
+    BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
+    if (!t->lazy) {
+	out.create_and_open(block_size);
+    } else {
+	out.erase();
+	out.set_block_size(block_size);
+    }
 
-	out.set_full_compaction(compaction != compactor.STANDARD);
-	if (compaction == compactor.FULLER) out.set_max_item_size(1);
+    if (t->dictionary) {
+	out.set_compression_dictionary(train_dictionary(t->name, inputs,
+							 t->lazy));
+    }
 
-	switch (t->type) {
-	    case POSTLIST:
-		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, &out, destdir, last_docid,
-					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, &out, offset.begin(),
-				    inputs.begin(), inputs.end(),
-				    last_docid);
-		}
-		break;
-	    case SPELLING:
-		merge_spellings(&out, inputs.begin(), inputs.end());
-		break;
-	    case SYNONYM:
-		merge_synonyms(&out, inputs.begin(), inputs.end());
-		break;
-	    default:
-		// Position, Record, Termlist
-		merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
-		break;
-	}
-
-	// Commit as revision 1.
-	out.flush_db();
-	out.commit(1);
-
-	off_t out_size = 0;
-	if (!bad_stat) {
-	    struct stat sb;
-	    if (stat(dest + "DB", &sb) == 0) {
-		out_size = sb.st_size / 1024;
+    // We add the entries in ascending key order, so build the table from
+    // the bottom up.
+    out.set_bulk_load(true);
+    out.set_full_compaction(compaction != Xapian::Compactor::STANDARD);
+    if (compaction == Xapian::Compactor::FULLER) out.set_max_item_size(1);
+
+    switch (t->type) {
+	case POSTLIST:
+	    if (multipass && inputs.size() > 3) {
+		multimerge_postlists(compactor, &out, destdir, last_docid,
+				     inputs, offset);
+	    } else if (pool && pool->size() > 1) {
+		parallel_merge_postlists(compactor, &out, destdir, last_docid,
+					 inputs, offset, *pool);
 	    } else {
-		bad_stat = (errno != ENOENT);
+		merge_postlists(compactor, &out, offset.begin(),
+				inputs.begin(), inputs.end(),
+				last_docid);
 	    }
+	    break;
+	case SPELLING:
+	    merge_spellings(&out, inputs.begin(), inputs.end());
+	    break;
+	case SYNONYM:
+	    merge_synonyms(&out, inputs.begin(), inputs.end());
+	    break;
+	default:
+	    // Position, Record, Termlist
+	    merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
+	    break;
+    }
+
+    // Commit as revision 1.
+    out.flush_db();
+    out.commit(1);
+
+    off_t out_size = 0;
+    if (!bad_stat) {
+	struct stat sb;
+	if (stat(dest + "DB", &sb) == 0) {
+	    out_size = sb.st_size / 1024;
+	} else {
+	    bad_stat = (errno != ENOENT);
 	}
-	if (bad_stat) {
-	    compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    }
+    if (bad_stat) {
+	compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    } else {
+	string status;
+	if (out_size == in_size) {
+	    status = "Size unchanged (";
 	} else {
-	    string status;
-	    if (out_size == in_size) {
-		status = "Size unchanged (";
+	    off_t delta;
+	    if (out_size < in_size) {
+		delta = in_size - out_size;
+		status = "Reduced by ";
 	    } else {
-		off_t delta;
-		if (out_size < in_size) {
-		    delta = in_size - out_size;
-		    status = "Reduced by ";
-		} else {
-		    delta = out_size - in_size;
-		    status = "INCREASED by ";
-		}
-		status += str(100 * delta / in_size);
-		status += "% ";
-		status += str(delta);
-		status += "K (";
-		status += str(in_size);
-		status += "K -> ";
+		delta = out_size - in_size;
+		status = "INCREASED by ";
 	    }
-	    status += str(out_size);
-	    status += "K)";
-	    compactor.set_status(t->name, status);
+	    status += str(100 * delta / in_size);
+	    status += "% ";
+	    status += str(delta);
+	    status += "K (";
+	    status += str(in_size);
+	    status += "K -> ";
+	}
+	status += str(out_size);
+	status += "K)";
+
+	// Report the time taken, and the rate the input was processed at.
+	double elapsed = RealTime::now() - start_time;
+	unsigned long tenths = static_cast<unsigned long>(elapsed * 10 + 0.5);
+	status += " in ";
+	status += str(tenths / 10);
+	status += '.';
+	status += str(tenths % 10);
+	status += 's';
+	if (in_size && elapsed > 0) {
+	    status += " (";
+	    status += str(static_cast<unsigned long>(in_size / elapsed));
+	    status += "K/s)";
 	}
+	compactor.set_status(t->name, status);
     }
 }
+
+/// Compact one table.
+class CompactTableTask : public ThreadPool::CheckedTask {
+    CompactorCallbacks & compactor;
+
+    const table_list * t;
+
+    const char * destdir;
+
+    const vector<string> & sources;
+
+    const vector<Xapian::docid> & offset;
+
+    size_t block_size;
+
+    Xapian::Compactor::compaction_level compaction;
+
+    bool multipass;
+
+    Xapian::docid last_docid;
+
+    ThreadPool * pool;
+
+  protected:
+    void perform() {
+	compact_table(compactor, t, destdir, sources, offset, block_size,
+		      compaction, multipass, last_docid, pool);
+    }
+
+  public:
+    CompactTableTask(CompactorCallbacks & compactor_, const table_list * t_,
+		     const char * destdir_, const vector<string> & sources_,
+		     const vector<Xapian::docid> & offset_, size_t block_size_,
+		     Xapian::Compactor::compaction_level compaction_,
+		     bool multipass_, Xapian::docid last_docid_,
+		     ThreadPool * pool_)
+	: compactor(compactor_), t(t_), destdir(destdir_), sources(sources_),
+	  offset(offset_), block_size(block_size_), compaction(compaction_),
+	  multipass(multipass_), last_docid(last_docid_), pool(pool_) { }
+};
+
+}
+
+using namespace BrassCompact;
+
+void
+compact_brass(Xapian::Compactor & compactor,
+	      const char * destdir, const vector<string> & sources,
+	      const vector<Xapian::docid> & offset, size_t block_size,
+	      Xapian::Compactor::compaction_level compaction, bool multipass,
+	      Xapian::docid last_docid, unsigned threads) {
+    static const table_list tables[] = {
+	// name		type		compress_strategy	dictionary lazy
+	{ "postlist",	POSTLIST,	DONT_COMPRESS,		false,	false },
+	{ "record",	RECORD,		Z_DEFAULT_STRATEGY,	true,	false },
+	{ "termlist",	TERMLIST,	Z_DEFAULT_STRATEGY,	true,	false },
+	{ "position",	POSITION,	DONT_COMPRESS,		false,	true },
+	{ "spelling",	SPELLING,	Z_DEFAULT_STRATEGY,	false,	true },
+	{ "synonym",	SYNONYM,	Z_DEFAULT_STRATEGY,	false,	true }
+    };
+    const table_list * tables_end = tables +
+	(sizeof(tables) / sizeof(tables[0]));
+
+    CompactorCallbacks callbacks(compactor);
+
+    if (threads <= 1) {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    compact_table(callbacks, t, destdir, sources, offset, block_size,
+			  compaction, multipass, last_docid, NULL);
+	}
+	return;
+    }
+
+    // The tables are independent, so merge them in parallel.  The postlist
+    // table is usually much the largest, so the pool is also used to split
+    // its merge up by term.
+    ThreadPool pool(threads);
+    vector<ThreadPool::Task *> tasks;
+    try {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    tasks.push_back(new CompactTableTask(callbacks, t, destdir,
+						 sources, offset, block_size,
+						 compaction, multipass,
+						 last_docid, &pool));
+	}
+	pool.run(tasks);
+	for (size_t i = 0; i != tasks.size(); ++i) {
+	    static_cast<CompactTableTask *>(tasks[i])->rethrow_error();
+	}
+    } catch (...) {
+	for (size_t i = 0; i != tasks.size(); ++i) delete tasks[i];
+	throw;
+    }
+    for (size_t i = 0; i != tasks.size(); ++i) delete tasks[i];
+}
+
+void
+merge_brass_postlist_runs(BrassTable * out, const vector<string> & runs)
+{
+    // The runs don't contain any user metadata, so the Compactor's methods
+    // won't actually get called.
+    Xapian::Compactor compactor;
+    CompactorCallbacks callbacks(compactor);
+    vector<Xapian::docid> offset(runs.size(), 0);
+    // Start from the first document length chunk, so the METAINFO isn't
+    // merged.
+    merge_postlists(callbacks, out, offset.begin(), runs.begin(), runs.end(),
+		    0, BrassPostListTable::make_key(string()));
+}
@@ -33,6 +33,21 @@ compact_brass(Xapian::Compactor & compactor,
 	      const char * destdir, const std::vector<std::string> & sources,
 	      const std::vector<Xapian::docid> & offset, size_t block_size,
 	      Xapian::Compactor::compaction_level compaction, bool multipass,
-	      Xapian::docid last_docid);
+	      Xapian::docid last_docid, unsigned threads);
+
+class BrassTable;
+
+/** Merge runs of postings from temporary postlist tables into @a out.
+ *
+ *  Only the document length and term postlists in the runs are merged.  The
+ *  runs must all use the same docids as @a out (so no offsets are applied),
+ *  and be in ascending docid order.
+ *
+ *  @param out	The table to merge into, which mustn't contain any postings.
+ *  @param runs	The path and prefix of each run's files.
+ */
+void
+merge_brass_postlist_runs(BrassTable * out,
+			  const std::vector<std::string> & runs);
 
 #endif
@@ -58,7 +58,9 @@ BrassCursor::BrassCursor(const BrassTable *B_)
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  prefetched_n(BLK_UNUSED),
+	  prefetched_c(0)
 {
     B->cursor_created_since_last_modification = true;
     C = new Brass::Cursor[level + 1];
@@ -192,6 +194,21 @@ BrassCursor::next()
     RETURN(true);
 }
 
+void
+BrassCursor::prefetch_next()
+{
+    LOGCALL_VOID(DB, "BrassCursor::prefetch_next", NO_ARGS);
+    if (!is_positioned || level == 0 || B->cursor_version != version) return;
+    B->prefetch_next_leaves(C, prefetched_n, prefetched_c);
+}
+
+void
+BrassCursor::prefetch_entry(const string &key) const
+{
+    LOGCALL_VOID(DB, "BrassCursor::prefetch_entry", key);
+    B->prefetch_entry(key);
+}
+
 bool
 BrassCursor::find_entry(const string &key)
 {
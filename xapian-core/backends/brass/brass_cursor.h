@@ -111,6 +111,12 @@ class XAPIAN_VISIBILITY_DEFAULT BrassCursor {
 	/** The value of level in the Btree structure. */
 	int level;
 
+	/// The parent block of the leaf blocks we last hinted would be read.
+	uint4 prefetched_n;
+
+	/// Directory offset in block prefetched_n of the last leaf hinted.
+	int prefetched_c;
+
 	/** Get the key.
 	 *
 	 *  The key of the item at the cursor is copied into key.
@@ -242,6 +248,21 @@ class XAPIAN_VISIBILITY_DEFAULT BrassCursor {
 	 */
 	bool after_end() const { return is_after_end; }
 
+	/** Hint that the cursor will soon be moved on past the current leaf
+	 *  block.
+	 *
+	 *  This asks the OS to start reading the next few leaf blocks in the
+	 *  background.  It's cheap to call for each entry, as each block is
+	 *  only hinted once.
+	 */
+	void prefetch_next();
+
+	/** Hint that the cursor will soon be moved to @a key.
+	 *
+	 *  The cursor itself isn't moved.
+	 */
+	void prefetch_entry(const string &key) const;
+
 	/// Return a pointer to the BrassTable we're a cursor for.
 	const BrassTable * get_table() const { return B; }
 };
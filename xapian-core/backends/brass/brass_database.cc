@@ -36,6 +36,7 @@
 #include "brass_alldocspostlist.h"
 #include "brass_alltermslist.h"
 #include "brass_replicate_internal.h"
+#include "brass_doclenarray.h"
 #include "brass_document.h"
 #include "../flint_lock.h"
 #include "brass_metadata.h"
@@ -55,6 +56,7 @@
 #include "serialise.h"
 #include "str.h"
 #include "stringutils.h"
+#include "threadpool.h"
 #include "utils.h"
 #include "valuestats.h"
 
@@ -68,7 +70,10 @@
 
 #include <algorithm>
 #include "autoptr.h"
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -96,14 +101,24 @@ using Xapian::Internal::intrusive_ptr;
  */
 const int MAX_OPEN_RETRIES = 100;
 
+/** How many document lengths a read-only database looks up before building
+ *  a BrassDoclenArray, as a fraction of the number of documents.
+ *
+ *  Building the array means reading every document length, but the matcher
+ *  will typically look up the lengths of a good fraction of the documents
+ *  for each query.
+ */
+const Xapian::doccount DOCLEN_ARRAY_LOOKUP_RATIO = 32;
+
 /* This finds the tables, opens them at consistent revisions, manages
  * determining the current and next revision numbers, and stores handles
  * to the tables.
  */
-BrassDatabase::BrassDatabase(const string &brass_dir, int action,
+BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
 			     unsigned int block_size)
 	: db_dir(brass_dir),
-	  readonly(action == XAPIAN_DB_READONLY),
+	  readonly((flags & Xapian::DB_ACTION_MASK_) == XAPIAN_DB_READONLY),
+	  use_doclen_array(!(flags & Xapian::DB_NO_DOCLEN_ARRAY)),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
@@ -113,11 +128,24 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int action,
 	  spelling_table(db_dir, readonly),
 	  record_table(db_dir, readonly),
 	  lock(db_dir),
-	  max_changesets(0)
+	  max_changesets(0),
+	  doclens(NULL),
+	  doclen_lookups(0)
 {
-    LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | action | block_size);
+    LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | flags | block_size);
 
+    int action = flags & Xapian::DB_ACTION_MASK_;
     if (action == XAPIAN_DB_READONLY) {
+	if (flags & Xapian::DB_READ_MMAP) {
+	    postlist_table.set_mmap(true);
+	    position_table.set_mmap(true);
+	    termlist_table.set_mmap(true);
+	    synonym_table.set_mmap(true);
+	    spelling_table.set_mmap(true);
+	    record_table.set_mmap(true);
+	}
+	// Value streams are stored in the postlist table too.
+	if (flags & Xapian::DB_PREFETCH) postlist_table.set_prefetch(true);
 	open_tables_consistent();
 	return;
     }
@@ -173,6 +201,15 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int action,
 BrassDatabase::~BrassDatabase()
 {
     LOGCALL_DTOR(DB, "BrassDatabase");
+    reset_doclens();
+}
+
+void
+BrassDatabase::reset_doclens() const
+{
+    BrassDoclenArray::release(doclens);
+    doclens = NULL;
+    doclen_lookups = 0;
 }
 
 bool
@@ -243,6 +280,7 @@ BrassDatabase::open_tables_consistent()
     spelling_table.set_block_size(block_size);
 
     value_manager.reset();
+    reset_doclens();
 
     bool fully_opened = false;
     int tries_left = MAX_OPEN_RETRIES;
@@ -301,6 +339,7 @@ BrassDatabase::open_tables(brass_revision_number_t revision)
     spelling_table.set_block_size(block_size);
 
     value_manager.reset();
+    reset_doclens();
 
     spelling_table.open(revision);
     synonym_table.open(revision);
@@ -508,6 +547,7 @@ void
 BrassDatabase::close()
 {
     LOGCALL_VOID(DB, "BrassDatabase::close", NO_ARGS);
+    // Like the tables, we keep doclens so it can still answer lookups.
     postlist_table.close(true);
     position_table.close(true);
     termlist_table.close(true);
@@ -734,19 +774,23 @@ BrassDatabase::modifications_failed(brass_revision_number_t old_revision,
     }
 }
 
+bool
+BrassDatabase::is_modified() const
+{
+    return postlist_table.is_modified() ||
+	   position_table.is_modified() ||
+	   termlist_table.is_modified() ||
+	   value_manager.is_modified() ||
+	   synonym_table.is_modified() ||
+	   spelling_table.is_modified() ||
+	   record_table.is_modified();
+}
+
 void
 BrassDatabase::apply()
 {
     LOGCALL_VOID(DB, "BrassDatabase::apply", NO_ARGS);
-    if (!postlist_table.is_modified() &&
-	!position_table.is_modified() &&
-	!termlist_table.is_modified() &&
-	!value_manager.is_modified() &&
-	!synonym_table.is_modified() &&
-	!spelling_table.is_modified() &&
-	!record_table.is_modified()) {
-	return;
-    }
+    if (!is_modified()) return;
 
     brass_revision_number_t old_revision = get_revision_number();
     brass_revision_number_t new_revision = get_next_revision_number();
@@ -813,6 +857,19 @@ BrassDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "BrassDatabase::get_doclength", did);
     Assert(did != 0);
+    if (readonly && use_doclen_array) {
+	// Don't try to build the array once the database has been closed.
+	if (!doclens && postlist_table.is_open() &&
+	    ++doclen_lookups == get_doccount() / DOCLEN_ARRAY_LOOKUP_RATIO + 1) {
+	    doclens = BrassDoclenArray::acquire(this);
+	}
+	if (doclens) {
+	    Xapian::termcount doclen;
+	    if (!doclens->get_doclength(did, doclen))
+		throw Xapian::DocNotFoundError("Document " + str(did) + " not found");
+	    RETURN(doclen);
+	}
+    }
     intrusive_ptr<const BrassDatabase> ptrtothis(this);
     RETURN(postlist_table.get_doclength(did, ptrtothis));
 }
@@ -937,6 +994,33 @@ BrassDatabase::open_document(Xapian::docid did, bool lazy) const
     RETURN(new BrassDocument(ptrtothis, did, &value_manager, &record_table));
 }
 
+void
+BrassDatabase::open_documents(const vector<Xapian::docid> & dids,
+			      vector<Xapian::Document> & docs) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::open_documents", dids | Literal("docs"));
+    intrusive_ptr<const Database::Internal> ptrtothis(this);
+    // Walk through the record table with a single cursor, reading the data
+    // for all the documents now.
+    AutoPtr<BrassCursor> cursor(record_table.cursor_get());
+    string data;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	Assert(*i != 0);
+	Xapian::Document::Internal * doc;
+	if (cursor.get() && record_table.get_record(*cursor, *i, data)) {
+	    doc = new BrassDocument(ptrtothis, *i, &value_manager,
+				    &record_table, data);
+	} else {
+	    // Leave it to do_get_data() to report that the document doesn't
+	    // exist, as it would if we'd opened the document lazily.
+	    doc = new BrassDocument(ptrtothis, *i, &value_manager,
+				    &record_table);
+	}
+	docs.push_back(Xapian::Document(doc));
+    }
+}
+
 PositionList *
 BrassDatabase::open_position_list(Xapian::docid did, const string & term) const
 {
@@ -1086,6 +1170,7 @@ BrassWritableDatabase::BrassWritableDatabase(const string &dir, int action,
 	: BrassDatabase(dir, action, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  fresh_build(false),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1096,6 +1181,19 @@ BrassWritableDatabase::BrassWritableDatabase(const string &dir, int action,
 	flush_threshold = atoi(p);
     if (flush_threshold == 0)
 	flush_threshold = 10000;
+
+    // Only a database which has never had any documents in can be built
+    // fresh, as the runs are merged into an empty postlist table.
+    if ((action & Xapian::DB_FRESH_BUILD) && stats.get_last_docid() == 0) {
+	fresh_build = true;
+	// Added documents go on the end of these tables, as they're keyed by
+	// docid.  Entries which don't (e.g. for a replaced document) are
+	// still added the usual way, so we leave this on after the fresh
+	// build finishes.
+	record_table.set_bulk_load(true);
+	termlist_table.set_bulk_load(true);
+	position_table.set_bulk_load(true);
+    }
 }
 
 BrassWritableDatabase::~BrassWritableDatabase()
@@ -1109,6 +1207,7 @@ BrassWritableDatabase::commit()
 {
     if (transaction_active())
 	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (fresh_build) finish_fresh_build();
     if (change_count) flush_postlist_changes();
     apply();
 }
@@ -1116,12 +1215,70 @@ BrassWritableDatabase::commit()
 void
 BrassWritableDatabase::flush_postlist_changes() const
 {
+    if (fresh_build) {
+	write_postlist_run();
+	// The runs only hold postings, so merge the value changes now rather
+	// than holding them in memory until the build finishes.
+	value_manager.merge_changes();
+	return;
+    }
     stats.write(postlist_table);
     inverter.flush(postlist_table);
 
     change_count = 0;
 }
 
+void
+BrassWritableDatabase::write_postlist_run() const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::write_postlist_run", NO_ARGS);
+    string name = db_dir;
+    name += "/postlist_run";
+    name += str(postlist_runs.size());
+    name += '.';
+    postlist_runs.push_back(name);
+
+    BrassPostListTable run(name);
+    // Use maximum blocksize for temporary tables.
+    run.create_and_open(65536);
+    // The changes are in key order, so build the run from the bottom up.
+    run.set_bulk_load(true);
+    inverter.flush(run);
+    run.flush_db();
+    run.commit(1);
+
+    change_count = 0;
+}
+
+void
+BrassWritableDatabase::finish_fresh_build() const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::finish_fresh_build", NO_ARGS);
+    Assert(fresh_build);
+    if (change_count) write_postlist_run();
+
+    postlist_table.merge_runs(postlist_runs);
+    // Only leave fresh build mode once the merge has succeeded, so a failed
+    // merge doesn't leave us flushing further changes into a postlist table
+    // which is missing the postings in the runs.
+    fresh_build = false;
+    discard_postlist_runs();
+    stats.write(postlist_table);
+}
+
+void
+BrassWritableDatabase::discard_postlist_runs() const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::discard_postlist_runs", NO_ARGS);
+    vector<string>::const_iterator i;
+    for (i = postlist_runs.begin(); i != postlist_runs.end(); ++i) {
+	(void)io_unlink(*i + "DB");
+	(void)io_unlink(*i + "baseA");
+	(void)io_unlink(*i + "baseB");
+    }
+    postlist_runs.clear();
+}
+
 void
 BrassWritableDatabase::close()
 {
@@ -1130,6 +1287,8 @@ BrassWritableDatabase::close()
 	commit();
 	// FIXME: if commit() throws, should we still close?
     }
+    // If a transaction was in progress, its runs are of no use now.
+    discard_postlist_runs();
     BrassDatabase::close();
 }
 
@@ -1210,18 +1369,207 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
     // currently holds.
     if (++change_count >= flush_threshold) {
 	flush_postlist_changes();
-	if (!transaction_active()) apply();
+	// In a fresh build, the postings aren't in the postlist table until
+	// the build finishes, so we can't commit before then.
+	if (!transaction_active() && !fresh_build) apply();
     }
 
     RETURN(did);
 }
 
+/** Does the work for a slice of a batch of documents which can be done in
+ *  parallel.
+ *
+ *  This inverts the documents into runs of postings for each term, and
+ *  encodes their termlists and position lists, but doesn't touch the
+ *  database.
+ */
+class BrassInvertTask : public ThreadPool::CheckedTask {
+    const vector<Xapian::Document> & documents;
+
+    size_t begin, end;
+
+    Xapian::docid first_did;
+
+    bool want_termlists;
+
+  protected:
+    void perform();
+
+  public:
+    /// The document lengths.
+    vector<brass_doclen_t> doclens;
+
+    /// The largest wdf.
+    Xapian::termcount max_wdf;
+
+    /// The postings for each term, in ascending docid order.
+    map<string, vector<pair<Xapian::docid, Xapian::termcount> > > postings;
+
+    /// Position table keys and tags, in ascending key order.
+    vector<pair<string, string> > positions;
+
+    /// Termlist table tags.
+    vector<string> termlists;
+
+    /** Construct a task.
+     *
+     *  @param begin_, end_	The range of @a documents_ to process.
+     *  @param first_did_	The docid for documents_[begin_].
+     */
+    BrassInvertTask(const vector<Xapian::Document> & documents_,
+		    size_t begin_, size_t end_, Xapian::docid first_did_,
+		    bool want_termlists_)
+	: documents(documents_), begin(begin_), end(end_),
+	  first_did(first_did_), want_termlists(want_termlists_),
+	  max_wdf(0) { }
+};
+
+void
+BrassInvertTask::perform()
+{
+    doclens.reserve(end - begin);
+    if (want_termlists) termlists.reserve(end - begin);
+    Xapian::docid did = first_did;
+    for (size_t i = begin; i != end; ++i, ++did) {
+	const Xapian::Document & document = documents[i];
+	brass_doclen_t doclen = 0;
+	Xapian::TermIterator term = document.termlist_begin();
+	for ( ; term != document.termlist_end(); ++term) {
+	    termcount wdf = term.get_wdf();
+	    doclen += wdf;
+	    if (wdf > max_wdf) max_wdf = wdf;
+
+	    string tname = *term;
+	    if (tname.size() > MAX_SAFE_TERM_LENGTH)
+		throw Xapian::InvalidArgumentError("Term too long (> "STRINGIZE(MAX_SAFE_TERM_LENGTH)"): " + tname);
+
+	    postings[tname].push_back(make_pair(did, wdf));
+
+	    PositionIterator pos = term.positionlist_begin();
+	    if (pos != term.positionlist_end()) {
+		positions.push_back(make_pair(
+		    BrassPositionListTable::make_key(did, tname),
+		    BrassPositionListTable::encode_positionlist(
+			pos, term.positionlist_end())));
+	    }
+	}
+	doclens.push_back(doclen);
+	if (want_termlists)
+	    termlists.push_back(BrassTermListTable::encode_termlist(document,
+								    doclen));
+    }
+}
+
+/// Owns the tasks for a batch of documents.
+class BrassInvertTasks : public vector<ThreadPool::Task *> {
+  public:
+    ~BrassInvertTasks() {
+	for (iterator i = begin(); i != end(); ++i) {
+	    delete *i;
+	}
+    }
+};
+
+Xapian::docid
+BrassWritableDatabase::add_documents(const vector<Xapian::Document> & documents,
+				     unsigned threads)
+{
+    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_documents", documents.size() | threads);
+    Assert(!documents.empty());
+    // Make sure the docid counter doesn't overflow.
+    if (stats.get_last_docid() > Xapian::docid(-1) - documents.size())
+	throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+
+    ThreadPool pool(threads);
+    const Xapian::docid first_did = stats.get_last_docid() + 1;
+    size_t done = 0;
+    while (done != documents.size()) {
+	// Work in sub-batches which end where add_document() would flush, so
+	// we flush at the same points.
+	size_t n = documents.size() - done;
+	if (change_count < flush_threshold)
+	    n = min(n, size_t(flush_threshold - change_count));
+
+	try {
+	    // Documents from a database read their terms on demand, which
+	    // isn't safe to do from several threads at once.
+	    for (size_t i = done; i != done + n; ++i) {
+		documents[i].internal->need_terms();
+	    }
+
+	    // Split the sub-batch into a contiguous slice per thread.
+	    BrassInvertTasks tasks;
+	    size_t slices = min(size_t(pool.size()), n);
+	    size_t begin = done;
+	    for (size_t s = 0; s != slices; ++s) {
+		size_t end = done + n * (s + 1) / slices;
+		tasks.push_back(new BrassInvertTask(documents, begin, end,
+						    first_did + begin,
+						    termlist_table.is_open()));
+		begin = end;
+	    }
+	    pool.run(tasks);
+
+	    // Now apply the results in docid order.
+	    for (size_t s = 0; s != slices; ++s) {
+		BrassInvertTask & task = *static_cast<BrassInvertTask *>(tasks[s]);
+		task.rethrow_error();
+		stats.check_wdf(task.max_wdf);
+	    }
+	    size_t i = done;
+	    for (size_t s = 0; s != slices; ++s) {
+		BrassInvertTask & task = *static_cast<BrassInvertTask *>(tasks[s]);
+		for (size_t j = 0; j != task.doclens.size(); ++j, ++i) {
+		    const Xapian::Document & document = documents[i];
+		    Xapian::docid did = stats.get_next_docid();
+		    AssertEq(did, first_did + i);
+		    record_table.replace_record(document.get_data(), did);
+		    value_manager.add_document(did, document, value_stats);
+		    if (!task.termlists.empty()) {
+			termlist_table.add(BrassTermListTable::make_key(did),
+					   task.termlists[j]);
+		    }
+		    inverter.set_doclength(did, task.doclens[j], true);
+		    stats.add_document(task.doclens[j]);
+		}
+
+		vector<pair<string, string> >::const_iterator p;
+		for (p = task.positions.begin(); p != task.positions.end(); ++p) {
+		    position_table.add(p->first, p->second);
+		}
+
+		map<string, vector<pair<Xapian::docid, Xapian::termcount> > >::const_iterator t;
+		for (t = task.postings.begin(); t != task.postings.end(); ++t) {
+		    inverter.add_postings(t->first, t->second);
+		}
+	    }
+	} catch (...) {
+	    // As in add_document_(), discard the modifications so far.
+	    cancel();
+	    throw;
+	}
+
+	done += n;
+	change_count += n;
+	if (change_count >= flush_threshold) {
+	    flush_postlist_changes();
+	    // As in add_document_(), we can't commit during a fresh build.
+	    if (!transaction_active() && !fresh_build) apply();
+	}
+    }
+
+    RETURN(first_did);
+}
+
 void
 BrassWritableDatabase::delete_document(Xapian::docid did)
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::delete_document", did);
     Assert(did != 0);
 
+    if (fresh_build) finish_fresh_build();
+
     if (!termlist_table.is_open())
 	throw Xapian::FeatureUnavailableError("Database has no termlist");
 
@@ -1294,6 +1642,10 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    return;
 	}
 
+	// We may be replacing an existing document, so we need its postings
+	// to be in the postlist table.
+	if (fresh_build) finish_fresh_build();
+
 	if (!termlist_table.is_open()) {
 	    // We can replace an *unused* docid <= last_docid too.
 	    intrusive_ptr<const BrassDatabase> ptrtothis(this);
@@ -1468,6 +1820,7 @@ BrassWritableDatabase::get_doclength(Xapian::docid did) const
     Xapian::termcount doclen;
     if (inverter.get_doclength(did, doclen))
 	RETURN(doclen);
+    if (fresh_build) finish_fresh_build();
     RETURN(BrassDatabase::get_doclength(did));
 }
 
@@ -1475,6 +1828,7 @@ Xapian::doccount
 BrassWritableDatabase::get_termfreq(const string & term) const
 {
     LOGCALL(DB, Xapian::doccount, "BrassWritableDatabase::get_termfreq", term);
+    if (fresh_build) finish_fresh_build();
     RETURN(BrassDatabase::get_termfreq(term) + inverter.get_tfdelta(term));
 }
 
@@ -1482,6 +1836,7 @@ Xapian::termcount
 BrassWritableDatabase::get_collection_freq(const string & term) const
 {
     LOGCALL(DB, Xapian::termcount, "BrassWritableDatabase::get_collection_freq", term);
+    if (fresh_build) finish_fresh_build();
     RETURN(BrassDatabase::get_collection_freq(term) + inverter.get_cfdelta(term));
 }
 
@@ -1528,6 +1883,8 @@ BrassWritableDatabase::open_post_list(const string& tname) const
     LOGCALL(DB, LeafPostList *, "BrassWritableDatabase::open_post_list", tname);
     intrusive_ptr<const BrassWritableDatabase> ptrtothis(this);
 
+    if (fresh_build) finish_fresh_build();
+
     if (tname.empty()) {
 	Xapian::doccount doccount = get_doccount();
 	if (stats.get_last_docid() == doccount) {
@@ -1558,6 +1915,7 @@ TermList *
 BrassWritableDatabase::open_allterms(const string & prefix) const
 {
     LOGCALL(DB, TermList *, "BrassWritableDatabase::open_allterms", NO_ARGS);
+    if (fresh_build) finish_fresh_build();
     if (change_count) {
 	// There are changes, and terms may have been added or removed, and so
 	// we need to flush changes for terms with the specified prefix (but
@@ -1580,6 +1938,7 @@ BrassWritableDatabase::cancel()
     stats.read(postlist_table);
 
     inverter.clear();
+    discard_postlist_runs();
     value_stats.clear();
     change_count = 0;
 }
@@ -1711,3 +2070,9 @@ BrassWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+bool
+BrassWritableDatabase::has_uncommitted_changes() const
+{
+    return change_count || is_modified();
+}
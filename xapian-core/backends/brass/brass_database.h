@@ -40,9 +40,11 @@
 #include "valuestats.h"
 
 #include <map>
+#include <vector>
 
 class BrassTermList;
 class BrassAllDocsPostList;
+class BrassDoclenArray;
 class RemoteConnection;
 
 /** A backend designed for efficient indexing and retrieval, using
@@ -54,6 +56,7 @@ class BrassDatabase : public Xapian::Database::Internal {
     friend class BrassPostList;
     friend class BrassAllTermsList;
     friend class BrassAllDocsPostList;
+    friend class BrassDoclenArray;
     private:
 	/** Directory to store databases in.
 	 */
@@ -63,6 +66,12 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	bool readonly;
 
+	/** Whether to read the document lengths into a BrassDoclenArray.
+	 *
+	 *  This is false if Xapian::DB_NO_DOCLEN_ARRAY was passed.
+	 */
+	bool use_doclen_array;
+
 	/** The file describing the Brass database.
 	 *  This file has information about the format of the database
 	 *  which can't easily be stored in any of the individual tables.
@@ -116,6 +125,19 @@ class BrassDatabase : public Xapian::Database::Internal {
 	/// Database statistics.
 	BrassDatabaseStats stats;
 
+	/** Array of all the document lengths, or NULL.
+	 *
+	 *  This is only used for a read-only database, and only once enough
+	 *  document lengths have been looked up to make it worth building.
+	 */
+	mutable const BrassDoclenArray * doclens;
+
+	/// Number of document lengths looked up without doclens.
+	mutable Xapian::doccount doclen_lookups;
+
+	/// Release doclens, as the tables are being reopened.
+	void reset_doclens() const;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -206,6 +228,9 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	void apply();
 
+	/// Return true if any of the tables have been modified.
+	bool is_modified() const;
+
 	/** Cancel any outstanding changes to the tables.
 	 */
 	void cancel();
@@ -242,12 +267,15 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *
 	 *  @param dbdir directory holding brass tables
 	 *
+	 *  @param flags XAPIAN_DB_READONLY or a Xapian::DB_* action, bitwise
+	 *		 or-ed with any Xapian::DB_* flags.
+	 *
 	 *  @param block_size Block size, in bytes, to use when creating
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
 	 *                    created.
 	 */
-	BrassDatabase(const string &db_dir_, int action = XAPIAN_DB_READONLY,
+	BrassDatabase(const string &db_dir_, int flags = XAPIAN_DB_READONLY,
 		       unsigned int block_size = 0u);
 
 	~BrassDatabase();
@@ -278,6 +306,8 @@ class BrassDatabase : public Xapian::Database::Internal {
 	LeafPostList * open_post_list(const string & tname) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
+	void open_documents(const vector<Xapian::docid> & dids,
+			    vector<Xapian::Document> & docs) const;
 
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
 	TermList * open_term_list(Xapian::docid did) const;
@@ -327,6 +357,18 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// If change_count reaches this threshold we automatically flush.
 	Xapian::doccount flush_threshold;
 
+	/** Are we building a new database in "fresh build" mode?
+	 *
+	 *  In this mode, each flush writes the buffered postings to a new
+	 *  temporary postlist table (a "run"), rather than merging them into
+	 *  the postlist table.  When the build finishes, the runs are merged
+	 *  into the postlist table in a single pass.
+	 */
+	mutable bool fresh_build;
+
+	/// The path and prefix of the files of each run written so far.
+	mutable vector<string> postlist_runs;
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -342,6 +384,15 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// Flush any unflushed postlist changes, but don't commit them.
 	void flush_postlist_changes() const;
 
+	/// Write the unflushed postlist changes to a new run.
+	void write_postlist_run() const;
+
+	/// Merge the runs into the postlist table, ending the fresh build.
+	void finish_fresh_build() const;
+
+	/// Delete any runs.
+	void discard_postlist_runs() const;
+
 	/// Close all the tables permanently.
 	void close();
 
@@ -359,6 +410,8 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	Xapian::docid add_document(const Xapian::Document & document);
 	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
+	Xapian::docid add_documents(const vector<Xapian::Document> & documents,
+				    unsigned threads);
 	// Stop the default implementation of delete_document(term) and
 	// replace_document(term) from being hidden.  This isn't really
 	// a problem as we only try to call them through the base class
@@ -439,6 +492,7 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+	bool has_uncommitted_changes() const;
 	//@}
 };
 
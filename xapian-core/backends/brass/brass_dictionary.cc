@@ -0,0 +1,160 @@
+/** @file brass_dictionary.cc
+ * @brief Train a preset dictionary for compressing brass table tags.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "brass_dictionary.h"
+
+#include "internaltypes.h"
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// Length of the substrings we count.
+static const size_t KMER_LEN = 8;
+
+/// Length of the segments we pick to build the dictionary from.
+static const size_t SEGMENT_LEN = 256;
+
+/** Number of bits in the hash of a substring.
+ *
+ *  We count substrings by hash, so different substrings which collide are
+ *  counted together.  That doesn't matter much, as it only affects which
+ *  segments get picked.
+ */
+static const unsigned HASH_BITS = 20;
+
+/// Don't build a dictionary from less sample data than this.
+static const size_t MIN_SAMPLE_BYTES = 4 * SEGMENT_LEN;
+
+static inline uint4
+hash_kmer(const string & data, size_t pos)
+{
+    // FNV-1a.
+    uint4 h = 2166136261u;
+    for (size_t i = pos; i != pos + KMER_LEN; ++i) {
+	h ^= static_cast<unsigned char>(data[i]);
+	h *= 16777619u;
+    }
+    return (h & 0xffffffffu) >> (32 - HASH_BITS);
+}
+
+namespace {
+
+struct Segment {
+    uint4 score;
+    size_t begin, end;
+
+    Segment(uint4 score_, size_t begin_, size_t end_)
+	: score(score_), begin(begin_), end(end_) { }
+
+    bool operator<(const Segment & o) const { return score < o.score; }
+};
+
+}
+
+string
+brass_train_dictionary(const vector<string> & samples, size_t max_size)
+{
+    string data;
+    vector<string>::const_iterator i;
+    for (i = samples.begin(); i != samples.end(); ++i) data += *i;
+    if (data.size() < MIN_SAMPLE_BYTES || max_size < SEGMENT_LEN)
+	return string();
+
+    // Count how often each substring occurs.  We don't count substrings
+    // which span two samples.
+    vector<uint4> freqs(size_t(1) << HASH_BITS);
+    size_t start = 0;
+    for (i = samples.begin(); i != samples.end(); ++i) {
+	size_t end = start + i->size();
+	for (size_t pos = start; pos + KMER_LEN <= end; ++pos) {
+	    ++freqs[hash_kmer(data, pos)];
+	}
+	start = end;
+    }
+
+    // A dictionary much bigger than a quarter of the data sampled is
+    // unlikely to be representative.
+    size_t dict_size = min(max_size, data.size() / 4);
+    size_t epochs = max(dict_size / SEGMENT_LEN, size_t(1));
+    size_t epoch_size = data.size() / epochs;
+    AssertRel(epoch_size,>=,SEGMENT_LEN);
+
+    // How many times each substring occurs in the current window.
+    vector<unsigned short> window_freqs(size_t(1) << HASH_BITS);
+
+    vector<Segment> segments;
+    for (size_t epoch = 0; epoch != epochs; ++epoch) {
+	size_t epoch_begin = epoch * epoch_size;
+	size_t epoch_end = epoch_begin + epoch_size;
+	if (epoch + 1 == epochs) epoch_end = data.size();
+
+	// Slide a window of SEGMENT_LEN bytes across the epoch, keeping track
+	// of the total frequency of the distinct substrings in it.
+	uint4 score = 0;
+	Segment best(0, 0, 0);
+	size_t window_begin = epoch_begin;
+	size_t pos;
+	for (pos = epoch_begin; pos + KMER_LEN <= epoch_end; ++pos) {
+	    uint4 h = hash_kmer(data, pos);
+	    if (window_freqs[h]++ == 0) score += freqs[h];
+	    while (pos + KMER_LEN - window_begin > SEGMENT_LEN) {
+		uint4 old = hash_kmer(data, window_begin++);
+		if (--window_freqs[old] == 0) score -= freqs[old];
+	    }
+	    if (score > best.score) {
+		best = Segment(score, window_begin, pos + KMER_LEN);
+	    }
+	}
+	while (window_begin < pos) {
+	    window_freqs[hash_kmer(data, window_begin++)] = 0;
+	}
+
+	if (best.score == 0) continue;
+
+	// Substrings in the segment we've picked don't score for later
+	// segments, so we pick up different content from each epoch.
+	for (size_t p = best.begin; p + KMER_LEN <= best.end; ++p) {
+	    freqs[hash_kmer(data, p)] = 0;
+	}
+	segments.push_back(best);
+    }
+
+    // Put the best segments last, dropping the worst ones if we've picked
+    // more than will fit.
+    sort(segments.begin(), segments.end());
+    size_t total = 0;
+    size_t first = segments.size();
+    while (first != 0) {
+	const Segment & seg = segments[first - 1];
+	if (total + (seg.end - seg.begin) > max_size) break;
+	total += seg.end - seg.begin;
+	--first;
+    }
+
+    string dictionary;
+    dictionary.reserve(total);
+    for (size_t j = first; j != segments.size(); ++j) {
+	const Segment & seg = segments[j];
+	dictionary.append(data, seg.begin, seg.end - seg.begin);
+    }
+    return dictionary;
+}
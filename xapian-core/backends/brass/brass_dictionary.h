@@ -0,0 +1,42 @@
+/** @file brass_dictionary.h
+ * @brief Train a preset dictionary for compressing brass table tags.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_DICTIONARY_H
+#define XAPIAN_INCLUDED_BRASS_DICTIONARY_H
+
+#include <string>
+#include <vector>
+
+/** Train a zlib preset dictionary from some sample tags.
+ *
+ *  The samples are split into roughly equal ranges ("epochs"), and from each
+ *  range we pick the segment whose substrings occur most often across all
+ *  the samples, ignoring substrings already covered by an earlier segment.
+ *  The best segments go at the end of the dictionary, since zlib can refer
+ *  to data near the end of the dictionary more cheaply.
+ *
+ *  @param samples	Sample tags (uncompressed).
+ *  @param max_size	The maximum size of dictionary to build.
+ *
+ *  @return The dictionary, or an empty string if there isn't enough sample
+ *	    data to be worth building one.
+ */
+std::string brass_train_dictionary(const std::vector<std::string> & samples,
+				   size_t max_size);
+
+#endif // XAPIAN_INCLUDED_BRASS_DICTIONARY_H
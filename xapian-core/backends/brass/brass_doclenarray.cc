@@ -0,0 +1,191 @@
+/** @file brass_doclenarray.cc
+ * @brief Dense array of document lengths, shared between databases.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "brass_doclenarray.h"
+
+#include "xapian/error.h"
+
+#include "autoptr.h"
+#include "brass_alldocspostlist.h"
+#include "brass_database.h"
+#include "debuglog.h"
+#include "mutex.h"
+#include "omassert.h"
+#include "str.h"
+
+#include <cstdlib> // For getenv() and strtoul().
+#include <list>
+
+using namespace std;
+
+const Xapian::termcount BrassDoclenArray::NOT_PRESENT;
+
+/// The arrays which have been built, and the memory they use.
+class BrassDoclenArray::Registry {
+    /// Don't allow copying.
+    Registry(const Registry &);
+
+    /// Don't allow assignment.
+    void operator=(const Registry &);
+
+  public:
+    Mutex mutex;
+
+    /// The arrays, oldest first.
+    list<BrassDoclenArray *> arrays;
+
+    /// Maximum total size of the arrays in bytes.
+    size_t max_size;
+
+    /// Current total size of the arrays in bytes.
+    size_t used;
+
+    explicit Registry(size_t max_size_) : max_size(max_size_), used(0) { }
+
+    /** Find the array for @a revision of database @a uuid in @a file.
+     *
+     *  @return The array, or NULL if there isn't one.
+     */
+    BrassDoclenArray * find(const string & uuid,
+			    const BlockCache::FileId & file,
+			    brass_revision_number_t revision) {
+	list<BrassDoclenArray *>::const_iterator i;
+	for (i = arrays.begin(); i != arrays.end(); ++i) {
+	    if ((*i)->revision == revision && (*i)->file.same_file(file) &&
+		(*i)->uuid == uuid) return *i;
+	}
+	return NULL;
+    }
+
+    /** Delete unused arrays, oldest first, until @a size bytes will fit.
+     *
+     *  @return false if there isn't room even after deleting all the
+     *		unused arrays.
+     */
+    bool make_room(size_t size) {
+	if (size > max_size) return false;
+	list<BrassDoclenArray *>::iterator i = arrays.begin();
+	while (used + size > max_size) {
+	    if (i == arrays.end()) return false;
+	    if ((*i)->refs) {
+		++i;
+		continue;
+	    }
+	    used -= (*i)->get_size();
+	    delete *i;
+	    i = arrays.erase(i);
+	}
+	return true;
+    }
+};
+
+/// Find the limit on the total size of the arrays.
+static size_t
+get_cache_size()
+{
+    size_t size = BrassDoclenArray::DEFAULT_CACHE_SIZE;
+    const char * p = getenv("XAPIAN_DOCLEN_CACHE_SIZE");
+    if (p && *p) size = strtoul(p, NULL, 10);
+    return size;
+}
+
+BrassDoclenArray::Registry *
+BrassDoclenArray::get_registry()
+{
+    // Like the BlockCache, the registry is deliberately never deleted, as
+    // databases may be destroyed during static destruction.
+    static Registry * registry = new Registry(get_cache_size());
+    return registry;
+}
+
+const BrassDoclenArray *
+BrassDoclenArray::acquire(const BrassDatabase * db)
+{
+    LOGCALL_STATIC(DB, const BrassDoclenArray *, "BrassDoclenArray::acquire", (void*)db);
+    Registry * registry = get_registry();
+
+    string uuid = db->get_uuid();
+    BlockCache::FileId file;
+    if (!db->postlist_table.get_file_id(file)) RETURN(NULL);
+    brass_revision_number_t revision = db->get_revision_number();
+    Xapian::docid last_docid = db->stats.get_last_docid();
+    size_t size = (size_t(last_docid) + 1) * sizeof(Xapian::termcount);
+    {
+	MutexLock lock(registry->mutex);
+	BrassDoclenArray * array = registry->find(uuid, file, revision);
+	if (array) {
+	    ++array->refs;
+	    RETURN(array);
+	}
+	if (size > registry->max_size) RETURN(NULL);
+    }
+
+    // Build the array without holding the lock, since reading the whole
+    // doclen postlist can take a while.
+    AutoPtr<BrassDoclenArray> new_array(new BrassDoclenArray(uuid, file,
+								     revision));
+    vector<Xapian::termcount> & lengths = new_array->lengths;
+    lengths.resize(last_docid + 1, NOT_PRESENT);
+    Xapian::Internal::intrusive_ptr<const BrassDatabase> ptrtodb(db);
+    BrassAllDocsPostList pl(ptrtodb, db->get_doccount());
+    (void)pl.next(0.0);
+    const Xapian::doccount BATCH = 256;
+    Xapian::docid dids[BATCH];
+    Xapian::termcount doclens[BATCH];
+    Xapian::doccount n;
+    do {
+	n = pl.get_batch(BATCH, dids, NULL, doclens);
+	for (Xapian::doccount i = 0; i != n; ++i) {
+	    if (rare(dids[i] > last_docid)) {
+		throw Xapian::DatabaseCorruptError("Document ID " + str(dids[i]) +
+						   " is greater than the last "
+						   "document ID " +
+						   str(last_docid));
+	    }
+	    lengths[dids[i]] = doclens[i];
+	}
+    } while (n == BATCH);
+
+    MutexLock lock(registry->mutex);
+    BrassDoclenArray * array = registry->find(uuid, file, revision);
+    if (array) {
+	// Another thread built the same array while we were.
+	++array->refs;
+	RETURN(array);
+    }
+    if (!registry->make_room(size)) RETURN(NULL);
+    array = new_array.release();
+    array->refs = 1;
+    registry->arrays.push_back(array);
+    registry->used += size;
+    RETURN(array);
+}
+
+void
+BrassDoclenArray::release(const BrassDoclenArray * array)
+{
+    LOGCALL_STATIC_VOID(DB, "BrassDoclenArray::release", (void*)array);
+    if (!array) return;
+    Registry * registry = get_registry();
+    MutexLock lock(registry->mutex);
+    AssertRel(array->refs,>,0);
+    // Leave the array in the registry, in case it's wanted again.
+    --array->refs;
+}
@@ -0,0 +1,124 @@
+/** @file brass_doclenarray.h
+ * @brief Dense array of document lengths, shared between databases.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_DOCLENARRAY_H
+#define XAPIAN_INCLUDED_BRASS_DOCLENARRAY_H
+
+#include "xapian/types.h"
+
+#include "../blockcache.h"
+#include "brass_types.h"
+
+#include <string>
+#include <vector>
+
+class BrassDatabase;
+
+/** A dense array of the document lengths in a brass database.
+ *
+ *  Looking up a document length in the doclen postlist means finding and
+ *  decoding the right chunk, and the matcher does this for nearly every
+ *  candidate document.  Once a read-only database has done enough lookups
+ *  (see BrassDatabase::get_doclength()) it reads the whole doclen postlist
+ *  into one of these, after which each lookup is just an array access.
+ *
+ *  An array is shared by all the databases in the process which have the
+ *  same revision of the same database open.  A database is identified by
+ *  its UUID and the postlist table's file, since copies of a database (made
+ *  by replication or by copying the files) have the same UUID, and may have
+ *  diverged while reaching the same revision number.
+ *
+ *  The total size of the arrays defaults to DEFAULT_CACHE_SIZE bytes, and
+ *  can be set with the environment variable XAPIAN_DOCLEN_CACHE_SIZE (a value
+ *  of 0 disables the arrays).  Arrays which no database is using are kept
+ *  until the space is needed, so reopening a database at the same revision
+ *  doesn't have to build the array again.
+ */
+class BrassDoclenArray {
+    class Registry;
+    friend class Registry;
+
+    /// Return the process-wide registry.
+    static Registry * get_registry();
+
+    /// The UUID of the database.
+    std::string uuid;
+
+    /// Identifies the database's postlist table file.
+    BlockCache::FileId file;
+
+    /// The revision of the database.
+    brass_revision_number_t revision;
+
+    /// The document lengths, indexed by docid (NOT_PRESENT if unused).
+    std::vector<Xapian::termcount> lengths;
+
+    /** The number of databases using this array.
+     *
+     *  This is protected by the registry's mutex.
+     */
+    mutable unsigned refs;
+
+    BrassDoclenArray(const std::string & uuid_,
+		     const BlockCache::FileId & file_,
+		     brass_revision_number_t revision_)
+	: uuid(uuid_), file(file_), revision(revision_), refs(0) { }
+
+    /// Don't allow copying.
+    BrassDoclenArray(const BrassDoclenArray &);
+
+    /// Don't allow assignment.
+    void operator=(const BrassDoclenArray &);
+
+    /// The value stored for docids which aren't in use.
+    static const Xapian::termcount NOT_PRESENT = Xapian::termcount(-1);
+
+    /// Memory used by the lengths.
+    size_t get_size() const {
+	return lengths.size() * sizeof(Xapian::termcount);
+    }
+
+  public:
+    /// Default limit on the total size of the arrays in bytes.
+    static const size_t DEFAULT_CACHE_SIZE = 64 * 1024 * 1024;
+
+    /** Look up the length of document @a did.
+     *
+     *  @return false if there's no such document.
+     */
+    bool get_doclength(Xapian::docid did, Xapian::termcount & doclen) const {
+	if (did >= lengths.size()) return false;
+	doclen = lengths[did];
+	return doclen != NOT_PRESENT;
+    }
+
+    /** Get the array for the revision @a db has open.
+     *
+     *  The array is built if there isn't one already.  The caller must
+     *  pass the array to release() when it's finished with it.
+     *
+     *  @return The array, or NULL if it wouldn't fit in the cache (or
+     *		the arrays are disabled).
+     */
+    static const BrassDoclenArray * acquire(const BrassDatabase * db);
+
+    /// Release an array returned by acquire() (NULL is ignored).
+    static void release(const BrassDoclenArray * array);
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_DOCLENARRAY_H
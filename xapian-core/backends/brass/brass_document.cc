@@ -55,5 +55,6 @@ string
 BrassDocument::do_get_data() const
 {
     LOGCALL(DB, string, "BrassDocument::do_get_data", NO_ARGS);
+    if (have_data) RETURN(data);
     RETURN(record_table->get_record(did));
 }
@@ -40,6 +40,12 @@ class BrassDocument : public Xapian::Document::Internal {
     /// Used for lazy access to document data.
     const BrassRecordTable *record_table;
 
+    /// The document data, if it was read when the document was opened.
+    string data;
+
+    /// True if the document data was read when the document was opened.
+    bool have_data;
+
     /// BrassDatabase::open_document() needs to call our private constructor.
     friend class BrassDatabase;
 
@@ -49,7 +55,20 @@ class BrassDocument : public Xapian::Document::Internal {
 		  const BrassValueManager *value_manager_,
 		  const BrassRecordTable *record_table_)
 	: Xapian::Document::Internal(db, did_),
-	  value_manager(value_manager_), record_table(record_table_) { }
+	  value_manager(value_manager_), record_table(record_table_),
+	  have_data(false) { }
+
+    /// Private constructor used when the document data has already been read.
+    BrassDocument(Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal> db,
+		  Xapian::docid did_,
+		  const BrassValueManager *value_manager_,
+		  const BrassRecordTable *record_table_,
+		  string & data_)
+	: Xapian::Document::Internal(db, did_),
+	  value_manager(value_manager_), record_table(record_table_),
+	  have_data(true) {
+	swap(data, data_);
+    }
 
   public:
     /** Implementation of virtual methods @{ */
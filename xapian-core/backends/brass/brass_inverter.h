@@ -25,6 +25,8 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "omassert.h"
 #include "str.h"
@@ -75,6 +77,25 @@ class Inverter {
 	    pl_changes.insert(std::make_pair(did, new_wdf));
 	}
 
+	/// Constructor for a run of added postings.
+	explicit PostingChanges(const std::vector<std::pair<Xapian::docid, Xapian::termcount> > & postings)
+	    : tf_delta(0), cf_delta(0)
+	{
+	    add_postings(postings);
+	}
+
+	/// Add a run of postings, in ascending docid order.
+	void add_postings(const std::vector<std::pair<Xapian::docid, Xapian::termcount> > & postings) {
+	    std::vector<std::pair<Xapian::docid, Xapian::termcount> >::const_iterator i;
+	    for (i = postings.begin(); i != postings.end(); ++i) {
+		++tf_delta;
+		cf_delta += i->second;
+		// The postings are usually for new documents, so will go at
+		// the end.
+		pl_changes.insert(pl_changes.end(), *i)->second = i->second;
+	    }
+	}
+
 	/// Add a posting.
 	void add_posting(Xapian::docid did, Xapian::termcount wdf) {
 	    ++tf_delta;
@@ -125,6 +146,24 @@ class Inverter {
 	}
     }
 
+    /** Add a run of postings for @a term.
+     *
+     *  This is equivalent to calling add_posting() for each entry in
+     *  @a postings, which must be in ascending docid order, but only looks
+     *  up @a term once.
+     */
+    void add_postings(const std::string & term,
+		      const std::vector<std::pair<Xapian::docid, Xapian::termcount> > & postings) {
+	std::map<std::string, PostingChanges>::iterator i;
+	i = postlist_changes.find(term);
+	if (i == postlist_changes.end()) {
+	    postlist_changes.insert(
+		std::make_pair(term, PostingChanges(postings)));
+	} else {
+	    i->second.add_postings(postings);
+	}
+    }
+
     void remove_posting(Xapian::docid did, const std::string & term,
 			Xapian::doccount wdf) {
 	std::map<std::string, PostingChanges>::iterator i;
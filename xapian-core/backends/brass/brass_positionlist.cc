@@ -28,6 +28,7 @@
 #include "debuglog.h"
 #include "pack.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -43,12 +44,60 @@ BrassPositionListTable::set_positionlist(Xapian::docid did,
     LOGCALL_VOID(DB, "BrassPositionListTable::set_positionlist", did | tname | pos | pos_end | check_for_update);
     Assert(pos != pos_end);
 
+    string key = make_key(did, tname);
+
+    string s = encode_positionlist(pos, pos_end);
+
+    if (check_for_update) {
+	string old_tag;
+	if (get_exact_entry(key, old_tag) && s == old_tag)
+	    return;
+    }
+    add(key, s);
+}
+
+string
+BrassPositionListTable::encode_positionlist(Xapian::PositionIterator pos,
+					    const Xapian::PositionIterator &pos_end)
+{
+    LOGCALL_STATIC(DB, string, "BrassPositionListTable::encode_positionlist", pos | pos_end);
+    Assert(pos != pos_end);
+
     // FIXME: avoid the need for this copy!
     vector<Xapian::termpos> poscopy(pos, pos_end);
 
-    string key = make_key(did, tname);
-
     string s;
+    if (poscopy.size() >= BRASS_POSITIONLIST_BLOCKED_MIN) {
+	// Use the blocked encoding.
+	const size_t block_size = BRASS_POSITIONLIST_BLOCK_SIZE;
+	s += '\0';
+	pack_uint(s, poscopy.size());
+	pack_uint(s, block_size);
+	string block_data;
+	Xapian::termpos prev_last = 0;
+	for (size_t start = 0; start < poscopy.size(); start += block_size) {
+	    size_t last = min(start + block_size, poscopy.size()) - 1;
+	    Xapian::termpos first_pos = poscopy[start];
+	    Xapian::termpos last_pos = poscopy[last];
+	    pack_uint(s, start ? first_pos - prev_last - 1 : first_pos);
+	    pack_uint(s, last_pos - first_pos);
+	    prev_last = last_pos;
+	    // Each block's data is padded to a whole number of bytes so that
+	    // it can be decoded independently.
+	    size_t len = 0;
+	    if (last - start > 1) {
+		BitWriter wr;
+		wr.encode_interpolative(poscopy, start, last);
+		const string & bits = wr.freeze();
+		len = bits.size();
+		block_data += bits;
+	    }
+	    pack_uint(s, len);
+	}
+	s += block_data;
+	RETURN(s);
+    }
+
     pack_uint(s, poscopy.back());
 
     if (poscopy.size() > 1) {
@@ -58,13 +107,7 @@ BrassPositionListTable::set_positionlist(Xapian::docid did,
 	wr.encode_interpolative(poscopy, 0, poscopy.size() - 1);
 	swap(s, wr.freeze());
     }
-
-    if (check_for_update) {
-	string old_tag;
-	if (get_exact_entry(key, old_tag) && s == old_tag)
-	    return;
-    }
-    add(key, s);
+    RETURN(s);
 }
 
 Xapian::termcount
@@ -88,6 +131,14 @@ BrassPositionListTable::positionlist_count(Xapian::docid did,
 	// Special case for single entry position list.
 	RETURN(1);
     }
+    if (pos_last == 0) {
+	// Blocked encoding, which starts with the number of positions.
+	Xapian::termcount pos_size;
+	if (!unpack_uint(&pos, end, &pos_size)) {
+	    throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	}
+	RETURN(pos_size);
+    }
 
     // Skip the header we just read.
     BitReader rd(data, pos - data.data());
@@ -104,46 +155,126 @@ BrassPositionList::read_data(const BrassTable * table, Xapian::docid did,
 {
     LOGCALL(DB, bool, "BrassPositionList::read_data", table | did | tname);
 
-    have_started = false;
-    positions.clear();
-
-    string data;
-    if (!table->get_exact_entry(BrassPositionListTable::make_key(did, tname), data)) {
+    string tag;
+    if (!table->get_exact_entry(BrassPositionListTable::make_key(did, tname), tag)) {
 	// There's no positional information for this term.
+	have_started = false;
+	size = 0;
+	blocks.clear();
+	positions.clear();
 	current_pos = positions.begin();
 	RETURN(false);
     }
 
-    const char * pos = data.data();
-    const char * end = pos + data.size();
+    read_data(tag);
+    RETURN(true);
+}
+
+void
+BrassPositionList::read_data(string & data_)
+{
+    LOGCALL_VOID(DB, "BrassPositionList::read_data", data_);
+
+    have_started = false;
+    blocks.clear();
+    positions.clear();
+    data.resize(0);
+
+    const char * pos = data_.data();
+    const char * end = pos + data_.size();
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
     }
     if (pos == end) {
 	// Special case for single entry position list.
+	size = 1;
 	positions.push_back(pos_last);
 	current_pos = positions.begin();
-	RETURN(true);
+	return;
     }
+
+    if (pos_last == 0) {
+	// Blocked encoding - read the skip index, but don't decode any
+	// blocks until we need them.
+	if (!unpack_uint(&pos, end, &size) ||
+	    !unpack_uint(&pos, end, &block_size) ||
+	    block_size < 2 || size == 0) {
+	    throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	}
+	size_t n_blocks = (size - 1) / block_size + 1;
+	blocks.resize(n_blocks);
+	Xapian::termpos prev_last = 0;
+	size_t offset = 0;
+	for (size_t b = 0; b != n_blocks; ++b) {
+	    Block & block = blocks[b];
+	    Xapian::termpos delta, span;
+	    if (!unpack_uint(&pos, end, &delta) ||
+		!unpack_uint(&pos, end, &span) ||
+		!unpack_uint(&pos, end, &block.length)) {
+		throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	    }
+	    block.first = b ? prev_last + delta + 1 : delta;
+	    block.last = block.first + span;
+	    block.offset = offset;
+	    offset += block.length;
+	    Xapian::termcount n = (b + 1 == n_blocks) ?
+		size - b * block_size : block_size;
+	    if (rare(span < n - 1 || (b && block.first <= prev_last))) {
+		throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	    }
+	    prev_last = block.last;
+	}
+	if (rare(size_t(end - pos) != offset)) {
+	    throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	}
+	// Make the offsets relative to the start of the encoded data.
+	size_t data_start = pos - data_.data();
+	for (size_t b = 0; b != n_blocks; ++b) {
+	    blocks[b].offset += data_start;
+	}
+	swap(data, data_);
+	decode_block(0);
+	return;
+    }
+
     // Skip the header we just read.
-    BitReader rd(data, pos - data.data());
+    BitReader rd(data_, pos - data_.data());
     Xapian::termpos pos_first = rd.decode(pos_last);
     Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
+    size = pos_size;
     positions.resize(pos_size);
     positions[0] = pos_first;
     positions.back() = pos_last;
     rd.decode_interpolative(positions, 0, pos_size - 1);
 
     current_pos = positions.begin();
-    RETURN(true);
+}
+
+void
+BrassPositionList::decode_block(size_t b)
+{
+    LOGCALL_VOID(DB, "BrassPositionList::decode_block", b);
+    AssertRel(b,<,blocks.size());
+    current_block = b;
+    const Block & block = blocks[b];
+    Xapian::termcount n = (b + 1 == blocks.size()) ?
+	size - b * block_size : block_size;
+    positions.resize(n);
+    positions[0] = block.first;
+    positions[n - 1] = block.last;
+    if (n > 2) {
+	BitReader rd(data, block.offset, block.length);
+	rd.decode_interpolative(positions, 0, n - 1);
+    }
+    current_pos = positions.begin();
 }
 
 Xapian::termcount
 BrassPositionList::get_size() const
 {
     LOGCALL(DB, Xapian::termcount, "BrassPositionList::get_size", NO_ARGS);
-    RETURN(positions.size());
+    RETURN(size);
 }
 
 Xapian::termpos
@@ -163,7 +294,10 @@ BrassPositionList::next()
 	have_started = true;
     } else {
 	Assert(!at_end());
-	++current_pos;
+	if (++current_pos == positions.end() &&
+	    current_block + 1 < blocks.size()) {
+	    decode_block(current_block + 1);
+	}
     }
 }
 
@@ -174,6 +308,26 @@ BrassPositionList::skip_to(Xapian::termpos termpos)
     if (!have_started) {
 	have_started = true;
     }
+    if (at_end()) return;
+    if (!blocks.empty() && termpos > blocks[current_block].last) {
+	// Use the skip index to find the first block which could contain
+	// termpos, and decode just that block.
+	size_t lo = current_block + 1, hi = blocks.size();
+	while (lo < hi) {
+	    size_t mid = lo + (hi - lo) / 2;
+	    if (blocks[mid].last < termpos) {
+		lo = mid + 1;
+	    } else {
+		hi = mid;
+	    }
+	}
+	if (lo == blocks.size()) {
+	    // termpos is after the last position.
+	    current_pos = positions.end();
+	    return;
+	}
+	decode_block(lo);
+    }
     while (!at_end() && *current_pos < termpos) ++current_pos;
 }
 
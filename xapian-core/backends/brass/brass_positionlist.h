@@ -22,6 +22,7 @@
 #define XAPIAN_HGUARD_BRASS_POSITIONLIST_H
 
 #include <xapian/types.h>
+#include <xapian/visibility.h>
 
 #include "brass_lazytable.h"
 #include "pack.h"
@@ -63,6 +64,13 @@ class BrassPositionListTable : public BrassLazyTable {
 			  const Xapian::PositionIterator &pos_end,
 			  bool check_for_update);
 
+    /** Encode a position list.
+     *
+     *  This doesn't access the table, so can be called from any thread.
+     */
+    static string encode_positionlist(Xapian::PositionIterator pos,
+				      const Xapian::PositionIterator &pos_end);
+
     /// Delete the position list for term tname in document did.
     void delete_positionlist(Xapian::docid did, const string & tname) {
 	del(make_key(did, tname));
@@ -73,17 +81,89 @@ class BrassPositionListTable : public BrassLazyTable {
 					 const string & term) const;
 };
 
-/** A position list in a brass database. */
-class BrassPositionList : public PositionList {
-    /// Vector of term positions.
+/** Position lists with at least this many entries use the blocked encoding.
+ *
+ *  Shorter lists are cheap to decode in full, so they use the original (more
+ *  compact) encoding.
+ */
+#define BRASS_POSITIONLIST_BLOCKED_MIN 64
+
+/// The number of positions in each block in the blocked encoding.
+#define BRASS_POSITIONLIST_BLOCK_SIZE 32
+
+/** A position list in a brass database.
+ *
+ *  There are two encodings for a position list.  The original encoding is:
+ *
+ *  pack_uint(last position), and if there's more than one position:
+ *  (bit-packed) first position, number of positions - 2, and the positions
+ *  in between, interpolative coded.
+ *
+ *  This has to be decoded in full to get at any entry, which is slow for long
+ *  lists if we only need to look at a few positions (as is often the case
+ *  for phrase and NEAR matching).  So longer lists use a blocked encoding:
+ *
+ *  A zero byte (which can't be followed by any more data in the original
+ *  encoding since the last position would have to be 0), pack_uint(number of
+ *  positions), pack_uint(positions per block), then a skip index with an
+ *  entry for each block:
+ *
+ *  pack_uint(first position in block - last position in previous block - 1)
+ *  (or just the first position for the first block),
+ *  pack_uint(last position in block - first position in block),
+ *  pack_uint(length of the block's data in bytes)
+ *
+ *  Then the data for each block follows - the positions between the first
+ *  and last in the block, interpolative coded.  The reader uses the skip
+ *  index to decode only the blocks which are needed.
+ */
+class XAPIAN_VISIBILITY_DEFAULT BrassPositionList : public PositionList {
+    /// Information about a block in the blocked encoding.
+    struct Block {
+	/// First position in the block.
+	Xapian::termpos first;
+
+	/// Last position in the block.
+	Xapian::termpos last;
+
+	/// Offset of the block's data in data.
+	size_t offset;
+
+	/// Length of the block's data.
+	size_t length;
+    };
+
+    /// The encoded position list (only kept for the blocked encoding).
+    string data;
+
+    /// The skip index (empty for the original encoding).
+    vector<Block> blocks;
+
+    /// The number of positions in each block.
+    Xapian::termcount block_size;
+
+    /// The number of positions in the list.
+    Xapian::termcount size;
+
+    /** Decoded term positions.
+     *
+     *  For the original encoding, this is all the positions.  For the
+     *  blocked encoding, it's the positions in the current block.
+     */
     vector<Xapian::termpos> positions;
 
-    /// Position of iteration through data.
+    /// The block the positions are from.
+    size_t current_block;
+
+    /// Position of iteration through positions.
     vector<Xapian::termpos>::const_iterator current_pos;
 
     /// Have we started iterating yet?
     bool have_started;
 
+    /// Decode block b into positions and move to its first position.
+    void decode_block(size_t b);
+
     /// Advance to next term position.
     void next_internal();
 
@@ -95,7 +175,9 @@ class BrassPositionList : public PositionList {
 
   public:
     /// Default constructor.
-    BrassPositionList() : have_started(false) {}
+    BrassPositionList() : size(0), have_started(false) {
+	current_pos = positions.begin();
+    }
 
     /// Construct and initialise with data.
     BrassPositionList(const BrassTable * table, Xapian::docid did,
@@ -110,6 +192,14 @@ class BrassPositionList : public PositionList {
     bool read_data(const BrassTable * table, Xapian::docid did,
 		   const string & tname);
 
+    /** Fill list from an encoded position list, and move to the start.
+     *
+     *  @param data_	The encoded position list.  This may be swapped
+     *			with an internal string, so its contents are
+     *			unspecified afterwards.
+     */
+    void read_data(string & data_);
+
     /// Returns size of position list.
     Xapian::termcount get_size() const;
 
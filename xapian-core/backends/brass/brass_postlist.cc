@@ -24,13 +24,19 @@
 
 #include "brass_postlist.h"
 
+#include "brass_compact.h"
 #include "brass_cursor.h"
 #include "brass_database.h"
+#include "brass_postlistblock.h"
 #include "debuglog.h"
 #include "noreturn.h"
 #include "pack.h"
 #include "str.h"
 
+#include "xapian/weight.h"
+
+#include <algorithm>
+
 using Xapian::Internal::intrusive_ptr;
 
 Xapian::doccount
@@ -110,10 +116,11 @@ class Brass::PostlistChunkWriter {
 
 	/// Append a block of raw entries to this chunk.
 	void raw_append(Xapian::docid first_did_, Xapian::docid current_did_,
-			const string & s) {
+			Xapian::termcount max_wdf_, const string & s) {
 	    Assert(!started);
 	    first_did = first_did_;
 	    current_did = current_did_;
+	    max_wdf = max_wdf_;
 	    if (!s.empty()) {
 		chunk.append(s);
 		started = true;
@@ -136,6 +143,9 @@ class Brass::PostlistChunkWriter {
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
+	/// The greatest wdf of any entry in the chunk.
+	Xapian::termcount max_wdf;
+
 	string chunk;
 };
 
@@ -234,15 +244,21 @@ static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    bool * is_packed_ptr,
+		    Xapian::termcount * max_wdf_ptr)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr) | reinterpret_cast<const void*>(is_packed_ptr) | reinterpret_cast<const void*>(max_wdf_ptr));
     Assert(is_last_chunk_ptr);
+    Assert(is_packed_ptr);
 
-    // Read whether this is the last chunk
-    if (!unpack_bool(posptr, end, is_last_chunk_ptr))
-	report_read_error(*posptr);
+    // Read whether this is the last chunk, and how the entries are encoded.
+    if (*posptr == end) report_read_error(NULL);
+    if (!Brass::decode_chunk_flag(**posptr, is_last_chunk_ptr, is_packed_ptr))
+	throw Xapian::DatabaseCorruptError("Bad postlist chunk flag");
+    ++*posptr;
     LOGVALUE(DB, *is_last_chunk_ptr);
+    LOGVALUE(DB, *is_packed_ptr);
 
     // Read what the final document ID in this chunk is.
     Xapian::docid increase_to_last;
@@ -250,6 +266,12 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    // Read the greatest wdf of any entry in this chunk.
+    if (!unpack_uint(posptr, end, max_wdf_ptr))
+	report_read_error(*posptr);
+    if (max_wdf_ptr)
+	LOGVALUE(DB, *max_wdf_ptr);
     RETURN(last_did_in_chunk);
 }
 
@@ -265,19 +287,39 @@ class Brass::PostlistChunkReader {
 
     bool at_end;
 
+    /// Is the chunk block-packed?
+    bool is_packed;
+
     Xapian::docid did;
     Xapian::termcount wdf;
 
+    /// Entries in the current block, if the chunk is block-packed.
+    Xapian::docid block_dids[BRASS_POSTLIST_BLOCK_SIZE];
+    Xapian::termcount block_wdfs[BRASS_POSTLIST_BLOCK_SIZE];
+    unsigned block_size;
+    unsigned block_index;
+
+    /// Unpack the next block, given the last docid before it.
+    void read_block(Xapian::docid prev_did);
+
   public:
     /** Initialise the postlist chunk reader.
      *
      *  @param first_did  First document id in this chunk.
+     *  @param is_packed_ Is the chunk block-packed?
      *  @param data       The tag string with the header removed.
      */
-    PostlistChunkReader(Xapian::docid first_did, const string & data_)
-	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
+    PostlistChunkReader(Xapian::docid first_did, bool is_packed_,
+			const string & data_)
+	: data(data_), pos(data.data()), end(pos + data.length()),
+	  at_end(data.empty()), is_packed(is_packed_), did(first_did)
     {
-	if (!at_end) read_wdf(&pos, end, &wdf);
+	if (at_end) return;
+	if (is_packed) {
+	    read_block(first_did - 1);
+	} else {
+	    read_wdf(&pos, end, &wdf);
+	}
     }
 
     Xapian::docid get_docid() const {
@@ -298,9 +340,33 @@ class Brass::PostlistChunkReader {
 
 using Brass::PostlistChunkReader;
 
+void
+PostlistChunkReader::read_block(Xapian::docid prev_did)
+{
+    Brass::PostlistBlockHeader hdr;
+    if (!Brass::unpack_postlist_block_header(&pos, end, hdr))
+	report_read_error(pos);
+    Brass::unpack_postlist_block(&pos, hdr, prev_did, block_dids, block_wdfs);
+    block_size = hdr.size;
+    block_index = 0;
+    did = block_dids[0];
+    wdf = block_wdfs[0];
+}
+
 void
 PostlistChunkReader::next()
 {
+    if (is_packed) {
+	if (++block_index < block_size) {
+	    did = block_dids[block_index];
+	    wdf = block_wdfs[block_index];
+	} else if (pos == end) {
+	    at_end = true;
+	} else {
+	    read_block(did);
+	}
+	return;
+    }
     if (pos == end) {
 	at_end = true;
     } else {
@@ -316,7 +382,7 @@ PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false), max_wdf(0)
 {
     LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
 }
@@ -338,6 +404,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	    is_last_chunk = save_is_last_chunk;
 	    is_first_chunk = false;
 	    first_did = did;
+	    max_wdf = 0;
 	    chunk.resize(0);
 	    orig_key = BrassPostListTable::make_key(tname, first_did);
 	} else {
@@ -345,6 +412,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	}
     }
     current_did = did;
+    if (wdf > max_wdf) max_wdf = wdf;
     pack_uint(chunk, wdf);
 }
 
@@ -366,13 +434,16 @@ make_start_of_first_chunk(Xapian::doccount entries,
  */
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
+		    bool new_is_packed,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    Xapian::termcount new_max_wdf)
 {
     Assert(new_final_did >= new_first_did);
     string chunk;
-    pack_bool(chunk, new_is_last_chunk);
+    chunk += Brass::encode_chunk_flag(new_is_last_chunk, new_is_packed);
     pack_uint(chunk, new_final_did - new_first_did);
+    pack_uint(chunk, new_max_wdf);
     return chunk;
 }
 
@@ -381,15 +452,18 @@ write_start_of_chunk(string & chunk,
 		     unsigned int start_of_chunk_header,
 		     unsigned int end_of_chunk_header,
 		     bool is_last_chunk,
+		     bool is_packed,
 		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
+		     Xapian::docid last_did_in_chunk,
+		     Xapian::termcount max_wdf)
 {
     Assert((size_t)(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
 
     chunk.replace(start_of_chunk_header,
 		  end_of_chunk_header - start_of_chunk_header,
-		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
+		  make_start_of_chunk(is_last_chunk, is_packed,
+				      first_did_in_chunk, last_did_in_chunk,
+				      max_wdf));
 }
 
 void
@@ -480,9 +554,12 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    // Read the chunk header
 	    bool new_is_last_chunk;
+	    bool new_is_packed;
+	    Xapian::termcount new_max_wdf;
 	    Xapian::docid new_last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
+				    &new_is_last_chunk, &new_is_packed,
+				    &new_max_wdf);
 
 	    string chunk_data(tagpos, tagend);
 
@@ -493,8 +570,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 	    string tag;
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
+					      new_is_packed,
 					      new_first_did,
-					      new_last_did_in_chunk);
+					      new_last_did_in_chunk,
+					      new_max_wdf);
 	    tag += chunk_data;
 	    table->add(orig_key, tag);
 	    return;
@@ -542,10 +621,13 @@ PostlistChunkWriter::flush(BrassTable *table)
 		    report_read_error(keypos);
 	    }
 	    bool wrong_is_last_chunk;
+	    bool is_packed;
+	    Xapian::termcount max_wdf_in_chunk;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
 	    Xapian::docid last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
+				    &wrong_is_last_chunk, &is_packed,
+				    &max_wdf_in_chunk);
 	    string::size_type end_of_chunk_header = tagpos - tag.data();
 
 	    // write new is_last flag
@@ -553,8 +635,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 				 start_of_chunk_header,
 				 end_of_chunk_header,
 				 true, // is_last_chunk
+				 is_packed,
 				 first_did_in_chunk,
-				 last_did_in_chunk);
+				 last_did_in_chunk,
+				 max_wdf_in_chunk);
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -592,7 +676,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
+	    tag += make_start_of_chunk(is_last_chunk, false, first_did,
+				       current_did, max_wdf);
 	    tag += chunk;
 	    table->add(key, tag);
 	    return;
@@ -632,7 +717,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, false, first_did, current_did,
+				  max_wdf);
 
 	tag += chunk;
 	table->add(new_key, tag);
@@ -665,9 +751,13 @@ void BrassPostList::read_number_of_entries(const char ** posptr,
  *
  *  1)  bool - true if this is the last chunk.
  *  2)  difference between final docid in chunk and first docid.
- *  3)  wdf for the first item.
- *  4)  increment in docid to next item, followed by wdf for the item.
- *  5)  (4) repeatedly.
+ *  3)  the greatest wdf of any item in the chunk.
+ *  4)  wdf for the first item.
+ *  5)  increment in docid to next item, followed by wdf for the item.
+ *  6)  (5) repeatedly.
+ *
+ *  The greatest wdf allows the matcher to skip a whole chunk when no entry
+ *  in it could have enough weight to be of interest.
  *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
@@ -680,6 +770,7 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 	  this_db(keep_reference ? this_db_ : NULL),
 	  have_started(false),
 	  is_at_end(false),
+	  prefetch_hinted(false),
 	  cursor(this_db_->postlist_table.cursor_get())
 {
     LOGCALL_CTOR(DB, "BrassPostList", this_db_.get() | term_ | keep_reference);
@@ -693,6 +784,10 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 	end = 0;
 	first_did_in_chunk = 0;
 	last_did_in_chunk = 0;
+	max_wdf_in_chunk = 0;
+	max_weight_in_chunk = -1;
+	is_packed_chunk = false;
+	block_size = block_index = 0;
 	return;
     }
     cursor->read_tag();
@@ -702,8 +797,10 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    read_first_entry();
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -721,10 +818,45 @@ BrassPostList::get_doclength() const
     RETURN(this_db->get_doclength(did));
 }
 
+void
+BrassPostList::read_first_entry()
+{
+    if (is_packed_chunk) {
+	read_block(first_did_in_chunk - 1);
+    } else {
+	read_wdf(&pos, end, &wdf);
+    }
+}
+
+void
+BrassPostList::read_block(Xapian::docid prev_did)
+{
+    LOGCALL_VOID(DB, "BrassPostList::read_block", prev_did);
+    Brass::PostlistBlockHeader hdr;
+    if (!Brass::unpack_postlist_block_header(&pos, end, hdr))
+	report_read_error(pos);
+    Brass::unpack_postlist_block(&pos, hdr, prev_did, block_dids, block_wdfs);
+    block_size = hdr.size;
+    block_index = 0;
+    did = block_dids[0];
+    wdf = block_wdfs[0];
+}
+
 bool
 BrassPostList::next_in_chunk()
 {
     LOGCALL(DB, bool, "BrassPostList::next_in_chunk", NO_ARGS);
+    if (is_packed_chunk) {
+	if (++block_index < block_size) {
+	    did = block_dids[block_index];
+	    wdf = block_wdfs[block_index];
+	    RETURN(true);
+	}
+	if (pos == end) RETURN(false);
+	read_block(did);
+	RETURN(true);
+    }
+
     if (pos == end) RETURN(false);
 
     read_did_increase(&pos, end, &did);
@@ -774,14 +906,20 @@ BrassPostList::next_chunk()
     }
     did = newdid;
 
+    // We're reading through the postlist in order, so ask for the following
+    // leaf blocks to be read in the background.
+    cursor->prefetch_next();
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    prefetch_hinted = false;
+    read_first_entry();
 }
 
 PositionList *
@@ -801,17 +939,33 @@ BrassPostList::open_position_list() const
     RETURN(new BrassPositionList(&this_db->position_table, did, term));
 }
 
+void
+BrassPostList::skip_weak_chunks(Xapian::weight w_min)
+{
+    LOGCALL_VOID(DB, "BrassPostList::skip_weak_chunks", w_min);
+    // Without a weight object, every entry has weight 0.
+    if (w_min <= 0 || !weight) return;
+    while (!is_at_end) {
+	if (max_weight_in_chunk < 0) {
+	    max_weight_in_chunk = weight->get_maxpart_for_wdf_(max_wdf_in_chunk);
+	}
+	if (max_weight_in_chunk >= w_min) return;
+	LOGLINE(DB, "Skipping chunk with max wdf " << max_wdf_in_chunk);
+	next_chunk();
+    }
+}
+
 PostList *
 BrassPostList::next(Xapian::weight w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::next", w_min);
-    (void)w_min; // no warning
 
     if (!have_started) {
 	have_started = true;
     } else {
 	if (!next_in_chunk()) next_chunk();
     }
+    skip_weak_chunks(w_min);
 
     if (is_at_end) {
 	LOGLINE(DB, "Moved to end");
@@ -822,6 +976,53 @@ BrassPostList::next(Xapian::weight w_min)
     RETURN(NULL);
 }
 
+Xapian::doccount
+BrassPostList::read_raw_batch(Xapian::doccount n, Xapian::docid * dids,
+			      Xapian::termcount * wdfs)
+{
+    LOGCALL(DB, Xapian::doccount, "BrassPostList::read_raw_batch", n | dids | wdfs);
+    Assert(have_started);
+    Xapian::doccount count = 0;
+    while (count != n && !is_at_end) {
+	if (is_packed_chunk) {
+	    // Copy as much of the current block as we can in one go, and
+	    // leave the last entry copied as the current one.
+	    Xapian::doccount k = block_size - block_index;
+	    if (k > n - count) k = n - count;
+	    copy(block_dids + block_index, block_dids + block_index + k,
+		 dids + count);
+	    if (wdfs)
+		copy(block_wdfs + block_index, block_wdfs + block_index + k,
+		     wdfs + count);
+	    count += k;
+	    block_index += k - 1;
+	    did = block_dids[block_index];
+	    wdf = block_wdfs[block_index];
+	} else {
+	    dids[count] = did;
+	    if (wdfs) wdfs[count] = wdf;
+	    ++count;
+	}
+	if (!next_in_chunk()) next_chunk();
+    }
+    RETURN(count);
+}
+
+Xapian::doccount
+BrassPostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+			 Xapian::termcount * wdfs, Xapian::termcount * doclens)
+{
+    LOGCALL(DB, Xapian::doccount, "BrassPostList::get_batch", n | dids | wdfs | doclens);
+    Xapian::doccount count = read_raw_batch(n, dids, wdfs);
+    if (doclens) {
+	Assert(this_db.get());
+	for (Xapian::doccount i = 0; i != count; ++i) {
+	    doclens[i] = this_db->get_doclength(dids[i]);
+	}
+    }
+    RETURN(count);
+}
+
 bool
 BrassPostList::current_chunk_contains(Xapian::docid desired_did)
 {
@@ -873,8 +1074,11 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    prefetch_hinted = false;
+    read_first_entry();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
@@ -888,6 +1092,35 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     if (did >= desired_did)
 	RETURN(true);
 
+    if (desired_did <= last_did_in_chunk && is_packed_chunk) {
+	if (block_dids[block_size - 1] < desired_did) {
+	    // Step over any blocks which end before desired_did without
+	    // unpacking them.
+	    Xapian::docid prev_did = block_dids[block_size - 1];
+	    while (true) {
+		Brass::PostlistBlockHeader hdr;
+		if (!Brass::unpack_postlist_block_header(&pos, end, hdr))
+		    report_read_error(pos);
+		if (prev_did + hdr.span >= desired_did) {
+		    Brass::unpack_postlist_block(&pos, hdr, prev_did,
+						 block_dids, block_wdfs);
+		    block_size = hdr.size;
+		    block_index = 0;
+		    break;
+		}
+		pos += hdr.data_size();
+		prev_did += hdr.span;
+		// If we hit the end of the chunk then last_did_in_chunk must
+		// be wrong.
+		Assert(pos != end);
+	    }
+	}
+	while (block_dids[block_index] < desired_did) ++block_index;
+	did = block_dids[block_index];
+	wdf = block_wdfs[block_index];
+	RETURN(true);
+    }
+
     if (desired_did <= last_did_in_chunk) {
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
@@ -904,14 +1137,31 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     }
 
     pos = end;
+    // Make next_in_chunk() report the end of a block-packed chunk too.
+    block_size = block_index = 0;
     RETURN(false);
 }
 
+void
+BrassPostList::prefetch_skip_to(Xapian::docid desired_did)
+{
+    LOGCALL_VOID(DB, "BrassPostList::prefetch_skip_to", desired_did);
+    // Nothing to do if skip_to() won't need to move to another chunk, or
+    // we've already hinted where it's going from this one.  Finding the leaf
+    // block costs a descent of the B-tree, so hinting on every call would
+    // make skip_to() slower when the blocks are already cached.
+    if (prefetch_hinted || is_at_end || is_last_chunk ||
+	desired_did <= last_did_in_chunk)
+	return;
+    prefetch_hinted = true;
+    if (!cursor->get_table()->get_prefetch()) return;
+    cursor->prefetch_entry(BrassPostListTable::make_key(term, desired_did));
+}
+
 PostList *
 BrassPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::skip_to", desired_did | w_min);
-    (void)w_min; // no warning
     // We've started now - if we hadn't already, we're already positioned
     // at start so there's no need to actually do anything.
     have_started = true;
@@ -927,6 +1177,12 @@ BrassPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
 	if (is_at_end) RETURN(NULL);
     }
 
+    // If no entry in this chunk could be heavy enough, there's no point
+    // scanning through it.  If we move on to a later chunk, the scan below
+    // won't need to move at all.
+    skip_weak_chunks(w_min);
+    if (is_at_end) RETURN(NULL);
+
     // Move to correct position in chunk
     bool have_document = move_forward_in_chunk_to_at_least(desired_did);
     (void)have_document;
@@ -977,6 +1233,39 @@ BrassPostList::get_description() const
     return term + ":" + str(number_of_entries);
 }
 
+void
+BrassPostListTable::pack_chunk(string & tag)
+{
+    LOGCALL_STATIC_VOID(DB, "BrassPostListTable::pack_chunk", tag);
+    const char * pos = tag.data();
+    const char * end = pos + tag.size();
+    // The docids only matter relative to each other, so we can start from
+    // any first docid.
+    bool is_last_chunk, is_packed;
+    Xapian::termcount max_wdf;
+    Xapian::docid last_did = read_start_of_chunk(&pos, end, 1, &is_last_chunk,
+						 &is_packed, &max_wdf);
+    if (is_packed) return;
+
+    string new_tag = make_start_of_chunk(is_last_chunk, true, 1, last_did,
+					 max_wdf);
+    PostlistChunkReader from(1, false, string(pos, end));
+    Xapian::docid dids[BRASS_POSTLIST_BLOCK_SIZE];
+    Xapian::termcount wdfs[BRASS_POSTLIST_BLOCK_SIZE];
+    Xapian::docid prev_did = 0;
+    while (!from.is_at_end()) {
+	unsigned n = 0;
+	do {
+	    dids[n] = from.get_docid();
+	    wdfs[n] = from.get_wdf();
+	    from.next();
+	} while (++n != BRASS_POSTLIST_BLOCK_SIZE && !from.is_at_end());
+	Brass::pack_postlist_block(new_tag, prev_did, dids, wdfs, n);
+	prev_did = dids[n - 1];
+    }
+    tag.swap(new_tag);
+}
+
 // Returns the last did to allow in this chunk.
 Xapian::docid
 BrassPostListTable::get_chunk(const string &tname,
@@ -1027,19 +1316,26 @@ BrassPostListTable::get_chunk(const string &tname,
     }
 
     bool is_last_chunk;
+    bool is_packed;
     Xapian::docid last_did_in_chunk;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
+    Xapian::termcount max_wdf_in_chunk;
+    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
+					    &is_last_chunk, &is_packed,
+					    &max_wdf_in_chunk);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
 				  is_last_chunk);
-    if (did > last_did_in_chunk) {
+    // The writer can only append to a chunk using the pack_uint() encoding,
+    // so a block-packed chunk gets decoded and rewritten.
+    if (did > last_did_in_chunk && !is_packed) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
 	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
-			  string(pos, end));
+			  max_wdf_in_chunk, string(pos, end));
     } else {
-	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
+	*from = new PostlistChunkReader(first_did_in_chunk, is_packed,
+					string(pos, end));
     }
     if (is_last_chunk) RETURN(Xapian::docid(-1));
 
@@ -1078,7 +1374,7 @@ BrassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
 	string newtag = make_start_of_first_chunk(0, 0, 0);
-	newtag += make_start_of_chunk(true, 0, 0);
+	newtag += make_start_of_chunk(true, false, 0, 0, 0);
 	add(current_key, newtag);
     }
 
@@ -1130,6 +1426,25 @@ next_doclen_chunk:
     delete to;
 }
 
+void
+BrassPostListTable::merge_runs(const vector<string> & runs)
+{
+    LOGCALL_VOID(DB, "BrassPostListTable::merge_runs", runs);
+
+    // The cursor in the doclen_pl will no longer be valid, so reset it.
+    doclen_pl.reset(0);
+
+    if (runs.empty()) return;
+    set_bulk_load(true);
+    try {
+	merge_brass_postlist_runs(this, runs);
+    } catch (...) {
+	set_bulk_load(false);
+	throw;
+    }
+    set_bulk_load(false);
+}
+
 void
 BrassPostListTable::merge_changes(const string &term,
 				  const Inverter::PostingChanges & changes)
@@ -1147,18 +1462,22 @@ BrassPostListTable::merge_changes(const string &term,
 	Xapian::doccount termfreq;
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
-	bool islast;
+	Xapian::termcount maxwdf;
+	bool islast, ispacked;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
 	    firstdid = 0;
 	    lastdid = 0;
+	    maxwdf = 0;
 	    islast = true;
+	    ispacked = false;
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
 	    // Handle the generic start of chunk header.
-	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
+	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast,
+					  &ispacked, &maxwdf);
 	}
 
 	termfreq += changes.get_tfdelta();
@@ -1185,7 +1504,8 @@ BrassPostListTable::merge_changes(const string &term,
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
+	newhdr += make_start_of_chunk(islast, ispacked, firstdid, lastdid,
+				      maxwdf);
 	if (pos == end) {
 	    add(current_key, newhdr);
 	} else {
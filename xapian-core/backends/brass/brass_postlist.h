@@ -29,12 +29,14 @@
 #include "brass_inverter.h"
 #include "brass_types.h"
 #include "brass_positionlist.h"
+#include "brass_postlistblock.h"
 #include "leafpostlist.h"
 #include "omassert.h"
 
 #include "autoptr.h"
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -70,6 +72,16 @@ class BrassPostListTable : public BrassTable {
 	      doclen_pl()
 	{ }
 
+	/** Create a new object for a temporary postlist table.
+	 *
+	 *  @param name_	Path and prefix of the table's files (e.g.
+	 *			"/path/to/db/postlist_run0.").
+	 */
+	explicit BrassPostListTable(const string & name_)
+	    : BrassTable("postlist", name_, false),
+	      doclen_pl()
+	{ }
+
 	bool open(brass_revision_number_t revno) {
 	    doclen_pl.reset(0);
 	    return BrassTable::open(revno);
@@ -81,11 +93,31 @@ class BrassPostListTable : public BrassTable {
 	/// Merge document length changes.
 	void merge_doclen_changes(const map<Xapian::docid, Xapian::termcount> & doclens);
 
+	/** Merge in runs of postings written to temporary postlist tables.
+	 *
+	 *  This table mustn't contain any postings yet, and the postings in
+	 *  each run must all be for higher docids than those in the runs
+	 *  before it.  The postings are appended in key order, so the table is
+	 *  bulk loaded (see BrassTable::set_bulk_load()).
+	 *
+	 *  @param runs	The path and prefix of each run's files.
+	 */
+	void merge_runs(const vector<string> & runs);
+
 	Xapian::docid get_chunk(const string &tname,
 		Xapian::docid did, bool adding,
 		Brass::PostlistChunkReader ** from,
 		Brass::PostlistChunkWriter **to);
 
+	/** Convert a postlist chunk to the block-packed encoding.
+	 *
+	 *  @param tag	The chunk, starting with the standard chunk header
+	 *		(for the first chunk of a postlist, the part before
+	 *		that must have been removed).  If the chunk isn't
+	 *		already block-packed, it is re-encoded in place.
+	 */
+	static void pack_chunk(string & tag);
+
 	/// Compose a key from a termname and docid.
 	static string make_key(const string & term, Xapian::docid did) {
 	    return pack_brass_postlist_key(term, did);
@@ -137,6 +169,17 @@ class BrassPostList : public LeafPostList {
 	/// Whether we've started reading the list yet.
 	bool have_started;
 
+	/** Read a batch of entries as stored, starting with the current one.
+	 *
+	 *  This is get_batch() without the document lengths, and with
+	 *  @a wdfs receiving the wdfs as stored (which for
+	 *  BrassAllDocsPostList are the document lengths).  Entries in
+	 *  block-packed chunks are copied a block at a time.
+	 */
+	Xapian::doccount read_raw_batch(Xapian::doccount n,
+					Xapian::docid * dids,
+					Xapian::termcount * wdfs);
+
     private:
 	/// True if this is the last chunk.
 	bool is_last_chunk;
@@ -144,6 +187,13 @@ class BrassPostList : public LeafPostList {
 	/// Whether we've run off the end of the list yet.
 	bool is_at_end;
 
+	/** Has prefetch_skip_to() hinted the chunk after the current one?
+	 *
+	 *  We only hint once per chunk, so that a skip_to() which stays in the
+	 *  current chunk costs nothing extra.
+	 */
+	bool prefetch_hinted;
+
 	/// Cursor pointing to current chunk of postlist.
 	AutoPtr<BrassCursor> cursor;
 
@@ -153,6 +203,31 @@ class BrassPostList : public LeafPostList {
 	/// The last document id in this chunk.
 	Xapian::docid last_did_in_chunk;
 
+	/// The greatest wdf of any entry in this chunk.
+	Xapian::termcount max_wdf_in_chunk;
+
+	/** Upper bound on the weight of any entry in this chunk.
+	 *
+	 *  This is calculated from max_wdf_in_chunk when first needed, and is
+	 *  negative until then.
+	 */
+	Xapian::weight max_weight_in_chunk;
+
+	/// Is the current chunk block-packed?
+	bool is_packed_chunk;
+
+	/// Entries in the current block, if the chunk is block-packed.
+	Xapian::docid block_dids[BRASS_POSTLIST_BLOCK_SIZE];
+
+	/// The wdfs of the entries in block_dids.
+	Xapian::termcount block_wdfs[BRASS_POSTLIST_BLOCK_SIZE];
+
+	/// Number of entries in the current block.
+	unsigned block_size;
+
+	/// Index of the current entry in the current block.
+	unsigned block_index;
+
 	/// Position of iteration through current chunk.
 	const char * pos;
 
@@ -174,6 +249,18 @@ class BrassPostList : public LeafPostList {
 	/// Assignment is not allowed.
 	void operator=(const BrassPostList &);
 
+	/** Read the first entry in the current chunk.
+	 *
+	 *  Call with pos just after the chunk header.
+	 */
+	void read_first_entry();
+
+	/** Unpack the block at pos in a block-packed chunk.
+	 *
+	 *  @param prev_did	The last docid before the block.
+	 */
+	void read_block(Xapian::docid prev_did);
+
 	/** Move to the next item in the chunk, if possible.
 	 *  If already at the end of the chunk, returns false.
 	 */
@@ -219,6 +306,13 @@ class BrassPostList : public LeafPostList {
 	 */
 	bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+	/** Skip any chunks which can't contain an entry with weight >= w_min.
+	 *
+	 *  If the current chunk is skipped, we end up on the first entry of
+	 *  the next chunk which might, or at_end() if there isn't one.
+	 */
+	void skip_weak_chunks(Xapian::weight w_min);
+
     public:
 	/// Default constructor.
 	BrassPostList(Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db_,
@@ -265,6 +359,14 @@ class BrassPostList : public LeafPostList {
 	/// Skip to next document with docid >= docid.
 	PostList * skip_to(Xapian::docid desired_did, Xapian::weight w_min);
 
+	/// Start reading the chunk holding @a desired_did in the background.
+	void prefetch_skip_to(Xapian::docid desired_did);
+
+	/// Read a batch of entries, starting with the current one.
+	Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+				   Xapian::termcount * wdfs,
+				   Xapian::termcount * doclens);
+
 	/// Return true if and only if we're off the end of the list.
 	bool at_end() const { return is_at_end; }
 
@@ -0,0 +1,275 @@
+/** @file brass_postlistblock.h
+ * @brief Encoding of blocks in block-packed brass postlist chunks.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_POSTLISTBLOCK_H
+#define XAPIAN_INCLUDED_BRASS_POSTLISTBLOCK_H
+
+#include <xapian/types.h>
+
+#include "internaltypes.h"
+#include "omassert.h"
+#include "pack.h"
+
+#include <string>
+
+/* The body of a postlist chunk is either a sequence of entries each encoded
+ * with pack_uint(), or a sequence of blocks of up to BRASS_POSTLIST_BLOCK_SIZE
+ * entries.  Which is used is recorded in the flag character at the start of
+ * the chunk header:
+ *
+ *  '0' / '1'	pack_uint() encoding; not the last chunk / the last chunk.
+ *  '2' / '3'	Block-packed encoding; not the last chunk / the last chunk.
+ *
+ * The pack_uint() encoding is cheap to update in place, so that's what
+ * updates write.  xapian-compact converts chunks to the block-packed
+ * encoding, which is smaller and much faster to decode.
+ *
+ * Each block starts with a header:
+ *
+ *  pack_uint(number of entries - 1)
+ *  pack_uint(last docid in block - last docid before block)
+ *  pack_uint(gap base), byte(gap bits)
+ *  pack_uint(wdf base), byte(wdf bits)
+ *
+ * The "gap" for each entry is its docid minus the previous docid minus one
+ * (the first entry in a chunk is always at the chunk's first docid, so its
+ * gap is 0).  The gaps and then the wdfs follow, each stored as the
+ * difference from the base value (the minimum in the block) using a fixed
+ * number of bits (the fewest which can hold the largest difference), least
+ * significant bit first and padded to a whole number of bytes.
+ *
+ * Since the header gives the docid span and the size of the packed data, a
+ * reader looking for a later docid can step over a block without unpacking
+ * it.
+ */
+
+/// The maximum number of entries in a block.
+#define BRASS_POSTLIST_BLOCK_SIZE 128
+
+namespace Brass {
+
+/// Header of a block in a block-packed postlist chunk.
+struct PostlistBlockHeader {
+    /// Number of entries in the block.
+    unsigned size;
+
+    /// Last docid in block minus the last docid before the block.
+    Xapian::docid span;
+
+    Xapian::docid gap_base;
+
+    unsigned gap_bits;
+
+    Xapian::termcount wdf_base;
+
+    unsigned wdf_bits;
+
+    /// Number of bytes of packed data following the header.
+    size_t data_size() const {
+	return (size * gap_bits + 7) / 8 + (size * wdf_bits + 7) / 8;
+    }
+};
+
+/** Decode a chunk header flag character.
+ *
+ *  @return false if @a ch isn't a valid flag.
+ */
+inline bool
+decode_chunk_flag(char ch, bool * is_last_ptr, bool * is_packed_ptr)
+{
+    unsigned v = static_cast<unsigned char>(ch) - unsigned('0');
+    if (rare(v > 3)) return false;
+    *is_last_ptr = (v & 1);
+    *is_packed_ptr = (v & 2);
+    return true;
+}
+
+/// Encode a chunk header flag character.
+inline char
+encode_chunk_flag(bool is_last, bool is_packed)
+{
+    return char('0' | (is_last ? 1 : 0) | (is_packed ? 2 : 0));
+}
+
+/// Return the number of bits needed to represent @a v.
+inline unsigned
+bits_needed(uint4 v)
+{
+    unsigned bits = 0;
+    while (v) {
+	++bits;
+	v >>= 1;
+    }
+    return bits;
+}
+
+/// Append @a n values minus @a base, each packed into @a bits bits.
+inline void
+pack_bits(std::string & s, const uint4 * values, unsigned n,
+	  uint4 base, unsigned bits)
+{
+    if (bits == 0) return;
+    uint8 acc = 0;
+    unsigned acc_bits = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	acc |= uint8(values[i] - base) << acc_bits;
+	acc_bits += bits;
+	while (acc_bits >= 8) {
+	    s += char(acc & 0xff);
+	    acc >>= 8;
+	    acc_bits -= 8;
+	}
+    }
+    if (acc_bits) s += char(acc);
+}
+
+/** Unpack @a n values packed by pack_bits().
+ *
+ *  The caller must have checked that there's enough data.  The loop has no
+ *  data-dependent branches apart from refilling the accumulator, so it
+ *  decodes a whole block quickly.
+ */
+inline void
+unpack_bits(const unsigned char * p, uint4 * values, unsigned n,
+	    uint4 base, unsigned bits)
+{
+    if (bits == 0) {
+	for (unsigned i = 0; i != n; ++i) values[i] = base;
+	return;
+    }
+    const uint4 mask = (bits == 32) ? uint4(-1) : ((uint4(1) << bits) - 1);
+    uint8 acc = 0;
+    unsigned acc_bits = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	while (acc_bits < bits) {
+	    acc |= uint8(*p++) << acc_bits;
+	    acc_bits += 8;
+	}
+	values[i] = base + (uint4(acc) & mask);
+	acc >>= bits;
+	acc_bits -= bits;
+    }
+}
+
+/** Append a block of entries.
+ *
+ *  @param s	    The string to append to.
+ *  @param prev_did The docid before the block (for the first block in a
+ *		    chunk, the chunk's first docid minus one).
+ *  @param dids	    The docids of the entries, in ascending order.
+ *  @param wdfs	    The wdfs of the entries.
+ *  @param n	    The number of entries (1 to BRASS_POSTLIST_BLOCK_SIZE).
+ */
+inline void
+pack_postlist_block(std::string & s, Xapian::docid prev_did,
+		    const Xapian::docid * dids, const Xapian::termcount * wdfs,
+		    unsigned n)
+{
+    Assert(n > 0 && n <= BRASS_POSTLIST_BLOCK_SIZE);
+    uint4 gaps[BRASS_POSTLIST_BLOCK_SIZE];
+    uint4 gap_min = uint4(-1), gap_max = 0;
+    uint4 wdf_min = uint4(-1), wdf_max = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	Assert(dids[i] > prev_did);
+	uint4 gap = dids[i] - prev_did - 1;
+	prev_did = dids[i];
+	gaps[i] = gap;
+	if (gap < gap_min) gap_min = gap;
+	if (gap > gap_max) gap_max = gap;
+	if (wdfs[i] < wdf_min) wdf_min = wdfs[i];
+	if (wdfs[i] > wdf_max) wdf_max = wdfs[i];
+    }
+    unsigned gap_bits = bits_needed(gap_max - gap_min);
+    unsigned wdf_bits = bits_needed(wdf_max - wdf_min);
+    pack_uint(s, n - 1);
+    Xapian::docid span = 0;
+    for (unsigned i = 0; i != n; ++i) span += gaps[i] + 1;
+    pack_uint(s, span);
+    pack_uint(s, gap_min);
+    s += char(gap_bits);
+    pack_uint(s, wdf_min);
+    s += char(wdf_bits);
+    pack_bits(s, gaps, n, gap_min, gap_bits);
+    pack_bits(s, wdfs, n, wdf_min, wdf_bits);
+}
+
+/** Read the header of a block.
+ *
+ *  @return false if the data is corrupt, in which case *p is set to NULL if
+ *	    the data ran out (like the unpack_*() functions).
+ */
+inline bool
+unpack_postlist_block_header(const char ** p, const char * end,
+			     PostlistBlockHeader & hdr)
+{
+    unsigned size_minus_one;
+    if (!unpack_uint(p, end, &size_minus_one) ||
+	!unpack_uint(p, end, &hdr.span) ||
+	!unpack_uint(p, end, &hdr.gap_base)) {
+	return false;
+    }
+    if (*p == end) {
+	*p = NULL;
+	return false;
+    }
+    hdr.gap_bits = static_cast<unsigned char>(*(*p)++);
+    if (!unpack_uint(p, end, &hdr.wdf_base)) return false;
+    if (*p == end) {
+	*p = NULL;
+	return false;
+    }
+    hdr.wdf_bits = static_cast<unsigned char>(*(*p)++);
+    if (rare(size_minus_one >= BRASS_POSTLIST_BLOCK_SIZE ||
+	     hdr.gap_bits > 32 || hdr.wdf_bits > 32)) {
+	return false;
+    }
+    hdr.size = size_minus_one + 1;
+    if (rare(size_t(end - *p) < hdr.data_size())) {
+	*p = NULL;
+	return false;
+    }
+    return true;
+}
+
+/** Unpack the entries of a block whose header has just been read.
+ *
+ *  @param prev_did The docid before the block.
+ *  @param dids	    Array of at least hdr.size entries to store the docids in.
+ *  @param wdfs	    Array of at least hdr.size entries to store the wdfs in.
+ */
+inline void
+unpack_postlist_block(const char ** p, const PostlistBlockHeader & hdr,
+		      Xapian::docid prev_did,
+		      Xapian::docid * dids, Xapian::termcount * wdfs)
+{
+    const unsigned char * data = reinterpret_cast<const unsigned char *>(*p);
+    unpack_bits(data, dids, hdr.size, hdr.gap_base, hdr.gap_bits);
+    data += (hdr.size * hdr.gap_bits + 7) / 8;
+    unpack_bits(data, wdfs, hdr.size, hdr.wdf_base, hdr.wdf_bits);
+    data += (hdr.size * hdr.wdf_bits + 7) / 8;
+    *p = reinterpret_cast<const char *>(data);
+    // Turn the gaps into docids.
+    for (unsigned i = 0; i != hdr.size; ++i) {
+	prev_did += dids[i] + 1;
+	dids[i] = prev_did;
+    }
+}
+
+}
+
+#endif // XAPIAN_INCLUDED_BRASS_POSTLISTBLOCK_H
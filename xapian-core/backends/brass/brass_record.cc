@@ -23,6 +23,7 @@
 
 #include "brass_record.h"
 
+#include "brass_cursor.h"
 #include <xapian/error.h>
 #include "debuglog.h"
 #include "omassert.h"
@@ -52,6 +53,17 @@ BrassRecordTable::get_record(Xapian::docid did) const
     RETURN(tag);
 }
 
+bool
+BrassRecordTable::get_record(BrassCursor & cursor, Xapian::docid did,
+			     string & data) const
+{
+    LOGCALL(DB, bool, "BrassRecordTable::get_record", Literal("cursor") | did | data);
+    if (!cursor.find_entry(make_key(did))) RETURN(false);
+    cursor.read_tag();
+    swap(data, cursor.current_tag);
+    RETURN(true);
+}
+
 Xapian::doccount
 BrassRecordTable::get_doccount() const
 {   
@@ -31,6 +31,8 @@
 
 using namespace std;
 
+class BrassCursor;
+
 /** A record in a brass database.
  */
 class BrassRecordTable : public BrassTable {
@@ -54,6 +56,20 @@ class BrassRecordTable : public BrassTable {
 	 */
 	string get_record(Xapian::docid did) const;
 
+	/** Retrieve a document from the table using a cursor.
+	 *
+	 *  When reading several documents in ascending docid order, reusing
+	 *  the same cursor means the blocks they share are only read once.
+	 *
+	 *  @param cursor	Cursor on this table.
+	 *  @param did		The document ID to retrieve.
+	 *  @param data		Set to the document data if it was found.
+	 *
+	 *  @return true if the document was found.
+	 */
+	bool get_record(BrassCursor & cursor, Xapian::docid did,
+			string & data) const;
+
 	/** Get the number of records in the table.
 	 */
 	Xapian::doccount get_doccount() const;
@@ -63,6 +63,12 @@ PREAD_PROTOTYPE
 PWRITE_PROTOTYPE
 #endif
 
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include "safefcntl.h"
+#include "safesysstat.h"
+
 #include <cstdio>    /* for rename */
 #include <cstring>   /* for memmove */
 #include <climits>   /* for CHAR_BIT */
@@ -86,6 +92,14 @@ using namespace std;
 // Only try to compress tags longer than this many bytes.
 const size_t COMPRESS_MIN = 4;
 
+// When compressing a tag with a preset dictionary, only prime the stream with
+// the last this many bytes of dictionary per byte of tag (but at least
+// DICTIONARY_MIN_PRIME bytes).  Priming costs about as much as compressing
+// the same amount of data, and a short tag can't make use of much of the
+// dictionary anyway.
+const size_t DICTIONARY_PRIME_PER_BYTE = 16;
+const size_t DICTIONARY_MIN_PRIME = 1024;
+
 //#define BTREE_DEBUG_FULL 1
 #undef BTREE_DEBUG_FULL
 
@@ -191,6 +205,127 @@ BrassTable::read_block(uint4 n, byte * p) const
      */
     Assert(n / CHAR_BIT < base.get_bit_map_size());
 
+    if (use_mmap) {
+	// Copy the block rather than pointing cursors into the mapping, since
+	// a writer may reuse the block while a cursor is still looking at it.
+	const byte * m = mapped_block(n);
+	memcpy(p, m, block_size);
+	// If a writer was rewriting the block while we copied it, we may have
+	// the start of the old version and the end of the new one.  The
+	// revision is at the start, so it will normally have changed by the
+	// time we've copied the rest.  Reread it via a volatile pointer, since
+	// otherwise the compiler can assume it's what memcpy() just copied.
+	const volatile byte * rev = m;
+	for (int i = 0; i != 4; ++i) {
+	    if (rare(rev[i] != p[i])) set_overwritten();
+	}
+	return;
+    }
+
+    if (block_cache) {
+	// file_id was found when we opened the table, so a cache hit doesn't
+	// need any system calls.  Anything cached under our key was read at our
+	// revision, so it's still what we'd see even if a writer has since
+	// reused the block.
+	BlockCache::Key key(file_id, n, revision_number);
+	if (block_cache->lookup(key, p, block_size)) return;
+	read_block_from_file(n, p);
+	// Don't let anyone else see overwritten contents under our key - we
+	// leave block_to_cursor() to notice and throw DatabaseModifiedError.
+	if (REVISION(p) <= revision_number)
+	    block_cache->insert(key, p, block_size);
+	return;
+    }
+
+    read_block_from_file(n, p);
+}
+
+/// Return a pointer to block n in the mapping of the DB file.
+byte *
+BrassTable::mapped_block(uint4 n) const
+{
+    off_t offset = off_t(block_size) * n;
+    off_t end = offset + off_t(block_size);
+    if (rare(end > map_file_size)) {
+	string message = "Error reading block " + str(n) + ": got end of file";
+	throw Xapian::DatabaseError(message);
+    }
+    // A writer overwriting the database truncates the file we have mapped,
+    // and reading a page of the mapping which is now past the end of the file
+    // raises SIGBUS.  So check the file is still long enough, which reports
+    // the problem as pread() would.
+    struct stat sb;
+    if (rare(fstat(handle, &sb) < 0)) {
+	string message = "Error reading block " + str(n) + ": ";
+	message += strerror(errno);
+	throw Xapian::DatabaseError(message);
+    }
+    if (rare(sb.st_size < end)) {
+	string message = "Error reading block " + str(n) + ": got end of file";
+	throw Xapian::DatabaseError(message);
+    }
+    return map_base + offset;
+}
+
+/** Map the DB file into memory, or check that the current mapping covers it.
+ *
+ *  When the table is reopened, the file may have grown, or been replaced.
+ *  We leave some slack at the end of each mapping so that we don't need to
+ *  remap every time the file grows by a few blocks.
+ */
+void
+BrassTable::map_file()
+{
+    LOGCALL_VOID(DB, "BrassTable::map_file", NO_ARGS);
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    struct stat sb;
+    if (fstat(handle, &sb) < 0) {
+	string message("Couldn't stat ");
+	message += name;
+	message += "DB: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseOpeningError(message);
+    }
+    map_file_size = sb.st_size;
+    if (map_base && map_file_id.dev == sb.st_dev &&
+	map_file_id.ino == sb.st_ino && sb.st_size <= off_t(map_size)) {
+	// The current mapping still covers the whole file.
+	return;
+    }
+    if (sb.st_size == 0) return;
+
+    off_t len = sb.st_size + sb.st_size / 4;
+    if (off_t(size_t(len)) != len) {
+	len = sb.st_size;
+	if (off_t(size_t(len)) != len) {
+	    string message("Couldn't mmap ");
+	    message += name;
+	    message += "DB: file is too large";
+	    throw Xapian::DatabaseOpeningError(message);
+	}
+    }
+    void * m = mmap(NULL, size_t(len), PROT_READ, MAP_SHARED, handle, 0);
+    if (m == MAP_FAILED) {
+	string message("Couldn't mmap ");
+	message += name;
+	message += "DB: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseOpeningError(message);
+    }
+    // Cursors copy blocks out of the mapping, so nothing points into the old
+    // one.
+    if (map_base) (void)munmap(map_base, map_size);
+    map_base = static_cast<byte *>(m);
+    map_size = size_t(len);
+    map_file_id.dev = sb.st_dev;
+    map_file_id.ino = sb.st_ino;
+#endif
+}
+
+/// Read block n of the DB file to address p, bypassing block_cache.
+void
+BrassTable::read_block_from_file(uint4 n, byte * p) const
+{
 #ifdef HAVE_PREAD
     off_t offset = off_t(block_size) * n;
     int m = block_size;
@@ -382,6 +517,69 @@ BrassTable::block_to_cursor(Brass::Cursor * C_, int j, uint4 n) const
     }
 }
 
+/// Ask the OS to start reading block n of the DB file in the background.
+void
+BrassTable::prefetch_block(uint4 n) const
+{
+    LOGCALL_VOID(DB, "BrassTable::prefetch_block", n);
+#ifdef HAVE_POSIX_FADVISE
+    // This is only a hint, so we ignore any error.  It works for a mapped
+    // file too, since the mapping is backed by the same page cache.
+    (void)posix_fadvise(handle, off_t(block_size) * n, block_size,
+			POSIX_FADV_WILLNEED);
+#else
+    (void)n;
+#endif
+}
+
+void
+BrassTable::prefetch_entry(const string & key) const
+{
+    LOGCALL_VOID(DB, "BrassTable::prefetch_entry", key);
+    if (!use_prefetch || handle < 0 || level == 0) return;
+
+    if (key.size() > BRASS_BTREE_MAX_KEY_LEN) {
+	form_key(key.substr(0, BRASS_BTREE_MAX_KEY_LEN));
+    } else {
+	form_key(key);
+    }
+    Key k = kt.key();
+    for (int j = level; j > 0; --j) {
+	const byte * p = C[j].p;
+	int c = find_in_block(p, k, false, C[j].c);
+	C[j].c = c;
+	uint4 n = Item(p, c).block_given_by();
+	if (j == 1) {
+	    prefetch_block(n);
+	    return;
+	}
+	block_to_cursor(C, j - 1, n);
+    }
+}
+
+void
+BrassTable::prefetch_next_leaves(const Brass::Cursor * C_,
+				 uint4 & hinted_n, int & hinted_c) const
+{
+    LOGCALL_VOID(DB, "BrassTable::prefetch_next_leaves", (void*)C_ | hinted_n | hinted_c);
+    if (!use_prefetch || level == 0 || handle < 0) return;
+
+    const Brass::Cursor & parent = C_[1];
+    int c = parent.c + D2;
+    int stop = min(parent.c + (PREFETCH_LEAVES + 1) * D2, DIR_END(parent.p));
+    if (parent.n == hinted_n) {
+	// Don't hint the same blocks again.
+	if (hinted_c >= c) c = hinted_c + D2;
+    }
+    if (c >= stop) return;
+    while (c < stop) {
+	prefetch_block(Item(parent.p, c).block_given_by());
+	c += D2;
+    }
+    hinted_n = parent.n;
+    hinted_c = c - D2;
+}
+
 /** Btree::alter(); is called when the B-tree is to be altered.
 
    It causes new blocks to be forced for the current set of blocks in
@@ -507,6 +705,33 @@ BrassTable::find(Brass::Cursor * C_) const
     RETURN(Item(p, c).key() == key);
 }
 
+/** find_append_point() positions C at the last key in the B-tree.
+
+   Result is true if the key of kt sorts after it, so that kt can be added
+   by appending it to the last leaf block.  Unlike find(), no searching is
+   needed, and when adding keys in ascending order the blocks on the way
+   down are already in C.
+*/
+
+bool
+BrassTable::find_append_point()
+{
+    LOGCALL(DB, bool, "BrassTable::find_append_point", NO_ARGS);
+    const byte * p;
+    int c;
+    for (int j = level; j > 0; --j) {
+	p = C[j].p;
+	c = DIR_END(p) - D2;
+	C[j].c = c;
+	block_to_cursor(C, j - 1, Item(p, c).block_given_by());
+    }
+    p = C[0].p;
+    c = DIR_END(p) - D2;
+    C[0].c = c;
+    if (c < DIR_START) RETURN(true);
+    RETURN(Item(p, c).key() < kt.key());
+}
+
 /** compact(p) compact the block at p by shuffling all the items up to the end.
 
    MAX_FREE(p) is then maximized, and is equal to TOTAL_FREE(p).
@@ -718,7 +943,34 @@ BrassTable::add_item(Item_wr kt_, int j)
     uint4 n;
 
     int needed = kt_.size() + D2;
-    if (TOTAL_FREE(p) < needed) {
+    if (TOTAL_FREE(p) < needed && bulk_load && c == DIR_END(p)) {
+	// We're appending to a full block during a bulk load, so nothing will
+	// be inserted into it again.  Rather than splitting it, write it out
+	// as it is and start a new block to its right.  We keep the full block
+	// in split_p, as enter_key() needs its last key.
+	uint4 full_n = C[j].n;
+	write_block(full_n, p);
+	swap(C[j].p, split_p);
+	p = C[j].p;
+	C[j].n = base.next_free_block();
+	SET_REVISION(p, latest_revision_number + 1);
+	SET_LEVEL(p, j);
+	SET_DIR_END(p, DIR_START);
+	compact(p);      /* to reset TOTAL_FREE, MAX_FREE */
+
+	c = DIR_START;
+	add_item_to_block(p, kt_, c);
+	n = C[j].n;
+
+	// Check if we're splitting the root block.
+	if (j == level) split_root(full_n);
+
+	/* Enter a separating key at level j + 1 between */
+	/* the last key of block split_p, and the first key of block p */
+	enter_key(j + 1,
+		  Item(split_p, DIR_END(split_p) - D2).key(),
+		  Item(p, DIR_START).key());
+    } else if (TOTAL_FREE(p) < needed) {
 	int m;
 	// Prepare to split p. After splitting, the block is in two halves, the
 	// lower half is split_p, the upper half p again. add_to_upper_half
@@ -1031,6 +1283,7 @@ BrassTable::add(const string &key, string tag, bool already_compressed)
 #endif
 
 	lazy_alloc_deflate_zstream();
+	set_deflate_dictionary(tag.size());
 
 	deflate_zstream->next_in = (Bytef *)const_cast<char *>(tag.data());
 	deflate_zstream->avail_in = (uInt)tag.size();
@@ -1058,7 +1311,9 @@ BrassTable::add(const string &key, string tag, bool already_compressed)
     const size_t cd = kt.key().length() + K1 + I2 + C2 + C2;  // offset to the tag data
     const size_t L = max_item_size - cd; // largest amount of tag data for any chunk
     size_t first_L = L;                  // - amount for tag1
-    bool found = find(C);
+    // If we're bulk loading and the key sorts last, append the item.
+    bool append = bulk_load && find_append_point();
+    bool found = append ? false : find(C);
     if (!found) {
 	byte * p = C[0].p;
 	size_t n = TOTAL_FREE(p) % (max_item_size + D2);
@@ -1108,7 +1363,16 @@ BrassTable::add(const string &key, string tag, bool already_compressed)
 	o += l;
 	residue -= l;
 
-	if (i > 1) found = find(C);
+	if (i > 1) {
+	    if (append) {
+		// The previous component is now the last item, and this one
+		// sorts after it.
+		found = !find_append_point();
+		Assert(!found);
+	    } else {
+		found = find(C);
+	    }
+	}
 	n = add_kt(found);
 	if (n > 0) replacement = true;
     }
@@ -1298,6 +1562,18 @@ BrassTable::set_full_compaction(bool parity)
     full_compaction = parity;
 }
 
+void
+BrassTable::set_mmap(bool on)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_mmap", on);
+    Assert(handle < 0);
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    use_mmap = on && !writable;
+#else
+    (void)on;
+#endif
+}
+
 BrassCursor * BrassTable::cursor_get() const {
     LOGCALL(DB, BrassCursor *, "BrassTable::cursor_get", NO_ARGS);
     if (handle < 0) {
@@ -1507,6 +1783,14 @@ BrassTable::do_open_to_write(bool revision_supplied,
 	throw Xapian::DatabaseOpeningError(message);
     }
 
+    if (create_db) {
+	// Discard any blocks cached from a previous file with this inode.
+	BlockCache * cache = BlockCache::get_instance();
+	BlockCache::FileId id;
+	if (cache && BlockCache::get_file_id(handle, id))
+	    cache->invalidate_file(id);
+    }
+
     if (!basic_open(revision_supplied, revision_)) {
 	::close(handle);
 	handle = -1;
@@ -1549,6 +1833,12 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  faked_root_block(true),
 	  sequential(true),
 	  handle(-1),
+	  block_cache(NULL),
+	  use_mmap(false),
+	  use_prefetch(false),
+	  map_base(NULL),
+	  map_size(0),
+	  map_file_size(0),
 	  level(0),
 	  root(0),
 	  kt(0),
@@ -1561,6 +1851,7 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  max_item_size(0),
 	  Btree_modified(false),
 	  full_compaction(false),
+	  bulk_load(false),
 	  writable(!readonly_),
 	  cursor_created_since_last_modification(false),
 	  cursor_version(0),
@@ -1587,6 +1878,18 @@ BrassTable::really_empty() const
     return !cur.next();
 }
 
+void
+BrassTable::set_compression_dictionary(const string & dictionary)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_compression_dictionary", dictionary);
+    Assert(writable);
+    Assert(compress_strategy != DONT_COMPRESS || dictionary.empty());
+    AssertRel(dictionary.size(),<=,32768);
+
+    if (handle < 0) create_and_open(block_size);
+    base.set_dictionary(dictionary);
+}
+
 void
 BrassTable::lazy_alloc_deflate_zstream() const {
     if (usual(deflate_zstream)) {
@@ -1625,10 +1928,34 @@ BrassTable::lazy_alloc_deflate_zstream() const {
     }
 }
 
+void
+BrassTable::set_deflate_dictionary(size_t tag_size) const {
+    const string & dictionary = base.get_dictionary();
+    if (dictionary.empty()) return;
+    // The dictionary has the most useful strings at the end, and zlib only
+    // needs the end of the window to match that of the inflate stream, so
+    // priming with just the end of the dictionary still gives valid output.
+    size_t len = max(tag_size * DICTIONARY_PRIME_PER_BYTE, DICTIONARY_MIN_PRIME);
+    len = min(len, dictionary.size());
+    const char * start = dictionary.data() + dictionary.size() - len;
+    int err = deflateSetDictionary(deflate_zstream,
+				   reinterpret_cast<const Bytef *>(start),
+				   len);
+    if (rare(err != Z_OK)) {
+	string msg = "deflateSetDictionary failed (";
+	msg += str(err);
+	msg += ')';
+	throw Xapian::DatabaseError(msg);
+    }
+}
+
 void
 BrassTable::lazy_alloc_inflate_zstream() const {
     if (usual(inflate_zstream)) {
-	if (usual(inflateReset(inflate_zstream) == Z_OK)) return;
+	if (usual(inflateReset(inflate_zstream) == Z_OK)) {
+	    set_inflate_dictionary();
+	    return;
+	}
 	// Try to recover by deleting the stream and starting from scratch.
 	delete inflate_zstream;
     }
@@ -1659,6 +1986,24 @@ BrassTable::lazy_alloc_inflate_zstream() const {
 	inflate_zstream = 0;
 	throw Xapian::DatabaseError(msg);
     }
+    set_inflate_dictionary();
+}
+
+void
+BrassTable::set_inflate_dictionary() const {
+    const string & dictionary = base.get_dictionary();
+    if (dictionary.empty()) return;
+    // For a raw inflate stream, this just copies the dictionary into the
+    // window, so it's cheap.
+    int err = inflateSetDictionary(inflate_zstream,
+				   reinterpret_cast<const Bytef *>(dictionary.data()),
+				   dictionary.size());
+    if (rare(err != Z_OK)) {
+	string msg = "inflateSetDictionary failed (";
+	msg += str(err);
+	msg += ')';
+	throw Xapian::DatabaseError(msg);
+    }
 }
 
 bool
@@ -1729,6 +2074,10 @@ BrassTable::~BrassTable() {
     LOGCALL_DTOR(DB, "BrassTable");
     BrassTable::close();
 
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    if (map_base) (void)munmap(map_base, map_size);
+#endif
+
     if (deflate_zstream) {
 	// Errors which we care about have already been handled, so just ignore
 	// any which get returned here.
@@ -2018,6 +2367,16 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
 	throw Xapian::DatabaseOpeningError("Failed to open table for reading");
     }
 
+    if (use_mmap) {
+	// The blocks are already shared via the page cache.
+	block_cache = NULL;
+	map_file();
+    } else {
+	block_cache = BlockCache::get_instance();
+	if (block_cache && !BlockCache::get_file_id(handle, file_id))
+	    block_cache = NULL;
+    }
+
     for (int j = 0; j <= level; j++) {
 	C[j].n = BLK_UNUSED;
 	C[j].p = new byte[block_size];
@@ -30,6 +30,8 @@
 #include "brass_btreebase.h"
 #include "brass_cursor.h"
 
+#include "../blockcache.h"
+
 #include "noreturn.h"
 #include "omassert.h"
 #include "str.h"
@@ -270,6 +272,9 @@ public:
 // FIXME: but we want it to be completely impossible...
 #define BTREE_CURSOR_LEVELS 10
 
+/// How many leaf blocks ahead BrassTable::prefetch_next_leaves() looks.
+#define PREFETCH_LEAVES 4
+
 /** Class managing a Btree table in a Brass database.
  *
  *  A table is a store holding a set of key/tag pairs.
@@ -376,6 +381,15 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	 */
 	bool is_open() const { return handle >= 0; }
 
+	/** Find the identity of the file this table has open.
+	 *
+	 *  @return false if the table isn't open or the file can't be
+	 *		stat()-ed.
+	 */
+	bool get_file_id(BlockCache::FileId & id) const {
+	    return handle >= 0 && BlockCache::get_file_id(handle, id);
+	}
+
 	/** Flush any outstanding changes to the DB file of the table.
 	 *
 	 *  This must be called before commit, to ensure that the DB file is
@@ -529,6 +543,35 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 
 	void set_full_compaction(bool parity);
 
+	/** Set whether to read blocks via a read-only memory mapping.
+	 *
+	 *  This must be called before the table is opened, and is ignored if
+	 *  the table is writable or mmap() isn't available.
+	 */
+	void set_mmap(bool on);
+
+	/** Set whether to hint to the OS which blocks will be read soon.
+	 *
+	 *  This is ignored if the table is writable.  See prefetch_entry()
+	 *  and prefetch_next_leaves().
+	 */
+	void set_prefetch(bool on) { use_prefetch = on && !writable; }
+
+	/// Are hints to the OS about which blocks will be read soon enabled?
+	bool get_prefetch() const { return use_prefetch; }
+
+	/** Set whether to bulk load entries added in ascending key order.
+	 *
+	 *  While this is on, an entry whose key sorts after every key already
+	 *  in the table is appended to the rightmost leaf block without
+	 *  searching for where it goes, and when a block fills up it's written
+	 *  out as it is and a new block started to its right, rather than the
+	 *  block being split.  So a table built from entries in ascending key
+	 *  order ends up with fully packed blocks, each written just once.
+	 *  Entries which don't sort last are added as usual.
+	 */
+	void set_bulk_load(bool on) { bulk_load = on; }
+
 	/** Get the latest revision number stored in this table.
 	 *
 	 *  This gives the higher of the revision numbers held in the base
@@ -589,6 +632,33 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	 */
 	BrassCursor * cursor_get() const;
 
+	/** Hint that the entry with key @a key is likely to be read soon.
+	 *
+	 *  We find the leaf block which would hold @a key (reading the
+	 *  branch blocks above it, which are usually cached) and ask the OS
+	 *  to start reading the leaf block in the background.  This uses the
+	 *  built-in cursor, so does nothing for a writable table (where that
+	 *  cursor holds modified blocks).  It also does nothing unless
+	 *  set_prefetch() has been called.
+	 */
+	void prefetch_entry(const std::string & key) const;
+
+	/** Hint that the leaf blocks following the one cursor C_ points to
+	 *  are likely to be read soon.
+	 *
+	 *  We only look at the leaf blocks with the same parent block, so at
+	 *  most PREFETCH_LEAVES blocks are hinted.
+	 *
+	 *  @param C_		The cursor.
+	 *  @param hinted_n	The parent block we last hinted leaf blocks of
+	 *			(updated by this method).
+	 *  @param hinted_c	The directory offset in block @a hinted_n of the
+	 *			last leaf block we hinted (updated by this
+	 *			method).
+	 */
+	void prefetch_next_leaves(const Brass::Cursor * C_,
+				  uint4 & hinted_n, int & hinted_c) const;
+
 	/** Determine whether the object contains uncommitted modifications.
 	 *
 	 *  @return true if there have been modifications since the last
@@ -607,6 +677,23 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 		/ block_capacity;
 	}
 
+	/** Set a preset dictionary to use when compressing tags.
+	 *
+	 *  The dictionary is stored in the base file, so it takes effect when
+	 *  the table is next committed.  Tags already in the table must not
+	 *  be compressed, so this should only be called on a newly created
+	 *  table (xapian-compact uses it for the tables it writes).
+	 *
+	 *  @param dictionary	The dictionary (at most 32KB - zlib only uses
+	 *			the last 32KB of a longer dictionary).
+	 */
+	void set_compression_dictionary(const std::string & dictionary);
+
+	/// Get the preset dictionary used when compressing tags.
+	const std::string & get_compression_dictionary() const {
+	    return base.get_dictionary();
+	}
+
     protected:
 
 	/** Perform the opening operation to read.
@@ -625,11 +712,16 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	bool basic_open(bool revision_supplied, brass_revision_number_t revision);
 
 	bool find(Brass::Cursor *) const;
+	bool find_append_point();
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_from_file(uint4 n, byte *p) const;
+	byte * mapped_block(uint4 n) const;
+	void map_file();
 	void write_block(uint4 n, const byte *p) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Brass::Cursor *C_, int j, uint4 n) const;
+	void prefetch_block(uint4 n) const;
 	void alter();
 	void compact(byte *p);
 	void enter_key(int j, Brass::Key prevkey, Brass::Key newkey);
@@ -655,6 +747,16 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	/// Allocate the zstream for inflating, if not already allocated.
 	void lazy_alloc_inflate_zstream() const;
 
+	/** Prime deflate_zstream with the preset dictionary, if there is one.
+	 *
+	 *  @param tag_size	The size of the tag to be compressed, which
+	 *			limits how much of the dictionary is used.
+	 */
+	void set_deflate_dictionary(size_t tag_size) const;
+
+	/// Prime inflate_zstream with the preset dictionary, if there is one.
+	void set_inflate_dictionary() const;
+
 	/** revision number of the opened B-tree. */
 	brass_revision_number_t revision_number;
 
@@ -698,6 +800,39 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	 */
 	int handle;
 
+	/** The shared cache to read blocks via.
+	 *
+	 *  This is NULL if blocks from this table aren't being cached (which
+	 *  is always the case for a writable table).
+	 */
+	BlockCache * block_cache;
+
+	/// Identifies the file open as handle when we opened it.
+	BlockCache::FileId file_id;
+
+	/** Read blocks from a read-only memory mapping of the file?
+	 *
+	 *  Blocks are still copied into the cursors' buffers, as with pread(),
+	 *  so nothing points into the mapping and a writer reusing a block
+	 *  can't change it under a cursor.
+	 */
+	bool use_mmap;
+
+	/// Should prefetch_entry() and prefetch_next_leaves() give hints?
+	bool use_prefetch;
+
+	/// Start of the current mapping of the file (or NULL).
+	byte * map_base;
+
+	/// Length of the current mapping (this may extend past the file end).
+	size_t map_size;
+
+	/// The size of the file when we last opened it.
+	off_t map_file_size;
+
+	/// Identifies the file map_base maps.
+	BlockCache::FileId map_file_id;
+
 	/// number of levels, counting from 0
 	int level;
 
@@ -737,6 +872,9 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	/// set to true when full compaction is to be achieved
 	bool full_compaction;
 
+	/// Set to true when entries in ascending key order are to be appended.
+	bool bulk_load;
+
 	/// Set to true when the database is opened to write.
 	bool writable;
 
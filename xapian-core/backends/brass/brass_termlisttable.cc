@@ -42,19 +42,26 @@ BrassTermListTable::set_termlist(Xapian::docid did,
 				 brass_doclen_t doclen)
 {
     LOGCALL_VOID(DB, "BrassTermListTable::set_termlist", did | doc | doclen);
+    add(make_key(did), encode_termlist(doc, doclen));
+}
 
-    string tag;
-    pack_uint(tag, doclen);
+string
+BrassTermListTable::encode_termlist(const Xapian::Document & doc,
+				    brass_doclen_t doclen)
+{
+    LOGCALL_STATIC(DB, string, "BrassTermListTable::encode_termlist", doc | doclen);
 
     Xapian::doccount termlist_size = doc.termlist_count();
     if (termlist_size == 0) {
 	// doclen is sum(wdf) so should be zero if there are no terms.
 	Assert(doclen == 0);
 	Assert(doc.termlist_begin() == doc.termlist_end());
-	add(make_key(did), string());
-	return;
+	RETURN(string());
     }
 
+    string tag;
+    pack_uint(tag, doclen);
+
     Xapian::TermIterator t = doc.termlist_begin();
     if (t != doc.termlist_end()) {
 	pack_uint(tag, termlist_size);
@@ -106,5 +113,5 @@ BrassTermListTable::set_termlist(Xapian::docid did,
 	}
     }
     Assert(termlist_size == 0);
-    add(make_key(did), tag);
+    RETURN(tag);
 }
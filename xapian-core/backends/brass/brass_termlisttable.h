@@ -63,6 +63,16 @@ class BrassTermListTable : public BrassLazyTable {
     void set_termlist(Xapian::docid did, const Xapian::Document & doc,
 		      brass_doclen_t doclen);
 
+    /** Encode the termlist data for a document.
+     *
+     *  This doesn't access the table, so can be called from any thread.
+     *
+     *  @param doc	The Xapian::Document object to read term data from.
+     *  @param doclen	The document length.
+     */
+    static std::string encode_termlist(const Xapian::Document & doc,
+				       brass_doclen_t doclen);
+
     /** Delete the termlist data for document @a did.
      *
      *  @param did  The docid to delete the termlist data for.
@@ -36,15 +36,50 @@ BrassValueList::update_reader()
     Xapian::docid first_did = docid_from_key(slot, cursor->current_key);
     if (!first_did) return false;
 
+    // Value chunks are mostly read in order, so ask for the following leaf
+    // blocks to be read in the background.
+    cursor->prefetch_next();
     cursor->read_tag();
     const string & tag = cursor->current_tag;
     reader.assign(tag.data(), tag.size(), first_did);
     return true;
 }
 
+bool
+BrassValueList::find_chunk_in_range(const string & lo, const string & hi)
+{
+    string lower, upper;
+    while (!summary_cursor->after_end()) {
+	const string & key = summary_cursor->current_key;
+	Xapian::docid first_did = docid_from_key(slot, key, '\xd9');
+	if (!first_did) break;
+
+	summary_cursor->read_tag();
+	decode_valuesummary(summary_cursor->current_tag, lower, upper);
+	if (upper >= lo && (hi.empty() || lower <= hi)) {
+	    if (!cursor->find_entry(make_valuechunk_key(slot, first_did)))
+		throw Xapian::DatabaseCorruptError("Value chunk summary has no chunk");
+	    (void)update_reader();
+	    if (!reader.at_end()) return true;
+	}
+	summary_cursor->next();
+    }
+    return false;
+}
+
+void
+BrassValueList::set_at_end()
+{
+    delete cursor;
+    cursor = NULL;
+    delete summary_cursor;
+    summary_cursor = NULL;
+}
+
 BrassValueList::~BrassValueList()
 {
     delete cursor;
+    delete summary_cursor;
 }
 
 Xapian::docid
@@ -67,6 +102,13 @@ BrassValueList::get_value() const
     return reader.get_value();
 }
 
+int
+BrassValueList::compare_value(const string & s) const
+{
+    Assert(!at_end());
+    return reader.compare_value(s);
+}
+
 bool
 BrassValueList::at_end() const
 {
@@ -129,6 +171,62 @@ BrassValueList::skip_to(Xapian::docid did)
     cursor = NULL;
 }
 
+void
+BrassValueList::next_in_range(const string & lo, const string & hi)
+{
+    Xapian::docid after = 0;
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+    } else {
+	if (!reader.at_end()) {
+	    reader.next();
+	    if (!reader.at_end()) return;
+	}
+	if (cursor->after_end()) {
+	    set_at_end();
+	    return;
+	}
+	// This is 0 if the cursor is before the first chunk for the slot,
+	// which can happen after check().
+	after = docid_from_key(slot, cursor->current_key);
+    }
+
+    // Look for the next chunk which might have a value in the range.
+    if (!summary_cursor) summary_cursor = db->get_postlist_cursor();
+    summary_cursor->find_entry_ge(make_valuesummary_key(slot, after + 1));
+    if (!find_chunk_in_range(lo, hi)) set_at_end();
+}
+
+void
+BrassValueList::skip_to_in_range(Xapian::docid did,
+				 const string & lo, const string & hi)
+{
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+    } else if (!reader.at_end()) {
+	reader.skip_to(did);
+	if (!reader.at_end()) return;
+    }
+
+    // Find the summary for the chunk which would contain did, then look from
+    // there for a chunk which might have a value in the range.
+    if (!summary_cursor) summary_cursor = db->get_postlist_cursor();
+    if (!summary_cursor->find_entry(make_valuesummary_key(slot, did))) {
+	if (!docid_from_key(slot, summary_cursor->current_key, '\xd9')) {
+	    // did is before the first chunk for this slot.
+	    summary_cursor->next();
+	}
+    }
+    while (find_chunk_in_range(lo, hi)) {
+	reader.skip_to(did);
+	if (!reader.at_end()) return;
+	summary_cursor->next();
+    }
+    set_at_end();
+}
+
 bool
 BrassValueList::check(Xapian::docid did)
 {
@@ -37,6 +37,9 @@ class BrassValueList : public Xapian::ValueIterator::Internal {
 
     BrassCursor * cursor;
 
+    /// Cursor for reading chunk summaries, opened when first needed.
+    BrassCursor * summary_cursor;
+
     Brass::ValueChunkReader reader;
 
     Xapian::valueno slot;
@@ -46,10 +49,23 @@ class BrassValueList : public Xapian::ValueIterator::Internal {
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /** Move to the first chunk which might have a value in [lo, hi].
+     *
+     *  Starts looking from the chunk summary which @a summary_cursor points
+     *  to.
+     *
+     *  @return true if such a chunk was found, or false if there are no more
+     *		chunks for this slot.
+     */
+    bool find_chunk_in_range(const std::string & lo, const std::string & hi);
+
+    /// Move to the end of the list.
+    void set_at_end();
+
   public:
     BrassValueList(Xapian::valueno slot_,
 		   Xapian::Internal::intrusive_ptr<const BrassDatabase> db_)
-	: cursor(NULL), slot(slot_), db(db_) { }
+	: cursor(NULL), summary_cursor(NULL), slot(slot_), db(db_) { }
 
     ~BrassValueList();
 
@@ -59,12 +75,19 @@ class BrassValueList : public Xapian::ValueIterator::Internal {
 
     std::string get_value() const;
 
+    int compare_value(const std::string & s) const;
+
     bool at_end() const;
 
     void next();
 
     void skip_to(Xapian::docid);
 
+    void next_in_range(const std::string & lo, const std::string & hi);
+
+    void skip_to_in_range(Xapian::docid did,
+			  const std::string & lo, const std::string & hi);
+
     bool check(Xapian::docid did);
 
     std::string get_description() const;
@@ -74,14 +74,35 @@ ValueChunkReader::assign(const char * p_, size_t len, Xapian::docid did_)
     p = p_;
     end = p_ + len;
     did = did_;
-    if (!unpack_string(&p, end, value))
+    if (p != end && *p == '\0') {
+	// A packed column of fixed width values.
+	++p;
+	Xapian::doccount count;
+	if (!unpack_uint(&p, end, &width) || width == 0 ||
+	    !unpack_uint(&p, end, &count) || count == 0 ||
+	    size_t(end - p) / width < count)
+	    throw Xapian::DatabaseCorruptError("Bad value chunk header");
+	value = p;
+	value_len = width;
+	column_end = p + count * width;
+	p = column_end;
+	return;
+    }
+    width = 0;
+    size_t len_;
+    if (!unpack_uint(&p, end, &len_) || len_ > size_t(end - p))
 	throw Xapian::DatabaseCorruptError("Failed to unpack first value");
+    value = p;
+    value_len = len_;
+    p += len_;
 }
 
 void
 ValueChunkReader::next()
 {
     if (p == end) {
+	if (width && value + width != column_end)
+	    throw Xapian::DatabaseCorruptError("Value chunk has too few docids");
 	p = NULL;
 	return;
     }
@@ -90,8 +111,16 @@ ValueChunkReader::next()
     if (!unpack_uint(&p, end, &delta))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
     did += delta + 1;
-    if (!unpack_string(&p, end, value))
+    if (width) {
+	value += width;
+	if (rare(value == column_end))
+	    throw Xapian::DatabaseCorruptError("Value chunk has too many docids");
+	return;
+    }
+    if (!unpack_uint(&p, end, &value_len) || value_len > size_t(end - p))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
+    value = p;
+    p += value_len;
 }
 
 void
@@ -100,7 +129,28 @@ ValueChunkReader::skip_to(Xapian::docid target)
     if (p == NULL || target <= did)
 	return;
 
-    size_t value_len;
+    if (width) {
+	// The values are all the same length, so we only need to decode the
+	// docids.
+	const char * v = value;
+	while (p != end) {
+	    Xapian::docid delta;
+	    if (rare(!unpack_uint(&p, end, &delta)))
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
+	    did += delta + 1;
+	    v += width;
+	    if (rare(v == column_end))
+		throw Xapian::DatabaseCorruptError("Value chunk has too many docids");
+	    if (did >= target) {
+		value = v;
+		return;
+	    }
+	}
+	p = NULL;
+	return;
+    }
+
+    size_t len;
     while (p != end) {
 	// Get the next docid
 	Xapian::docid delta;
@@ -109,26 +159,80 @@ ValueChunkReader::skip_to(Xapian::docid target)
 	did += delta + 1;
 
 	// Get the length of the string
-	if (rare(!unpack_uint(&p, end, &value_len))) {
+	if (rare(!unpack_uint(&p, end, &len))) {
 	    throw Xapian::DatabaseCorruptError("Failed to unpack streamed value length");
 	}
 
 	// Check that it's not too long
-	if (rare(value_len > size_t(end - p))) {
+	if (rare(len > size_t(end - p))) {
 	    throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
 	}
 
-	// Assign the value and return only if we've reached the target
+	// Note the value and return only if we've reached the target
 	if (did >= target) {
-	    value.assign(p, value_len);
-	    p += value_len;
+	    value = p;
+	    value_len = len;
+	    p += len;
 	    return;
 	}
-	p += value_len;
+	p += len;
     }
     p = NULL;
 }
 
+void
+ValueChunkWriter::append(Xapian::docid did, const string & value)
+{
+    Assert(did);
+    Assert(!value.empty());
+    if (count == 0) {
+	first_did = did;
+	width = value.size();
+	lower = upper = value;
+    } else {
+	if (value < lower) {
+	    lower = value;
+	} else if (value > upper) {
+	    upper = value;
+	}
+	AssertRel(did,>,prev_did);
+	pack_uint(chunk, did - prev_did - 1);
+	if (width) {
+	    if (value.size() == width) {
+		pack_uint(deltas, did - prev_did - 1);
+	    } else {
+		// The values differ in length, so we can't use a packed column.
+		width = 0;
+		deltas.resize(0);
+		column.resize(0);
+	    }
+	}
+    }
+    prev_did = did;
+    ++count;
+    pack_string(chunk, value);
+    if (width) column += value;
+}
+
+void
+ValueChunkWriter::finish(string & tag)
+{
+    if (width && count > 1) {
+	tag.assign(1, '\0');
+	pack_uint(tag, width);
+	pack_uint(tag, count);
+	tag += column;
+	tag += deltas;
+    } else {
+	swap(tag, chunk);
+    }
+    chunk.resize(0);
+    deltas.resize(0);
+    column.resize(0);
+    width = 0;
+    count = 0;
+}
+
 void
 BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -205,39 +309,35 @@ class ValueUpdater {
 
     ValueChunkReader reader;
 
-    string tag;
-
-    Xapian::docid prev_did;
+    ValueChunkWriter writer;
 
     Xapian::docid first_did;
 
-    Xapian::docid new_first_did;
-
     Xapian::docid last_allowed_did;
 
     void append_to_stream(Xapian::docid did, const string & value) {
-	Assert(did);
-	if (tag.empty()) {
-	    new_first_did = did;
-	} else {
-	    AssertRel(did,>,prev_did);
-	    pack_uint(tag, did - prev_did - 1);
-	}
-	prev_did = did;
-	pack_string(tag, value);
-	if (tag.size() >= CHUNK_SIZE_THRESHOLD) write_tag();
+	writer.append(did, value);
+	if (writer.size() >= CHUNK_SIZE_THRESHOLD) write_tag();
     }
 
     void write_tag() {
-	// If the first docid has changed, delete the old entry.
-	if (first_did && new_first_did != first_did) {
+	Xapian::docid new_first_did = writer.get_first_did();
+	bool empty = writer.empty();
+	// If the first docid has changed, delete the old entry and its
+	// summary.
+	if (first_did && (empty || new_first_did != first_did)) {
 	    table->del(make_valuechunk_key(slot, first_did));
+	    table->del(make_valuesummary_key(slot, first_did));
 	}
-	if (!tag.empty()) {
+	if (!empty) {
+	    table->add(make_valuesummary_key(slot, new_first_did),
+		       encode_valuesummary(writer.get_lower_bound(),
+					   writer.get_upper_bound()));
+	    string tag;
+	    writer.finish(tag);
 	    table->add(make_valuechunk_key(slot, new_first_did), tag);
 	}
 	first_did = 0;
-	tag.resize(0);
     }
 
   public:
@@ -271,8 +371,7 @@ class ValueUpdater {
 	}
 	if (last_allowed_did == 0) {
 	    last_allowed_did = MAX_DOCID;
-	    Assert(tag.empty());
-	    new_first_did = 0;
+	    Assert(writer.empty());
 	    AutoPtr<BrassCursor> cursor(table->cursor_get());
 	    if (cursor->find_entry(make_valuechunk_key(slot, did))) {
 		// We found an exact match, so the first docid is the one
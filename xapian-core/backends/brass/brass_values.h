@@ -27,7 +27,10 @@
 
 #include "xapian/error.h"
 #include "xapian/types.h"
+#include "xapian/visibility.h"
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <string>
 
@@ -43,13 +46,63 @@ make_valuechunk_key(Xapian::valueno slot, Xapian::docid did)
     return key;
 }
 
+/** Generate a key for the summary of a value stream chunk.
+ *
+ *  The summary gives the lowest and highest values in the chunk starting at
+ *  @a did, which allows chunks to be skipped without reading them.
+ */
+inline std::string
+make_valuesummary_key(Xapian::valueno slot, Xapian::docid did)
+{
+    std::string key("\0\xd9", 2);
+    pack_uint(key, slot);
+    pack_uint_preserving_sort(key, did);
+    return key;
+}
+
+/** Encode the summary of a value stream chunk.
+ *
+ *  As for the value statistics, we store an empty upper bound if it's the
+ *  same as the lower bound, which is fine since values can't be empty.
+ */
+inline std::string
+encode_valuesummary(const std::string & lower, const std::string & upper)
+{
+    std::string tag;
+    pack_string(tag, lower);
+    if (lower != upper) tag += upper;
+    return tag;
+}
+
+/// Decode the summary of a value stream chunk.
+inline void
+decode_valuesummary(const std::string & tag,
+		    std::string & lower, std::string & upper)
+{
+    const char * p = tag.data();
+    const char * end = p + tag.size();
+    if (!unpack_string(&p, end, lower) || lower.empty())
+	throw Xapian::DatabaseCorruptError("Bad value chunk summary");
+    if (p == end) {
+	upper = lower;
+    } else {
+	upper.assign(p, end - p);
+    }
+}
+
+/** Get the docid from a value stream chunk key.
+ *
+ *  Returns 0 if @a key isn't a value stream chunk key for @a required_slot.
+ *  Pass '\xd9' for @a type to decode a value chunk summary key.
+ */
 inline Xapian::docid
-docid_from_key(Xapian::valueno required_slot, const std::string & key)
+docid_from_key(Xapian::valueno required_slot, const std::string & key,
+	       char type = '\xd8')
 {
     const char * p = key.data();
     const char * end = p + key.length();
     // Fail if not a value chunk key.
-    if (end - p < 2 || *p++ != '\0' || *p++ != '\xd8') return 0;
+    if (end - p < 2 || *p++ != '\0' || *p++ != type) return 0;
     Xapian::valueno slot;
     if (!unpack_uint(&p, end, &slot))
        	throw Xapian::DatabaseCorruptError("bad value key");
@@ -171,18 +224,47 @@ class BrassValueManager {
 
 namespace Brass {
 
-class ValueChunkReader {
+/** Reads the entries in a value stream chunk.
+ *
+ *  Each chunk has a separate summary entry (see make_valuesummary_key())
+ *  giving the lowest and highest values in it.
+ *
+ *  A chunk is usually a list of entries, each giving the docid (as a delta
+ *  from the previous one, except for the first which is in the key) and
+ *  the value (with its length).
+ *
+ *  If all the values in a chunk are the same length (as is the case for
+ *  dates, fixed width binary numbers, etc), the values are instead stored as
+ *  a packed column: a zero byte (which can't start a normal chunk, since
+ *  values are never empty), the width, the number of entries, then the
+ *  values one after another, then the docid deltas.
+ */
+class XAPIAN_VISIBILITY_DEFAULT ValueChunkReader {
     const char *p;
     const char *end;
 
     Xapian::docid did;
 
-    std::string value;
+    /// The current value, which points into the chunk.
+    const char * value;
+
+    /// The length of the current value.
+    size_t value_len;
+
+    /// The width of the values if the chunk is a packed column, or 0.
+    size_t width;
+
+    /// The end of the packed values if the chunk is a packed column.
+    const char * column_end;
 
   public:
     /// Create a ValueChunkReader which is already at_end().
     ValueChunkReader() : p(NULL) { }
 
+    /** Create a ValueChunkReader for a chunk.
+     *
+     *  The chunk data must remain valid while this object is in use.
+     */
     ValueChunkReader(const char * p_, size_t len, Xapian::docid did_) {
 	assign(p_, len, did_);
     }
@@ -193,13 +275,77 @@ class ValueChunkReader {
 
     Xapian::docid get_docid() const { return did; }
 
-    const std::string & get_value() const { return value; }
+    std::string get_value() const { return std::string(value, value_len); }
+
+    /// Compare the current value with @a s, as std::string::compare() would.
+    int compare_value(const std::string & s) const {
+	size_t len = std::min(value_len, s.size());
+	int result = std::memcmp(value, s.data(), len);
+	if (result) return result;
+	if (value_len == s.size()) return 0;
+	return value_len < s.size() ? -1 : 1;
+    }
 
     void next();
 
     void skip_to(Xapian::docid target);
 };
 
+/** Builds a value stream chunk.
+ *
+ *  Chooses the packed column encoding described for ValueChunkReader if all
+ *  the values added are the same length.
+ */
+class ValueChunkWriter {
+    /// The chunk in the usual encoding.
+    std::string chunk;
+
+    /// The docid deltas.
+    std::string deltas;
+
+    /// The values one after another.
+    std::string column;
+
+    /// The width of all values so far, or 0 if they differ.
+    size_t width;
+
+    /// The number of entries.
+    Xapian::doccount count;
+
+    /// The lowest value.
+    std::string lower;
+
+    /// The highest value.
+    std::string upper;
+
+    Xapian::docid first_did;
+
+    Xapian::docid prev_did;
+
+  public:
+    ValueChunkWriter() : width(0), count(0), first_did(0), prev_did(0) { }
+
+    /// Add an entry - @a did must be greater than any previously added.
+    void append(Xapian::docid did, const std::string & value);
+
+    bool empty() const { return count == 0; }
+
+    /// Approximate size of the encoded chunk.
+    size_t size() const { return chunk.size(); }
+
+    /// The docid of the first entry.
+    Xapian::docid get_first_did() const { return first_did; }
+
+    /// The lowest value added.
+    const std::string & get_lower_bound() const { return lower; }
+
+    /// The highest value added.
+    const std::string & get_upper_bound() const { return upper; }
+
+    /// Encode the chunk into @a tag and reset to empty.
+    void finish(std::string & tag);
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_BRASS_VALUES_H
@@ -44,7 +44,12 @@
 using namespace std;
 
 // YYYYMMDDX where X allows multiple format revisions in a day
-#define BRASS_VERSION 201103110
+#define BRASS_VERSION 202610170
+// 202610170 1.3.0 Postlist chunk headers store the greatest wdf in the chunk;
+//                 postlist chunks may be block-packed; long position lists
+//                 may be blocked with a skip index; value chunks may store
+//                 fixed width values as a column and have a lowest/highest
+//                 summary; base files can hold a preset compression dictionary
 // 201103110 1.2.5 Bump for new max changesets dbstats
 // 200912150 1.1.4 Brass debuts.
 
@@ -119,6 +119,18 @@ ChertAllDocsModifiedPostList::skip_to(Xapian::docid desired_did,
     RETURN(NULL);
 }
 
+Xapian::doccount
+ChertAllDocsModifiedPostList::get_batch(Xapian::doccount n,
+					Xapian::docid * dids,
+					Xapian::termcount * wdfs,
+					Xapian::termcount * doclens)
+{
+    LOGCALL(DB, Xapian::doccount, "ChertAllDocsModifiedPostList::get_batch", n | dids | wdfs | doclens);
+    // We need to merge in the modifications, so the raw batch reading which
+    // ChertAllDocsPostList provides is no use to us.
+    RETURN(PostList::get_batch(n, dids, wdfs, doclens));
+}
+
 bool
 ChertAllDocsModifiedPostList::at_end() const
 {
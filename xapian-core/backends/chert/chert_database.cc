@@ -103,10 +103,10 @@ const int MAX_OPEN_RETRIES = 100;
  * determining the current and next revision numbers, and stores handles
  * to the tables.
  */
-ChertDatabase::ChertDatabase(const string &chert_dir, int action,
+ChertDatabase::ChertDatabase(const string &chert_dir, int flags,
 			     unsigned int block_size)
 	: db_dir(chert_dir),
-	  readonly(action == XAPIAN_DB_READONLY),
+	  readonly((flags & Xapian::DB_ACTION_MASK_) == XAPIAN_DB_READONLY),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
@@ -118,9 +118,18 @@ ChertDatabase::ChertDatabase(const string &chert_dir, int action,
 	  lock(db_dir),
 	  max_changesets(0)
 {
-    LOGCALL_CTOR(DB, "ChertDatabase", chert_dir | action | block_size);
+    LOGCALL_CTOR(DB, "ChertDatabase", chert_dir | flags | block_size);
 
+    int action = flags & Xapian::DB_ACTION_MASK_;
     if (action == XAPIAN_DB_READONLY) {
+	if (flags & Xapian::DB_READ_MMAP) {
+	    postlist_table.set_mmap(true);
+	    position_table.set_mmap(true);
+	    termlist_table.set_mmap(true);
+	    synonym_table.set_mmap(true);
+	    spelling_table.set_mmap(true);
+	    record_table.set_mmap(true);
+	}
 	open_tables_consistent();
 	return;
     }
@@ -717,19 +726,23 @@ ChertDatabase::modifications_failed(chert_revision_number_t old_revision,
     }
 }
 
+bool
+ChertDatabase::is_modified() const
+{
+    return postlist_table.is_modified() ||
+	   position_table.is_modified() ||
+	   termlist_table.is_modified() ||
+	   value_manager.is_modified() ||
+	   synonym_table.is_modified() ||
+	   spelling_table.is_modified() ||
+	   record_table.is_modified();
+}
+
 void
 ChertDatabase::apply()
 {
     LOGCALL_VOID(DB, "ChertDatabase::apply", NO_ARGS);
-    if (!postlist_table.is_modified() &&
-	!position_table.is_modified() &&
-	!termlist_table.is_modified() &&
-	!value_manager.is_modified() &&
-	!synonym_table.is_modified() &&
-	!spelling_table.is_modified() &&
-	!record_table.is_modified()) {
-	return;
-    }
+    if (!is_modified()) return;
 
     chert_revision_number_t old_revision = get_revision_number();
     chert_revision_number_t new_revision = get_next_revision_number();
@@ -1682,3 +1695,9 @@ ChertWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+bool
+ChertWritableDatabase::has_uncommitted_changes() const
+{
+    return change_count || is_modified();
+}
@@ -205,6 +205,9 @@ class ChertDatabase : public Xapian::Database::Internal {
 	 */
 	void apply();
 
+	/// Return true if any of the tables have been modified.
+	bool is_modified() const;
+
 	/** Cancel any outstanding changes to the tables.
 	 */
 	void cancel();
@@ -240,12 +243,15 @@ class ChertDatabase : public Xapian::Database::Internal {
 	 *
 	 *  @param dbdir directory holding chert tables
 	 *
+	 *  @param flags XAPIAN_DB_READONLY or a Xapian::DB_* action, bitwise
+	 *		 or-ed with any Xapian::DB_* flags.
+	 *
 	 *  @param block_size Block size, in bytes, to use when creating
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
 	 *                    created.
 	 */
-	ChertDatabase(const string &db_dir_, int action = XAPIAN_DB_READONLY,
+	ChertDatabase(const string &db_dir_, int flags = XAPIAN_DB_READONLY,
 		       unsigned int block_size = 0u);
 
 	~ChertDatabase();
@@ -456,6 +462,7 @@ class ChertWritableDatabase : public ChertDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+	bool has_uncommitted_changes() const;
 	//@}
 };
 
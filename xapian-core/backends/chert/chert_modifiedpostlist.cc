@@ -138,6 +138,16 @@ ChertModifiedPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
     return NULL;
 }
 
+Xapian::doccount
+ChertModifiedPostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+				 Xapian::termcount * wdfs,
+				 Xapian::termcount * doclens)
+{
+    // We need to merge in the modifications, so the raw batch reading which
+    // ChertPostList provides is no use to us.
+    return PostList::get_batch(n, dids, wdfs, doclens);
+}
+
 bool
 ChertModifiedPostList::at_end() const {
     return it == mods.end() && ChertPostList::at_end();
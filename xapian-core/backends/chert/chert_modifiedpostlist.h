@@ -69,6 +69,10 @@ class ChertModifiedPostList : public ChertPostList {
 
     PostList * skip_to(Xapian::docid desired_did, Xapian::weight w_min);
 
+    Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+			       Xapian::termcount * wdfs,
+			       Xapian::termcount * doclens);
+
     bool at_end() const;
 
     std::string get_description() const;
@@ -822,6 +822,37 @@ ChertPostList::next(Xapian::weight w_min)
     RETURN(NULL);
 }
 
+Xapian::doccount
+ChertPostList::read_raw_batch(Xapian::doccount n, Xapian::docid * dids,
+			      Xapian::termcount * wdfs)
+{
+    LOGCALL(DB, Xapian::doccount, "ChertPostList::read_raw_batch", n | dids | wdfs);
+    Assert(have_started);
+    Xapian::doccount count = 0;
+    while (count != n && !is_at_end) {
+	dids[count] = did;
+	if (wdfs) wdfs[count] = wdf;
+	++count;
+	if (!next_in_chunk()) next_chunk();
+    }
+    RETURN(count);
+}
+
+Xapian::doccount
+ChertPostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+			 Xapian::termcount * wdfs, Xapian::termcount * doclens)
+{
+    LOGCALL(DB, Xapian::doccount, "ChertPostList::get_batch", n | dids | wdfs | doclens);
+    Xapian::doccount count = read_raw_batch(n, dids, wdfs);
+    if (doclens) {
+	Assert(this_db.get());
+	for (Xapian::doccount i = 0; i != count; ++i) {
+	    doclens[i] = this_db->get_doclength(dids[i]);
+	}
+    }
+    RETURN(count);
+}
+
 bool
 ChertPostList::current_chunk_contains(Xapian::docid desired_did)
 {
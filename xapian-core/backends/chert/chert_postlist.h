@@ -136,6 +136,16 @@ class ChertPostList : public LeafPostList {
 	/// Whether we've started reading the list yet.
 	bool have_started;
 
+	/** Read a batch of entries as stored, starting with the current one.
+	 *
+	 *  This is get_batch() without the document lengths, and with
+	 *  @a wdfs receiving the wdfs as stored (which for
+	 *  ChertAllDocsPostList are the document lengths).
+	 */
+	Xapian::doccount read_raw_batch(Xapian::doccount n,
+					Xapian::docid * dids,
+					Xapian::termcount * wdfs);
+
     private:
 	/// True if this is the last chunk.
 	bool is_last_chunk;
@@ -264,6 +274,11 @@ class ChertPostList : public LeafPostList {
 	/// Skip to next document with docid >= docid.
 	PostList * skip_to(Xapian::docid desired_did, Xapian::weight w_min);
 
+	/// Read a batch of entries, starting with the current one.
+	Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+				   Xapian::termcount * wdfs,
+				   Xapian::termcount * doclens);
+
 	/// Return true if and only if we're off the end of the list.
 	bool at_end() const { return is_at_end; }
 
@@ -63,6 +63,11 @@ PREAD_PROTOTYPE
 PWRITE_PROTOTYPE
 #endif
 
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include "safesysstat.h"
+
 #include <cstdio>    /* for rename */
 #include <cstring>   /* for memmove */
 #include <climits>   /* for CHAR_BIT */
@@ -192,6 +197,127 @@ ChertTable::read_block(uint4 n, byte * p) const
      */
     Assert(n / CHAR_BIT < base.get_bit_map_size());
 
+    if (use_mmap) {
+	// Copy the block rather than pointing cursors into the mapping, since
+	// a writer may reuse the block while a cursor is still looking at it.
+	const byte * m = mapped_block(n);
+	memcpy(p, m, block_size);
+	// If a writer was rewriting the block while we copied it, we may have
+	// the start of the old version and the end of the new one.  The
+	// revision is at the start, so it will normally have changed by the
+	// time we've copied the rest.  Reread it via a volatile pointer, since
+	// otherwise the compiler can assume it's what memcpy() just copied.
+	const volatile byte * rev = m;
+	for (int i = 0; i != 4; ++i) {
+	    if (rare(rev[i] != p[i])) set_overwritten();
+	}
+	return;
+    }
+
+    if (block_cache) {
+	// file_id was found when we opened the table, so a cache hit doesn't
+	// need any system calls.  Anything cached under our key was read at our
+	// revision, so it's still what we'd see even if a writer has since
+	// reused the block.
+	BlockCache::Key key(file_id, n, revision_number);
+	if (block_cache->lookup(key, p, block_size)) return;
+	read_block_from_file(n, p);
+	// Don't let anyone else see overwritten contents under our key - we
+	// leave block_to_cursor() to notice and throw DatabaseModifiedError.
+	if (REVISION(p) <= revision_number)
+	    block_cache->insert(key, p, block_size);
+	return;
+    }
+
+    read_block_from_file(n, p);
+}
+
+/// Return a pointer to block n in the mapping of the DB file.
+byte *
+ChertTable::mapped_block(uint4 n) const
+{
+    off_t offset = off_t(block_size) * n;
+    off_t end = offset + off_t(block_size);
+    if (rare(end > map_file_size)) {
+	string message = "Error reading block " + str(n) + ": got end of file";
+	throw Xapian::DatabaseError(message);
+    }
+    // A writer overwriting the database truncates the file we have mapped,
+    // and reading a page of the mapping which is now past the end of the file
+    // raises SIGBUS.  So check the file is still long enough, which reports
+    // the problem as pread() would.
+    struct stat sb;
+    if (rare(fstat(handle, &sb) < 0)) {
+	string message = "Error reading block " + str(n) + ": ";
+	message += strerror(errno);
+	throw Xapian::DatabaseError(message);
+    }
+    if (rare(sb.st_size < end)) {
+	string message = "Error reading block " + str(n) + ": got end of file";
+	throw Xapian::DatabaseError(message);
+    }
+    return map_base + offset;
+}
+
+/** Map the DB file into memory, or check that the current mapping covers it.
+ *
+ *  When the table is reopened, the file may have grown, or been replaced.
+ *  We leave some slack at the end of each mapping so that we don't need to
+ *  remap every time the file grows by a few blocks.
+ */
+void
+ChertTable::map_file()
+{
+    LOGCALL_VOID(DB, "ChertTable::map_file", NO_ARGS);
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    struct stat sb;
+    if (fstat(handle, &sb) < 0) {
+	string message("Couldn't stat ");
+	message += name;
+	message += "DB: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseOpeningError(message);
+    }
+    map_file_size = sb.st_size;
+    if (map_base && map_file_id.dev == sb.st_dev &&
+	map_file_id.ino == sb.st_ino && sb.st_size <= off_t(map_size)) {
+	// The current mapping still covers the whole file.
+	return;
+    }
+    if (sb.st_size == 0) return;
+
+    off_t len = sb.st_size + sb.st_size / 4;
+    if (off_t(size_t(len)) != len) {
+	len = sb.st_size;
+	if (off_t(size_t(len)) != len) {
+	    string message("Couldn't mmap ");
+	    message += name;
+	    message += "DB: file is too large";
+	    throw Xapian::DatabaseOpeningError(message);
+	}
+    }
+    void * m = mmap(NULL, size_t(len), PROT_READ, MAP_SHARED, handle, 0);
+    if (m == MAP_FAILED) {
+	string message("Couldn't mmap ");
+	message += name;
+	message += "DB: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseOpeningError(message);
+    }
+    // Cursors copy blocks out of the mapping, so nothing points into the old
+    // one.
+    if (map_base) (void)munmap(map_base, map_size);
+    map_base = static_cast<byte *>(m);
+    map_size = size_t(len);
+    map_file_id.dev = sb.st_dev;
+    map_file_id.ino = sb.st_ino;
+#endif
+}
+
+/// Read block n of the DB file to address p, bypassing block_cache.
+void
+ChertTable::read_block_from_file(uint4 n, byte * p) const
+{
 #ifdef HAVE_PREAD
     off_t offset = off_t(block_size) * n;
     int m = block_size;
@@ -1301,6 +1427,18 @@ ChertTable::set_full_compaction(bool parity)
     full_compaction = parity;
 }
 
+void
+ChertTable::set_mmap(bool on)
+{
+    LOGCALL_VOID(DB, "ChertTable::set_mmap", on);
+    Assert(handle < 0);
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    use_mmap = on && !writable;
+#else
+    (void)on;
+#endif
+}
+
 ChertCursor * ChertTable::cursor_get() const {
     LOGCALL(DB, ChertCursor *, "ChertTable::cursor_get", NO_ARGS);
     if (handle < 0) {
@@ -1510,6 +1648,14 @@ ChertTable::do_open_to_write(bool revision_supplied,
 	throw Xapian::DatabaseOpeningError(message);
     }
 
+    if (create_db) {
+	// Discard any blocks cached from a previous file with this inode.
+	BlockCache * cache = BlockCache::get_instance();
+	BlockCache::FileId id;
+	if (cache && BlockCache::get_file_id(handle, id))
+	    cache->invalidate_file(id);
+    }
+
     if (!basic_open(revision_supplied, revision_)) {
 	::close(handle);
 	handle = -1;
@@ -1552,6 +1698,11 @@ ChertTable::ChertTable(const char * tablename_, const string & path_,
 	  faked_root_block(true),
 	  sequential(true),
 	  handle(-1),
+	  block_cache(NULL),
+	  use_mmap(false),
+	  map_base(NULL),
+	  map_size(0),
+	  map_file_size(0),
 	  level(0),
 	  root(0),
 	  kt(0),
@@ -1733,6 +1884,10 @@ ChertTable::~ChertTable() {
     LOGCALL_DTOR(DB, "ChertTable");
     ChertTable::close();
 
+#if defined HAVE_MMAP && defined HAVE_SYS_MMAN_H
+    if (map_base) (void)munmap(map_base, map_size);
+#endif
+
     if (deflate_zstream) {
 	// Errors which we care about have already been handled, so just ignore
 	// any which get returned here.
@@ -2023,6 +2178,16 @@ ChertTable::do_open_to_read(bool revision_supplied, chert_revision_number_t revi
 	throw Xapian::DatabaseOpeningError("Failed to open table for reading");
     }
 
+    if (use_mmap) {
+	// The blocks are already shared via the page cache.
+	block_cache = NULL;
+	map_file();
+    } else {
+	block_cache = BlockCache::get_instance();
+	if (block_cache && !BlockCache::get_file_id(handle, file_id))
+	    block_cache = NULL;
+    }
+
     for (int j = 0; j <= level; j++) {
 	C[j].n = BLK_UNUSED;
 	C[j].p = new byte[block_size];
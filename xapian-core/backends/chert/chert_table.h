@@ -30,6 +30,8 @@
 #include "chert_btreebase.h"
 #include "chert_cursor.h"
 
+#include "../blockcache.h"
+
 #include "noreturn.h"
 #include "omassert.h"
 #include "str.h"
@@ -525,6 +527,13 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 
 	void set_full_compaction(bool parity);
 
+	/** Set whether to read blocks via a read-only memory mapping.
+	 *
+	 *  This must be called before the table is opened, and is ignored if
+	 *  the table is writable or mmap() isn't available.
+	 */
+	void set_mmap(bool on);
+
 	/** Get the latest revision number stored in this table.
 	 *
 	 *  This gives the higher of the revision numbers held in the base
@@ -623,6 +632,9 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 	bool find(Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_from_file(uint4 n, byte *p) const;
+	byte * mapped_block(uint4 n) const;
+	void map_file();
 	void write_block(uint4 n, const byte *p) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Cursor *C_, int j, uint4 n) const;
@@ -694,6 +706,36 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 	 */
 	int handle;
 
+	/** The shared cache to read blocks via.
+	 *
+	 *  This is NULL if blocks from this table aren't being cached (which
+	 *  is always the case for a writable table).
+	 */
+	BlockCache * block_cache;
+
+	/// Identifies the file open as handle when we opened it.
+	BlockCache::FileId file_id;
+
+	/** Read blocks from a read-only memory mapping of the file?
+	 *
+	 *  Blocks are still copied into the cursors' buffers, as with pread(),
+	 *  so nothing points into the mapping and a writer reusing a block
+	 *  can't change it under a cursor.
+	 */
+	bool use_mmap;
+
+	/// Start of the current mapping of the file (or NULL).
+	byte * map_base;
+
+	/// Length of the current mapping (this may extend past the file end).
+	size_t map_size;
+
+	/// The size of the file when we last opened it.
+	off_t map_file_size;
+
+	/// Identifies the file map_base maps.
+	BlockCache::FileId map_file_id;
+
 	/// number of levels, counting from 0
 	int level;
 
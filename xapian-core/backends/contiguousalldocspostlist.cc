@@ -98,6 +98,29 @@ ContiguousAllDocsPostList::skip_to(Xapian::docid target, Xapian::weight)
     return NULL;
 }
 
+Xapian::doccount
+ContiguousAllDocsPostList::get_batch(Xapian::doccount n, Xapian::docid * dids,
+				     Xapian::termcount * wdfs,
+				     Xapian::termcount * doclens)
+{
+    Assert(did != 0);
+    Xapian::doccount count = 0;
+    if (at_end()) return count;
+    if (n > doccount - did + 1) n = doccount - did + 1;
+    while (count != n) {
+	dids[count] = did + count;
+	if (wdfs) wdfs[count] = 1;
+	if (doclens) doclens[count] = db->get_doclength(did + count);
+	++count;
+    }
+    if (did + count > doccount) {
+	db = NULL;
+    } else {
+	did += count;
+    }
+    return count;
+}
+
 bool
 ContiguousAllDocsPostList::at_end() const
 {
@@ -37,6 +37,9 @@
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
 
+/// Number of docids to read at once when deleting by unique term.
+static const Xapian::doccount BATCH_SIZE = 64;
+
 namespace Xapian {
 
 Database::Internal::~Internal()
@@ -176,6 +179,19 @@ Database::Internal::add_document(const Xapian::Document &)
     return 0;
 }
 
+Xapian::docid
+Database::Internal::add_documents(const vector<Xapian::Document> & documents,
+				  unsigned)
+{
+    Assert(!documents.empty());
+    vector<Xapian::Document>::const_iterator i = documents.begin();
+    Xapian::docid first = add_document(*i);
+    while (++i != documents.end()) {
+	add_document(*i);
+    }
+    return first;
+}
+
 void
 Database::Internal::delete_document(Xapian::docid)
 {
@@ -188,8 +204,13 @@ Database::Internal::delete_document(const string & unique_term)
 {
     // Default implementation - overridden for remote databases
     intrusive_ptr<LeafPostList> pl(open_post_list(unique_term));
-    while (pl->next(), !pl->at_end()) {
-	delete_document(pl->get_docid());
+    pl->next();
+    Xapian::docid dids[BATCH_SIZE];
+    while (!pl->at_end()) {
+	Xapian::doccount n = pl->get_batch(BATCH_SIZE, dids, NULL, NULL);
+	for (Xapian::doccount i = 0; i != n; ++i) {
+	    delete_document(dids[i]);
+	}
     }
 }
 
@@ -212,8 +233,13 @@ Database::Internal::replace_document(const string & unique_term,
     }
     Xapian::docid did = pl->get_docid();
     replace_document(did, document);
-    while (pl->next(), !pl->at_end()) {
-	delete_document(pl->get_docid());
+    pl->next();
+    Xapian::docid dids[BATCH_SIZE];
+    while (!pl->at_end()) {
+	Xapian::doccount n = pl->get_batch(BATCH_SIZE, dids, NULL, NULL);
+	for (Xapian::doccount i = 0; i != n; ++i) {
+	    delete_document(dids[i]);
+	}
     }
     return did;
 }
@@ -434,17 +460,13 @@ Database::Internal::reopen()
 }
 
 void
-Database::Internal::request_document(Xapian::docid /*did*/) const
+Database::Internal::open_documents(const vector<Xapian::docid> & dids,
+				   vector<Xapian::Document> & docs) const
 {
-}
-
-Xapian::Document::Internal *
-Database::Internal::collect_document(Xapian::docid did) const
-{
-    // Open the document lazily - collect document is only called by
-    // Enquire::Internal::read_doc() for a given MSetItem, so we know that the
-    // document already exists.
-    return open_document(did, true);
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	docs.push_back(Xapian::Document(open_document(*i, true)));
+    }
 }
 
 void
@@ -459,6 +481,12 @@ Database::Internal::get_revision_info() const
     throw Xapian::UnimplementedError("This backend doesn't provide access to revision information");
 }
 
+bool
+Database::Internal::has_uncommitted_changes() const
+{
+    return false;
+}
+
 string
 Database::Internal::get_uuid() const
 {
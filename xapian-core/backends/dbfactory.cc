@@ -89,7 +89,7 @@ InMemory::open() {
 #endif
 
 static void
-open_stub(Database &db, const string &file)
+open_stub(Database &db, const string &file, int flags)
 {
     // A stub database is a text file with one or more lines of this format:
     // <dbtype> <serialised db object>
@@ -113,14 +113,14 @@ open_stub(Database &db, const string &file)
 
 	if (type == "auto") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(line));
+	    db.add_database(Database(line, flags));
 	    continue;
 	}
 
 #ifdef XAPIAN_HAS_CHERT_BACKEND
 	if (type == "chert") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Chert::open(line));
+	    db.add_database(Database(new ChertDatabase(line, flags)));
 	    continue;
 	}
 #endif
@@ -128,7 +128,7 @@ open_stub(Database &db, const string &file)
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	if (type == "brass") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Brass::open(line));
+	    db.add_database(Database(new BrassDatabase(line, flags)));
 	    continue;
 	}
 #endif
@@ -296,7 +296,7 @@ Auto::open_stub(const string &file)
 {
     LOGCALL_STATIC(API, Database, "Auto::open_stub", file);
     Database db;
-    open_stub(db, file);
+    open_stub(db, file, 0);
     RETURN(db);
 }
 
@@ -309,9 +309,12 @@ Auto::open_stub(const string &file, int action)
     RETURN(db);
 }
 
-Database::Database(const string &path)
+Database::Database(const string &path, int flags)
 {
-    LOGCALL_CTOR(API, "Database", path);
+    LOGCALL_CTOR(API, "Database", path | flags);
+
+    // We always open read-only, so ignore any action code.
+    flags &= ~DB_ACTION_MASK_;
 
     struct stat statbuf;
     if (stat(path, &statbuf) == -1) {
@@ -320,7 +323,7 @@ Database::Database(const string &path)
 
     if (S_ISREG(statbuf.st_mode)) {
 	// The path is a file, so assume it is a stub database file.
-	open_stub(*this, path);
+	open_stub(*this, path, flags);
 	return;
     }
 
@@ -330,14 +333,14 @@ Database::Database(const string &path)
 
 #ifdef XAPIAN_HAS_CHERT_BACKEND
     if (file_exists(path + "/iamchert")) {
-	internal.push_back(new ChertDatabase(path));
+	internal.push_back(new ChertDatabase(path, flags));
 	return;
     }
 #endif
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
     if (file_exists(path + "/iambrass")) {
-	internal.push_back(new BrassDatabase(path));
+	internal.push_back(new BrassDatabase(path, flags));
 	return;
     }
 #endif
@@ -353,7 +356,7 @@ Database::Database(const string &path)
 	throw DatabaseOpeningError("Couldn't detect type of database");
     }
 
-    open_stub(*this, stub_file);
+    open_stub(*this, stub_file, flags);
 }
 
 #if defined XAPIAN_HAS_CHERT_BACKEND || \
@@ -58,6 +58,10 @@ struct SubValueList {
 
     std::string get_value() const { return valuelist->get_value(); }
 
+    int compare_value(const std::string & s) const {
+	return valuelist->compare_value(s);
+    }
+
     void next() {
 	valuelist->next();
     }
@@ -121,6 +125,13 @@ MultiValueList::get_value() const
     return valuelists.front()->get_value();
 }
 
+int
+MultiValueList::compare_value(const std::string & s) const
+{
+    Assert(!at_end());
+    return valuelists.front()->compare_value(s);
+}
+
 Xapian::valueno
 MultiValueList::get_valueno() const
 {
@@ -27,6 +27,34 @@
 
 using namespace std;
 
+/// Size in bytes of the first batch of postings we ask for.
+static const size_t FIRST_BATCH_BYTES = 4096;
+
+/// Maximum size in bytes of the batches of postings we ask for.
+static const size_t MAX_BATCH_BYTES = 1024 * 1024;
+
+NetworkPostList::NetworkPostList(Xapian::Internal::intrusive_ptr<const RemoteDatabase> db_,
+				 const string & term_)
+    : LeafPostList(term_),
+      db(db_), started(false), pos(NULL), pos_end(NULL),
+      more(false), batch_last_did(0), batch_bytes(FIRST_BATCH_BYTES),
+      lastdocid(0), lastwdf(0), termfreq(0)
+{
+    termfreq = db->read_post_list(term, 1, *this);
+}
+
+void
+NetworkPostList::fetch_batch(Xapian::docid did)
+{
+    // Ask for bigger batches as we go, so that reading a long postlist
+    // doesn't need too many round trips.
+    if (batch_bytes < MAX_BATCH_BYTES) batch_bytes *= 2;
+    (void)db->read_post_list(term, did, *this);
+    pos = postings.data();
+    pos_end = pos + postings.size();
+    lastdocid = did - 1;
+}
+
 Xapian::doccount
 NetworkPostList::get_termfreq() const
 {
@@ -74,6 +102,8 @@ NetworkPostList::next(Xapian::weight)
 	lastdocid = 0;
     }
 
+    if (pos == pos_end && more) fetch_batch(lastdocid + 1);
+
     if (pos == pos_end) {
 	pos = NULL;
     } else {
@@ -89,6 +119,12 @@ NetworkPostList::skip_to(Xapian::docid did, Xapian::weight min_weight)
 {
     if (!started)
 	next(min_weight);
+    if (pos && lastdocid < did && did > batch_last_did && more) {
+	// Rather than reading the rest of this batch and the postings in
+	// between, ask the server to skip to did for us.
+	fetch_batch(did);
+	next(min_weight);
+    }
     while (pos && lastdocid < did)
 	next(min_weight);
     return NULL;
@@ -32,40 +32,44 @@
 using namespace std;
 
 /** A postlist in a remote database.
+ *
+ *  The postings are fetched from the server in batches as they are needed.
+ *  When skip_to() wants a docid beyond the current batch, the server skips
+ *  to it, so the postings in between don't have to be sent.
  */
 class NetworkPostList : public LeafPostList {
     friend class RemoteDatabase;
 
     Xapian::Internal::intrusive_ptr<const RemoteDatabase> db;
 
+    /// The current batch of postings.
     string postings;
     bool started;
     const char * pos;
     const char * pos_end;
 
+    /// Does the server have more postings after the current batch?
+    bool more;
+
+    /// The last docid in the current batch.
+    Xapian::docid batch_last_did;
+
+    /// Approximate size in bytes of the next batch to ask for.
+    size_t batch_bytes;
+
     Xapian::docid lastdocid;
     Xapian::termcount lastwdf;
     Xapian::Internal::intrusive_ptr<PositionList> lastposlist;
 
     Xapian::doccount termfreq;
 
-    /// Append a posting to the end of the postlist.
-    void append_posting(const string & serialised) {
-	Assert(pos == NULL);
-	Assert(!started);
-	postings.append(serialised);
-    }
+    /// Fetch the batch of postings starting at docid @a did.
+    void fetch_batch(Xapian::docid did);
 
   public:
     /// Constructor.
     NetworkPostList(Xapian::Internal::intrusive_ptr<const RemoteDatabase> db_,
-		    const string & term_)
-	: LeafPostList(term_),
-	  db(db_), started(false), pos(NULL), pos_end(NULL),
-	  lastdocid(0), lastwdf(0), termfreq(0)
-    {
-	termfreq = db->read_post_list(term, *this);
-    }
+		    const string & term_);
 
     /// Get number of documents indexed by this term.
     Xapian::doccount get_termfreq() const;
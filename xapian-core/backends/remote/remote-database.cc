@@ -56,6 +56,10 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
 	  cached_stats_valid(),
 	  mru_valstats(),
 	  mru_slot(Xapian::BAD_VALUENO),
+	  next_request_id(0),
+	  results_request_id(0),
+	  results_header_pending(false),
+	  results_items_pending(0),
 	  timeout(timeout_)
 {
 #ifndef __WIN32__
@@ -131,7 +135,9 @@ RemoteDatabase::open_term_list(Xapian::docid did) const
     // Ensure that total_length and doccount are up-to-date.
     if (!cached_stats_valid) update_stats();
 
-    send_message(MSG_TERMLIST, encode_length(did));
+    string request = encode_length(did);
+    request += encode_length(block_compression_supported() ? 1 : 0);
+    send_message(MSG_TERMLIST, request);
 
     string message;
     get_message(message, REPLY_DOCLENGTH);
@@ -148,15 +154,20 @@ RemoteDatabase::open_term_list(Xapian::docid did) const
 			    did));
     vector<NetworkTermListItem> & items = tlist->items;
 
+    string batch;
     char type;
     while ((type = get_message(message)) == REPLY_TERMLIST) {
+	unserialise_block(message.data(), message.data() + message.size(),
+			  batch);
+	p = batch.data();
+	p_end = p + batch.size();
 	NetworkTermListItem item;
-	p = message.data();
-	p_end = p + message.size();
-	item.wdf = decode_length(&p, p_end, false);
-	item.termfreq = decode_length(&p, p_end, false);
-	item.tname.assign(p, p_end);
-	items.push_back(item);
+	while (p != p_end) {
+	    item.wdf = decode_length(&p, p_end, false);
+	    item.termfreq = decode_length(&p, p_end, false);
+	    unserialise_term_after(&p, p_end, item.tname);
+	    items.push_back(item);
+	}
     }
     if (type != REPLY_DONE) {
 	throw Xapian::NetworkError("Bad message received", context);
@@ -171,7 +182,9 @@ RemoteDatabase::open_allterms(const string & prefix) const {
     // Ensure that total_length and doccount are up-to-date.
     if (!cached_stats_valid) update_stats();
 
-    send_message(MSG_ALLTERMS, prefix);
+    string request = encode_length(block_compression_supported() ? 1 : 0);
+    request += prefix;
+    send_message(MSG_ALLTERMS, request);
 
     AutoPtr<NetworkTermList> tlist(
 	new NetworkTermList(0, doccount,
@@ -179,15 +192,20 @@ RemoteDatabase::open_allterms(const string & prefix) const {
 			    0));
     vector<NetworkTermListItem> & items = tlist->items;
 
-    string message;
+    string message, batch;
     char type;
     while ((type = get_message(message)) == REPLY_ALLTERMS) {
+	unserialise_block(message.data(), message.data() + message.size(),
+			  batch);
+	const char * p = batch.data();
+	const char * p_end = p + batch.size();
 	NetworkTermListItem item;
-	const char * p = message.data();
-	const char * p_end = p + message.size();
-	item.termfreq = decode_length(&p, p_end, false);
-	item.tname.assign(p, p_end);
-	items.push_back(item);
+	item.wdf = 0;
+	while (p != p_end) {
+	    item.termfreq = decode_length(&p, p_end, false);
+	    unserialise_term_after(&p, p_end, item.tname);
+	    items.push_back(item);
+	}
     }
     if (type != REPLY_DONE) {
 	throw Xapian::NetworkError("Bad message received", context);
@@ -204,24 +222,30 @@ RemoteDatabase::open_post_list(const string &term) const
 }
 
 Xapian::doccount
-RemoteDatabase::read_post_list(const string &term, NetworkPostList & pl) const
+RemoteDatabase::read_post_list(const string &term, Xapian::docid first,
+			       NetworkPostList & pl) const
 {
-    send_message(MSG_POSTLIST, term);
+    string message = encode_length(first);
+    message += encode_length(pl.batch_bytes);
+    message += encode_length(block_compression_supported() ? 1 : 0);
+    message += term;
+    send_message(MSG_POSTLIST, message);
 
-    string message;
-    char type;
     get_message(message, REPLY_POSTLISTSTART);
 
     const char * p = message.data();
     const char * p_end = p + message.size();
     Xapian::doccount termfreq = decode_length(&p, p_end, false);
 
-    while ((type = get_message(message)) == REPLY_POSTLISTITEM) {
-	pl.append_posting(message);
-    }
-    if (type != REPLY_DONE) {
-	throw Xapian::NetworkError("Bad message received", context);
+    get_message(message, REPLY_POSTLISTITEM);
+    p = message.data();
+    p_end = p + message.size();
+    if (p == p_end) {
+	throw Xapian::NetworkError("Bad REPLY_POSTLISTITEM message received", context);
     }
+    pl.more = (*p++ != '\0');
+    pl.batch_last_did = decode_length(&p, p_end, false);
+    unserialise_block(p, p_end, pl.postings);
 
     return termfreq;
 }
@@ -301,6 +325,46 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
     return new RemoteDocument(this, did, doc_data, values);
 }
 
+void
+RemoteDatabase::open_documents(const vector<Xapian::docid> & dids,
+			       vector<Xapian::Document> & docs) const
+{
+    if (dids.empty()) return;
+
+    // The docids are in ascending order, so send the differences.
+    string message;
+    Xapian::docid prev = 0;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	Assert(*i > prev);
+	message += encode_length(*i - prev);
+	prev = *i;
+    }
+    send_message(MSG_DOCUMENTS, message);
+
+    // Each document is sent as for MSG_DOCUMENT, without the REPLY_DONE
+    // after each one.
+    string doc_data;
+    get_message(doc_data, REPLY_DOCDATA);
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	map<Xapian::valueno, string> values;
+	reply_type type;
+	while ((type = get_message(message)) == REPLY_VALUE) {
+	    const char * p = message.data();
+	    const char * p_end = p + message.size();
+	    Xapian::valueno slot = decode_length(&p, p_end, false);
+	    values.insert(make_pair(slot, string(p, p_end)));
+	}
+	docs.push_back(Xapian::Document(new RemoteDocument(this, *i, doc_data,
+							   values)));
+	reply_type expected = (i + 1 == dids.end()) ? REPLY_DONE : REPLY_DOCDATA;
+	if (type != expected) {
+	    throw Xapian::NetworkError("Bad message received", context);
+	}
+	swap(doc_data, message);
+    }
+}
+
 bool
 RemoteDatabase::update_stats(message_type msg_code) const
 {
@@ -520,6 +584,8 @@ RemoteDatabase::get_message(string &result, reply_type required_type) const
 void
 RemoteDatabase::send_message(message_type type, const string &message) const
 {
+    if (rare(results_header_pending || results_items_pending))
+	discard_results();
     double end_time = RealTime::end_time(timeout);
     link.send_message(static_cast<unsigned char>(type), message, end_time);
 }
@@ -618,22 +684,91 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
 				  Xapian::doccount check_at_least,
 				  const Xapian::Weight::Internal &stats)
 {
-    string message = encode_length(first);
+    // Discard any unread results from a previous match before we update
+    // the request id.
+    if (results_header_pending || results_items_pending) discard_results();
+    results_request_id = next_request_id++;
+
+    string message = encode_length(results_request_id);
+    message += encode_length(first);
     message += encode_length(maxitems);
     message += encode_length(check_at_least);
     message += serialise_stats(stats);
     send_message(MSG_GETMSET, message);
+    results_header_pending = true;
+}
+
+void
+RemoteDatabase::get_results_message(string & message,
+				    reply_type required_type) const
+{
+    get_message(message, required_type);
+    const char * p = message.data();
+    const char * p_end = p + message.size();
+    if (decode_length(&p, p_end, false) != results_request_id) {
+	throw Xapian::NetworkError("Results for unexpected request received");
+    }
+    message.erase(0, p - message.data());
+}
+
+void
+RemoteDatabase::discard_results() const
+{
+    string message;
+    if (results_header_pending) {
+	results_header_pending = false;
+	double end_time = RealTime::end_time(timeout);
+	int type = link.get_message(message, end_time);
+	// If the match failed on the server, no items will follow.
+	if (type == REPLY_EXCEPTION) return;
+	if (type != REPLY_RESULTS) {
+	    throw Xapian::NetworkError("Expecting reply type " +
+				       str(int(REPLY_RESULTS)) + ", got " +
+				       str(type));
+	}
+	const char * p = message.data();
+	const char * p_end = p + message.size();
+	if (decode_length(&p, p_end, false) != results_request_id) {
+	    throw Xapian::NetworkError("Results for unexpected request received");
+	}
+	results_items_pending = decode_length(&p, p_end, false);
+    }
+    while (results_items_pending) {
+	vector<Xapian::Internal::MSetItem> items;
+	get_results_message(message, REPLY_RESULTSITEMS);
+	unserialise_mset_items(message.data(), message.data() + message.size(),
+			       items);
+	if (items.size() > results_items_pending) {
+	    results_items_pending = 0;
+	    throw Xapian::NetworkError("Too many MSet items received");
+	}
+	results_items_pending -= items.size();
+    }
 }
 
 void
 RemoteDatabase::get_mset(Xapian::MSet &mset,
 			 const vector<Xapian::MatchSpy *> & matchspies)
 {
+    (void)get_mset_header(mset, matchspies);
+    while (get_mset_items(mset.internal->items)) { }
+}
+
+Xapian::doccount
+RemoteDatabase::get_mset_header(Xapian::MSet &mset,
+				const vector<Xapian::MatchSpy *> & matchspies)
+{
+    Assert(results_header_pending);
+    // If the server reports an exception, get_message() will throw it and
+    // there won't be any items to follow.
+    results_header_pending = false;
     string message;
-    get_message(message, REPLY_RESULTS);
+    get_results_message(message, REPLY_RESULTS);
     const char * p = message.data();
     const char * p_end = p + message.size();
 
+    results_items_pending = decode_length(&p, p_end, false);
+
     vector<Xapian::MatchSpy *>::const_iterator i;
     for (i = matchspies.begin(); i != matchspies.end(); ++i) {
 	if (p == p_end)
@@ -643,7 +778,27 @@ RemoteDatabase::get_mset(Xapian::MSet &mset,
 	p += len;
 	(*i)->merge_results(spyresults);
     }
-    mset = unserialise_mset(p, p_end);
+    mset = unserialise_mset_header(p, p_end);
+    mset.internal->items.reserve(results_items_pending);
+    return results_items_pending;
+}
+
+bool
+RemoteDatabase::get_mset_items(vector<Xapian::Internal::MSetItem> & items)
+{
+    if (results_items_pending == 0) return false;
+    string message;
+    get_results_message(message, REPLY_RESULTSITEMS);
+    size_t old_size = items.size();
+    unserialise_mset_items(message.data(), message.data() + message.size(),
+			   items);
+    size_t n = items.size() - old_size;
+    if (n == 0 || n > results_items_pending) {
+	results_items_pending = 0;
+	throw Xapian::NetworkError("Unexpected number of MSet items received");
+    }
+    results_items_pending -= n;
+    return true;
 }
 
 void
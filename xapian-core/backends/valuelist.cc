@@ -26,6 +26,27 @@ namespace Xapian {
 
 ValueIterator::Internal::~Internal() { }
 
+int
+ValueIterator::Internal::compare_value(const std::string & s) const
+{
+    return get_value().compare(s);
+}
+
+void
+ValueIterator::Internal::next_in_range(const std::string &,
+				       const std::string &)
+{
+    next();
+}
+
+void
+ValueIterator::Internal::skip_to_in_range(Xapian::docid did,
+					  const std::string &,
+					  const std::string &)
+{
+    skip_to(did);
+}
+
 bool
 ValueIterator::Internal::check(Xapian::docid did)
 {
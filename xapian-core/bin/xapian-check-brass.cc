@@ -24,14 +24,15 @@
 
 #include "xapian-check-brass.h"
 
-#include "bitstream.h"
-
 #include "internaltypes.h"
 
 #include "brass_check.h"
 #include "brass_cursor.h"
+#include "brass_positionlist.h"
+#include "brass_postlistblock.h"
 #include "brass_table.h"
 #include "brass_types.h"
+#include "brass_values.h"
 #include "pack.h"
 #include "valuestats.h"
 
@@ -48,6 +49,38 @@ is_user_metadata_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xc0';
 }
 
+/** Decode the body of a block-packed postlist chunk.
+ *
+ *  The entries are re-encoded with pack_uint() as they would be in a chunk
+ *  which isn't block-packed, so the same checks can be applied.
+ *
+ *  @return false if the body is corrupt.
+ */
+static bool
+unpack_packed_chunk(const char * pos, const char * end, string & entries)
+{
+    Xapian::docid dids[BRASS_POSTLIST_BLOCK_SIZE];
+    Xapian::termcount wdfs[BRASS_POSTLIST_BLOCK_SIZE];
+    // Work with docids relative to the first in the chunk, which is 1.
+    Xapian::docid prev_did = 0;
+    while (pos != end) {
+	Brass::PostlistBlockHeader hdr;
+	if (!Brass::unpack_postlist_block_header(&pos, end, hdr)) return false;
+	Brass::unpack_postlist_block(&pos, hdr, prev_did, dids, wdfs);
+	if (dids[hdr.size - 1] - prev_did != hdr.span) return false;
+	for (unsigned i = 0; i != hdr.size; ++i) {
+	    if (prev_did == 0) {
+		if (dids[i] != 1) return false;
+	    } else {
+		pack_uint(entries, dids[i] - prev_did - 1);
+	    }
+	    pack_uint(entries, wdfs[i]);
+	    prev_did = dids[i];
+	}
+    }
+    return true;
+}
+
 struct VStats : public ValueStats {
     Xapian::doccount freq_real;
 
@@ -77,6 +110,9 @@ check_brass_table(const char * tablename, string filename, int opts,
     if (strcmp(tablename, "postlist") == 0) {
 	// Now check the structure of each postlist in the table.
 	map<Xapian::valueno, VStats> valuestats;
+	// The lowest and highest values in each value chunk, for checking
+	// the chunk summaries against (which sort after all the chunks).
+	map<string, pair<string, string> > valuechunk_bounds;
 	string current_term;
 	Xapian::docid lastdid = 0;
 	Xapian::termcount termfreq = 0, collfreq = 0;
@@ -180,8 +216,10 @@ check_brass_table(const char * tablename, string filename, int opts,
 		    }
 		}
 
-		bool is_last_chunk;
-		if (!unpack_bool(&pos, end, &is_last_chunk)) {
+		bool is_last_chunk, is_packed;
+		if (pos == end ||
+		    !Brass::decode_chunk_flag(*pos++, &is_last_chunk,
+					      &is_packed)) {
 		    cout << "Failed to unpack last chunk flag for doclen" << endl;
 		    ++errors;
 		    continue;
@@ -193,6 +231,22 @@ check_brass_table(const char * tablename, string filename, int opts,
 		    continue;
 		}
 		lastdid += did;
+		Xapian::termcount max_doclen;
+		if (!unpack_uint(&pos, end, &max_doclen)) {
+		    cout << "Failed to unpack max doclen in chunk" << endl;
+		    ++errors;
+		    continue;
+		}
+		string unpacked;
+		if (is_packed) {
+		    if (!unpack_packed_chunk(pos, end, unpacked)) {
+			cout << "Bad block in block-packed doclen chunk" << endl;
+			++errors;
+			continue;
+		    }
+		    pos = unpacked.data();
+		    end = pos + unpacked.size();
+		}
 		bool bad = false;
 		while (true) {
 		    Xapian::termcount doclen;
@@ -203,6 +257,13 @@ check_brass_table(const char * tablename, string filename, int opts,
 			break;
 		    }
 
+		    if (doclen > max_doclen) {
+			cout << "document id " << did << ": length " << doclen
+			     << " > max length in chunk " << max_doclen
+			     << endl;
+			++errors;
+		    }
+
 		    if (did > db_last_docid) {
 			cout << "document id " << did << " in doclen stream "
 			     << "is larger than get_last_docid() "
@@ -328,59 +389,91 @@ check_brass_table(const char * tablename, string filename, int opts,
 		VStats & v = valuestats[slot];
 
 		cursor->read_tag();
-		p = cursor->current_tag.data();
-		end = p + cursor->current_tag.size();
-
-		while (true) {
-		    string value;
-		    if (!unpack_string(&p, end, value)) {
-			cout << "Failed to unpack value from chunk" << endl;
-			++errors;
-			break;
-		    }
-
-		    ++v.freq_real;
+		const string & chunk = cursor->current_tag;
+		pair<string, string> & bounds =
+		    valuechunk_bounds[Brass::make_valuesummary_key(slot, did)];
+
+		try {
+		    Brass::ValueChunkReader reader(chunk.data(), chunk.size(),
+						   did);
+		    Xapian::docid prev_did = 0;
+		    while (!reader.at_end()) {
+			did = reader.get_docid();
+			if (did <= prev_did) {
+			    cout << "docid overflowed in value chunk" << endl;
+			    ++errors;
+			    break;
+			}
+			prev_did = did;
 
-		    // FIXME: Cross-check that docid did has value slot (and
-		    // vice versa - that there's a value here if the slot entry
-		    // says so).
+			if (did > db_last_docid) {
+			    cout << "document id " << did << " in value chunk "
+				 << "is larger than get_last_docid() "
+				 << db_last_docid << endl;
+			    ++errors;
+			}
 
-		    // FIXME: Check if the bounds are tight?  Or is that better
-		    // as a separate tool which can also update the bounds?
-		    if (value < v.lower_bound) {
-			cout << "Value slot " << slot << " has value below "
-				"lower bound: '" << value << "' < '"
-			     << v.lower_bound << "'" << endl;
-			++errors;
-		    } else if (value > v.upper_bound) {
-			cout << "Value slot " << slot << " has value above "
-				"upper bound: '" << value << "' > '"
-			     << v.upper_bound << "'" << endl;
-			++errors;
-		    }
+			++v.freq_real;
+
+			// FIXME: Cross-check that docid did has value slot
+			// (and vice versa - that there's a value here if the
+			// slot entry says so).
+
+			// FIXME: Check if the bounds are tight?  Or is that
+			// better as a separate tool which can also update the
+			// bounds?
+			string value = reader.get_value();
+			if (bounds.first.empty() || value < bounds.first)
+			    bounds.first = value;
+			if (value > bounds.second) bounds.second = value;
+			if (value < v.lower_bound) {
+			    cout << "Value slot " << slot << " has value below "
+				    "lower bound: '" << value << "' < '"
+				 << v.lower_bound << "'" << endl;
+			    ++errors;
+			} else if (value > v.upper_bound) {
+			    cout << "Value slot " << slot << " has value above "
+				    "upper bound: '" << value << "' > '"
+				 << v.upper_bound << "'" << endl;
+			    ++errors;
+			}
 
-		    if (p == end) break;
-		    Xapian::docid delta;
-		    if (!unpack_uint(&p, end, &delta)) {
-			cout << "Failed to unpack docid delta from chunk" << endl;
-			++errors;
-			break;
+			reader.next();
 		    }
-		    Xapian::docid new_did = did + delta + 1;
-		    if (new_did <= did) {
-			cout << "docid overflowed in value chunk" << endl;
-			++errors;
-			break;
-		    }
-		    did = new_did;
+		} catch (const Xapian::DatabaseCorruptError & e) {
+		    cout << "Value chunk corrupt: " << e.get_msg() << endl;
+		    ++errors;
+		}
+		continue;
+	    }
 
-		    if (did > db_last_docid) {
-			cout << "document id " << did << " in value chunk "
-			     << "is larger than get_last_docid() "
-			     << db_last_docid << endl;
+	    if (key.size() >= 2 && key[0] == '\0' && key[1] == '\xd9') {
+		// Value stream chunk summary.
+		map<string, pair<string, string> >::iterator b;
+		b = valuechunk_bounds.find(key);
+		if (b == valuechunk_bounds.end()) {
+		    cout << "Value chunk summary with no value chunk" << endl;
+		    ++errors;
+		    continue;
+		}
+		cursor->read_tag();
+		string lower, upper;
+		try {
+		    Brass::decode_valuesummary(cursor->current_tag,
+					       lower, upper);
+		    if (lower != b->second.first || upper != b->second.second) {
+			cout << "Value chunk summary gives bounds '" << lower
+			     << "' and '" << upper << "' but the chunk has '"
+			     << b->second.first << "' and '"
+			     << b->second.second << "'" << endl;
 			++errors;
 		    }
+		} catch (const Xapian::DatabaseCorruptError & e) {
+		    cout << "Value chunk summary corrupt: " << e.get_msg()
+			 << endl;
+		    ++errors;
 		}
+		valuechunk_bounds.erase(b);
 		continue;
 	    }
 
@@ -472,8 +565,9 @@ check_brass_table(const char * tablename, string filename, int opts,
 		end = pos + cursor->current_tag.size();
 	    }
 
-	    bool is_last_chunk;
-	    if (!unpack_bool(&pos, end, &is_last_chunk)) {
+	    bool is_last_chunk, is_packed;
+	    if (pos == end ||
+		!Brass::decode_chunk_flag(*pos++, &is_last_chunk, &is_packed)) {
 		cout << "Failed to unpack last chunk flag" << endl;
 		++errors;
 		continue;
@@ -485,6 +579,22 @@ check_brass_table(const char * tablename, string filename, int opts,
 		continue;
 	    }
 	    lastdid += did;
+	    Xapian::termcount max_wdf;
+	    if (!unpack_uint(&pos, end, &max_wdf)) {
+		cout << "Failed to unpack max wdf in chunk" << endl;
+		++errors;
+		continue;
+	    }
+	    string unpacked;
+	    if (is_packed) {
+		if (!unpack_packed_chunk(pos, end, unpacked)) {
+		    cout << "Bad block in block-packed chunk" << endl;
+		    ++errors;
+		    continue;
+		}
+		pos = unpacked.data();
+		end = pos + unpacked.size();
+	    }
 	    bool bad = false;
 	    while (true) {
 		Xapian::termcount wdf;
@@ -497,6 +607,12 @@ check_brass_table(const char * tablename, string filename, int opts,
 		++tf;
 		cf += wdf;
 
+		if (wdf > max_wdf) {
+		    cout << "document id " << did << ": wdf " << wdf
+			 << " > max wdf in chunk " << max_wdf << endl;
+		    ++errors;
+		}
+
 		if (pos == end) break;
 
 		Xapian::docid inc;
@@ -542,6 +658,12 @@ check_brass_table(const char * tablename, string filename, int opts,
 	    ++errors;
 	}
 
+	if (!valuechunk_bounds.empty()) {
+	    cout << valuechunk_bounds.size() << " value chunks have no summary"
+		 << endl;
+	    ++errors;
+	}
+
 	map<Xapian::valueno, VStats>::const_iterator i;
 	for (i = valuestats.begin(); i != valuestats.end(); ++i) {
 	    if (i->second.freq != i->second.freq_real) {
@@ -744,39 +866,30 @@ check_brass_table(const char * tablename, string filename, int opts,
 
 	    cursor->read_tag();
 
-	    const string & data = cursor->current_tag;
-	    pos = data.data();
-	    end = pos + data.size();
-
-	    Xapian::termpos pos_last;
-	    if (!unpack_uint(&pos, end, &pos_last)) {
-		cout << tablename << " table: Position list data corrupt" << endl;
-		++errors;
-		continue;
-	    }
-	    if (pos == end) {
-		// Special case for single entry position list.
-	    } else {
-		// Skip the header we just read.
-		BitReader rd(data, pos - data.data());
-		Xapian::termpos pos_first = rd.decode(pos_last);
-		Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
-		vector<Xapian::termpos> positions;
-		positions.resize(pos_size);
-		positions[0] = pos_first;
-		positions.back() = pos_last;
-		rd.decode_interpolative(positions, 0, pos_size - 1);
-		vector<Xapian::termpos>::const_iterator current_pos = positions.begin();
-		Xapian::termpos lastpos = *current_pos++;
-		while (current_pos != positions.end()) {
-		    Xapian::termpos termpos = *current_pos++;
-		    if (termpos <= lastpos) {
+	    BrassPositionList poslist;
+	    try {
+		poslist.read_data(cursor->current_tag);
+		Xapian::termcount count = 0;
+		Xapian::termpos lastpos = 0;
+		for (poslist.next(); !poslist.at_end(); poslist.next()) {
+		    Xapian::termpos termpos = poslist.get_position();
+		    if (count && termpos <= lastpos) {
 			cout << tablename << " table: Positions not strictly monotonically increasing" << endl;
 			++errors;
 			break;
 		    }
 		    lastpos = termpos;
+		    ++count;
+		}
+		if (poslist.at_end() && count != poslist.get_size()) {
+		    cout << tablename << " table: Position list has " << count
+			 << " entries but claims to have "
+			 << poslist.get_size() << endl;
+		    ++errors;
 		}
+	    } catch (const Xapian::DatabaseCorruptError &) {
+		cout << tablename << " table: Position list data corrupt" << endl;
+		++errors;
 	    }
 	}
     } else {
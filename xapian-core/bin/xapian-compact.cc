@@ -49,6 +49,7 @@ static void show_usage() {
 "  -m, --multipass   If merging more than 3 databases, merge the postlists in\n"
 "                    multiple passes (which is generally faster but requires\n"
 "                    more disk space for temporary files)\n"
+"  -j, --threads=NUM Merge tables in parallel using NUM threads (default 1)\n"
 "      --no-renumber Preserve the numbering of document ids (useful if you have\n"
 "                    external references to them, or have set them to match\n"
 "                    unique ids from an external source).  Currently this\n"
@@ -61,11 +62,15 @@ static void show_usage() {
 class MyCompactor : public Xapian::Compactor {
     bool quiet;
 
+    bool parallel;
+
   public:
-    MyCompactor() : quiet(false) { }
+    MyCompactor() : quiet(false), parallel(false) { }
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    void set_parallel(bool parallel_) { parallel = parallel_; }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -79,10 +84,14 @@ MyCompactor::set_status(const string & table, const string & status)
 {
     if (quiet)
 	return;
-    if (!status.empty())
-	cout << '\r' << table << ": " << status << endl;
-    else
-	cout << table << " ..." << flush;
+    if (status.empty()) {
+	// Tables merged in parallel would overwrite each other's progress
+	// line, so in that case just report when each table is done.
+	if (!parallel) cout << table << " ..." << flush;
+    } else {
+	if (!parallel) cout << '\r';
+	cout << table << ": " << status << endl;
+    }
 }
 
 string
@@ -103,11 +112,12 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
 int
 main(int argc, char **argv)
 {
-    const char * opts = "b:nFmq";
+    const char * opts = "b:nFmj:q";
     const struct option long_opts[] = {
 	{"fuller",	no_argument, 0, 'F'},
 	{"no-full",	no_argument, 0, 'n'},
 	{"multipass",	no_argument, 0, 'm'},
+	{"threads",	required_argument, 0, 'j'},
 	{"blocksize",	required_argument, 0, 'b'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
 	{"quiet",	no_argument, 0, 'q'},
@@ -147,6 +157,19 @@ main(int argc, char **argv)
 	    case 'm':
 		compactor.set_multipass(true);
 		break;
+	    case 'j': {
+		char *p;
+		unsigned long threads = strtoul(optarg, &p, 10);
+		if (*p || threads == 0 || threads > 1024) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be between 1 and 1024"
+			 << endl;
+		    exit(1);
+		}
+		compactor.set_threads(threads);
+		compactor.set_parallel(threads > 1);
+		break;
+	    }
 	    case OPT_NO_RENUMBER:
 		compactor.set_renumber(false);
 		break;
@@ -54,13 +54,14 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 
-static const char * opts = "I:p:a:i:t:oqw";
+static const char * opts = "I:p:a:i:t:T:oqw";
 static const struct option long_opts[] = {
     {"interface",	required_argument,	0, 'I'},
     {"port",		required_argument,	0, 'p'},
     {"active-timeout",	required_argument,	0, 'a'},
     {"idle-timeout",	required_argument,	0, 'i'},
     {"timeout",		required_argument,	0, 't'},
+    {"threads",		required_argument,	0, 'T'},
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
@@ -78,6 +79,9 @@ static void show_usage() {
 "  --idle-timeout MSECS    set timeout for idle connections (default " << MSECS_IDLE_TIMEOUT_DEFAULT << "ms)\n"
 "  --active-timeout MSECS  set timeout for active connections (default " << MSECS_ACTIVE_TIMEOUT_DEFAULT << "ms)\n"
 "  --timeout MSECS         set both timeout values\n"
+"  --threads NUM           serve connections with a pool of NUM threads which\n"
+"                          share open databases, rather than forking for each\n"
+"                          connection (not with --writable)\n"
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
@@ -91,6 +95,7 @@ int main(int argc, char **argv) {
     double active_timeout = MSECS_ACTIVE_TIMEOUT_DEFAULT * 1e-3;
     double idle_timeout   = MSECS_IDLE_TIMEOUT_DEFAULT * 1e-3;
 
+    unsigned threads = 0;
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
@@ -121,6 +126,10 @@ int main(int argc, char **argv) {
 	    case 't':
 		active_timeout = idle_timeout = atoi(optarg) * 1e-3;
 		break;
+	    case 'T':
+		threads = atoi(optarg);
+		if (threads == 0) syntax_error = true;
+		break;
 	    case 'o':
 		one_shot = true;
 		break;
@@ -151,6 +160,11 @@ int main(int argc, char **argv) {
 	exit(1);
     }
 
+    if (writable && threads) {
+	cerr << "Error: '--threads' can't be used with '--writable'." << endl;
+	exit(1);
+    }
+
     try {
 	vector<string> dbnames;
 	// Try to open the database(s) so we report problems now instead of
@@ -185,6 +199,8 @@ int main(int argc, char **argv) {
 
 	if (one_shot) {
 	    server.run_once();
+	} else if (threads) {
+	    server.run_threaded(threads);
 	} else {
 	    server.run();
 	}
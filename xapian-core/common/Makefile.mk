@@ -6,6 +6,7 @@ noinst_HEADERS +=\
 	common/const_database_wrapper.h\
 	common/contiguousalldocspostlist.h\
 	common/database.h\
+	common/databasepool.h\
 	common/databasereplicator.h\
 	common/debuglog.h\
 	common/document.h\
@@ -24,6 +25,7 @@ noinst_HEADERS +=\
 	common/multialltermslist.h\
 	common/multimatch.h\
 	common/multivaluelist.h\
+	common/mutex.h\
 	common/noreturn.h\
 	common/omassert.h\
 	common/omenquireinternal.h\
@@ -32,6 +34,7 @@ noinst_HEADERS +=\
 	common/output.h\
 	common/positionlist.h\
 	common/pack.h\
+	common/phrasepairs.h\
 	common/postlist.h\
 	common/pretty.h\
 	common/progclient.h\
@@ -67,7 +70,9 @@ noinst_HEADERS +=\
 	common/tcpclient.h\
 	common/tcpserver.h\
 	common/termlist.h\
+	common/threadpool.h\
 	common/unaligned.h\
+	common/unordered_map.h\
 	common/utils.h\
 	common/valuelist.h\
 	common/valuestats.h\
@@ -95,6 +100,7 @@ lib_src +=\
 	common/socket_utils.cc\
 	common/str.cc\
 	common/stringutils.cc\
+	common/threadpool.cc\
 	common/utils.cc
 
 if USE_WIN32_UUID_API
@@ -69,6 +69,9 @@ class XAPIAN_VISIBILITY_DEFAULT BitReader {
     BitReader(const std::string &buf_, size_t skip)
 	: buf(buf_, skip), idx(0), n_bits(0), acc(0) { }
 
+    BitReader(const std::string &buf_, size_t skip, size_t len)
+	: buf(buf_, skip, len), idx(0), n_bits(0), acc(0) { }
+
     Xapian::termpos decode(Xapian::termpos outof);
 
     // Check all the data has been read.  Because it'll be zero padded
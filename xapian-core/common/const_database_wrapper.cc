@@ -193,15 +193,10 @@ ConstDatabaseWrapper::open_metadata_keylist(const std::string &prefix) const
 }
 
 void
-ConstDatabaseWrapper::request_document(Xapian::docid did) const
+ConstDatabaseWrapper::open_documents(const vector<Xapian::docid> & dids,
+				     vector<Xapian::Document> & docs) const
 {
-    return realdb->request_document(did);
-}
-
-Xapian::Document::Internal *
-ConstDatabaseWrapper::collect_document(Xapian::docid did) const
-{
-    return realdb->collect_document(did);
+    return realdb->open_documents(dids, docs);
 }
 
 string
@@ -210,6 +205,12 @@ ConstDatabaseWrapper::get_revision_info() const
     return realdb->get_revision_info();
 }
 
+bool
+ConstDatabaseWrapper::has_uncommitted_changes() const
+{
+    return realdb->has_uncommitted_changes();
+}
+
 string
 ConstDatabaseWrapper::get_uuid() const
 {
@@ -83,9 +83,10 @@ class ConstDatabaseWrapper : public Xapian::Database::Internal {
     TermList * open_synonym_keylist(const string & prefix) const;
     string get_metadata(const string & key) const;
     TermList * open_metadata_keylist(const std::string &prefix) const;
-    void request_document(Xapian::docid did) const;
-    Xapian::Document::Internal * collect_document(Xapian::docid did) const;
+    void open_documents(const std::vector<Xapian::docid> & dids,
+			std::vector<Xapian::Document> & docs) const;
     string get_revision_info() const;
+    bool has_uncommitted_changes() const;
     string get_uuid() const;
     void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 
@@ -79,6 +79,11 @@ class ContiguousAllDocsPostList : public LeafPostList {
     /// Skip ahead to next document with docid >= target.
     PostList * skip_to(Xapian::docid target, Xapian::weight w_min);
 
+    /// Read a batch of entries, starting with the current one.
+    Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+			       Xapian::termcount * wdfs,
+			       Xapian::termcount * doclens);
+
     /// Return true if and only if we're off the end of the list.
     bool at_end() const;
 
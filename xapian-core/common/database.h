@@ -25,6 +25,7 @@
 #define OM_HGUARD_DATABASE_H
 
 #include <string>
+#include <vector>
 
 #include "internaltypes.h"
 
@@ -494,6 +495,15 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  See WritableDatabase::add_documents() for more information.
+	 *
+	 *  The default implementation calls add_document() for each document.
+	 */
+	virtual Xapian::docid add_documents(const std::vector<Xapian::Document> & documents,
+					    unsigned threads);
+
 	/** Delete a document in the database.
 	 *
 	 *  See WritableDatabase::delete_document() for more information.
@@ -520,20 +530,20 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	virtual Xapian::docid replace_document(const string & unique_term,
 					       const Xapian::Document & document);
 
-	/** Request and later collect a document from the database.
-	 *  Multiple documents can be requested with request_document(),
-	 *  and then collected with collect_document().  Allows the backend
-	 *  to optimise (e.g. the remote backend can start requests for all
-	 *  the documents so they fetch in parallel).
+	/** Open several documents from the database.
+	 *
+	 *  This is used to read the documents in an MSet, so the documents
+	 *  are known to exist and are opened lazily, as by
+	 *  open_document(did, true).  Backends can override this to read
+	 *  them more efficiently than one at a time (e.g. the remote backend
+	 *  fetches them all with a single message).
 	 *
-	 *  If a backend doesn't support this, request_document() can be a
-	 *  no-op and collect_document() the same as open_document().
+	 *  @param dids	The document ids to open, in ascending order.
+	 *  @param docs	The documents are appended to this, in the same order
+	 *		as @a dids.
 	 */
-	//@{
-	virtual void request_document(Xapian::docid /*did*/) const;
-
-	virtual Xapian::Document::Internal * collect_document(Xapian::docid did) const;
-	//@}
+	virtual void open_documents(const std::vector<Xapian::docid> & dids,
+				    std::vector<Xapian::Document> & docs) const;
 
 	/** Write a set of changesets to a file descriptor.
 	 *
@@ -548,6 +558,15 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	/// Get a string describing the current revision of the database.
 	virtual string get_revision_info() const;
 
+	/** Return true if there are modifications which haven't been
+	 *  committed.
+	 *
+	 *  These are visible to searches but not reflected by
+	 *  get_revision_info().  The default implementation returns false,
+	 *  which is correct for read-only databases.
+	 */
+	virtual bool has_uncommitted_changes() const;
+
 	/** Get a UUID for the database.
 	 *
 	 *  The UUID will persist for the lifetime of the database.
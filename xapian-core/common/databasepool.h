@@ -0,0 +1,121 @@
+/** @file databasepool.h
+ * @brief A pool of open read-only databases shared between connections.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DATABASEPOOL_H
+#define XAPIAN_INCLUDED_DATABASEPOOL_H
+
+#include <xapian/database.h>
+#include <xapian/visibility.h>
+
+#include "mutex.h"
+
+#include <list>
+#include <string>
+#include <vector>
+
+/** A pool of open read-only databases shared between connections.
+ *
+ *  A Xapian::Database object can only be used by one thread at once, so
+ *  the pool hands out an object for the duration of each operation, and it
+ *  is returned for reuse afterwards.  This means the work of opening the
+ *  databases is only done once per object, not once per connection.
+ *
+ *  A connection should see a consistent revision of the databases until it
+ *  asks to reopen, so each object in the pool is labelled with the revision
+ *  it has open.  If no object at the revision a connection wants is free,
+ *  a new one is opened, and if that has moved on to a newer revision then
+ *  DatabaseModifiedError is thrown, just as if the connection had its own
+ *  Database object and the revision it was reading had been discarded.
+ */
+class XAPIAN_VISIBILITY_DEFAULT DatabasePool {
+    /// Don't allow assignment.
+    void operator=(const DatabasePool &);
+
+    /// Don't allow copying.
+    DatabasePool(const DatabasePool &);
+
+    /// An open database which isn't in use.
+    struct Entry {
+	Xapian::Database * db;
+
+	std::string revision;
+
+	Entry(Xapian::Database * db_, const std::string & revision_)
+	    : db(db_), revision(revision_) { }
+    };
+
+    /// Paths to the databases to open.
+    const std::vector<std::string> dbpaths;
+
+    /// The maximum number of unused databases to keep open.
+    size_t max_free;
+
+    /// Protects free_dbs.
+    Mutex mutex;
+
+    /// Unused databases, most recently released first.
+    std::list<Entry> free_dbs;
+
+    /// Open a new Database object for dbpaths.
+    Xapian::Database * open_database() const;
+
+    /** Return a label for the revision @a db has open.
+     *
+     *  This is empty if any of the sub-databases don't support reporting
+     *  their revision, in which case we just use whichever object is free.
+     */
+    static std::string get_revision(const Xapian::Database & db);
+
+  public:
+    /** Create a pool.
+     *
+     *  @param dbpaths_	The path(s) to the database(s) to open.
+     *  @param max_free_	The maximum number of unused database objects to
+     *			keep open.  This should be the number of threads
+     *			which may be using the pool at once.
+     */
+    DatabasePool(const std::vector<std::string> & dbpaths_, size_t max_free_);
+
+    /// Close all the unused databases.
+    ~DatabasePool();
+
+    /** Get a database object to use.
+     *
+     *  @param revision	If @a latest is false, the revision wanted, as
+     *			returned by an earlier call.  Set to the revision of
+     *			the object returned.
+     *  @param latest	If true, return an object open at the latest
+     *			available revision.
+     *
+     *  @exception Xapian::DatabaseModifiedError if @a revision is no longer
+     *		   available.
+     */
+    Xapian::Database * acquire(std::string & revision, bool latest);
+
+    /** Return a database object which acquire() returned.
+     *
+     *  @param db	The object to return, which must not be used again.
+     *  @param revision	The revision acquire() reported for @a db.
+     */
+    void release(Xapian::Database * db, const std::string & revision);
+
+    /// A description of the databases, for use in error messages.
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_DATABASEPOOL_H
@@ -30,8 +30,13 @@
 
 #include "xapian/weight.h"
 
+class ShardMatch;
+
 class MultiMatch
 {
+	/// ShardMatch uses a MultiMatch for each sub-database it runs.
+	friend class ShardMatch;
+
     private:
 	/// Vector of the items.
 	std::vector<Xapian::Internal::intrusive_ptr<SubMatch> > leaves;
@@ -56,6 +61,9 @@ class MultiMatch
 
 	bool sort_value_forward;
 
+	/// The number of threads to match sub-databases in parallel with.
+	unsigned match_threads;
+
 	/// ErrorHandler
 	Xapian::ErrorHandler * errorhandler;
 
@@ -79,6 +87,21 @@ class MultiMatch
 	 */
         Xapian::weight getorrecalc_maxweight(PostList *pl);
 
+	/** Does query @a q use a PostingSource?
+	 *
+	 *  We don't match in parallel if so, as a PostingSource may not be
+	 *  thread-safe (and one which can't be cloned is shared by all the
+	 *  sub-databases).
+	 */
+	static bool uses_posting_source(const Xapian::Query::Internal * q);
+
+	/** Construct a matcher for one sub-database of @a parent.
+	 *
+	 *  This is used when matching sub-databases in parallel, so that each
+	 *  has its own recalculate_w_max flag for its postlists to set.
+	 */
+	MultiMatch(const MultiMatch & parent, Xapian::doccount shard);
+
 	/// Copying is not permitted.
 	MultiMatch(const MultiMatch &);
 
@@ -92,6 +115,8 @@ class MultiMatch
 	 *  @param query     The query
 	 *  @param qlen      The query length
 	 *  @param omrset    The relevance set (or NULL for no RSet)
+	 *  @param match_threads_ The number of threads to match sub-databases
+	 *		     in parallel with (0 or 1 for a serial match).
 	 *  @param errorhandler Errorhandler object
 	 *  @param stats     The stats object to add our stats to.
 	 *  @param wtscheme  Weighting scheme
@@ -111,6 +136,7 @@ class MultiMatch
 		   Xapian::valueno sort_key_,
 		   Xapian::Enquire::Internal::sort_setting sort_by_,
 		   bool sort_value_forward_,
+		   unsigned match_threads_,
 		   Xapian::ErrorHandler * errorhandler,
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
@@ -63,6 +63,9 @@ class MultiValueList : public ValueList {
     /// Return the value at the current position.
     std::string get_value() const;
 
+    /// Compare the value at the current position with @a s.
+    int compare_value(const std::string & s) const;
+
     /// Return the value slot for the current position/this iterator.
     Xapian::valueno get_valueno() const;
 
@@ -0,0 +1,89 @@
+/** @file mutex.h
+ * @brief Minimal portable mutex wrapper.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MUTEX_H
+#define XAPIAN_INCLUDED_MUTEX_H
+
+// Xapian objects aren't thread-safe in general, but separate Database objects
+// may be used from different threads, so any state they share behind the
+// scenes needs to be protected.  If we don't know how to lock on a platform
+// then these classes are no-ops, which is fine for single-threaded use.
+
+#if defined __WIN32__ || defined __CYGWIN__
+# include "safewindows.h"
+#elif defined HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+/// A non-recursive mutex.
+class Mutex {
+    /// Don't allow copying.
+    Mutex(const Mutex &);
+
+    /// Don't allow assignment.
+    void operator=(const Mutex &);
+
+#if defined __WIN32__ || defined __CYGWIN__
+    CRITICAL_SECTION cs;
+#elif defined HAVE_PTHREAD
+    pthread_mutex_t mutex;
+#endif
+
+  public:
+#if defined __WIN32__ || defined __CYGWIN__
+    Mutex() { InitializeCriticalSection(&cs); }
+
+    ~Mutex() { DeleteCriticalSection(&cs); }
+
+    void lock() { EnterCriticalSection(&cs); }
+
+    void unlock() { LeaveCriticalSection(&cs); }
+#elif defined HAVE_PTHREAD
+    Mutex() { (void)pthread_mutex_init(&mutex, NULL); }
+
+    ~Mutex() { (void)pthread_mutex_destroy(&mutex); }
+
+    void lock() { (void)pthread_mutex_lock(&mutex); }
+
+    void unlock() { (void)pthread_mutex_unlock(&mutex); }
+#else
+    Mutex() { }
+
+    void lock() { }
+
+    void unlock() { }
+#endif
+};
+
+/// Hold a Mutex for the lifetime of this object.
+class MutexLock {
+    /// Don't allow copying.
+    MutexLock(const MutexLock &);
+
+    /// Don't allow assignment.
+    void operator=(const MutexLock &);
+
+    Mutex & mutex;
+
+  public:
+    explicit MutexLock(Mutex & mutex_) : mutex(mutex_) { mutex.lock(); }
+
+    ~MutexLock() { mutex.unlock(); }
+};
+
+#endif // XAPIAN_INCLUDED_MUTEX_H
@@ -28,6 +28,7 @@
 #include "xapian/database.h"
 #include "xapian/document.h"
 #include "xapian/enquire.h"
+#include "xapian/msetcache.h"
 #include "xapian/query.h"
 #include "xapian/keymaker.h"
 
@@ -129,6 +130,16 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 	/// Assignment not allowed
 	void operator=(const Internal &);
 
+	/** Build the keys to look up a result in the cache.
+	 *
+	 *  @return false if the result of this search shouldn't be cached.
+	 */
+	bool get_cache_key(Xapian::doccount first, Xapian::doccount maxitems,
+			   Xapian::doccount check_at_least,
+			   const RSet *omrset, const MatchDecider *mdecider,
+			   string & dbkey, string & revision,
+			   string & key) const;
+
     public:
 	typedef enum { REL, VAL, VAL_REL, REL_VAL } sort_setting;
 
@@ -142,6 +153,8 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	Xapian::weight weight_cutoff;
 
+	unsigned match_threads;
+
 	Xapian::valueno sort_key;
 	sort_setting sort_by;
 	bool sort_value_forward;
@@ -161,16 +174,22 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	vector<MatchSpy *> spies;
 
+	/// The cache of results to use (NULL if not using one).
+	Xapian::Internal::intrusive_ptr<MSetCache::Internal> cache;
+
 	Internal(const Xapian::Database &databases, ErrorHandler * errorhandler_);
 	~Internal();
 
-	/** Request a document from the database.
-	 */
-	void request_doc(const Xapian::Internal::MSetItem &item) const;
-
-	/** Read a previously requested document from the database.
+	/** Read documents from the database.
+	 *
+	 *  The documents are read from each sub-database in a single batch,
+	 *  in ascending docid order.
+	 *
+	 *  @param dids	The document ids to read.
+	 *  @param docs	Set to the documents, in the same order as @a dids.
 	 */
-	Xapian::Document read_doc(const Xapian::Internal::MSetItem &item) const;
+	void read_docs(const vector<Xapian::docid> & dids,
+		       vector<Xapian::Document> & docs) const;
 
 	void set_query(const Query & query_, termcount qlen_);
 	const Query & get_query();
@@ -196,17 +215,9 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 	double percent_factor;
 
     private:
-	/** The set of documents which have been requested but not yet
-	 *  collected.
-	 */
-	mutable set<Xapian::doccount> requested_docs;
-
 	/// Cache of documents, indexed by MSet index.
 	mutable map<Xapian::doccount, Xapian::Document> indexeddocs;
 
-	/// Read and cache the documents so far requested.
-	void read_docs() const;
-
 	/// Copy not allowed
 	Internal(const Internal &);
 	/// Assignment not allowed
@@ -307,6 +318,12 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 	string get_description() const;
 
 	/** Fetch items specified into the document cache.
+	 *
+	 *  Any which aren't already cached are read in a single batch.
+	 *
+	 *  @param first	Index of the first item to fetch (0 for the first
+	 *			item in the MSet).
+	 *  @param last		Index of the last item to fetch.
 	 */
 	void fetch_items(Xapian::doccount first, Xapian::doccount last) const;
 };
@@ -0,0 +1,73 @@
+/** @file phrasepairs.h
+ * @brief Terms indexing adjacent pairs of words, used to speed up phrases.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PHRASEPAIRS_H
+#define XAPIAN_INCLUDED_PHRASEPAIRS_H
+
+#include <string>
+
+/** Term added to every document indexed with TermGenerator::FLAG_PHRASE_PAIRS.
+ *
+ *  If every document in a database has this term, the matcher can rely on
+ *  pair terms being present.  It's also the prefix of the pair terms.
+ *
+ *  A byte of \xff can't start a UTF-8 sequence, so no term generated from
+ *  text (by TermGenerator or QueryParser) can clash with this.
+ */
+#define PHRASE_PAIRS_MARKER "\xff"
+
+/// Separates the two terms in a pair term.
+#define PHRASE_PAIRS_SEPARATOR ' '
+
+/** The longest pair term we generate.
+ *
+ *  This matches MAX_SAFE_TERM_LENGTH in the disk backends - a longer term
+ *  would make add_document() throw.
+ */
+#define PHRASE_PAIRS_MAX_LENGTH 245
+
+/** Check if the pair term for @a first and @a second would be too long.
+ *
+ *  TermGenerator doesn't index such pairs, so the matcher mustn't look for
+ *  them.
+ */
+inline bool
+phrase_pair_too_long(const std::string & first, const std::string & second)
+{
+    return (sizeof(PHRASE_PAIRS_MARKER) - 1) + first.size() + 1 +
+	second.size() > PHRASE_PAIRS_MAX_LENGTH;
+}
+
+/** Make the pair term for @a first immediately followed by @a second.
+ *
+ *  The pair term is ambiguous if @a first or @a second contain
+ *  PHRASE_PAIRS_SEPARATOR, which TermGenerator never generates.
+ */
+inline std::string
+make_phrase_pair_term(const std::string & first, const std::string & second)
+{
+    std::string result(PHRASE_PAIRS_MARKER);
+    result.reserve(result.size() + first.size() + 1 + second.size());
+    result += first;
+    result += PHRASE_PAIRS_SEPARATOR;
+    result += second;
+    return result;
+}
+
+#endif // XAPIAN_INCLUDED_PHRASEPAIRS_H
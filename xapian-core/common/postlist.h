@@ -180,6 +180,17 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
     virtual Internal * check(Xapian::docid did, Xapian::weight w_min,
 			     bool &valid);
 
+    /** Hint that skip_to() is likely to be called soon with @a did.
+     *
+     *  This allows a subclass to start reading the data it will need in the
+     *  background, so that when several postlists are skipped one after
+     *  another (as MultiAndPostList does) their reads can overlap.  It
+     *  doesn't change the current position.
+     *
+     *  The default implementation does nothing.
+     */
+    virtual void prefetch_skip_to(Xapian::docid did);
+
     /** Advance the current position to the next document in the postlist.
      *
      *  Any weight contribution is acceptable.
@@ -192,6 +203,26 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
      */
     Internal * skip_to(Xapian::docid did) { return skip_to(did, 0.0); }
 
+    /** Read a batch of entries, starting with the current one.
+     *
+     *  Stores the docids (and the wdfs and document lengths, unless
+     *  @a wdfs or @a doclens is NULL) of up to @a n entries starting at the
+     *  current position, then advances past them, as if next() had been
+     *  called after each.
+     *
+     *  Backends which decode postings in blocks can override this to avoid
+     *  the overhead of a virtual call per entry.  The default implementation
+     *  just calls get_docid(), get_wdf(), get_doclength() and next().  It
+     *  mustn't be used on a PostList which might prune.
+     *
+     *  @return The number of entries read, which is less than @a n only if
+     *	    the end of the list was reached.
+     */
+    virtual Xapian::doccount get_batch(Xapian::doccount n,
+				       Xapian::docid * dids,
+				       Xapian::termcount * wdfs,
+				       Xapian::termcount * doclens);
+
     /// Count the number of leaf subqueries which match at the current position.
     virtual Xapian::termcount count_matching_subqs() const;
 
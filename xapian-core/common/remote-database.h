@@ -86,6 +86,33 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /// The request id to use for the next MSG_GETMSET.
+    unsigned next_request_id;
+
+    /** The request id of the results we're currently reading.
+     *
+     *  Replies to MSG_GETMSET are tagged with the request id so that we can
+     *  check they're for the match we think they are.
+     */
+    mutable unsigned results_request_id;
+
+    /// Is REPLY_RESULTS for results_request_id still to be read?
+    mutable bool results_header_pending;
+
+    /// The number of MSet items for results_request_id still to be read.
+    mutable Xapian::doccount results_items_pending;
+
+    /** Read and discard the rest of the current results.
+     *
+     *  The match may not need all the MSet items (or may have been
+     *  abandoned because of an exception), so we discard any unread
+     *  items before sending the next message.
+     */
+    void discard_results() const;
+
+    /// Read a reply message tagged with results_request_id.
+    void get_results_message(string & message, reply_type required_type) const;
+
     bool update_stats(message_type msg_code = MSG_UPDATE) const;
 
   protected:
@@ -178,6 +205,23 @@ class RemoteDatabase : public Xapian::Database::Internal {
     void get_mset(Xapian::MSet &mset,
 		  const vector<Xapian::MatchSpy *> & matchspies);
 
+    /** Get the MSet from the remote server without its items.
+     *
+     *  The items can then be read as they're needed with get_mset_items().
+     *
+     *  @return The number of items in the MSet.
+     */
+    Xapian::doccount get_mset_header(Xapian::MSet &mset,
+				     const vector<Xapian::MatchSpy *> & matchspies);
+
+    /** Read the next batch of MSet items from the remote server.
+     *
+     *  @param items	The items read are appended to this vector.
+     *
+     *  @return false if all the items have already been read.
+     */
+    bool get_mset_items(vector<Xapian::Internal::MSetItem> & items);
+
     /// Get remote metadata key list.
     TermList * open_metadata_keylist(const std::string & prefix) const;
 
@@ -195,7 +239,16 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     LeafPostList * open_post_list(const string & tname) const;
 
-    Xapian::doccount read_post_list(const string &term, NetworkPostList & pl) const;
+    /** Fetch a batch of postings for a NetworkPostList.
+     *
+     *  @param term	The term.
+     *  @param first	Fetch postings from this docid onwards.
+     *  @param pl	The postlist to store the batch in.
+     *
+     *  @return		The term frequency of @a term.
+     */
+    Xapian::doccount read_post_list(const string &term, Xapian::docid first,
+				    NetworkPostList & pl) const;
 
     PositionList * open_position_list(Xapian::docid did,
 				      const string & tname) const;
@@ -203,6 +256,10 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /// Get several remote documents with a single message.
+    void open_documents(const std::vector<Xapian::docid> & dids,
+			std::vector<Xapian::Document> & docs) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
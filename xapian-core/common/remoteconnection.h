@@ -166,6 +166,14 @@ class RemoteConnection {
      */
     bool ready_to_read() const;
 
+    /** Is there input which has already been read from fdin?
+     *
+     *  Unlike ready_to_read(), this doesn't wait or check fdin, so it can
+     *  be used to see if more messages need processing before waiting for
+     *  fdin to become readable.
+     */
+    bool input_buffered() const { return !buffer.empty(); }
+
     /** Check what the next message type is.
      *
      *  This must not be called after a call to get_message_chunked() until
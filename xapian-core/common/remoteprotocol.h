@@ -45,7 +45,9 @@
 // 34: 1.1.4 Support for metadata over with remote databases.
 // 35: 1.1.5 Support for add_spelling() and remove_spelling().
 // 35.1: 1.2.4 Support for metadata_keys_begin().
-// 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, and more...
+// 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, MSet items sent in
+//     batches after REPLY_RESULTS, postlists fetched in batches, termlists
+//     sent in compressed batches, MSG_DOCUMENTS added, and more...
 #define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 36
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
@@ -84,6 +86,7 @@ enum message_type {
     MSG_GETMSET,		// Get MSet
     MSG_SHUTDOWN,		// Shutdown
     MSG_METADATAKEYLIST,	// Iterator for metadata keys
+    MSG_DOCUMENTS,		// Get several Documents
     MSG_MAX
 };
 
@@ -110,6 +113,7 @@ enum reply_type {
     REPLY_RESULTS,		// Results (MSet)
     REPLY_METADATA,		// Metadata
     REPLY_METADATAKEYLIST,	// Iterator for metadata keys
+    REPLY_RESULTSITEMS,		// Batch of items in Results (MSet)
     REPLY_MAX
 };
 
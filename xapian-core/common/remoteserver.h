@@ -30,6 +30,8 @@
 
 #include "remoteconnection.h"
 
+class DatabasePool;
+
 #include <string>
 
 /** Remote backend server base class. */
@@ -52,6 +54,15 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// Do we support writing?
     bool writable;
 
+    /** The pool to take database objects from, or NULL.
+     *
+     *  If set, db is only set while a message is being processed.
+     */
+    DatabasePool * pool;
+
+    /// The revision of the databases in pool which the client has seen.
+    std::string revision;
+
     /** Timeout for actions during a conversation.
      *
      *  The timeout is specified in seconds.  If the timeout is exceeded then a
@@ -69,6 +80,17 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /** Accept and process one message from the client.
+     *
+     *  @param timeout	Timeout to wait for the message (in seconds).
+     *
+     *  @return	false if the client closed the connection.
+     */
+    bool handle_message(double timeout);
+
+    /// Return the database object to the pool, if we're using one.
+    void release_db();
+
     /// Accept a message from the client.
     message_type get_message(double timeout, std::string & result,
 			     message_type required_type = MSG_MAX);
@@ -86,9 +108,15 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // all terms
     void msg_allterms(const std::string & message);
 
+    // send a document (used by msg_document() and msg_documents())
+    void send_document(Xapian::docid did);
+
     // get document
     void msg_document(const std::string & message);
 
+    // get several documents
+    void msg_documents(const std::string & message);
+
     // term exists?
     void msg_termexists(const std::string & message);
 
@@ -183,6 +211,24 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
 		 double idle_timeout_,
 		 bool writable = false);
 
+    /** Construct a RemoteServer which shares databases with others.
+     *
+     *  The connection is read-only.
+     *
+     *  @param pool_	The pool to take database objects from.
+     *  @param fdin	The file descriptor to read from.
+     *  @param fdout	The file descriptor to write to (fdin and fdout may be
+     *			the same).
+     *  @param active_timeout_	Timeout for actions during a conversation
+     *			(specified in seconds).
+     *  @param idle_timeout_	Timeout while waiting for a new action from
+     *			the client (specified in seconds).
+     */
+    RemoteServer(DatabasePool & pool_,
+		 int fdin, int fdout,
+		 double active_timeout_,
+		 double idle_timeout_);
+
     /// Destructor.
     ~RemoteServer();
 
@@ -193,6 +239,27 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      */
     void run();
 
+    /** Process a message from the client which is ready to be read.
+     *
+     *  Errors are handled as run() does.
+     *
+     *  @return	false if the client closed the connection.
+     */
+    bool run_one_message() { return handle_message(active_timeout); }
+
+    /// Is there another message from the client already read in?
+    bool message_pending() const {
+	return RemoteConnection::input_buffered();
+    }
+
+    /** Tell the client that the connection has been idle for too long.
+     *
+     *  This is for use when the caller is waiting for messages rather than
+     *  run().  Errors sending the message are ignored, as the client may
+     *  not be listening.
+     */
+    void send_idle_timeout();
+
     /// Get the registry used for (un)serialisation.
     const Xapian::Registry & get_registry() const { return reg; }
 
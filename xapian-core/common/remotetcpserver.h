@@ -83,6 +83,24 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
      *  This method may be called by multiple threads.
      */
     void handle_one_connection(int socket);
+
+    /** Accept connections and service requests indefinitely, using a pool
+     *  of threads.
+     *
+     *  Rather than forking for each connection, connections are watched
+     *  with epoll and each message which arrives is handled by one of a
+     *  fixed number of worker threads.  The workers share a pool of open
+     *  database objects (and so any block cache), so a connection doesn't
+     *  need to open the databases itself, and the number of threads caps the
+     *  number of requests processed at once.
+     *
+     *  This mode is only available for read-only servers, and requires
+     *  epoll and POSIX threads - otherwise Xapian::UnimplementedError is
+     *  thrown.
+     *
+     *  @param threads	The number of worker threads.
+     */
+    void run_threaded(unsigned threads);
 };
 
 #endif // XAPIAN_INCLUDED_REMOTETCPSERVER_H
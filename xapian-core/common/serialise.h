@@ -22,6 +22,7 @@
 #define XAPIAN_INCLUDED_SERIALISE_H
 
 #include <string>
+#include <vector>
 #include "noreturn.h"
 #include "xapian/visibility.h"
 #include "xapian/weight.h"
@@ -33,6 +34,9 @@ namespace Xapian {
     class Error;
     class MSet;
     class RSet;
+    namespace Internal {
+	class MSetItem;
+    }
 }
 
 /** Encode a length as a variable-length string.
@@ -122,22 +126,42 @@ std::string serialise_stats(const Xapian::Weight::Internal &stats);
  */
 Xapian::Weight::Internal unserialise_stats(const std::string &s);
 
-/** Serialise a Xapian::MSet object.
+/** Serialise a Xapian::MSet object apart from its items.
+ *
+ *  The items are serialised separately with serialise_mset_item() so that
+ *  they can be sent in batches.
  *
  *  @param mset		The object to serialise.
  *
  *  @return		The serialisation of the Xapian::MSet object.
  */
-std::string serialise_mset(const Xapian::MSet &mset);
+std::string serialise_mset_header(const Xapian::MSet &mset);
 
-/** Unserialise a serialised Xapian::MSet object.
+/** Unserialise a Xapian::MSet object serialised by serialise_mset_header().
  *
  *  @param p	 Pointer to the start of the string to unserialise.
  *  @param p_end Pointer to the end of the string to unserialise.
  *
- *  @return	The unserialised Xapian::MSet object.
+ *  @return	The unserialised Xapian::MSet object, with no items.
+ */
+Xapian::MSet unserialise_mset_header(const char * p, const char * p_end);
+
+/** Serialise an item in a Xapian::MSet object.
+ *
+ *  @param item		The item to serialise.
+ *
+ *  @return		The serialisation of the item.
  */
-Xapian::MSet unserialise_mset(const char * p, const char * p_end);
+std::string serialise_mset_item(const Xapian::Internal::MSetItem & item);
+
+/** Unserialise items serialised by serialise_mset_item().
+ *
+ *  @param p	 Pointer to the start of the string to unserialise.
+ *  @param p_end Pointer to the end of the string to unserialise.
+ *  @param items The items are appended to this vector.
+ */
+void unserialise_mset_items(const char * p, const char * p_end,
+			    std::vector<Xapian::Internal::MSetItem> & items);
 
 /** Serialise a Xapian::RSet object.
  *
@@ -173,4 +197,52 @@ std::string serialise_document(const Xapian::Document &doc);
 XAPIAN_VISIBILITY_DEFAULT
 Xapian::Document unserialise_document(const std::string &s);
 
+/** Serialise a block of data, compressing it if that makes it smaller.
+ *
+ *  @param data		The data to serialise.
+ *  @param compress	Whether to try compressing the data.  Pass false if
+ *			the recipient can't decompress it.
+ *
+ *  @return		The serialised block.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+std::string serialise_block(const std::string & data, bool compress);
+
+/** Unserialise a block serialised by serialise_block().
+ *
+ *  @param p		Pointer to the start of the serialised block.
+ *  @param p_end	Pointer to the end of the serialised block.
+ *  @param[out] data	Set to the unserialised data.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void unserialise_block(const char * p, const char * p_end, std::string & data);
+
+/// Return true if unserialise_block() can handle compressed blocks.
+XAPIAN_VISIBILITY_DEFAULT
+bool block_compression_supported();
+
+/** Append a term to a list of sorted terms, sharing a prefix with the
+ *  previous term.
+ *
+ *  @param[inout] result	The serialised list to append to.
+ *  @param[inout] prev		The previous term, which is updated to
+ *				@a term.  Use an empty string for the first
+ *				term in a list.
+ *  @param term			The term to append.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void serialise_term_after(std::string & result, std::string & prev,
+			  const std::string & term);
+
+/** Read a term appended by serialise_term_after().
+ *
+ *  @param p		Pointer to a pointer to the serialised term, which
+ *			is advanced past it.
+ *  @param p_end	Pointer to the end of the serialised data.
+ *  @param[inout] term	The previous term, which is updated to the term read.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void unserialise_term_after(const char ** p, const char * p_end,
+			    std::string & term);
+
 #endif
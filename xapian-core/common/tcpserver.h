@@ -76,6 +76,9 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
+    /// Return the socket we're listening on.
+    int get_listen_socket() const { return listen_socket; }
+
   public:
     /** Construct a TcpServer and start listening for connections.
      *
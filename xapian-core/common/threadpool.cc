@@ -0,0 +1,251 @@
+/** @file threadpool.cc
+ * @brief A simple pool of worker threads.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "threadpool.h"
+
+#include <xapian/error.h>
+
+#include "debuglog.h"
+#include "omassert.h"
+
+#include <new>
+
+using namespace std;
+
+ThreadPool::Task::~Task() { }
+
+void
+ThreadPool::CheckedTask::run()
+{
+    try {
+	perform();
+    } catch (const Xapian::Error & e) {
+	status = XAPIAN_ERROR;
+	// The byte before the type name is the type code (as used by
+	// serialise_error()).
+	error_type = e.get_type()[-1];
+	error_msg = e.get_msg();
+	error_context = e.get_context();
+	const char * err = e.get_error_string();
+	if (err) error_errstr = err;
+    } catch (const char * msg) {
+	// Some code throws a C string to report an unexpected condition.
+	status = UNKNOWN_ERROR;
+	error_msg = msg;
+    } catch (const std::bad_alloc &) {
+	status = OUT_OF_MEMORY;
+    } catch (...) {
+	status = UNKNOWN_ERROR;
+    }
+}
+
+void
+ThreadPool::CheckedTask::rethrow_error() const
+{
+    switch (status) {
+	case OK:
+	    return;
+	case XAPIAN_ERROR: {
+	    const string & msg = error_msg;
+	    const string & context = error_context;
+	    const char * error_string = NULL;
+	    if (!error_errstr.empty()) error_string = error_errstr.c_str();
+	    switch (error_type) {
+#include "xapian/errordispatch.h"
+	    }
+	    break;
+	}
+	case OUT_OF_MEMORY:
+	    throw std::bad_alloc();
+	case UNKNOWN_ERROR:
+	    if (!error_msg.empty()) throw Xapian::InternalError(error_msg);
+	    break;
+    }
+    throw Xapian::InternalError("Unknown exception in a worker thread");
+}
+
+#ifdef HAVE_PTHREAD
+
+ThreadPool::ThreadPool(unsigned threads)
+    : stopping(false)
+{
+    LOGCALL_CTOR(API, "ThreadPool", threads);
+    (void)pthread_mutex_init(&mutex, NULL);
+    (void)pthread_cond_init(&work_available, NULL);
+    (void)pthread_cond_init(&batch_finished, NULL);
+    grow(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    LOGCALL_DTOR(API, "ThreadPool");
+    (void)pthread_mutex_lock(&mutex);
+    stopping = true;
+    (void)pthread_cond_broadcast(&work_available);
+    (void)pthread_mutex_unlock(&mutex);
+    vector<pthread_t>::const_iterator i;
+    for (i = workers.begin(); i != workers.end(); ++i) {
+	(void)pthread_join(*i, NULL);
+    }
+    (void)pthread_cond_destroy(&batch_finished);
+    (void)pthread_cond_destroy(&work_available);
+    (void)pthread_mutex_destroy(&mutex);
+}
+
+void
+ThreadPool::grow(unsigned threads)
+{
+    LOGCALL_VOID(API, "ThreadPool::grow", threads);
+    while (workers.size() + 1 < threads) {
+	pthread_t thread;
+	// If we can't create a thread, just make do with fewer workers.
+	if (pthread_create(&thread, NULL, worker_thread, this) != 0) break;
+	(void)pthread_mutex_lock(&mutex);
+	workers.push_back(thread);
+	(void)pthread_mutex_unlock(&mutex);
+    }
+}
+
+void *
+ThreadPool::worker_thread(void * pool)
+{
+    ThreadPool * p = static_cast<ThreadPool *>(pool);
+    (void)pthread_mutex_lock(&p->mutex);
+    while (true) {
+	while (p->queue.empty() && !p->stopping) {
+	    (void)pthread_cond_wait(&p->work_available, &p->mutex);
+	}
+	if (p->queue.empty()) break;
+	p->run_front_task();
+    }
+    (void)pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+void
+ThreadPool::run_front_task()
+{
+    Assert(!queue.empty());
+    Task * task = queue.front().first;
+    Batch * batch = queue.front().second;
+    queue.pop_front();
+    (void)pthread_mutex_unlock(&mutex);
+    task->run();
+    (void)pthread_mutex_lock(&mutex);
+    if (batch && --batch->pending == 0) {
+	// We don't know which thread is waiting for this batch, so wake them
+	// all - any others will just go back to waiting.
+	(void)pthread_cond_broadcast(&batch_finished);
+    }
+}
+
+void
+ThreadPool::run(const vector<Task *> & tasks)
+{
+    LOGCALL_VOID(API, "ThreadPool::run", tasks.size());
+    if (tasks.empty()) return;
+    Batch batch(tasks.size());
+    (void)pthread_mutex_lock(&mutex);
+    vector<Task *>::const_iterator i;
+    for (i = tasks.begin(); i != tasks.end(); ++i) {
+	queue.push_back(make_pair(*i, &batch));
+    }
+    if (tasks.size() == 1) {
+	(void)pthread_cond_signal(&work_available);
+    } else {
+	(void)pthread_cond_broadcast(&work_available);
+    }
+    while (batch.pending) {
+	if (!queue.empty()) {
+	    // Rather than sitting idle, run a task ourselves.  It may not be
+	    // from our batch, but that doesn't matter as either way it needs
+	    // to be done.
+	    run_front_task();
+	} else {
+	    (void)pthread_cond_wait(&batch_finished, &mutex);
+	}
+    }
+    (void)pthread_mutex_unlock(&mutex);
+}
+
+void
+ThreadPool::post(Task * task)
+{
+    LOGCALL_VOID(API, "ThreadPool::post", task);
+    if (workers.empty()) {
+	task->run();
+	return;
+    }
+    (void)pthread_mutex_lock(&mutex);
+    queue.push_back(make_pair(task, static_cast<Batch *>(NULL)));
+    (void)pthread_cond_signal(&work_available);
+    (void)pthread_mutex_unlock(&mutex);
+}
+
+unsigned
+ThreadPool::size() const
+{
+    return workers.size() + 1;
+}
+
+#else
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    LOGCALL_CTOR(API, "ThreadPool", threads);
+    (void)threads;
+}
+
+ThreadPool::~ThreadPool()
+{
+    LOGCALL_DTOR(API, "ThreadPool");
+}
+
+void
+ThreadPool::grow(unsigned threads)
+{
+    LOGCALL_VOID(API, "ThreadPool::grow", threads);
+    (void)threads;
+}
+
+void
+ThreadPool::run(const vector<Task *> & tasks)
+{
+    LOGCALL_VOID(API, "ThreadPool::run", tasks.size());
+    vector<Task *>::const_iterator i;
+    for (i = tasks.begin(); i != tasks.end(); ++i) {
+	(*i)->run();
+    }
+}
+
+void
+ThreadPool::post(Task * task)
+{
+    LOGCALL_VOID(API, "ThreadPool::post", task);
+    task->run();
+}
+
+unsigned
+ThreadPool::size() const
+{
+    return 1;
+}
+
+#endif
@@ -0,0 +1,174 @@
+/** @file threadpool.h
+ * @brief A simple pool of worker threads.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_THREADPOOL_H
+#define XAPIAN_INCLUDED_THREADPOOL_H
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+/** A pool of worker threads.
+ *
+ *  Work is submitted as a batch of tasks with run(), which returns once every
+ *  task in the batch has completed.  The calling thread runs tasks from the
+ *  queue too while it waits, so a pool of N threads has N - 1 workers, and
+ *  a batch always makes progress even if every worker is busy with another
+ *  caller's batch.
+ *
+ *  If POSIX threads aren't available, there are no workers and run() simply
+ *  runs the tasks one after another in the calling thread.
+ */
+class ThreadPool {
+  public:
+    /// A unit of work to run in the pool.
+    class Task {
+      public:
+	virtual ~Task();
+
+	/** Perform the task.
+	 *
+	 *  This may be called in any thread, and must not throw an exception
+	 *  - any error needs to be caught and recorded for the submitter to
+	 *  deal with once run() has returned.
+	 */
+	virtual void run() = 0;
+    };
+
+    /** A task which catches any exception it throws.
+     *
+     *  The submitter can call rethrow_error() once the task has finished to
+     *  rethrow it in the submitting thread.
+     */
+    class CheckedTask : public Task {
+	/// What went wrong, if anything.
+	enum { OK, XAPIAN_ERROR, OUT_OF_MEMORY, UNKNOWN_ERROR } status;
+
+	/// Details of a Xapian::Error (or a C string) which was thrown.
+	char error_type;
+	std::string error_msg, error_context, error_errstr;
+
+      protected:
+	/** Perform the task.
+	 *
+	 *  Unlike Task::run(), this may throw an exception.
+	 */
+	virtual void perform() = 0;
+
+      public:
+	CheckedTask() : status(OK), error_type(0) { }
+
+	void run();
+
+	/// Did perform() throw an exception?
+	bool failed() const { return status != OK; }
+
+	/// Rethrow the exception perform() threw, if it threw one.
+	void rethrow_error() const;
+    };
+
+  private:
+    /// Don't allow copying.
+    ThreadPool(const ThreadPool &);
+
+    /// Don't allow assignment.
+    void operator=(const ThreadPool &);
+
+#ifdef HAVE_PTHREAD
+    /** The number of tasks from a call to run() which haven't finished.
+     *
+     *  Tasks queued by post() don't belong to a batch.
+     */
+    struct Batch {
+	size_t pending;
+
+	explicit Batch(size_t pending_) : pending(pending_) { }
+    };
+
+    /// Protects everything below.
+    pthread_mutex_t mutex;
+
+    /// Signalled when tasks are queued, or the pool is being destroyed.
+    pthread_cond_t work_available;
+
+    /// Broadcast when the last task of a batch finishes.
+    pthread_cond_t batch_finished;
+
+    /// Tasks waiting to be run, and the batch each belongs to.
+    std::deque<std::pair<Task *, Batch *> > queue;
+
+    /// The worker threads.
+    std::vector<pthread_t> workers;
+
+    /// Set to tell the workers to exit.
+    bool stopping;
+
+    /// Entry point for the worker threads.
+    static void * worker_thread(void * pool);
+
+    /** Run the task at the front of the queue.
+     *
+     *  The mutex must be held, and is released while the task runs.
+     */
+    void run_front_task();
+#endif
+
+  public:
+    /** Create a pool.
+     *
+     *  @param threads	The number of threads to run tasks in, including the
+     *			thread calling run().
+     */
+    explicit ThreadPool(unsigned threads);
+
+    /// Wait for the workers to finish their current tasks and exit.
+    ~ThreadPool();
+
+    /** Add workers so that tasks may be run in up to @a threads threads.
+     *
+     *  The pool never shrinks, so this does nothing if it already has that
+     *  many threads.  Calls to grow() mustn't overlap calls to size() or
+     *  post().
+     */
+    void grow(unsigned threads);
+
+    /** Run a batch of tasks, returning once they have all completed.
+     *
+     *  Several threads may call run() on the same pool at once.
+     */
+    void run(const std::vector<Task *> & tasks);
+
+    /** Queue a task to be run by a worker, without waiting for it.
+     *
+     *  The task isn't deleted by the pool, but may delete itself at the end
+     *  of run().  The pool must have been created with at least 2 threads
+     *  for the task to run in the background - otherwise it is run before
+     *  post() returns.
+     */
+    void post(Task * task);
+
+    /// Return the number of threads tasks may be run in.
+    unsigned size() const;
+};
+
+#endif // XAPIAN_INCLUDED_THREADPOOL_H
@@ -51,6 +51,16 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
     /// Return the value at the current position.
     virtual std::string get_value() const = 0;
 
+    /** Compare the value at the current position with @a s.
+     *
+     *  The result is less than, equal to, or greater than zero as for
+     *  std::string::compare().  Backends can override this to avoid
+     *  constructing a std::string for the value.
+     *
+     *  The default implementation compares get_value() with @a s.
+     */
+    virtual int compare_value(const std::string & s) const;
+
     /// Return the value slot for the current position/this iterator.
     virtual Xapian::valueno get_valueno() const = 0;
 
@@ -72,6 +82,32 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
      */
     virtual void skip_to(Xapian::docid) = 0;
 
+    /** Advance, skipping entries whose values are known to be outside a range.
+     *
+     *  Like next(), except that the backend may also skip over entries
+     *  which it can cheaply tell have values outside [@a lo, @a hi], for
+     *  example using per-chunk bounds.  Entries which aren't skipped may
+     *  still have values outside the range, so the caller must still check
+     *  them.
+     *
+     *  Values can't be empty, so an empty @a hi is taken to mean there's
+     *  no upper bound.
+     *
+     *  The default implementation calls next().
+     */
+    virtual void next_in_range(const std::string & lo, const std::string & hi);
+
+    /** Skip forward, skipping entries whose values are known to be outside a
+     *  range.
+     *
+     *  Like skip_to(), but may also skip entries as next_in_range() does.
+     *
+     *  The default implementation calls skip_to().
+     */
+    virtual void skip_to_in_range(Xapian::docid did,
+				  const std::string & lo,
+				  const std::string & hi);
+
     /** Check if the specified docid occurs in this valuestream.
      *
      *  The caller is required to ensure that the specified @a docid actually
@@ -22,6 +22,7 @@ xapianinclude_HEADERS =\
 	include/xapian/intrusive_ptr.h\
 	include/xapian/keymaker.h\
 	include/xapian/matchspy.h\
+	include/xapian/msetcache.h\
 	include/xapian/positioniterator.h\
 	include/xapian/postingiterator.h\
 	include/xapian/postingsource.h\
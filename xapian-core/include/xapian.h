@@ -47,6 +47,7 @@
 #include <xapian/expanddecider.h>
 #include <xapian/keymaker.h>
 #include <xapian/matchspy.h>
+#include <xapian/msetcache.h>
 #include <xapian/postingsource.h>
 #include <xapian/query.h>
 #include <xapian/queryparser.h>
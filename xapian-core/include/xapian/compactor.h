@@ -76,6 +76,19 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      */
     void set_multipass(bool multipass);
 
+    /** Set the number of threads to use.
+     *
+     *  Default is 1.  If greater than 1, the tables are merged in parallel,
+     *  and (unless multipass is in use) the merging of the postlist table is
+     *  also split up by term, which requires temporary disk space for all
+     *  but the first part.
+     *
+     *  When using more than one thread, calls to set_status() for
+     *  different tables may be interleaved, but calls to set_status() and
+     *  resolve_duplicate_metadata() are never made concurrently.
+     */
+    void set_threads(unsigned threads);
+
     /** Set the compaction level.
      *
      *  Values are:
@@ -107,7 +120,9 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      *
      *  Subclass this method if you want to get progress updates during
      *  compaction.  This is called for each table first with empty status,
-     *  And then one or more times with non-empty status.
+     *  And then one or more times with non-empty status.  The final status
+     *  for a table includes the time taken and the rate the input was
+     *  processed at.
      *
      *  The default implementation does nothing.
      */
@@ -94,9 +94,21 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	/** Open a Database, automatically determining the database
 	 *  backend to use.
 	 *
+	 *  Once enough document lengths have been looked up in a brass
+	 *  database, they're all read into an array in memory, which is
+	 *  shared by all the Database objects in the process with the same
+	 *  revision open.  The total size of these arrays is limited to 64MB
+	 *  by default - set the environment variable XAPIAN_DOCLEN_CACHE_SIZE
+	 *  to a size in bytes to change this (0 disables the arrays).  Pass
+	 *  Xapian::DB_NO_DOCLEN_ARRAY to stop this database using them.
+	 *
 	 * @param path directory that the database is stored in.
+	 * @param flags bitwise-or of Xapian::DB_* flags.  The flags which are
+	 *	  currently useful here are Xapian::DB_READ_MMAP,
+	 *	  Xapian::DB_NO_DOCLEN_ARRAY and Xapian::DB_PREFETCH.  (Default:
+	 *	  0)
 	 */
-	explicit Database(const std::string &path);
+	explicit Database(const std::string &path, int flags = 0);
 
 	/** @private @internal Create a Database from its internals.
 	 */
@@ -590,6 +602,8 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *    none exists
 	 *  - Xapian::DB_OPEN open for read/write; fail if no db exists
 	 *
+	 *  which may be bitwise-or'd with Xapian::DB_FRESH_BUILD.
+	 *
 	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
 	 *             database is in a corrupt state.
 	 *
@@ -777,6 +791,34 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  The effect is the same as calling add_document() for each of the
+	 *  documents in turn, but the backend may spread the work over
+	 *  several threads.  Currently the brass backend does this - it
+	 *  inverts the documents and encodes their termlists and positional
+	 *  information in parallel, then merges the results in.  Other
+	 *  backends just add the documents one at a time.
+	 *
+	 *  If an exception is thrown, then as with add_document(), any
+	 *  uncommitted changes are discarded.
+	 *
+	 *  @param documents	The documents to add.
+	 *  @param threads	The number of threads to use (default 1).
+	 *
+	 *  @return		The document ID of the first document added
+	 *			(the others get the following document IDs), or
+	 *			0 if @a documents is empty.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	Xapian::docid add_documents(const std::vector<Xapian::Document> & documents,
+				    unsigned threads = 1);
+
 	/** Delete a document from the database.
 	 *
 	 *  This method removes the document with the specified document ID
@@ -1083,6 +1125,52 @@ const int DB_CREATE_OR_OVERWRITE = 3;
 /** Open for read/write; fail if no db exists. */
 const int DB_OPEN = 4;
 
+/** @internal Bit mask for the action codes above. */
+const int DB_ACTION_MASK_ = 0x07;
+
+/** Read a brass or chert database's tables via read-only memory mappings.
+ *
+ *  Blocks are copied out of the mappings rather than read with pread(),
+ *  which can be faster if the database is already in the OS page cache.
+ *  Each block read still calls fstat() to check that a writer hasn't
+ *  truncated the file.  It only affects databases opened read-only.
+ */
+const int DB_READ_MMAP = 0x08;
+
+/** Build a new brass database in "fresh build" mode.
+ *
+ *  Rather than merging each batch of postings into the posting lists, the
+ *  batches are written to temporary files in the database directory, and
+ *  these are merged into the posting lists in one pass, which is much faster
+ *  for a large build.  The merge happens at the first commit() (so batches
+ *  aren't committed automatically in this mode), or sooner if documents are
+ *  deleted or replaced, or the posting lists or term frequencies are read.
+ *
+ *  This is ignored unless the database doesn't yet contain any documents,
+ *  and by backends other than brass.
+ */
+const int DB_FRESH_BUILD = 0x10;
+
+/** Don't read a brass database's document lengths into an array.
+ *
+ *  The array takes 4 bytes per document ID (up to the last one used), so
+ *  a program which only looks up a few document lengths in a large
+ *  database, or which opens many databases, may want to save the memory.
+ *  It only affects databases opened read-only.
+ */
+const int DB_NO_DOCLEN_ARRAY = 0x20;
+
+/** Hint to the OS which blocks of a brass database will be read next.
+ *
+ *  When a posting list or value stream moves on to its next chunk, the
+ *  following leaf blocks are hinted, and an AND query hints the chunk each
+ *  subquery will skip to.  This lets reads from disk overlap, which helps
+ *  if the database isn't in the OS page cache, but the hints cost a system
+ *  call each, so it's slower if the database is cached.  It only affects
+ *  databases opened read-only.
+ */
+const int DB_PREFETCH = 0x40;
+
 }
 
 #endif /* XAPIAN_INCLUDED_DATABASE_H */
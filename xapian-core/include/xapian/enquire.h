@@ -41,6 +41,7 @@ class ErrorHandler;
 class ExpandDecider;
 class KeyMaker;
 class MatchSpy;
+class MSetCache;
 class MSetIterator;
 class Query;
 class Weight;
@@ -717,6 +718,23 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void clear_matchspies();
 
+	/** Set a cache of match results to use.
+	 *
+	 *  get_mset() will return a cached result if there is one for the
+	 *  same search against the same revision of the database, and will
+	 *  add results it calculates to the cache.  See Xapian::MSetCache for
+	 *  details of which searches are cached.
+	 *
+	 *  @param cache	The cache to use.  This can be shared with other
+	 *			Enquire objects, including ones searching
+	 *			different databases.
+	 */
+	void set_cache(const MSetCache & cache);
+
+	/** Stop using a cache of match results.
+	 */
+	void unset_cache();
+
 	/** Set the weighting scheme to use for queries.
 	 *
 	 *  @param weight_  the new weighting scheme.  If no weighting scheme
@@ -810,6 +828,24 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_cutoff(Xapian::percent percent_cutoff, Xapian::weight weight_cutoff = 0);
 
+	/** Set the number of threads to match sub-databases in parallel with.
+	 *
+	 *  If the Database has several local sub-databases, get_mset() can
+	 *  match each in a separate thread, which reduces the time a search
+	 *  takes at the cost of using more CPU time overall.  The results
+	 *  are the same either way.  All Enquire objects share one pool of
+	 *  threads, which grows to the largest number any of them asks for.
+	 *
+	 *  The sub-databases are still matched serially if there's a match
+	 *  decider, match spy, KeyMaker, PostingSource, collapse key or
+	 *  percentage cutoff in use, any sub-database is remote, or the same
+	 *  sub-database has been added more than once.
+	 *
+	 *  @param threads	The number of threads to use.  0 or 1 means
+	 *			match serially (the default is 0).
+	 */
+	void set_match_threads(unsigned threads);
+
 	/** Set the sorting to be by relevance only.
 	 *
 	 *  This is the default.
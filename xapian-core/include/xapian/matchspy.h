@@ -29,6 +29,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 namespace Xapian {
 
@@ -157,6 +158,12 @@ class XAPIAN_VISIBILITY_DEFAULT MatchSpy {
 
 
 /** Class for counting the frequencies of values in the matching documents.
+ *
+ *  For broad queries, fetching the value from every document the matcher
+ *  sees can be a significant part of the cost of the search.  If
+ *  approximate counts are good enough, set_sampling() can be used to tally
+ *  only some of these documents, and get_estimated_count() to scale the
+ *  tallies up.
  */
 class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
   public:
@@ -172,11 +179,35 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
 	/// Total number of documents seen by the match spy.
 	Xapian::doccount total;
 
+	/// Number of documents whose values have been tallied.
+	Xapian::doccount sampled;
+
+	/// Tally one in every sample_interval documents seen.
+	Xapian::doccount sample_interval;
+
+	/// Tally a random sample of at most this many documents (0 for all).
+	Xapian::doccount max_samples;
+
+	/// Number of documents which have been candidates for the sample.
+	Xapian::doccount candidates;
+
+	/// The values of the documents in the sample, if max_samples is set.
+	std::vector<std::string> reservoir;
+
+	/// State of the random number generator used to pick the sample.
+	unsigned rng_state;
+
 	/// The values seen so far, together with their frequency.
 	std::map<std::string, Xapian::doccount> values;
 
-	Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
-	Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
+	Internal()
+	    : slot(Xapian::BAD_VALUENO), total(0), sampled(0),
+	      sample_interval(1), max_samples(0), candidates(0),
+	      rng_state(1) {}
+	Internal(Xapian::valueno slot_)
+	    : slot(slot_), total(0), sampled(0),
+	      sample_interval(1), max_samples(0), candidates(0),
+	      rng_state(1) {}
     };
 #endif
 
@@ -191,11 +222,59 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
     ValueCountMatchSpy(Xapian::valueno slot_)
 	    : internal(new Internal(slot_)) {}
 
-    /** Return the total number of documents tallied. */
+    /** Return the total number of documents seen. */
     size_t get_total() const {
 	return internal->total;
     }
 
+    /** Only tally the values of some of the documents seen.
+     *
+     *  By default, the value of every document seen is tallied.
+     *
+     *  @param sample_interval	Tally one document in every
+     *				@a sample_interval seen (default 1, which
+     *				means tally every document).
+     *  @param max_samples	Only tally a random sample of this many of
+     *				those documents (default 0, which means no
+     *				limit).  Every document is equally likely to
+     *				be in the sample, however many are seen.
+     *				When searching several databases with the
+     *				remote backend, this limit applies to each
+     *				remote database separately, so the estimates
+     *				assume they have similar numbers of matches.
+     *
+     *  Documents which aren't tallied are still counted by get_total().
+     */
+    void set_sampling(Xapian::doccount sample_interval,
+		      Xapian::doccount max_samples = 0);
+
+    /** Return the number of documents whose values were tallied.
+     *
+     *  This is the same as get_total() unless set_sampling() has been used.
+     */
+    Xapian::doccount get_sampled() const {
+	return internal->sampled;
+    }
+
+    /** Estimate how many documents have a particular value.
+     *
+     *  This scales up the tally for @a value from the documents sampled to
+     *  @a matches documents.  Pass get_total() to estimate how many of the
+     *  documents seen have @a value, or the MSet's get_matches_estimated() to
+     *  estimate how many of all the matching documents do.
+     *
+     *  @param value	The value to estimate the count for.
+     *  @param matches	The number of documents to scale the tally up to.
+     *  @param[out] error	Set to the half-width of an approximate 95%
+     *			confidence interval for the estimate (0 if every
+     *			one of @a matches documents was tallied).
+     *
+     *  @return The estimated count.
+     */
+    Xapian::doccount get_estimated_count(const std::string & value,
+					 Xapian::doccount matches,
+					 Xapian::doccount & error) const;
+
     /** Get an iterator over the values seen in the slot.
      *
      *  Items will be returned in ascending alphabetical order.
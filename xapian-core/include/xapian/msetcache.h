@@ -0,0 +1,116 @@
+/** @file msetcache.h
+ * @brief Cache of match results which can be shared between Enquire objects.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHE_H
+#define XAPIAN_INCLUDED_MSETCACHE_H
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/visibility.h>
+#include <string>
+
+namespace Xapian {
+
+/** A cache of match results.
+ *
+ *  If a cache is set on an Enquire object with Enquire::set_cache(), then
+ *  get_mset() looks for the result in the cache before running the match,
+ *  and stores the result in the cache afterwards.  The cache is keyed on
+ *  the serialised query, the weighting scheme and its parameters, the
+ *  sorting, collapsing and cutoff settings, the get_mset() parameters, and
+ *  the revision of each database being searched, so a cached result is only
+ *  used if running the match again would produce the same MSet.
+ *
+ *  When a search sees a new revision of a database (e.g. after
+ *  Database::reopen()), cached results for the old revision are discarded.
+ *
+ *  The least recently used results are discarded to keep the memory used
+ *  within the limit specified.
+ *
+ *  Results aren't cached if a match decider, match spy, KeyMaker or error
+ *  handler is in use, or if the query or weighting scheme can't be
+ *  serialised, or if any database being searched doesn't provide revision
+ *  information (currently this is the case for inmemory and remote
+ *  databases).
+ *
+ *  Copying an MSetCache object is cheap, and the copy refers to the same
+ *  cache, so the same cache can be used by several Enquire objects.  It is
+ *  safe for those Enquire objects to be used in different threads.
+ */
+class XAPIAN_VISIBILITY_DEFAULT MSetCache {
+  public:
+    /// Class containing the implementation.
+    class Internal;
+
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+    /// Copying is allowed (and is cheap).
+    MSetCache(const MSetCache & o);
+
+    /// Assignment is allowed (and is cheap).
+    MSetCache & operator=(const MSetCache & o);
+
+    /** Construct an MSetCache.
+     *
+     *  @param max_memory	The approximate maximum number of bytes of
+     *				memory to use for cached results (default
+     *				16MB).
+     */
+    explicit MSetCache(size_t max_memory = 16 * 1024 * 1024);
+
+    /// Destructor.
+    ~MSetCache();
+
+    /** Set the approximate maximum memory to use.
+     *
+     *  If the cache currently uses more than this, the least recently used
+     *  results are discarded.
+     */
+    void set_max_memory(size_t max_memory);
+
+    /// Get the approximate maximum memory to use.
+    size_t get_max_memory() const;
+
+    /// Get the approximate memory currently used by cached results.
+    size_t get_memory_used() const;
+
+    /// Get the number of results currently cached.
+    size_t size() const;
+
+    /// Get the number of searches which found their result in the cache.
+    unsigned long get_hits() const;
+
+    /** Get the number of searches which didn't find their result in the
+     *  cache.
+     *
+     *  Searches which can't be cached (see the class documentation) aren't
+     *  counted.
+     */
+    unsigned long get_misses() const;
+
+    /// Discard all cached results and reset the hit and miss counts.
+    void clear();
+
+    /// Return a string describing this object.
+    std::string get_description() const;
+};
+
+}
+
+#endif /* XAPIAN_INCLUDED_MSETCACHE_H */
@@ -100,6 +100,35 @@ class XAPIAN_VISIBILITY_DEFAULT PostingIterator {
      */
     void skip_to(Xapian::docid did);
 
+    /** Read a batch of postings, starting with the current one.
+     *
+     *  This stores the document ids of up to @a n postings, starting at the
+     *  current position, in @a dids, and advances the iterator past them.
+     *  If the end of the list is reached, the iterator becomes equal to the
+     *  end iterator.  Optionally the wdfs and document lengths are also
+     *  stored.
+     *
+     *  The result is the same as calling operator*(), get_wdf(),
+     *  get_doclength() and operator++() for each posting in turn, but for
+     *  long posting lists this can be much faster.
+     *
+     *  @param n	The maximum number of postings to read.
+     *  @param dids	Array of at least @a n entries to store the document
+     *			ids in.
+     *  @param wdfs	Array of at least @a n entries to store the wdfs in,
+     *			or NULL if they aren't wanted (the default).
+     *  @param doclens	Array of at least @a n entries to store the document
+     *			lengths in, or NULL if they aren't wanted (the
+     *			default).
+     *
+     *  @return The number of postings read, which is less than @a n only if
+     *	    the end of the list was reached (so 0 if this iterator is
+     *	    already at the end).
+     */
+    Xapian::doccount get_batch(Xapian::doccount n, Xapian::docid * dids,
+			       Xapian::termcount * wdfs = 0,
+			       Xapian::termcount * doclens = 0);
+
     /// Return a string describing this object.
     std::string get_description() const;
 
@@ -82,6 +82,26 @@ class XAPIAN_VISIBILITY_DEFAULT TermGenerator {
 
     /// Flags to OR together and pass to TermGenerator::set_flags().
     enum flags {
+	/** Index a term for each pair of adjacent words.
+	 *
+	 *  This allows exact phrase searches to be run without looking at
+	 *  positional information in many cases.  A two word phrase can be
+	 *  matched using just the pair term, while a longer phrase still
+	 *  needs to check positions, but only for documents which contain
+	 *  all its pairs.
+	 *
+	 *  The matcher only uses the pair terms for a database if every
+	 *  document in it was indexed with this flag set.  Pair terms are
+	 *  only generated for words indexed with index_text(), and if you add
+	 *  positional postings to the document by other means then phrases
+	 *  involving them may not match.
+	 *
+	 *  Pair terms start with the byte '\\xff' (which can't occur at the
+	 *  start of a UTF-8 term), and are added with wdf 0 so they don't
+	 *  change document lengths.  A pair is skipped if its term would be
+	 *  longer than the backends allow.
+	 */
+	FLAG_PHRASE_PAIRS = 2, // Value matches QueryParser::FLAG_PHRASE.
 	/// Index data required for spelling correction.
 	FLAG_SPELLING = 128 // Value matches QueryParser flag.
     };
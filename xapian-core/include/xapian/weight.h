@@ -101,8 +101,13 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
     /// An upper bound on the maximum length of any document in the database.
     Xapian::termcount doclength_upper_bound_;
 
-    /// An upper bound on the wdf of this term.
-    Xapian::termcount wdf_upper_bound_;
+    /** An upper bound on the wdf of this term.
+     *
+     *  This is mutable so that get_maxpart_for_wdf_() can lower it while it
+     *  calls get_maxpart(), since subclasses calculate that from
+     *  get_wdf_upper_bound().
+     */
+    mutable Xapian::termcount wdf_upper_bound_;
 
   public:
     class Internal;
@@ -247,6 +252,16 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
 	return stats_needed & WDF;
     }
 
+    /** @private @internal Return an upper bound on get_sumpart() for
+     *  documents in which the term's wdf is at most @a wdf_ub.
+     *
+     *  This is get_maxpart() calculated with a tighter wdf upper bound, and
+     *  allows a backend to skip a block of postings which can't contribute
+     *  enough weight.  If the scheme doesn't use the wdf upper bound, it is
+     *  the same as get_maxpart().
+     */
+    Xapian::weight get_maxpart_for_wdf_(Xapian::termcount wdf_ub) const;
+
   protected:
     /** Don't allow copying.
      *
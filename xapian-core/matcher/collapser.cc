@@ -88,7 +88,7 @@ Collapser::process(Xapian::Internal::MSetItem & item,
 	return EMPTY;
     }
 
-    map<string, CollapseData>::iterator oldkey;
+    unordered_map<string, CollapseData>::iterator oldkey;
     oldkey = table.find(item.collapse_key);
     if (oldkey == table.end()) {
 	// We've not seen this collapse key before.
@@ -112,7 +112,7 @@ Xapian::doccount
 Collapser::get_collapse_count(const string & collapse_key, int percent_cutoff,
 			      Xapian::weight min_weight) const
 {
-    map<string, CollapseData>::const_iterator key = table.find(collapse_key);
+    unordered_map<string, CollapseData>::const_iterator key = table.find(collapse_key);
     // If a collapse key is present in the MSet, it must be in our table.
     Assert(key != table.end());
 
@@ -147,7 +147,7 @@ Collapser::get_matches_lower_bound() const
     // many documents.
 #if 0
     Xapian::doccount max_kept = 0;
-    map<string, CollapseData>::const_iterator i;
+    unordered_map<string, CollapseData>::const_iterator i;
     for (i = table.begin(); i != table.end(); ++i) {
 	if (i->second.get_collapse_count() > max_kept) {
 	    max_kept = i->second.get_collapse_count();
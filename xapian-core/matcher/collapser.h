@@ -25,8 +25,9 @@
 #include "msetcmp.h"
 #include "omenquireinternal.h"
 #include "postlist.h"
+#include "unordered_map.h"
 
-#include <map>
+#include <string>
 
 /// Enumeration reporting how a document was handled by the Collapser.
 typedef enum {
@@ -85,8 +86,12 @@ class CollapseData {
 
 /// The Collapser class tracks collapse keys and the documents they match.
 class Collapser {
-    /// Map from collapse key values to the items we're keeping for them.
-    std::map<std::string, CollapseData> table;
+    /** Map from collapse key values to the items we're keeping for them.
+     *
+     *  We look up every candidate's collapse key here, and don't need the
+     *  keys in order, so a hash table is a better fit than a std::map.
+     */
+    std::unordered_map<std::string, CollapseData> table;
 
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count;
@@ -86,6 +86,15 @@ class MergePostList : public PostList {
 
 	Xapian::termcount count_matching_subqs() const;
 
+	/** Return a reference to the postlist for sub-database @a i.
+	 *
+	 *  This is used when the sub-databases are matched in parallel - each
+	 *  postlist is run separately, but we still own them and provide the
+	 *  combined bounds.  It's a reference so the caller can replace the
+	 *  postlist when pruning.
+	 */
+	PostList *& get_sub_postlist(size_t i) { return plists[i]; }
+
 	MergePostList(const std::vector<PostList *> & plists_,
 		      MultiMatch *matcher_,
 		      ValueStreamDocument & vsdoc_,
@@ -112,13 +112,19 @@ MSetPostList::next(Xapian::weight w_min)
     if (decreasing_relevance) {
 	// MSet items are in decreasing weight order, so if the current item
 	// doesn't have enough weight, none of the remaining items will, so
-	// skip straight to the end.
-	if (!at_end() && mset_internal->items[cursor].wt < w_min)
-	    cursor = mset_internal->items.size();
+	// skip straight to the end (without reading any more items).
+	if (!at_end()) {
+	    ensure_item();
+	    if (mset_internal->items[cursor].wt < w_min)
+		cursor = mset_size;
+	}
     } else {
 	// Otherwise, skip to the next entry with enough weight.
-	while (!at_end() && mset_internal->items[cursor].wt < w_min)
+	while (!at_end()) {
+	    ensure_item();
+	    if (mset_internal->items[cursor].wt >= w_min) break;
 	    ++cursor;
+	}
     }
     RETURN(NULL);
 }
@@ -137,7 +143,7 @@ MSetPostList::at_end() const
 {
     LOGCALL(MATCH, bool, "MSetPostList::at_end", NO_ARGS);
     Assert(cursor != -1);
-    RETURN(size_t(cursor) >= mset_internal->items.size());
+    RETURN(size_t(cursor) >= mset_size);
 }
 
 string
@@ -31,6 +31,9 @@
  *  This class is used with the remote backend.  We perform a match on the
  *  remote server, then serialise the resulting MSet and pass it back to the
  *  client where we include it in the match by wrapping it in an MSetPostList.
+ *
+ *  The items can be read as they're needed, so subclasses must say how to
+ *  read more of them by implementing read_items().
  */
 class MSetPostList : public PostList {
     /// Don't allow assignment.
@@ -42,20 +45,44 @@ class MSetPostList : public PostList {
     /// The MSet element that this PostList is pointing to.
     int cursor;
 
-    /// The MSet::Internal object which we're returning entries from.
-    Xapian::Internal::intrusive_ptr<Xapian::MSet::Internal> mset_internal;
-
     /** Is the sort order such the relevance decreases down the MSet?
      *
      *  This is true for sort_by_relevance and sort_by_relevance_then_value.
      */
     bool decreasing_relevance;
 
-  public:
-    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_)
-	: cursor(-1), mset_internal(mset.internal),
-	  decreasing_relevance(decreasing_relevance_) { }
+    /// Ensure the item at cursor has been read.
+    void ensure_item() {
+	while (size_t(cursor) >= mset_internal->items.size()) read_items();
+    }
+
+  protected:
+    /// The MSet::Internal object which we're returning entries from.
+    Xapian::Internal::intrusive_ptr<Xapian::MSet::Internal> mset_internal;
+
+    /** The number of items in the MSet.
+     *
+     *  This can be more than the number in mset_internal->items if they
+     *  haven't all been read yet.
+     */
+    Xapian::doccount mset_size;
+
+    /** Append more items to mset_internal->items.
+     *
+     *  Only called if fewer than mset_size items have been read.
+     */
+    virtual void read_items() = 0;
 
+    /** Construct.
+     *
+     *  @param mset_size_	The number of items in the MSet.
+     */
+    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_,
+		 Xapian::doccount mset_size_)
+	: cursor(-1), decreasing_relevance(decreasing_relevance_),
+	  mset_internal(mset.internal), mset_size(mset_size_) { }
+
+  public:
     Xapian::doccount get_termfreq_min() const;
 
     Xapian::doccount get_termfreq_est() const;
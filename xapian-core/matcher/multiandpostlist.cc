@@ -193,6 +193,12 @@ advanced_plist0:
 	return NULL;
     }
     did = plist[0]->get_docid();
+    // Let the other sub-postlists start reading what they'll need to check
+    // this document, so that their reads can overlap rather than each one
+    // waiting in turn.
+    for (size_t i = 1; i < n_kids; ++i) {
+	plist[i]->prefetch_skip_to(did);
+    }
     for (size_t i = 1; i < n_kids; ++i) {
 	bool valid;
 	check_helper(i, did, w_min, valid);
@@ -227,6 +233,14 @@ MultiAndPostList::skip_to(Xapian::docid did_min, Xapian::weight w_min)
     return find_next_match(w_min);
 }
 
+void
+MultiAndPostList::prefetch_skip_to(Xapian::docid did_min)
+{
+    for (size_t i = 0; i < n_kids; ++i) {
+	plist[i]->prefetch_skip_to(did_min);
+    }
+}
+
 std::string
 MultiAndPostList::get_description() const
 {
@@ -184,6 +184,8 @@ class MultiAndPostList : public PostList {
 
     Internal *skip_to(Xapian::docid, Xapian::weight w_min);
 
+    void prefetch_skip_to(Xapian::docid did_min);
+
     std::string get_description() const;
 
     /** get_wdf() for MultiAndPostlists returns the sum of the wdfs of the
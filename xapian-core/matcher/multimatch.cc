@@ -46,9 +46,12 @@
 
 #include "msetcmp.h"
 
+#include "mutex.h"
+#include "threadpool.h"
 #include "valuestreamdocument.h"
 #include "weightinternal.h"
 
+#include <xapian/error.h>
 #include <xapian/errorhandler.h>
 #include <xapian/matchspy.h>
 #include <xapian/version.h> // For XAPIAN_HAS_REMOTE_BACKEND
@@ -61,6 +64,7 @@
 #include <algorithm>
 #include <cfloat> // For DBL_EPSILON.
 #include <climits> // For UINT_MAX.
+#include <new> // For std::bad_alloc.
 #include <vector>
 #include <map>
 #include <set>
@@ -74,10 +78,8 @@ const Xapian::Enquire::Internal::sort_setting REL_VAL =
 	Xapian::Enquire::Internal::REL_VAL;
 const Xapian::Enquire::Internal::sort_setting VAL =
 	Xapian::Enquire::Internal::VAL;
-#if 0 // VAL_REL isn't currently used which causes a warning with SGI CC.
 const Xapian::Enquire::Internal::sort_setting VAL_REL =
 	Xapian::Enquire::Internal::VAL_REL;
-#endif
 
 /** Split an RSet into several sub rsets, one for each database.
  *
@@ -119,6 +121,61 @@ split_rset_by_db(const Xapian::RSet * rset,
     Assert(subrsets.size() == number_of_subdbs);
 }
 
+/** Check if a candidate's value means it must sort below @a min_item.
+ *
+ *  This compares the value in the value stream without constructing a
+ *  string for it, so when sorting by value most candidates which can't make
+ *  the proto-MSet are rejected without any allocation.
+ *
+ *  Only valid when the value is the primary sort key (VAL or VAL_REL) and
+ *  @a min_item is a real item (not the initial dummy one with docid 0) -
+ *  then a value which compares strictly worse decides the result without
+ *  needing to look at the weight or docid.
+ */
+inline bool
+value_sorts_below(const ValueStreamDocument & vsdoc, Xapian::valueno slot,
+		  bool sort_value_forward,
+		  const Xapian::Internal::MSetItem & min_item)
+{
+    int cmp = vsdoc.compare_value(slot, min_item.sort_key);
+    return sort_value_forward ? (cmp < 0) : (cmp > 0);
+}
+
+/** Remove the lowest ranked item from the proto-mset heap.
+ *
+ *  Items whose docids are in @a removed have already been displaced from the
+ *  proto-mset by collapsing.  Any such items which reach the top of the heap
+ *  are discarded (and removed from @a removed) and don't count.
+ */
+static void
+pop_lowest_item(vector<Xapian::Internal::MSetItem> & items,
+		set<Xapian::docid> & removed, const MSetCmp & mcmp)
+{
+    while (true) {
+	pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
+		 MSetCmp>(items.begin(), items.end(), mcmp);
+	Xapian::docid did = items.back().did;
+	items.pop_back();
+	if (removed.empty() || removed.erase(did) == 0) return;
+    }
+}
+
+/** Discard displaced items from the top of the proto-mset heap.
+ *
+ *  After this, items.front() is the lowest ranked item still in the
+ *  proto-mset.
+ */
+static void
+discard_removed_items(vector<Xapian::Internal::MSetItem> & items,
+		      set<Xapian::docid> & removed, const MSetCmp & mcmp)
+{
+    while (!removed.empty() && removed.erase(items.front().did)) {
+	pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
+		 MSetCmp>(items.begin(), items.end(), mcmp);
+	items.pop_back();
+    }
+}
+
 /** Prepare some SubMatches.
  *
  *  This calls the prepare_match() method on each SubMatch object, causing them
@@ -214,6 +271,7 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       Xapian::valueno sort_key_,
 		       Xapian::Enquire::Internal::sort_setting sort_by_,
 		       bool sort_value_forward_,
+		       unsigned match_threads_,
 		       Xapian::ErrorHandler * errorhandler_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
@@ -225,11 +283,12 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 	  order(order_),
 	  sort_key(sort_key_), sort_by(sort_by_),
 	  sort_value_forward(sort_value_forward_),
+	  match_threads(match_threads_),
 	  errorhandler(errorhandler_), weight(weight_),
 	  is_remote(db.internal.size()),
 	  matchspies(matchspies_)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | match_threads_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
 
     if (!query) return;
     query->validate_query();
@@ -259,7 +318,12 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 				  subrsets[i], matchspies);
 		bool decreasing_relevance =
 		    (sort_by == REL || sort_by == REL_VAL);
-		smatch = new RemoteSubMatch(rem_db, decreasing_relevance, matchspies);
+		// If we sort by value, the matcher fetches values from the
+		// remote database while working through the MSet items, so we
+		// can't leave items unread on the connection.
+		bool lazy_items = (sort_by == REL);
+		smatch = new RemoteSubMatch(rem_db, decreasing_relevance,
+					    lazy_items, matchspies);
 		is_remote[i] = true;
 	    } else {
 		smatch = new LocalSubMatch(subdb, query, qlen, subrsets[i], weight);
@@ -285,6 +349,21 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     stats.set_bounds_from_db(db);
 }
 
+MultiMatch::MultiMatch(const MultiMatch & parent, Xapian::doccount shard)
+	: db(parent.db.internal[shard].get()), query(parent.query),
+	  collapse_max(0), collapse_key(Xapian::BAD_VALUENO),
+	  percent_cutoff(0), weight_cutoff(parent.weight_cutoff),
+	  order(parent.order),
+	  sort_key(parent.sort_key), sort_by(parent.sort_by),
+	  sort_value_forward(parent.sort_value_forward),
+	  match_threads(0),
+	  errorhandler(NULL), weight(parent.weight),
+	  recalculate_w_max(false), is_remote(1),
+	  matchspies(parent.matchspies)
+{
+    LOGCALL_CTOR(MATCH, "MultiMatch", Literal("parent") | shard);
+}
+
 Xapian::weight
 MultiMatch::getorrecalc_maxweight(PostList *pl)
 {
@@ -303,6 +382,338 @@ MultiMatch::getorrecalc_maxweight(PostList *pl)
     RETURN(wt);
 }
 
+/// The minimum weight shared by sub-databases being matched in parallel.
+class SharedMinWeight {
+    /// Don't allow copying.
+    SharedMinWeight(const SharedMinWeight &);
+
+    /// Don't allow assignment.
+    void operator=(const SharedMinWeight &);
+
+    Mutex mutex;
+
+    Xapian::weight min_weight;
+
+  public:
+    explicit SharedMinWeight(Xapian::weight min_weight_)
+	: min_weight(min_weight_) { }
+
+    Xapian::weight get() {
+	MutexLock lock(mutex);
+	return min_weight;
+    }
+
+    void raise(Xapian::weight w) {
+	MutexLock lock(mutex);
+	if (w > min_weight) min_weight = w;
+    }
+};
+
+/** Runs the match for one sub-database when matching in parallel.
+ *
+ *  This is a cut-down version of the main loop in MultiMatch::get_mset(),
+ *  which only has to handle the cases where we match in parallel (there's no
+ *  collapsing, percentage cutoff, match decider, match spy or KeyMaker).
+ *
+ *  Each shard keeps its own proto-MSet, and get_mset() merges them once all
+ *  the shards have finished.  Once a shard's proto-MSet is full, its lowest
+ *  weight is a lower bound on the lowest weight in the merged MSet, so it
+ *  publishes that to the other shards so they can prune too.
+ */
+class ShardMatch : public ThreadPool::CheckedTask {
+    /// Don't allow copying.
+    ShardMatch(const ShardMatch &);
+
+    /// Don't allow assignment.
+    void operator=(const ShardMatch &);
+
+    /// How many candidates to consider between checking the shared minimum.
+    static const unsigned MIN_WEIGHT_SYNC_INTERVAL = 64;
+
+    /// Matcher for the sub-database, for its postlists to notify.
+    MultiMatch matcher;
+
+    ValueStreamDocument vsdoc;
+
+    /// The postlist to match (which the caller owns).
+    PostList ** pl;
+
+    Xapian::doccount max_msize;
+
+    Xapian::doccount check_at_least;
+
+    bool sort_forward;
+
+    MSetCmp mcmp;
+
+    SharedMinWeight & shared_min_weight;
+
+  protected:
+    /// Run the match (in whichever thread the pool picks).
+    void perform();
+
+  public:
+    /// The proto-MSet, using docids in the sub-database.
+    vector<Xapian::Internal::MSetItem> items;
+
+    Xapian::doccount docs_matched;
+
+    Xapian::weight greatest_wt;
+
+    Xapian::termcount greatest_wt_subqs_matched;
+
+    ShardMatch(const MultiMatch & parent, Xapian::doccount shard,
+	       Xapian::doccount max_msize_, Xapian::doccount check_at_least_,
+	       SharedMinWeight & shared_min_weight_)
+	: matcher(parent, shard), vsdoc(matcher.db), pl(NULL),
+	  max_msize(max_msize_), check_at_least(check_at_least_),
+	  sort_forward(parent.order != Xapian::Enquire::DESCENDING),
+	  mcmp(get_msetcmp_function(parent.sort_by, sort_forward,
+				    parent.sort_value_forward)),
+	  shared_min_weight(shared_min_weight_),
+	  docs_matched(0), greatest_wt(0), greatest_wt_subqs_matched(0) {
+	++vsdoc._refs;
+    }
+
+    MultiMatch * get_matcher() { return &matcher; }
+
+    void set_postlist(PostList *& pl_) { pl = &pl_; }
+};
+
+void
+ShardMatch::perform()
+{
+    LOGCALL_VOID(MATCH, "ShardMatch::perform", NO_ARGS);
+    const Xapian::Enquire::Internal::sort_setting sort_by = matcher.sort_by;
+    const bool value_first = (sort_by == VAL || sort_by == VAL_REL);
+    Xapian::weight min_weight = shared_min_weight.get();
+    unsigned until_sync = MIN_WEIGHT_SYNC_INTERVAL;
+
+    const Xapian::weight max_possible = (*pl)->recalc_maxweight();
+    matcher.recalculate_w_max = false;
+
+    items.reserve(max_msize + 1);
+    Xapian::Internal::MSetItem min_item(0.0, 0);
+    bool is_heap = false;
+
+    while (true) {
+	if (rare(matcher.recalculate_w_max)) {
+	    if (min_weight > 0.0) {
+		if (rare(matcher.getorrecalc_maxweight(*pl) < min_weight)) {
+		    LOGLINE(MATCH, "*** TERMINATING EARLY (1)");
+		    break;
+		}
+	    }
+	}
+
+	// Pick up any higher minimum weight which other shards have found.
+	if (rare(--until_sync == 0)) {
+	    until_sync = MIN_WEIGHT_SYNC_INTERVAL;
+	    Xapian::weight w = shared_min_weight.get();
+	    if (w > min_weight) {
+		LOGLINE(MATCH, "Setting min_weight to " << w <<
+			" from " << min_weight << " (shared)");
+		min_weight = w;
+		if (rare(matcher.getorrecalc_maxweight(*pl) < min_weight)) {
+		    LOGLINE(MATCH, "*** TERMINATING EARLY (4)");
+		    break;
+		}
+	    }
+	}
+
+	if (rare(next_handling_prune(*pl, min_weight, &matcher))) {
+	    LOGLINE(MATCH, "*** REPLACING ROOT");
+	    if (min_weight > 0.0) {
+		if (rare(matcher.getorrecalc_maxweight(*pl) < min_weight)) {
+		    LOGLINE(MATCH, "*** TERMINATING EARLY (2)");
+		    break;
+		}
+	    }
+	}
+
+	if (rare((*pl)->at_end())) {
+	    LOGLINE(MATCH, "Reached end of potential matches");
+	    break;
+	}
+
+	Xapian::weight wt = 0.0;
+	bool calculated_weight = false;
+	if (sort_by != VAL || min_weight > 0.0) {
+	    wt = (*pl)->get_weight();
+	    if (wt < min_weight) continue;
+	    calculated_weight = true;
+	}
+
+	Xapian::docid did = (*pl)->get_docid();
+	Xapian::Internal::MSetItem new_item(wt, did);
+	if (sort_by != REL) {
+	    vsdoc.set_document(did);
+	    bool below_min;
+	    if (value_first && min_item.did != 0 &&
+		value_sorts_below(vsdoc, matcher.sort_key,
+				  matcher.sort_value_forward, min_item)) {
+		below_min = true;
+	    } else {
+		vsdoc.get_value(matcher.sort_key).swap(new_item.sort_key);
+		below_min = !mcmp(new_item, min_item);
+	    }
+	    if (below_min) {
+		// The document can't make this shard's proto-MSet, so it
+		// can't make the merged MSet either.
+		++docs_matched;
+		if (!calculated_weight) wt = (*pl)->get_weight();
+		if (wt > greatest_wt) goto new_greatest_weight;
+		continue;
+	    }
+	}
+
+	if (!calculated_weight) {
+	    wt = (*pl)->get_weight();
+	    new_item.wt = wt;
+	}
+
+	++docs_matched;
+	if (items.size() >= max_msize) {
+	    items.push_back(new_item);
+	    if (!is_heap) {
+		is_heap = true;
+		make_heap(items.begin(), items.end(), mcmp);
+	    } else {
+		push_heap<vector<Xapian::Internal::MSetItem>::iterator,
+			  MSetCmp>(items.begin(), items.end(), mcmp);
+	    }
+	    pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
+		     MSetCmp>(items.begin(), items.end(), mcmp);
+	    items.pop_back();
+
+	    min_item = items.front();
+	    if (sort_by == REL || sort_by == REL_VAL) {
+		if (docs_matched >= check_at_least) {
+		    // Docids from a single sub-database arrive in ascending
+		    // order, so a forward boolean match of this shard is done.
+		    if (sort_by == REL && rare(max_possible == 0 && sort_forward))
+			break;
+		    if (min_item.wt > min_weight) {
+			LOGLINE(MATCH, "Setting min_weight to " <<
+				min_item.wt << " from " << min_weight);
+			min_weight = min_item.wt;
+			shared_min_weight.raise(min_weight);
+		    }
+		}
+	    }
+	    if (rare(matcher.getorrecalc_maxweight(*pl) < min_weight)) {
+		LOGLINE(MATCH, "*** TERMINATING EARLY (3)");
+		break;
+	    }
+	} else {
+	    items.push_back(new_item);
+	    is_heap = false;
+	    if (sort_by == REL && items.size() == max_msize) {
+		if (docs_matched >= check_at_least) {
+		    if (rare(max_possible == 0 && sort_forward)) break;
+		}
+	    }
+	}
+
+	if (wt > greatest_wt) {
+new_greatest_weight:
+	    greatest_wt = wt;
+	    greatest_wt_subqs_matched = (*pl)->count_matching_subqs();
+	}
+    }
+}
+
+/// Owns the ShardMatch objects for a parallel match.
+class ShardMatchList : public vector<ShardMatch *> {
+  public:
+    ~ShardMatchList() {
+	for (iterator i = begin(); i != end(); ++i) {
+	    delete *i;
+	}
+    }
+};
+
+bool
+MultiMatch::uses_posting_source(const Xapian::Query::Internal * q)
+{
+    if (q->op == Xapian::Query::Internal::OP_EXTERNAL_SOURCE) return true;
+    Xapian::Query::Internal::subquery_list::const_iterator i;
+    for (i = q->subqs.begin(); i != q->subqs.end(); ++i) {
+	if (uses_posting_source(*i)) return true;
+    }
+    return false;
+}
+
+namespace {
+
+/// The pool for matching sub-databases in parallel.
+struct MatchPool {
+    Mutex mutex;
+
+    ThreadPool pool;
+
+    MatchPool() : pool(1) { }
+};
+
+/** Runs the matches for several shards, one after another.
+ *
+ *  The match pool is shared by all Enquire objects, so may have more threads
+ *  than a particular match asked for.  Running the shards in this many groups
+ *  limits the match to the number of threads it asked for.
+ */
+class ShardMatchGroup : public ThreadPool::Task {
+    /// The shards to match.
+    vector<ShardMatch *> shards;
+
+  public:
+    void add(ShardMatch * shard) { shards.push_back(shard); }
+
+    void run() {
+	vector<ShardMatch *>::const_iterator i;
+	for (i = shards.begin(); i != shards.end(); ++i) {
+	    (*i)->run();
+	}
+    }
+};
+
+}
+
+/** Return the pool to match sub-databases in parallel with @a threads threads.
+ *
+ *  All Enquire objects share one pool, which grows to the largest number of
+ *  threads asked for.  @a threads is reduced to the number of threads the
+ *  pool actually has, if that's fewer.
+ *
+ *  Returns NULL if @a threads is less than 2, or we can't run threads on this
+ *  platform.
+ */
+static ThreadPool *
+get_match_pool(unsigned & threads)
+{
+    if (threads <= 1) return NULL;
+    // Like the block cache, the pool is deliberately never deleted, to avoid
+    // problems with the order of static destruction.
+    static MatchPool * match_pool = new MatchPool;
+    MutexLock lock(match_pool->mutex);
+    ThreadPool & pool = match_pool->pool;
+    pool.grow(threads);
+    threads = min(threads, pool.size());
+    if (threads <= 1) return NULL;
+    return &pool;
+}
+
+/// Do any of the sub-databases of @a db share a Database::Internal object?
+static bool
+has_repeated_subdatabase(const Xapian::Database & db)
+{
+    vector<const Xapian::Database::Internal *> subdbs;
+    for (size_t i = 0; i != db.internal.size(); ++i) {
+	subdbs.push_back(db.internal[i].get());
+    }
+    sort(subdbs.begin(), subdbs.end());
+    return adjacent_find(subdbs.begin(), subdbs.end()) != subdbs.end();
+}
+
 void
 MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		     Xapian::doccount check_at_least,
@@ -353,6 +764,33 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
     }
 
+    // We can run the match for each sub-database in a separate thread if
+    // they're all local and there's nothing which needs to see every
+    // candidate document in docid order (or in a single thread).  A
+    // Database::Internal object isn't safe to use in several threads at once,
+    // so the same sub-database mustn't appear twice.
+    ThreadPool * pool = NULL;
+    unsigned threads = match_threads;
+    if (leaves.size() > 1 && check_at_least != 0 &&
+	!collapse_max && !percent_cutoff &&
+	!mdecider && !sorter && matchspies.empty() &&
+	find(is_remote.begin(), is_remote.end(), true) == is_remote.end() &&
+	!uses_posting_source(query) && !has_repeated_subdatabase(db)) {
+	pool = get_match_pool(threads);
+	for (size_t i = 0; pool && i != leaves.size(); ++i) {
+	    if (!leaves[i].get()) pool = NULL;
+	}
+    }
+    SharedMinWeight shared_min_weight(weight_cutoff);
+    ShardMatchList shards;
+    if (pool) {
+	for (size_t i = 0; i != leaves.size(); ++i) {
+	    shards.push_back(new ShardMatch(*this, i, first + maxitems,
+					    check_at_least,
+					    shared_min_weight));
+	}
+    }
+
     // Get postlists and term info
     vector<PostList *> postlists;
     map<string, Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
@@ -368,7 +806,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
 	try {
-	    pl = leaves[i]->get_postlist_and_term_info(this,
+	    MultiMatch * matcher = this;
+	    if (!shards.empty()) matcher = shards[i]->get_matcher();
+	    pl = leaves[i]->get_postlist_and_term_info(matcher,
 						       termfreqandwts_ptr,
 						       &total_subqs);
 	    if (termfreqandwts_ptr && !termfreqandwts.empty())
@@ -406,7 +846,12 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     if (postlists.size() == 1) {
 	pl.reset(postlists.front());
     } else {
-	pl.reset(new MergePostList(postlists, this, vsdoc, errorhandler));
+	MergePostList * merger;
+	merger = new MergePostList(postlists, this, vsdoc, errorhandler);
+	pl.reset(merger);
+	for (size_t i = 0; i != shards.size(); ++i) {
+	    shards[i]->set_postlist(merger->get_sub_postlist(i));
+	}
     }
 
     LOGLINE(MATCH, "pl = (" << pl->get_description() << ")");
@@ -514,6 +959,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     bool sort_forward = (order != Xapian::Enquire::DESCENDING);
     MSetCmp mcmp(get_msetcmp_function(sort_by, sort_forward, sort_value_forward));
 
+    // Is the value the primary sort key?
+    const bool value_first = (sort_by == VAL || sort_by == VAL_REL);
+
     // Perform query
 
     // We form the mset in two stages.  In the first we fill up our working
@@ -529,8 +977,61 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Docids of items in the mset which have been displaced by collapsing,
+    // and are waiting to be discarded.  Removing an item from the middle of
+    // the heap would mean finding it first, so we leave it in place until it
+    // reaches the top, or until we've finished the match.
+    set<Xapian::docid> removed;
+
+    if (!shards.empty()) {
+	// Match the sub-databases in parallel, then merge their proto-MSets.
+	vector<ShardMatchGroup> groups(min(size_t(threads), shards.size()));
+	for (size_t i = 0; i != shards.size(); ++i) {
+	    groups[i % groups.size()].add(shards[i]);
+	}
+	vector<ThreadPool::Task *> tasks;
+	for (size_t i = 0; i != groups.size(); ++i) {
+	    tasks.push_back(&groups[i]);
+	}
+	pool->run(tasks);
+
+	const unsigned int multiplier = db.internal.size();
+	for (size_t i = 0; i != shards.size(); ++i) {
+	    const ShardMatch & shard = *shards[i];
+	    if (shard.failed()) {
+		try {
+		    shard.rethrow_error();
+		} catch (Xapian::Error & e) {
+		    if (!errorhandler) throw;
+		    LOGLINE(EXCEPTION, "Calling error handler for parallel "
+				       "match of a sub-database.");
+		    (*errorhandler)(e);
+		    // Continue match without this sub-database.
+		    continue;
+		}
+	    }
+	    docs_matched += shard.docs_matched;
+	    if (shard.greatest_wt > greatest_wt) {
+		greatest_wt = shard.greatest_wt;
+		greatest_wt_subqs_matched = shard.greatest_wt_subqs_matched;
+	    }
+	    vector<Xapian::Internal::MSetItem>::const_iterator j;
+	    for (j = shard.items.begin(); j != shard.items.end(); ++j) {
+		items.push_back(*j);
+		items.back().did = (j->did - 1) * multiplier + i + 1;
+	    }
+	}
+
+	if (items.size() > max_msize) {
+	    nth_element(items.begin(), items.begin() + max_msize, items.end(),
+			mcmp);
+	    items.erase(items.begin() + max_msize, items.end());
+	}
+	goto match_done;
+    }
+
     while (true) {
-	bool pushback;
+	bool replacing;
 
 	if (rare(recalculate_w_max)) {
 	    if (min_weight > 0.0) {
@@ -582,17 +1083,25 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	LOGLINE(MATCH, "Candidate document id " << did << " wt " << wt);
 	Xapian::Internal::MSetItem new_item(wt, did);
 	if (sort_by != REL) {
+	    // If the value is the primary sort key, we can usually reject a
+	    // candidate by comparing its value with min_item's in place, and
+	    // only need to fetch it as a string if it might make the proto-mset.
+	    bool below_min = false;
 	    if (sorter) {
 		new_item.sort_key = (*sorter)(doc);
+	    } else if (value_first && min_item.did != 0 &&
+		       value_sorts_below(vsdoc, sort_key, sort_value_forward,
+					 min_item)) {
+		below_min = true;
 	    } else {
-		new_item.sort_key = vsdoc.get_value(sort_key);
+		vsdoc.get_value(sort_key).swap(new_item.sort_key);
 	    }
 
 	    // We're sorting by value (in part at least), so compare the item
 	    // against the lowest currently in the proto-mset.  If sort_by is
 	    // VAL, then new_item.wt won't yet be set, but that doesn't
 	    // matter since it's not used by the sort function.
-	    if (!mcmp(new_item, min_item)) {
+	    if (below_min || !mcmp(new_item, min_item)) {
 		if (mdecider == NULL && !collapser) {
 		    // Document was definitely suitable for mset - no more
 		    // processing needed.
@@ -617,6 +1126,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		// mdecider would accept it and/or test whether it would be
 		// collapsed.
 		LOGLINE(MATCH, "Keeping candidate which sorts lower than min_item for further investigation");
+		if (below_min)
+		    vsdoc.get_value(sort_key).swap(new_item.sort_key);
 	    }
 	}
 
@@ -650,7 +1161,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    new_item.wt = wt;
 	}
 
-	pushback = true;
+	replacing = false;
 
 	// Perform collapsing on key if requested.
 	if (collapser) {
@@ -673,84 +1184,48 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		const Xapian::Internal::MSetItem & old_item =
 		    collapser.old_item;
 		// This is one of the best collapse_max potential MSet entries
-		// with this key which we've seen so far.  Check if the
-		// entry with this key which it displaced might still be in the
-		// proto-MSet.  If it might be, we need to check through for
-		// it.
+		// with this key which we've seen so far.  If the entry with this
+		// key which it displaced still ranks above min_item, then it
+		// must still be in the proto-MSet (anything ranking below
+		// min_item has been evicted), so we mark it as removed, and
+		// new_item takes its place.
 		Xapian::weight old_wt = old_item.wt;
 		if (old_wt >= min_weight && mcmp(old_item, min_item)) {
-		    // Scan through (unsorted) MSet looking for entry.
-		    // FIXME: more efficient way than just scanning?
 		    Xapian::docid olddid = old_item.did;
-		    vector<Xapian::Internal::MSetItem>::iterator i;
+		    LOGLINE(MATCH, "collapse: removing " <<
+				   olddid << ": " <<
+				   new_item.collapse_key);
+#ifdef XAPIAN_ASSERTIONS_PARANOID
+		    vector<Xapian::Internal::MSetItem>::const_iterator i;
 		    for (i = items.begin(); i != items.end(); ++i) {
-			if (i->did == olddid) {
-			    LOGLINE(MATCH, "collapse: removing " <<
-					   olddid << ": " <<
-					   new_item.collapse_key);
-			    // We can replace an arbitrary element in O(log N)
-			    // but have to do it by hand (in this case the new
-			    // elt is bigger, so we just swap down the tree).
-			    // FIXME: implement this, and clean up is_heap
-			    // handling
-			    *i = new_item;
-			    pushback = false;
-			    is_heap = false;
-			    break;
-			}
+			if (i->did == olddid) break;
 		    }
+		    Assert(i != items.end());
+#endif
+		    removed.insert(olddid);
+		    replacing = true;
 		}
 	    }
 	}
 
 	// OK, actually add the item to the mset.
-	if (pushback) {
-	    ++docs_matched;
-	    if (items.size() >= max_msize) {
-		items.push_back(new_item);
-		if (!is_heap) {
-		    is_heap = true;
-		    make_heap(items.begin(), items.end(), mcmp);
-		} else {
-		    push_heap<vector<Xapian::Internal::MSetItem>::iterator,
-			      MSetCmp>(items.begin(), items.end(), mcmp);
-		}
-		pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
-			 MSetCmp>(items.begin(), items.end(), mcmp);
-		items.pop_back();
-
-		min_item = items.front();
-		if (sort_by == REL || sort_by == REL_VAL) {
-		    if (docs_matched >= check_at_least) {
-			if (sort_by == REL) {
-			    // We're done if this is a forward boolean match
-			    // with only one database (bodgetastic, FIXME
-			    // better if we can!)
-			    if (rare(max_possible == 0 && sort_forward)) {
-				// In the multi database case, MergePostList
-				// currently processes each database
-				// sequentially (which actually may well be
-				// more efficient) so the docids in general
-				// won't arrive in order.
-				if (leaves.size() == 1) break;
-			    }
-			}
-			if (min_item.wt > min_weight) {
-			    LOGLINE(MATCH, "Setting min_weight to " <<
-				    min_item.wt << " from " << min_weight);
-			    min_weight = min_item.wt;
-			}
-		    }
-		}
-		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
-		    LOGLINE(MATCH, "*** TERMINATING EARLY (3)");
-		    break;
-		}
+	if (!replacing) ++docs_matched;
+	if (items.size() - removed.size() >= max_msize) {
+	    items.push_back(new_item);
+	    if (!is_heap) {
+		is_heap = true;
+		make_heap(items.begin(), items.end(), mcmp);
 	    } else {
-		items.push_back(new_item);
-		is_heap = false;
-		if (sort_by == REL && items.size() == max_msize) {
-		    if (docs_matched >= check_at_least) {
+		push_heap<vector<Xapian::Internal::MSetItem>::iterator,
+			  MSetCmp>(items.begin(), items.end(), mcmp);
+	    }
+	    pop_lowest_item(items, removed, mcmp);
+	    discard_removed_items(items, removed, mcmp);
+
+	    min_item = items.front();
+	    if (sort_by == REL || sort_by == REL_VAL) {
+		if (docs_matched >= check_at_least) {
+		    if (sort_by == REL) {
 			// We're done if this is a forward boolean match
 			// with only one database (bodgetastic, FIXME
 			// better if we can!)
@@ -763,6 +1238,33 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    if (leaves.size() == 1) break;
 			}
 		    }
+		    if (min_item.wt > min_weight) {
+			LOGLINE(MATCH, "Setting min_weight to " <<
+				min_item.wt << " from " << min_weight);
+			min_weight = min_item.wt;
+		    }
+		}
+	    }
+	    if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
+		LOGLINE(MATCH, "*** TERMINATING EARLY (3)");
+		break;
+	    }
+	} else {
+	    items.push_back(new_item);
+	    is_heap = false;
+	    if (sort_by == REL && items.size() - removed.size() == max_msize) {
+		if (docs_matched >= check_at_least) {
+		    // We're done if this is a forward boolean match
+		    // with only one database (bodgetastic, FIXME
+		    // better if we can!)
+		    if (rare(max_possible == 0 && sort_forward)) {
+			// In the multi database case, MergePostList
+			// currently processes each database
+			// sequentially (which actually may well be
+			// more efficient) so the docids in general
+			// won't arrive in order.
+			if (leaves.size() == 1) break;
+		    }
 		}
 	    }
 	}
@@ -799,6 +1301,7 @@ new_greatest_weight:
 			pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
 				 MSetCmp>(items.begin(), items.end(), mcmp);
 			Assert(items.back().wt < min_weight);
+			if (!removed.empty()) removed.erase(items.back().did);
 			items.pop_back();
 		    }
 #ifdef XAPIAN_ASSERTIONS_PARANOID
@@ -812,9 +1315,23 @@ new_greatest_weight:
 	}
     }
 
+match_done:
     // done with posting list tree
     pl.reset(NULL);
 
+    if (!removed.empty()) {
+	// Discard any items displaced by collapsing which are still present.
+	vector<Xapian::Internal::MSetItem>::iterator i, j = items.begin();
+	for (i = items.begin(); i != items.end(); ++i) {
+	    if (removed.find(i->did) == removed.end()) {
+		if (i != j) swap(*i, *j);
+		++j;
+	    }
+	}
+	items.erase(j, items.end());
+	is_heap = false;
+    }
+
     double percent_scale = 0;
     if (!items.empty() && greatest_wt > 0) {
 	// Find the document with the highest weight, then total up the
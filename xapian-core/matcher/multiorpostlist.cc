@@ -0,0 +1,360 @@
+/** @file multiorpostlist.cc
+ * @brief N-way OR postlist with WAND-style pruning
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "multiorpostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+
+using namespace std;
+
+void
+MultiOrPostList::allocate_arrays()
+{
+    plist = new PostList * [n_kids];
+    try {
+	max_wt = new Xapian::weight [n_kids];
+	pos = new size_t [n_kids];
+    } catch (...) {
+	delete [] plist;
+	plist = NULL;
+	delete [] max_wt;
+	max_wt = NULL;
+	throw;
+    }
+}
+
+MultiOrPostList::~MultiOrPostList()
+{
+    if (plist) {
+	for (size_t i = 0; i < n_kids; ++i) {
+	    delete plist[i];
+	}
+	delete [] plist;
+    }
+    delete [] max_wt;
+    delete [] pos;
+}
+
+void
+MultiOrPostList::next_helper(size_t n, Xapian::weight w_min)
+{
+    PostList * res = plist[n]->next(new_min(w_min, n));
+    if (res) {
+	delete plist[n];
+	plist[n] = res;
+	matcher->recalc_maxweight();
+    }
+}
+
+void
+MultiOrPostList::skip_to_helper(size_t n, Xapian::docid did_min,
+				Xapian::weight w_min)
+{
+    PostList * res = plist[n]->skip_to(did_min, new_min(w_min, n));
+    if (res) {
+	delete plist[n];
+	plist[n] = res;
+	matcher->recalc_maxweight();
+    }
+}
+
+void
+MultiOrPostList::erase_sublist(size_t n)
+{
+    Assert(plist[n]->at_end());
+    delete plist[n];
+    max_total -= max_wt[n];
+    --n_kids;
+    for (size_t i = n; i < n_kids; ++i) {
+	plist[i] = plist[i + 1];
+	max_wt[i] = max_wt[i + 1];
+	pos[i] = pos[i + 1];
+    }
+    matcher->recalc_maxweight();
+}
+
+void
+MultiOrPostList::sort_sublists()
+{
+    // Only a few sub-postlists move each time, and there aren't many of
+    // them, so an insertion sort is a good choice.
+    for (size_t i = 1; i < n_kids; ++i) {
+	PostList * pl = plist[i];
+	Xapian::weight wt = max_wt[i];
+	size_t pl_pos = pos[i];
+	Xapian::docid pl_did = pl->get_docid();
+	size_t j = i;
+	while (j > 0) {
+	    Xapian::docid prev_did = plist[j - 1]->get_docid();
+	    if (prev_did < pl_did) break;
+	    if (prev_did == pl_did && pos[j - 1] < pl_pos) break;
+	    plist[j] = plist[j - 1];
+	    max_wt[j] = max_wt[j - 1];
+	    pos[j] = pos[j - 1];
+	    --j;
+	}
+	plist[j] = pl;
+	max_wt[j] = wt;
+	pos[j] = pl_pos;
+    }
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_min() const
+{
+    // The number of matching documents is minimised when all the other
+    // sub-postlists are subsets of the one with the largest minimum.
+    // erase_sublist() may have removed all the sub-postlists.
+    if (n_kids == 0) return 0;
+    Xapian::doccount result = plist[0]->get_termfreq_min();
+    for (size_t i = 1; i < n_kids; ++i) {
+	result = max(result, plist[i]->get_termfreq_min());
+    }
+    return result;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_max() const
+{
+    // Maximum is if all sub-postlists are disjoint.
+    if (n_kids == 0) return 0;
+    Xapian::doccount result = plist[0]->get_termfreq_max();
+    for (size_t i = 1; i < n_kids; ++i) {
+	Xapian::doccount tf_max = plist[i]->get_termfreq_max();
+	Xapian::doccount old_result = result;
+	result += tf_max;
+	// Catch overflowing the type too.
+	if (result < old_result || result >= db_size)
+	    return db_size;
+    }
+    return result;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_est() const
+{
+    // We calculate the estimate assuming independence:
+    // P(a or b or ...) = 1 - (1 - P(a)) . (1 - P(b)) ...
+    double scale = 1.0 / db_size;
+    double P_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	P_none *= 1.0 - plist[i]->get_termfreq_est() * scale;
+    }
+    return static_cast<Xapian::doccount>((1.0 - P_none) * db_size + 0.5);
+}
+
+TermFreqs
+MultiOrPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "MultiOrPostList::get_termfreq_est_using_stats", stats);
+    // We calculate the estimate assuming independence, as above.
+
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double scale = 1.0 / stats.collection_size;
+    double P_none = 1.0;
+    double Pr_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	TermFreqs freqs(plist[i]->get_termfreq_est_using_stats(stats));
+	P_none *= 1.0 - freqs.termfreq * scale;
+	// If the rset is empty, the reltermfreq estimate is 0 anyway.
+	if (stats.rset_size != 0)
+	    Pr_none *= 1.0 - double(freqs.reltermfreq) / stats.rset_size;
+    }
+    double Pr_est = (stats.rset_size != 0) ? 1.0 - Pr_none : 0.0;
+    RETURN(TermFreqs(Xapian::doccount((1.0 - P_none) * stats.collection_size + 0.5),
+		     Xapian::doccount(Pr_est * stats.rset_size + 0.5)));
+}
+
+Xapian::weight
+MultiOrPostList::get_maxweight() const
+{
+    LOGCALL(MATCH, Xapian::weight, "MultiOrPostList::get_maxweight", NO_ARGS);
+    RETURN(max_total);
+}
+
+Xapian::docid
+MultiOrPostList::get_docid() const
+{
+    Assert(did);
+    return did;
+}
+
+Xapian::termcount
+MultiOrPostList::get_doclength() const
+{
+    Assert(did);
+    // The sub-postlists are in docid order, so the first is at did.
+    AssertEq(plist[0]->get_docid(), did);
+    return plist[0]->get_doclength();
+}
+
+Xapian::weight
+MultiOrPostList::get_weight() const
+{
+    Assert(did);
+    Xapian::weight result = 0;
+    for (size_t i = 0; i < n_kids && plist[i]->get_docid() == did; ++i) {
+	result += plist[i]->get_weight();
+    }
+    return result;
+}
+
+bool
+MultiOrPostList::at_end() const
+{
+    return (did == 0);
+}
+
+Xapian::weight
+MultiOrPostList::recalc_maxweight()
+{
+    LOGCALL(MATCH, Xapian::weight, "MultiOrPostList::recalc_maxweight", NO_ARGS);
+    max_total = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	Xapian::weight new_max = plist[i]->recalc_maxweight();
+	max_wt[i] = new_max;
+	max_total += new_max;
+    }
+    RETURN(max_total);
+}
+
+PostList *
+MultiOrPostList::find_next_match(Xapian::weight w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::find_next_match", w_min);
+    while (true) {
+	for (size_t i = 0; i < n_kids; ) {
+	    if (plist[i]->at_end()) {
+		erase_sublist(i);
+	    } else {
+		++i;
+	    }
+	}
+
+	if (n_kids <= 1) {
+	    did = 0;
+	    if (n_kids == 0) RETURN(NULL);
+	    n_kids = 0;
+	    RETURN(plist[0]);
+	}
+
+	sort_sublists();
+
+	// Find the pivot - the first sub-postlist at which the total of the
+	// maximum weights reaches w_min.
+	size_t pivot = 0;
+	Xapian::weight w = max_wt[0];
+	while (w < w_min) {
+	    if (++pivot == n_kids) {
+		// Even a document matching every remaining sub-postlist can't
+		// reach w_min, so we're done.
+		LOGLINE(MATCH, "No document can reach w_min " << w_min);
+		did = 0;
+		RETURN(NULL);
+	    }
+	    w += max_wt[pivot];
+	}
+
+	Xapian::docid pivot_did = plist[pivot]->get_docid();
+	if (plist[0]->get_docid() == pivot_did) {
+	    did = pivot_did;
+	    RETURN(NULL);
+	}
+
+	// No document before pivot_did can reach w_min, since only the
+	// sub-postlists before the pivot can match it.  So move those on.
+	for (size_t i = 0; i < pivot; ++i) {
+	    if (plist[i]->get_docid() < pivot_did)
+		skip_to_helper(i, pivot_did, w_min);
+	}
+    }
+}
+
+PostList *
+MultiOrPostList::next(Xapian::weight w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::next", w_min);
+    if (did == 0) {
+	// This is the first call, so start all the sub-postlists.
+	for (size_t i = 0; i < n_kids; ++i) {
+	    next_helper(i, w_min);
+	}
+    } else {
+	for (size_t i = 0; i < n_kids && plist[i]->get_docid() == did; ++i) {
+	    next_helper(i, w_min);
+	}
+    }
+    RETURN(find_next_match(w_min));
+}
+
+PostList *
+MultiOrPostList::skip_to(Xapian::docid did_min, Xapian::weight w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::skip_to", did_min | w_min);
+    if (did == 0) {
+	// This is the first call, so start all the sub-postlists.
+	for (size_t i = 0; i < n_kids; ++i) {
+	    skip_to_helper(i, did_min, w_min);
+	}
+    } else {
+	// Don't skip backwards.
+	if (did_min <= did) RETURN(NULL);
+	for (size_t i = 0; i < n_kids && plist[i]->get_docid() < did_min; ++i) {
+	    skip_to_helper(i, did_min, w_min);
+	}
+    }
+    RETURN(find_next_match(w_min));
+}
+
+string
+MultiOrPostList::get_description() const
+{
+    string desc("(");
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (i) desc += " OR ";
+	desc += plist[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+MultiOrPostList::get_wdf() const
+{
+    Xapian::termcount totwdf = 0;
+    for (size_t i = 0; i < n_kids && plist[i]->get_docid() == did; ++i) {
+	totwdf += plist[i]->get_wdf();
+    }
+    return totwdf;
+}
+
+Xapian::termcount
+MultiOrPostList::count_matching_subqs() const
+{
+    Xapian::termcount total = 0;
+    for (size_t i = 0; i < n_kids && plist[i]->get_docid() == did; ++i) {
+	total += plist[i]->count_matching_subqs();
+    }
+    return total;
+}
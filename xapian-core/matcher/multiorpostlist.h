@@ -0,0 +1,160 @@
+/** @file multiorpostlist.h
+ * @brief N-way OR postlist with WAND-style pruning
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+#define XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+
+#include "postlist.h"
+#include <algorithm>
+
+class MultiMatch;
+
+/** N-way OR postlist.
+ *
+ *  This is used for weighted OR queries with many subqueries, where a tree
+ *  of binary OrPostList objects can only prune a branch once w_min exceeds
+ *  the maximum weight of a whole subtree.
+ *
+ *  The sub-postlists are kept in ascending docid order, and next() uses WAND
+ *  pivoting: summing the maximum weights of the sub-postlists in that order,
+ *  the first one which brings the total up to w_min is the "pivot", and no
+ *  document before the pivot's current docid can reach w_min.  So the
+ *  sub-postlists before the pivot can skip straight to it, passing on a
+ *  minimum weight which lets a leaf postlist skip whole blocks of postings.
+ */
+class MultiOrPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const MultiOrPostList &);
+
+    /// Don't allow copying.
+    MultiOrPostList(const MultiOrPostList &);
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// The number of sub-postlists.
+    size_t n_kids;
+
+    /// Array of pointers to sub-postlists, in ascending docid order.
+    PostList ** plist;
+
+    /// Array of maximum weights for the sub-postlists.
+    Xapian::weight * max_wt;
+
+    /** Array of the original positions of the sub-postlists.
+     *
+     *  Sub-postlists at the same docid are kept in this order, so that the
+     *  weight of a document is always summed in the same order - otherwise
+     *  rounding can make documents with equal weights compare differently.
+     */
+    size_t * pos;
+
+    /// Total maximum weight (== sum of max_wt values).
+    Xapian::weight max_total;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    MultiMatch *matcher;
+
+    /// Calculate the new minimum weight for sub-postlist n.
+    Xapian::weight new_min(Xapian::weight w_min, size_t n) {
+	return w_min - (max_total - max_wt[n]);
+    }
+
+    /// Call next on a sub-postlist n, and handle any pruning.
+    void next_helper(size_t n, Xapian::weight w_min);
+
+    /// Call skip_to on a sub-postlist n, and handle any pruning.
+    void skip_to_helper(size_t n, Xapian::docid did_min, Xapian::weight w_min);
+
+    /// Erase sub-postlist n, which must be at_end().
+    void erase_sublist(size_t n);
+
+    /// Restore ascending docid order after sub-postlists have moved.
+    void sort_sublists();
+
+    /** Allocate plist, max_wt and pos arrays of @a n_kids each.
+     *
+     *  @exceptions  std::bad_alloc.
+     */
+    void allocate_arrays();
+
+    /// Advance the sub-postlists to the next document which might match.
+    PostList * find_next_match(Xapian::weight w_min);
+
+  public:
+    /** Construct from 2 random-access iterators to a container of PostList*,
+     *  a pointer to the matcher, and the document collection size.
+     */
+    template <class RandomItor>
+    MultiOrPostList(RandomItor pl_begin, RandomItor pl_end,
+		    MultiMatch * matcher_, Xapian::doccount db_size_)
+	: did(0), n_kids(pl_end - pl_begin), plist(NULL), max_wt(NULL),
+	  pos(NULL),
+	  max_total(0), db_size(db_size_), matcher(matcher_)
+    {
+	allocate_arrays();
+	std::copy(pl_begin, pl_end, plist);
+	std::fill_n(max_wt, n_kids, 0);
+	for (size_t i = 0; i < n_kids; ++i) pos[i] = i;
+    }
+
+    ~MultiOrPostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    Xapian::weight get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::weight get_weight() const;
+
+    bool at_end() const;
+
+    Xapian::weight recalc_maxweight();
+
+    Internal *next(Xapian::weight w_min);
+
+    Internal *skip_to(Xapian::docid, Xapian::weight w_min);
+
+    std::string get_description() const;
+
+    /** get_wdf() for MultiOrPostlists returns the sum of the wdfs of the
+     *  sub postlists which match the current docid.
+     *
+     *  The wdf isn't really meaningful in many situations, but if the lists
+     *  are being combined as a synonym we want the sum of the wdfs, so we do
+     *  that in general.
+     */
+    Xapian::termcount get_wdf() const;
+
+    Xapian::termcount count_matching_subqs() const;
+};
+
+#endif // XAPIAN_INCLUDED_MULTIORPOSTLIST_H
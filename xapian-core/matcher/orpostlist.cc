@@ -124,6 +124,14 @@ OrPostList::next(Xapian::weight w_min)
     RETURN(ret);
 }
 
+void
+OrPostList::prefetch_skip_to(Xapian::docid did)
+{
+    LOGCALL_VOID(MATCH, "OrPostList::prefetch_skip_to", did);
+    if (lhead < did) l->prefetch_skip_to(did);
+    if (rhead < did) r->prefetch_skip_to(did);
+}
+
 PostList *
 OrPostList::skip_to(Xapian::docid did, Xapian::weight w_min)
 {
@@ -56,6 +56,7 @@ class OrPostList : public BranchPostList {
 	PostList *next(Xapian::weight w_min);
 	PostList *skip_to(Xapian::docid did, Xapian::weight w_min);
 	PostList *check(Xapian::docid did, Xapian::weight w_min, bool &valid);
+	void prefetch_skip_to(Xapian::docid did);
 	bool   at_end() const;
 
 	std::string get_description() const;
@@ -30,12 +30,15 @@
 #include "emptypostlist.h"
 #include "exactphrasepostlist.h"
 #include "externalpostlist.h"
+#include "leafpostlist.h"
 #include "multiandpostlist.h"
 #include "multimatch.h"
+#include "multiorpostlist.h"
 #include "multixorpostlist.h"
 #include "omassert.h"
 #include "omqueryinternal.h"
 #include "orpostlist.h"
+#include "phrasepairs.h"
 #include "phrasepostlist.h"
 #include "postlist.h"
 #include "valuegepostlist.h"
@@ -48,6 +51,16 @@
 
 using namespace std;
 
+/** The number of subqueries at which a weighted OR uses MultiOrPostList.
+ *
+ *  With only a few subqueries, a tree of OrPostList objects works well as
+ *  branches decay to AND and AND_MAYBE as w_min rises.  With more, w_min
+ *  needs to exceed the maximum weight of a whole subtree before that
+ *  happens, whereas MultiOrPostList can skip ahead using any subset of the
+ *  subqueries.
+ */
+static const size_t MULTIOR_MIN_SUBQUERIES = 8;
+
 PostList *
 QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor)
 {
@@ -230,6 +243,19 @@ QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor,
     Xapian::Query::Internal::op_t op = query->op;
     Assert(is_and_like(op));
 
+    const Xapian::Query::Internal::subquery_list &queries = query->subqs;
+    AssertRel(queries.size(), >=, 2);
+
+    // If the database has phrase pair terms, we can use those to filter the
+    // candidates for an exact phrase, and for a two word phrase they're all
+    // we need.
+    vector<PostList *> pair_plists;
+    if (op == Xapian::Query::OP_PHRASE &&
+	query->parameter == queries.size() &&
+	do_phrase_pairs(query, pair_plists)) {
+	op = Xapian::Query::OP_AND;
+    }
+
     bool positional = false;
     if (op == Xapian::Query::OP_PHRASE || op == Xapian::Query::OP_NEAR) {
 	// If this sub-database has no positional information, change
@@ -242,9 +268,6 @@ QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor,
 	}
     }
 
-    const Xapian::Query::Internal::subquery_list &queries = query->subqs;
-    AssertRel(queries.size(), >=, 2);
-
     for (size_t i = 0; i != queries.size(); ++i) {
 	// The second branch of OP_FILTER is always boolean.
 	if (i == 1 && op == Xapian::Query::OP_FILTER) factor = 0.0;
@@ -266,6 +289,63 @@ QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor,
 
 	pos_filters.push_back(PosFilter(op, begin, end, window));
     }
+
+    // Add the pair terms after the positional filter's terms.
+    and_plists.insert(and_plists.end(), pair_plists.begin(), pair_plists.end());
+}
+
+bool
+QueryOptimiser::have_phrase_pairs()
+{
+    if (phrase_pairs < 0) {
+	phrase_pairs = (db_size != 0 &&
+			db.get_termfreq(PHRASE_PAIRS_MARKER) == db_size);
+    }
+    return phrase_pairs;
+}
+
+bool
+QueryOptimiser::do_phrase_pairs(const Xapian::Query::Internal *query,
+				vector<PostList *> & and_plists)
+{
+    LOGCALL(MATCH, bool, "QueryOptimiser::do_phrase_pairs", query | and_plists);
+    AssertEq(query->op, Xapian::Query::OP_PHRASE);
+
+    const Xapian::Query::Internal::subquery_list &queries = query->subqs;
+    Xapian::Query::Internal::subquery_list::const_iterator q;
+    for (q = queries.begin(); q != queries.end(); ++q) {
+	// We can only handle a phrase of terms which could have been
+	// generated by TermGenerator.
+	const Xapian::Query::Internal * subq = *q;
+	if (subq->op != Xapian::Query::Internal::OP_LEAF ||
+	    subq->tname.empty() ||
+	    subq->tname.find(PHRASE_PAIRS_SEPARATOR) != string::npos) {
+	    RETURN(false);
+	}
+    }
+
+    if (!have_phrase_pairs()) RETURN(false);
+
+    bool all_pairs = true;
+    for (q = queries.begin() + 1; q != queries.end(); ++q) {
+	const string & first = q[-1]->tname;
+	const string & second = q[0]->tname;
+	if (phrase_pair_too_long(first, second)) {
+	    // TermGenerator won't have indexed this pair, but the others
+	    // can still narrow down the candidates.
+	    all_pairs = false;
+	    continue;
+	}
+	// The LeafPostList defaults to boolean weighting, which is what we
+	// want as the pair terms aren't part of the query as far as the user
+	// is concerned.
+	and_plists.push_back(db.open_post_list(make_phrase_pair_term(first,
+								     second)));
+    }
+
+    // The pair terms alone only prove a two word phrase - for a longer
+    // phrase the pairs could occur in different places in the document.
+    RETURN(all_pairs && queries.size() == 2);
 }
 
 /** Class providing an operator which sorts postlists to select max or terms.
@@ -379,6 +459,12 @@ QueryOptimiser::do_or_like(const Xapian::Query::Internal *query, double factor)
 	}
     }
 
+    if (factor != 0.0 && op != Xapian::Query::OP_SYNONYM &&
+	postlists.size() >= MULTIOR_MIN_SUBQUERIES) {
+	RETURN(new MultiOrPostList(postlists.begin(), postlists.end(),
+				   matcher, db_size));
+    }
+
     // Make postlists into a heap so that the postlist with the greatest term
     // frequency is at the top of the heap.
     make_heap(postlists.begin(), postlists.end(),
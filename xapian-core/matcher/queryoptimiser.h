@@ -51,6 +51,27 @@ class QueryOptimiser {
      */
     Xapian::termcount total_subqs;
 
+    /** Whether every document in db has phrase pair terms.
+     *
+     *  -1 means we haven't checked yet.
+     */
+    int phrase_pairs;
+
+    /// Check if we can use phrase pair terms for this database.
+    bool have_phrase_pairs();
+
+    /** Try to use phrase pair terms for an exact phrase subquery.
+     *
+     *  @param query	    The OP_PHRASE subquery.
+     *  @param and_plists   Append PostLists for the pair terms (which
+     *			    contribute no weight) to this vector.
+     *
+     *  @return		true if the pair terms prove the phrase matches, so
+     *			no positional check is needed.
+     */
+    bool do_phrase_pairs(const Xapian::Query::Internal *query,
+			 std::vector<PostList *> & and_plists);
+
     /** Optimise a Xapian::Query::Internal subtree into a PostList subtree.
      *
      *  @param query	The subtree to optimise.
@@ -109,7 +130,7 @@ class QueryOptimiser {
 		   LocalSubMatch & localsubmatch_,
 		   MultiMatch * matcher_)
 	: db(db_), db_size(db.get_doccount()), localsubmatch(localsubmatch_),
-	  matcher(matcher_), total_subqs(0) { }
+	  matcher(matcher_), total_subqs(0), phrase_pairs(-1) { }
 
     PostList * optimise_query(const Xapian::Query::Internal * query) {
 	return do_subquery(query, 1.0);
@@ -28,14 +28,32 @@
 #include "remote-database.h"
 #include "weightinternal.h"
 
+/// MSetPostList which reads the MSet items from the server as they're needed.
+class RemoteMSetPostList : public MSetPostList {
+    /// The remote database to read items from.
+    RemoteDatabase *db;
+
+  public:
+    RemoteMSetPostList(const Xapian::MSet & mset, bool decreasing_relevance_,
+		       Xapian::doccount mset_size_, RemoteDatabase *db_)
+	: MSetPostList(mset, decreasing_relevance_, mset_size_), db(db_) { }
+
+    void read_items() {
+	if (!db->get_mset_items(mset_internal->items))
+	    throw Xapian::NetworkError("MSet items missing from results");
+    }
+};
+
 RemoteSubMatch::RemoteSubMatch(RemoteDatabase *db_,
 			       bool decreasing_relevance_,
+			       bool lazy_items_,
 			       const vector<Xapian::MatchSpy *> & matchspies_)
 	: db(db_),
 	  decreasing_relevance(decreasing_relevance_),
+	  lazy_items(lazy_items_),
 	  matchspies(matchspies_)
 {
-    LOGCALL_CTOR(MATCH, "RemoteSubMatch", db_ | decreasing_relevance_ | matchspies_);
+    LOGCALL_CTOR(MATCH, "RemoteSubMatch", db_ | decreasing_relevance_ | lazy_items_ | matchspies_);
 }
 
 bool
@@ -66,11 +84,18 @@ RemoteSubMatch::get_postlist_and_term_info(MultiMatch *,
 {
     LOGCALL(MATCH, PostList *, "RemoteSubMatch::get_postlist_and_term_info", Literal("[matcher]") | termfreqandwts | total_subqs_ptr);
     Xapian::MSet mset;
-    db->get_mset(mset, matchspies);
+    Xapian::doccount mset_size = db->get_mset_header(mset, matchspies);
     percent_factor = mset.internal->percent_factor;
     if (termfreqandwts) *termfreqandwts = mset.internal->termfreqandwts;
     // For remote databases we report percent_factor rather than counting the
     // number of subqueries.
     (void)total_subqs_ptr;
-    return new MSetPostList(mset, decreasing_relevance);
+    // The server sends the items in batches after the header, so with
+    // lazy_items we can start merging as soon as the first batch arrives.
+    // If the matcher doesn't need all the items, the rest are discarded
+    // before the next message is sent to this server.
+    if (!lazy_items) {
+	while (db->get_mset_items(mset.internal->items)) { }
+    }
+    return new RemoteMSetPostList(mset, decreasing_relevance, mset_size, db);
 }
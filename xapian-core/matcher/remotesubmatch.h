@@ -47,6 +47,13 @@ class RemoteSubMatch : public SubMatch {
      */
     bool decreasing_relevance;
 
+    /** Should MSet items be read from the server as they're needed?
+     *
+     *  This is only safe if the matcher doesn't need to talk to the server
+     *  while working through the items (e.g. to fetch values to sort on).
+     */
+    bool lazy_items;
+
     /// The factor to use to convert weights to percentages.
     double percent_factor;
 
@@ -57,6 +64,7 @@ class RemoteSubMatch : public SubMatch {
     /// Constructor.
     RemoteSubMatch(RemoteDatabase *db_,
 		   bool decreasing_relevance_,
+		   bool lazy_items_,
 		   const vector<Xapian::MatchSpy *> & matchspies);
 
     /// Fetch and collate statistics.
@@ -34,11 +34,11 @@ ValueGePostList::next(Xapian::weight)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    // end is empty, which next_in_range() takes to mean no upper bound.
+    valuelist->next_in_range(begin, end);
     while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
+	if (valuelist->compare_value(begin) >= 0) return NULL;
+	valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
@@ -49,11 +49,10 @@ ValueGePostList::skip_to(Xapian::docid did, Xapian::weight)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    valuelist->skip_to_in_range(did, begin, end);
     while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
+	if (valuelist->compare_value(begin) >= 0) return NULL;
+	valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
@@ -69,8 +68,7 @@ ValueGePostList::check(Xapian::docid did, Xapian::weight, bool &valid)
     if (!valid) {
 	return NULL;
     }
-    const string & v = valuelist->get_value();
-    valid = (v >= begin);
+    valid = (valuelist->compare_value(begin) >= 0);
     return NULL;
 }
 
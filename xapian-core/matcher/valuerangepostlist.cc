@@ -121,13 +121,13 @@ ValueRangePostList::next(Xapian::weight)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    valuelist->next_in_range(begin, end);
     while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
+	if (valuelist->compare_value(begin) >= 0 &&
+	    valuelist->compare_value(end) <= 0) {
 	    return NULL;
 	}
-	valuelist->next();
+	valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
@@ -138,13 +138,13 @@ ValueRangePostList::skip_to(Xapian::docid did, Xapian::weight)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    valuelist->skip_to_in_range(did, begin, end);
     while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
+	if (valuelist->compare_value(begin) >= 0 &&
+	    valuelist->compare_value(end) <= 0) {
 	    return NULL;
 	}
-	valuelist->next();
+	valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
@@ -160,8 +160,8 @@ ValueRangePostList::check(Xapian::docid did, Xapian::weight, bool &valid)
     if (!valid) {
 	return NULL;
     }
-    const string & v = valuelist->get_value();
-    valid = (v >= begin && v <= end);
+    valid = (valuelist->compare_value(begin) >= 0 &&
+	     valuelist->compare_value(end) <= 0);
     return NULL;
 }
 
@@ -51,8 +51,8 @@ ValueStreamDocument::new_subdb(int n)
     clear_valuelists(valuelists);
 }
 
-string
-ValueStreamDocument::do_get_value(Xapian::valueno slot) const
+ValueList *
+ValueStreamDocument::get_value_list(Xapian::valueno slot) const
 {
 #ifdef XAPIAN_ASSERTIONS_PARANOID
     if (!doc) {
@@ -72,7 +72,7 @@ ValueStreamDocument::do_get_value(Xapian::valueno slot) const
 	vl = ret.first->second;
 	if (!vl) {
 	    AssertEqParanoid(string(), doc->get_value(slot));
-	    return string();
+	    return NULL;
 	}
     }
 
@@ -84,14 +84,28 @@ ValueStreamDocument::do_get_value(Xapian::valueno slot) const
 	    delete vl;
 	    ret.first->second = NULL;
 	} else if (vl->get_docid() == sub_did) {
-	    Assert(vl);
-	    string v = vl->get_value();
-	    AssertEq(v, doc->get_value(slot));
-	    return v;
+	    AssertEq(vl->get_value(), doc->get_value(slot));
+	    return vl;
 	}
     }
     AssertEqParanoid(string(), doc->get_value(slot));
-    return string();
+    return NULL;
+}
+
+string
+ValueStreamDocument::do_get_value(Xapian::valueno slot) const
+{
+    ValueList * vl = get_value_list(slot);
+    if (!vl) return string();
+    return vl->get_value();
+}
+
+int
+ValueStreamDocument::compare_value(Xapian::valueno slot, const string & s) const
+{
+    ValueList * vl = get_value_list(slot);
+    if (!vl) return s.empty() ? 0 : -1;
+    return vl->compare_value(s);
 }
 
 void
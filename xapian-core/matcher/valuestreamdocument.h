@@ -62,7 +62,20 @@ class ValueStreamDocument : public Xapian::Document::Internal {
 	return ValueStreamDocument::do_get_value(slot);
     }
 
+    /** Compare the value in slot @a slot with @a s.
+     *
+     *  The result is as for std::string::compare().  This allows the matcher
+     *  to reject a candidate without constructing a string for its value.
+     */
+    int compare_value(Xapian::valueno slot, const string & s) const;
+
   private:
+    /** Return a value list positioned on the current document.
+     *
+     *  Returns NULL if the current document has no value in slot @a slot.
+     */
+    ValueList * get_value_list(Xapian::valueno slot) const;
+
     /** Implementation of virtual methods @{ */
     string do_get_value(Xapian::valueno slot) const;
     void do_get_all_values(map<Xapian::valueno, string> & values_) const;
@@ -0,0 +1,155 @@
+/** @file databasepool.cc
+ * @brief A pool of open read-only databases shared between connections.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "databasepool.h"
+
+#include <xapian/error.h>
+
+#include "autoptr.h"
+#include "database.h"
+#include "debuglog.h"
+#include "omassert.h"
+#include "serialise.h"
+
+using namespace std;
+
+DatabasePool::DatabasePool(const vector<string> & dbpaths_, size_t max_free_)
+    : dbpaths(dbpaths_), max_free(max_free_)
+{
+    LOGCALL_CTOR(REMOTE, "DatabasePool", dbpaths_.size() | max_free_);
+    Assert(!dbpaths.empty());
+}
+
+DatabasePool::~DatabasePool()
+{
+    LOGCALL_DTOR(REMOTE, "DatabasePool");
+    list<Entry>::const_iterator i;
+    for (i = free_dbs.begin(); i != free_dbs.end(); ++i) {
+	delete i->db;
+    }
+}
+
+Xapian::Database *
+DatabasePool::open_database() const
+{
+    AutoPtr<Xapian::Database> db(new Xapian::Database(dbpaths[0]));
+    vector<string>::const_iterator i(dbpaths.begin());
+    for (++i; i != dbpaths.end(); ++i) {
+	db->add_database(Xapian::Database(*i));
+    }
+    return db.release();
+}
+
+string
+DatabasePool::get_revision(const Xapian::Database & db)
+{
+    string result;
+    for (size_t i = 0; i != db.internal.size(); ++i) {
+	string rev;
+	try {
+	    rev = db.internal[i]->get_revision_info();
+	} catch (const Xapian::UnimplementedError &) {
+	    return string();
+	}
+	result += encode_length(rev.size());
+	result += rev;
+    }
+    return result;
+}
+
+Xapian::Database *
+DatabasePool::acquire(string & revision, bool latest)
+{
+    LOGCALL(REMOTE, Xapian::Database *, "DatabasePool::acquire", revision | latest);
+    Xapian::Database * db = NULL;
+    {
+	MutexLock lock(mutex);
+	list<Entry>::iterator i;
+	for (i = free_dbs.begin(); i != free_dbs.end(); ++i) {
+	    if (latest || revision.empty() || i->revision.empty() ||
+		i->revision == revision) {
+		db = i->db;
+		free_dbs.erase(i);
+		break;
+	    }
+	}
+    }
+
+    if (db) {
+	if (latest) {
+	    try {
+		db->reopen();
+	    } catch (...) {
+		delete db;
+		throw;
+	    }
+	    revision = get_revision(*db);
+	}
+	RETURN(db);
+    }
+
+    db = open_database();
+    string new_revision;
+    try {
+	new_revision = get_revision(*db);
+    } catch (...) {
+	delete db;
+	throw;
+    }
+    if (!latest && !revision.empty() && !new_revision.empty() &&
+	new_revision != revision) {
+	// The revision the caller wants has gone, but the object we've just
+	// opened is still useful to someone else.
+	release(db, new_revision);
+	throw Xapian::DatabaseModifiedError("The revision being read has been discarded - you should call Xapian::Database::reopen() and retry the operation");
+    }
+    revision = new_revision;
+    RETURN(db);
+}
+
+void
+DatabasePool::release(Xapian::Database * db, const string & revision)
+{
+    LOGCALL_VOID(REMOTE, "DatabasePool::release", db | revision);
+    Xapian::Database * unwanted = NULL;
+    {
+	MutexLock lock(mutex);
+	free_dbs.push_front(Entry(db, revision));
+	if (free_dbs.size() > max_free) {
+	    // Close the least recently used, which is the most likely to be
+	    // at an old revision.
+	    unwanted = free_dbs.back().db;
+	    free_dbs.pop_back();
+	}
+    }
+    delete unwanted;
+}
+
+string
+DatabasePool::get_description() const
+{
+    string desc = dbpaths[0];
+    vector<string>::const_iterator i(dbpaths.begin());
+    for (++i; i != dbpaths.end(); ++i) {
+	desc += ' ';
+	desc += *i;
+    }
+    return desc;
+}
@@ -29,6 +29,9 @@
 #include "safeunistd.h"
 
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <string>
 
 #include "debuglog.h"
@@ -39,7 +42,12 @@
 #include "utils.h"
 
 #ifndef __WIN32__
-# include "safesysselect.h"
+# ifdef HAVE_POLL
+#  include <poll.h>
+# else
+#  include "safesysselect.h"
+# endif
+# include <sys/uio.h>
 #else
 # include "msvc_posix_wrapper.h"
 #endif
@@ -48,6 +56,73 @@ using namespace std;
 
 #define CHUNKSIZE 4096
 
+/** The most we read in one go.
+ *
+ *  The length of a message comes from the other end, so we only grow the
+ *  buffer as the data actually arrives rather than trusting it up front.
+ */
+#define MAX_READ_SIZE (64 * 1024)
+
+#ifndef __WIN32__
+/** Calculate the timeout to pass to wait_for_fd().
+ *
+ *  @return -1 if end_time is 0.0 (i.e. no timeout), otherwise the number of
+ *	    milliseconds until end_time, rounded up (or 0 if it has passed).
+ */
+static int
+calc_wait_msecs(double end_time)
+{
+    if (end_time == 0.0) return -1;
+    double time_diff = end_time - RealTime::now();
+    if (time_diff <= 0.0) return 0;
+    // Round up so we don't spin for the final fraction of a millisecond.
+    time_diff = ceil(time_diff * 1000.0);
+    if (time_diff >= double(INT_MAX)) return INT_MAX;
+    return int(time_diff);
+}
+
+/** Wait until @a fd is ready for reading or writing.
+ *
+ *  We use poll() where we can, as select() can't handle file descriptors
+ *  >= FD_SETSIZE, which a process with many remote connections can easily
+ *  reach.
+ *
+ *  @param fd		The file descriptor to wait on.
+ *  @param for_write	true to wait until fd is writable, false to wait until
+ *			it is readable.
+ *  @param msecs	Maximum time to wait in milliseconds, or -1 to wait
+ *			indefinitely.
+ *
+ *  @return > 0 if fd is ready (or has an error or EOF pending), 0 if the
+ *	    timeout expired, and < 0 on error (with errno set).
+ */
+static int
+wait_for_fd(int fd, bool for_write, int msecs)
+{
+#ifdef HAVE_POLL
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = for_write ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, msecs);
+#else
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fd, &fdset);
+    struct timeval tv;
+    struct timeval * tvp = NULL;
+    if (msecs >= 0) {
+	tv.tv_sec = msecs / 1000;
+	tv.tv_usec = (msecs % 1000) * 1000;
+	tvp = &tv;
+    }
+    if (for_write)
+	return select(fd + 1, 0, &fdset, &fdset, tvp);
+    return select(fd + 1, &fdset, 0, &fdset, tvp);
+#endif
+}
+#endif
+
 #ifdef __WIN32__
 inline void
 update_overlapped_offset(WSAOVERLAPPED & overlapped, DWORD n)
@@ -126,11 +201,17 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
     }
 
     while (true) {
-	char buf[CHUNKSIZE];
-	ssize_t received = read(fdin, buf, sizeof(buf));
+	// Read straight into buffer, which keeps its capacity between
+	// messages.  If we need more than CHUNKSIZE bytes, ask for as many of
+	// them as we can at once, up to MAX_READ_SIZE.
+	size_t old_len = buffer.length();
+	size_t want = max(min_len - old_len, size_t(CHUNKSIZE));
+	want = min(want, size_t(MAX_READ_SIZE));
+	buffer.resize(old_len + want);
+	ssize_t received = read(fdin, &buffer[old_len], want);
+	buffer.resize(old_len + (received > 0 ? size_t(received) : 0));
 
 	if (received > 0) {
-	    buffer.append(buf, received);
 	    if (buffer.length() >= min_len) return;
 	    continue;
 	}
@@ -146,32 +227,18 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
 
 	Assert(end_time != 0.0);
 	while (true) {
-	    // Calculate how far in the future end_time is.
-	    double time_diff = end_time - RealTime::now();
-	    // Check if the timeout has expired.
-	    if (time_diff < 0) {
+	    // Wait until there is data or the timeout is reached.
+	    int wait_result = wait_for_fd(fdin, false, calc_wait_msecs(end_time));
+	    if (wait_result > 0) break;
+
+	    if (wait_result == 0) {
 		LOGLINE(REMOTE, "read: timeout has expired");
 		throw Xapian::NetworkTimeoutError("Timeout expired while trying to read", context);
 	    }
 
-	    // Use select to wait until there is data or the timeout is reached.
-	    fd_set fdset;
-	    FD_ZERO(&fdset);
-	    FD_SET(fdin, &fdset);
-
-	    struct timeval tv;
-	    tv.tv_sec = long(time_diff);
-	    tv.tv_usec = long(fmod(time_diff, 1.0) * 1000000);
-
-	    int select_result = select(fdin + 1, &fdset, 0, &fdset, &tv);
-	    if (select_result > 0) break;
-
-	    if (select_result == 0)
-		throw Xapian::NetworkTimeoutError("Timeout expired while trying to read", context);
-
-	    // EINTR means select was interrupted by a signal.
+	    // EINTR means the wait was interrupted by a signal.
 	    if (errno != EINTR)
-		throw Xapian::NetworkError("select failed during read", context, errno);
+		throw Xapian::NetworkError("poll failed during read", context, errno);
 	}
     }
 #endif
@@ -187,18 +254,24 @@ RemoteConnection::ready_to_read() const
 
     if (!buffer.empty()) RETURN(true);
 
+#ifdef __WIN32__
     // Use select to see if there's data available to be read.
     fd_set fdset;
     FD_ZERO(&fdset);
     FD_SET(fdin, &fdset);
 
     // Set a 0.1 second timeout to avoid a busy loop.
-    // FIXME: this would be much better done by exposing the fd so that the
-    // matcher can call select on all the fds involved...
     struct timeval tv;
     tv.tv_sec = 0;
     tv.tv_usec = 100000;
     RETURN(select(fdin + 1, &fdset, 0, &fdset, &tv) > 0);
+#else
+    // Don't wait at all.  The matcher only asks without blocking on its first
+    // pass over the remote databases, and then blocks on each in turn, so
+    // waiting here would just add a delay per database when fanning out to
+    // many servers.
+    RETURN(wait_for_fd(fdin, false, 0) > 0);
+#endif
 }
 
 void
@@ -210,11 +283,13 @@ RemoteConnection::send_message(char type, const string &message,
 	throw Xapian::DatabaseError("Database has been closed");
     }
 
+    string enc_len = encode_length(message.size());
+
+#ifdef __WIN32__
     string header;
     header += type;
-    header += encode_length(message.size());
+    header += enc_len;
 
-#ifdef __WIN32__
     HANDLE hout = fd_to_handle(fdout);
     const string * str = &header;
 
@@ -257,59 +332,59 @@ RemoteConnection::send_message(char type, const string &message,
 				   context, errno);
     }
 
-    const string * str = &header;
+    // Write the type, length and contents with a single writev() call, which
+    // saves copying the message to append it to the header.
+    struct iovec iov[3];
+    iov[0].iov_base = &type;
+    iov[0].iov_len = 1;
+    iov[1].iov_base = const_cast<char *>(enc_len.data());
+    iov[1].iov_len = enc_len.size();
+    iov[2].iov_base = const_cast<char *>(message.data());
+    iov[2].iov_len = message.size();
+    struct iovec * v = iov;
+    int iovcnt = message.empty() ? 2 : 3;
 
-    fd_set fdset;
-    size_t count = 0;
     while (true) {
 	// We've set write to non-blocking, so just try writing as there
 	// will usually be space.
-	ssize_t n = write(fdout, str->data() + count, str->size() - count);
+	ssize_t n = writev(fdout, v, iovcnt);
 
 	if (n >= 0) {
-	    count += n;
-	    if (count == str->size()) {
-		if (str == &message || message.empty()) return;
-		str = &message;
-		count = 0;
+	    // Skip over whatever has been written.
+	    size_t written = n;
+	    while (iovcnt && written >= v->iov_len) {
+		written -= v->iov_len;
+		++v;
+		--iovcnt;
 	    }
+	    if (iovcnt == 0) return;
+	    v->iov_base = static_cast<char *>(v->iov_base) + written;
+	    v->iov_len -= written;
 	    continue;
 	}
 
-	LOGLINE(REMOTE, "write gave errno = " << strerror(errno));
+	LOGLINE(REMOTE, "writev gave errno = " << strerror(errno));
 	if (errno == EINTR) continue;
 
 	if (errno != EAGAIN)
 	    throw Xapian::NetworkError("write failed", context, errno);
 
-	// Use select to wait until there is space or the timeout is reached.
-	FD_ZERO(&fdset);
-	FD_SET(fdout, &fdset);
-
-	double time_diff = end_time - RealTime::now();
-	if (time_diff < 0) {
-	    LOGLINE(REMOTE, "write: timeout has expired");
-	    throw Xapian::NetworkTimeoutError("Timeout expired while trying to write", context);
-	}
-
-	struct timeval tv;
-	tv.tv_sec = long(time_diff);
-	tv.tv_usec = long(fmod(time_diff, 1.0) * 1000000);
-
-	int select_result = select(fdout + 1, 0, &fdset, &fdset, &tv);
+	// Wait until there is space or the timeout is reached.
+	int wait_result = wait_for_fd(fdout, true, calc_wait_msecs(end_time));
 
-	if (select_result < 0) {
+	if (wait_result < 0) {
 	    if (errno == EINTR) {
-		// EINTR means select was interrupted by a signal.
-		// We could just retry the select, but it's easier to just
-		// retry the write.
+		// EINTR means the wait was interrupted by a signal.  We could
+		// just retry the wait, but it's easier to just retry the write.
 		continue;
 	    }
-	    throw Xapian::NetworkError("select failed during write", context, errno);
+	    throw Xapian::NetworkError("poll failed during write", context, errno);
 	}
 
-	if (select_result == 0)
+	if (wait_result == 0) {
+	    LOGLINE(REMOTE, "write: timeout has expired");
 	    throw Xapian::NetworkTimeoutError("Timeout expired while trying to write", context);
+	}
     }
 #endif
 }
@@ -391,7 +466,6 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 				   context, errno);
     }
 
-    fd_set fdset;
     size_t count = 0;
     while (true) {
 	// We've set write to non-blocking, so just try writing as there
@@ -422,34 +496,22 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 	if (errno != EAGAIN)
 	    throw Xapian::NetworkError("write failed", context, errno);
 
-	// Use select to wait until there is space or the timeout is reached.
-	FD_ZERO(&fdset);
-	FD_SET(fdout, &fdset);
+	// Wait until there is space or the timeout is reached.
+	int wait_result = wait_for_fd(fdout, true, calc_wait_msecs(end_time));
 
-	double time_diff = end_time - RealTime::now();
-	if (time_diff < 0) {
-	    LOGLINE(REMOTE, "write: timeout has expired");
-	    throw Xapian::NetworkTimeoutError("Timeout expired while trying to write", context);
-	}
-
-	struct timeval tv;
-	tv.tv_sec = long(time_diff);
-	tv.tv_usec = long(fmod(time_diff, 1.0) * 1000000);
-
-	int select_result = select(fdout + 1, 0, &fdset, &fdset, &tv);
-
-	if (select_result < 0) {
+	if (wait_result < 0) {
 	    if (errno == EINTR) {
-		// EINTR means select was interrupted by a signal.
-		// We could just retry the select, but it's easier to just
-		// retry the write.
+		// EINTR means the wait was interrupted by a signal.  We could
+		// just retry the wait, but it's easier to just retry the write.
 		continue;
 	    }
-	    throw Xapian::NetworkError("select failed during write", context, errno);
+	    throw Xapian::NetworkError("poll failed during write", context, errno);
 	}
 
-	if (select_result == 0)
+	if (wait_result == 0) {
+	    LOGLINE(REMOTE, "write: timeout has expired");
 	    throw Xapian::NetworkTimeoutError("Timeout expired while trying to write", context);
+	}
     }
 #endif
 }
@@ -666,13 +728,10 @@ RemoteConnection::do_close(bool wait)
 	    }
 #else
 	    // Wait for the connection to be closed - when this happens
-	    // select() will report that a read won't block.
-	    fd_set fdset;
-	    FD_ZERO(&fdset);
-	    FD_SET(fdin, &fdset);
+	    // poll() will report that a read won't block.
 	    int res;
 	    do {
-		res = select(fdin + 1, &fdset, 0, &fdset, NULL);
+		res = wait_for_fd(fdin, false, -1);
 	    } while (res < 0 && errno == EINTR);
 #endif
 	}
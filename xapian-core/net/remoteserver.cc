@@ -33,6 +33,7 @@
 #include <cstdlib>
 
 #include "autoptr.h"
+#include "databasepool.h"
 #include "multimatch.h"
 #include "omassert.h"
 #include "realtime.h"
@@ -44,12 +45,25 @@
 /// Class to throw when we receive the connection closing message.
 struct ConnectionClosed { };
 
+/** Approximate size in bytes of each batch of MSet items we send.
+ *
+ *  Small enough that the client can start merging the first batch while the
+ *  rest are in transit, but big enough to keep the per-message overhead low.
+ */
+static const size_t RESULTS_BATCH_BYTES = 8192;
+
+/// Number of postings to read from the database at once in msg_postlist().
+static const Xapian::doccount POSTLIST_BATCH_SIZE = 256;
+
+/// Approximate size in bytes of each batch of termlist or allterms entries.
+static const size_t TERMLIST_BATCH_BYTES = 65536;
+
 RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 			   int fdin_, int fdout_,
 			   double active_timeout_, double idle_timeout_,
 			   bool writable_)
     : RemoteConnection(fdin_, fdout_, std::string()),
-      db(NULL), wdb(NULL), writable(writable_),
+      db(NULL), wdb(NULL), writable(writable_), pool(NULL),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
 {
     // Catch errors opening the database and propagate them to the client.
@@ -92,8 +106,45 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
     msg_update(string());
 }
 
+RemoteServer::RemoteServer(DatabasePool & pool_,
+			   int fdin_, int fdout_,
+			   double active_timeout_, double idle_timeout_)
+    : RemoteConnection(fdin_, fdout_, pool_.get_description()),
+      db(NULL), wdb(NULL), writable(false), pool(&pool_),
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_)
+{
+    // Catch errors opening the database and propagate them to the client.
+    try {
+	db = pool->acquire(revision, true);
+    } catch (const Xapian::Error &err) {
+	// Propagate the exception to the client.
+	send_message(REPLY_EXCEPTION, serialise_error(err));
+	// And rethrow it so our caller can log it and close the connection.
+	throw;
+    }
+
+#ifndef __WIN32__
+    // It's simplest to just ignore SIGPIPE.  We'll still know if the
+    // connection dies because we'll get EPIPE back from write().
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+	release_db();
+	throw Xapian::NetworkError("Couldn't set SIGPIPE to SIG_IGN", errno);
+    }
+#endif
+
+    // Send greeting message.
+    try {
+	msg_update(string());
+    } catch (...) {
+	release_db();
+	throw;
+    }
+    release_db();
+}
+
 RemoteServer::~RemoteServer()
 {
+    release_db();
     delete db;
     // wdb is either NULL or equal to db, so we shouldn't delete it too!
 }
@@ -135,98 +186,147 @@ typedef void (RemoteServer::* dispatch_func)(const string &);
 void
 RemoteServer::run()
 {
-    while (true) {
+    while (handle_message(idle_timeout)) { }
+}
+
+bool
+RemoteServer::handle_message(double timeout)
+{
+    try {
+	/* This list needs to be kept in the same order as the list of
+	 * message types in "remoteprotocol.h". Note that messages at the
+	 * end of the list in "remoteprotocol.h" can be omitted if they
+	 * don't correspond to dispatch actions.
+	 */
+	static const dispatch_func dispatch[] = {
+	    &RemoteServer::msg_allterms,
+	    &RemoteServer::msg_collfreq,
+	    &RemoteServer::msg_document,
+	    &RemoteServer::msg_termexists,
+	    &RemoteServer::msg_termfreq,
+	    &RemoteServer::msg_valuestats,
+	    &RemoteServer::msg_keepalive,
+	    &RemoteServer::msg_doclength,
+	    &RemoteServer::msg_query,
+	    &RemoteServer::msg_termlist,
+	    &RemoteServer::msg_positionlist,
+	    &RemoteServer::msg_postlist,
+	    &RemoteServer::msg_reopen,
+	    &RemoteServer::msg_update,
+	    &RemoteServer::msg_adddocument,
+	    &RemoteServer::msg_cancel,
+	    &RemoteServer::msg_deletedocumentterm,
+	    &RemoteServer::msg_commit,
+	    &RemoteServer::msg_replacedocument,
+	    &RemoteServer::msg_replacedocumentterm,
+	    &RemoteServer::msg_deletedocument,
+	    &RemoteServer::msg_writeaccess,
+	    &RemoteServer::msg_getmetadata,
+	    &RemoteServer::msg_setmetadata,
+	    &RemoteServer::msg_addspelling,
+	    &RemoteServer::msg_removespelling,
+	    0, // MSG_GETMSET - used during a conversation.
+	    0, // MSG_SHUTDOWN - handled by get_message().
+	    &RemoteServer::msg_openmetadatakeylist,
+	    &RemoteServer::msg_documents,
+	};
+
+	string message;
+	size_t type = get_message(timeout, message);
+	if (type >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[type]) {
+	    string errmsg("Unexpected message type ");
+	    errmsg += str(type);
+	    throw Xapian::InvalidArgumentError(errmsg);
+	}
+	// When sharing databases, take one at the revision the client has
+	// seen for the duration of the message.  msg_reopen() wants the
+	// latest revision instead, so it handles this itself.
+	if (pool && type != MSG_REOPEN) db = pool->acquire(revision, false);
 	try {
-	    /* This list needs to be kept in the same order as the list of
-	     * message types in "remoteprotocol.h". Note that messages at the
-	     * end of the list in "remoteprotocol.h" can be omitted if they
-	     * don't correspond to dispatch actions.
-	     */
-	    static const dispatch_func dispatch[] = {
-		&RemoteServer::msg_allterms,
-		&RemoteServer::msg_collfreq,
-		&RemoteServer::msg_document,
-		&RemoteServer::msg_termexists,
-		&RemoteServer::msg_termfreq,
-		&RemoteServer::msg_valuestats,
-		&RemoteServer::msg_keepalive,
-		&RemoteServer::msg_doclength,
-		&RemoteServer::msg_query,
-		&RemoteServer::msg_termlist,
-		&RemoteServer::msg_positionlist,
-		&RemoteServer::msg_postlist,
-		&RemoteServer::msg_reopen,
-		&RemoteServer::msg_update,
-		&RemoteServer::msg_adddocument,
-		&RemoteServer::msg_cancel,
-		&RemoteServer::msg_deletedocumentterm,
-		&RemoteServer::msg_commit,
-		&RemoteServer::msg_replacedocument,
-		&RemoteServer::msg_replacedocumentterm,
-		&RemoteServer::msg_deletedocument,
-		&RemoteServer::msg_writeaccess,
-		&RemoteServer::msg_getmetadata,
-		&RemoteServer::msg_setmetadata,
-		&RemoteServer::msg_addspelling,
-		&RemoteServer::msg_removespelling,
-		0, // MSG_GETMSET - used during a conversation.
-		0, // MSG_SHUTDOWN - handled by get_message().
-		&RemoteServer::msg_openmetadatakeylist,
-	    };
-
-	    string message;
-	    size_t type = get_message(idle_timeout, message);
-	    if (type >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[type]) {
-		string errmsg("Unexpected message type ");
-		errmsg += str(type);
-		throw Xapian::InvalidArgumentError(errmsg);
-	    }
 	    (this->*(dispatch[type]))(message);
-	} catch (const Xapian::NetworkTimeoutError & e) {
-	    try {
-		// We've had a timeout, so the client may not be listening, so
-		// set the end_time to 1 and if we can't send the message right
-		// away, just exit and the client will cope.
-		send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
-	    } catch (...) {
-	    }
-	    // And rethrow it so our caller can log it and close the
-	    // connection.
-	    throw;
-	} catch (const Xapian::NetworkError &) {
-	    // All other network errors mean we are fatally confused and are
-	    // unlikely to be able to communicate further across this
-	    // connection.  So we don't try to propagate the error to the
-	    // client, but instead just rethrow the exception so our caller can
-	    // log it and close the connection.
-	    throw;
-	} catch (const Xapian::Error &e) {
-	    // Propagate the exception to the client, then return to the main
-	    // message handling loop.
-	    send_message(REPLY_EXCEPTION, serialise_error(e));
-	} catch (ConnectionClosed &) {
-	    return;
 	} catch (...) {
-	    // Propagate an unknown exception to the client.
-	    send_message(REPLY_EXCEPTION, string());
-	    // And rethrow it so our caller can log it and close the
-	    // connection.
+	    release_db();
 	    throw;
 	}
+	release_db();
+    } catch (const Xapian::NetworkTimeoutError & e) {
+	try {
+	    // We've had a timeout, so the client may not be listening, so
+	    // set the end_time to 1 and if we can't send the message right
+	    // away, just exit and the client will cope.
+	    send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
+	} catch (...) {
+	}
+	// And rethrow it so our caller can log it and close the
+	// connection.
+	throw;
+    } catch (const Xapian::NetworkError &) {
+	// All other network errors mean we are fatally confused and are
+	// unlikely to be able to communicate further across this
+	// connection.  So we don't try to propagate the error to the
+	// client, but instead just rethrow the exception so our caller can
+	// log it and close the connection.
+	throw;
+    } catch (const Xapian::Error &e) {
+	// Propagate the exception to the client, then return to the main
+	// message handling loop.
+	send_message(REPLY_EXCEPTION, serialise_error(e));
+    } catch (ConnectionClosed &) {
+	return false;
+    } catch (...) {
+	// Propagate an unknown exception to the client.
+	send_message(REPLY_EXCEPTION, string());
+	// And rethrow it so our caller can log it and close the
+	// connection.
+	throw;
+    }
+    return true;
+}
+
+void
+RemoteServer::release_db()
+{
+    if (pool && db) {
+	pool->release(db, revision);
+	db = NULL;
+    }
+}
+
+void
+RemoteServer::send_idle_timeout()
+{
+    Xapian::NetworkTimeoutError e("Timeout expired while trying to read",
+				  context);
+    try {
+	// As in handle_message(), don't wait if the client isn't listening.
+	send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
+    } catch (...) {
     }
 }
 
 void
 RemoteServer::msg_allterms(const string &message)
 {
-    const string & prefix = message;
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    bool compress = (decode_length(&p, p_end, false) & 1);
+    string prefix(p, p_end - p);
 
+    // Send the terms in batches, with each term sharing any common prefix
+    // with the previous one in the batch.
+    string batch, prev;
     const Xapian::TermIterator end = db->allterms_end(prefix);
     for (Xapian::TermIterator t = db->allterms_begin(prefix); t != end; ++t) {
-	string item = encode_length(t.get_termfreq());
-	item += *t;
-	send_message(REPLY_ALLTERMS, item);
+	batch += encode_length(t.get_termfreq());
+	serialise_term_after(batch, prev, *t);
+	if (batch.size() >= TERMLIST_BATCH_BYTES) {
+	    send_message(REPLY_ALLTERMS, serialise_block(batch, compress));
+	    batch.resize(0);
+	    prev.resize(0);
+	}
     }
+    if (!batch.empty())
+	send_message(REPLY_ALLTERMS, serialise_block(batch, compress));
 
     send_message(REPLY_DONE, string());
 }
@@ -237,15 +337,25 @@ RemoteServer::msg_termlist(const string &message)
     const char *p = message.data();
     const char *p_end = p + message.size();
     Xapian::docid did = decode_length(&p, p_end, false);
+    bool compress = (decode_length(&p, p_end, false) & 1);
 
     send_message(REPLY_DOCLENGTH, encode_length(db->get_doclength(did)));
+
+    // Send the entries in batches, as for msg_allterms().
+    string batch, prev;
     const Xapian::TermIterator end = db->termlist_end(did);
     for (Xapian::TermIterator t = db->termlist_begin(did); t != end; ++t) {
-	string item = encode_length(t.get_wdf());
-	item += encode_length(t.get_termfreq());
-	item += *t;
-	send_message(REPLY_TERMLIST, item);
+	batch += encode_length(t.get_wdf());
+	batch += encode_length(t.get_termfreq());
+	serialise_term_after(batch, prev, *t);
+	if (batch.size() >= TERMLIST_BATCH_BYTES) {
+	    send_message(REPLY_TERMLIST, serialise_block(batch, compress));
+	    batch.resize(0);
+	    prev.resize(0);
+	}
     }
+    if (!batch.empty())
+	send_message(REPLY_TERMLIST, serialise_block(batch, compress));
 
     send_message(REPLY_DONE, string());
 }
@@ -273,26 +383,43 @@ RemoteServer::msg_positionlist(const string &message)
 void
 RemoteServer::msg_postlist(const string &message)
 {
-    const string & term = message;
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    Xapian::docid first = decode_length(&p, p_end, false);
+    size_t max_bytes = decode_length(&p, p_end, false);
+    bool compress = (decode_length(&p, p_end, false) & 1);
+    string term(p, p_end - p);
+    if (first == 0) first = 1;
 
     Xapian::doccount termfreq = db->get_termfreq(term);
     Xapian::termcount collfreq = db->get_collection_freq(term);
     send_message(REPLY_POSTLISTSTART, encode_length(termfreq) + encode_length(collfreq));
 
-    Xapian::docid lastdocid = 0;
-    const Xapian::PostingIterator end = db->postlist_end(term);
-    for (Xapian::PostingIterator i = db->postlist_begin(term);
-	 i != end; ++i) {
-
-	Xapian::docid newdocid = *i;
-	string reply = encode_length(newdocid - lastdocid - 1);
-	reply += encode_length(i.get_wdf());
-
-	send_message(REPLY_POSTLISTITEM, reply);
-	lastdocid = newdocid;
+    // Send the postings from docid first onwards, stopping once we've encoded
+    // about max_bytes of them.  The client asks for more (or skips ahead)
+    // only if it needs to.
+    Xapian::PostingIterator i = db->postlist_begin(term);
+    if (first > 1) i.skip_to(first);
+
+    string postings;
+    Xapian::docid lastdocid = first - 1;
+    Xapian::docid dids[POSTLIST_BATCH_SIZE];
+    Xapian::termcount wdfs[POSTLIST_BATCH_SIZE];
+    Xapian::doccount n;
+    while ((postings.empty() || postings.size() < max_bytes) &&
+	   (n = i.get_batch(POSTLIST_BATCH_SIZE, dids, wdfs)) != 0) {
+	for (Xapian::doccount j = 0; j != n; ++j) {
+	    postings += encode_length(dids[j] - lastdocid - 1);
+	    postings += encode_length(wdfs[j]);
+	    lastdocid = dids[j];
+	}
     }
 
-    send_message(REPLY_DONE, string());
+    string reply;
+    reply += (i == db->postlist_end(term)) ? '\0' : '\1';
+    reply += encode_length(lastdocid);
+    reply += serialise_block(postings, compress);
+    send_message(REPLY_POSTLISTITEM, reply);
 }
 
 void
@@ -310,6 +437,16 @@ RemoteServer::msg_writeaccess(const string & msg)
 void
 RemoteServer::msg_reopen(const string & msg)
 {
+    if (pool) {
+	string old_revision = revision;
+	db = pool->acquire(revision, true);
+	if (!revision.empty() && revision == old_revision) {
+	    send_message(REPLY_DONE, string());
+	    return;
+	}
+	msg_update(msg);
+	return;
+    }
     if (!db->reopen()) {
 	send_message(REPLY_DONE, string());
 	return;
@@ -449,7 +586,7 @@ RemoteServer::msg_query(const string &message_in)
     Xapian::Weight::Internal local_stats;
     MultiMatch match(*db, query.get(), qlen, &rset, collapse_max, collapse_key,
 		     percent_cutoff, weight_cutoff, order,
-		     sort_key, sort_by, sort_value_forward, NULL,
+		     sort_key, sort_by, sort_value_forward, 0, NULL,
 		     local_stats, wt.get(), matchspies.spies, false, false);
 
     send_message(REPLY_STATS, serialise_stats(local_stats));
@@ -459,6 +596,7 @@ RemoteServer::msg_query(const string &message_in)
     p = message.c_str();
     p_end = p + message.size();
 
+    unsigned request_id = decode_length(&p, p_end, false);
     Xapian::termcount first = decode_length(&p, p_end, false);
     Xapian::termcount maxitems = decode_length(&p, p_end, false);
 
@@ -472,24 +610,36 @@ RemoteServer::msg_query(const string &message_in)
     Xapian::MSet mset;
     match.get_mset(first, maxitems, check_at_least, mset, total_stats, 0, 0);
 
-    message.resize(0);
+    const string request_tag = encode_length(request_id);
+    message = request_tag;
+    message += encode_length(mset.size());
     vector<Xapian::MatchSpy *>::const_iterator i;
     for (i = matchspies.spies.begin(); i != matchspies.spies.end(); ++i) {
 	string spy_results = (*i)->serialise_results();
 	message += encode_length(spy_results.size());
 	message += spy_results;
     }
-    message += serialise_mset(mset);
+    message += serialise_mset_header(mset);
     send_message(REPLY_RESULTS, message);
+
+    // Send the items in batches, so the client can start merging them as
+    // soon as the first batch arrives rather than waiting for the whole
+    // MSet, and can skip unserialising items it turns out not to need.
+    const vector<Xapian::Internal::MSetItem> & items = mset.internal->items;
+    vector<Xapian::Internal::MSetItem>::const_iterator item = items.begin();
+    while (item != items.end()) {
+	message = request_tag;
+	do {
+	    message += serialise_mset_item(*item);
+	} while (++item != items.end() &&
+		 message.size() < RESULTS_BATCH_BYTES);
+	send_message(REPLY_RESULTSITEMS, message);
+    }
 }
 
 void
-RemoteServer::msg_document(const string &message)
+RemoteServer::send_document(Xapian::docid did)
 {
-    const char *p = message.data();
-    const char *p_end = p + message.size();
-    Xapian::docid did = decode_length(&p, p_end, false);
-
     Xapian::Document doc = db->get_document(did);
 
     send_message(REPLY_DOCDATA, doc.get_data());
@@ -500,6 +650,29 @@ RemoteServer::msg_document(const string &message)
 	item += *i;
 	send_message(REPLY_VALUE, item);
     }
+}
+
+void
+RemoteServer::msg_document(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    Xapian::docid did = decode_length(&p, p_end, false);
+
+    send_document(did);
+    send_message(REPLY_DONE, string());
+}
+
+void
+RemoteServer::msg_documents(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    Xapian::docid did = 0;
+    while (p != p_end) {
+	did += decode_length(&p, p_end, false);
+	send_document(did);
+    }
     send_message(REPLY_DONE, string());
 }
 
@@ -28,6 +28,19 @@
 
 #include "remoteserver.h"
 
+#if defined HAVE_EPOLL_CREATE && defined HAVE_PTHREAD
+# include "databasepool.h"
+# include "mutex.h"
+# include "realtime.h"
+# include "threadpool.h"
+
+# include "safeerrno.h"
+# include <cstring>
+# include <map>
+# include <sys/epoll.h>
+# include <unistd.h>
+#endif
+
 #include <iostream>
 
 using namespace std;
@@ -59,3 +72,238 @@ RemoteTcpServer::handle_one_connection(int socket)
 	// ignore other exceptions
     }
 }
+
+#if defined HAVE_EPOLL_CREATE && defined HAVE_PTHREAD
+
+namespace {
+
+class ThreadedServerState;
+
+/// A client connection being served by RemoteTcpServer::run_threaded().
+class Connection : public ThreadPool::Task {
+    ThreadedServerState & state;
+
+  public:
+    int fd;
+
+    /// NULL until a worker has sent the greeting message.
+    RemoteServer * server;
+
+    /// Is a worker handling this connection?
+    bool busy;
+
+    /// Is fd in the epoll set yet?
+    bool watched;
+
+    /// When this connection last finished handling a message.
+    double idle_since;
+
+    Connection(ThreadedServerState & state_, int fd_)
+	: state(state_), fd(fd_), server(NULL), busy(true), watched(false),
+	  idle_since(0) { }
+
+    ~Connection() {
+	delete server;
+	close(fd);
+    }
+
+    /// Handle the messages waiting, then hand back to the event loop.
+    void run();
+};
+
+/// State shared between the event loop and the workers.
+class ThreadedServerState {
+  public:
+    DatabasePool pool;
+
+    double active_timeout, idle_timeout;
+
+    bool verbose;
+
+    int epoll_fd;
+
+    /// Protects connections, and the busy and watched flags on them.
+    Mutex mutex;
+
+    /// The connections which are open, keyed by fd.
+    std::map<int, Connection *> connections;
+
+    ThreadedServerState(const vector<string> & dbpaths, unsigned threads,
+			double active_timeout_, double idle_timeout_,
+			bool verbose_)
+	: pool(dbpaths, threads),
+	  active_timeout(active_timeout_), idle_timeout(idle_timeout_),
+	  verbose(verbose_), epoll_fd(-1) { }
+
+    /// Start watching a connection for the next message.
+    void wait_for_message(Connection * conn) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = conn->fd;
+	MutexLock lock(mutex);
+	conn->busy = false;
+	conn->idle_since = RealTime::now();
+	int op = conn->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	conn->watched = true;
+	if (epoll_ctl(epoll_fd, op, conn->fd, &ev) < 0) {
+	    // We'll never hear from this connection again, so let the idle
+	    // timeout sweep tidy it up.
+	    cerr << "epoll_ctl failed: " << strerror(errno) << endl;
+	}
+    }
+
+    /// Close a connection which a worker is handling.
+    void close_connection(Connection * conn) {
+	{
+	    MutexLock lock(mutex);
+	    connections.erase(conn->fd);
+	}
+	// Closing the fd removes it from the epoll set.
+	delete conn;
+	if (verbose) cout << "Closing connection." << endl;
+    }
+
+    /// Close connections which have been idle for too long.
+    void close_idle_connections() {
+	if (idle_timeout <= 0) return;
+	double cutoff = RealTime::now() - idle_timeout;
+	vector<Connection *> idle;
+	{
+	    MutexLock lock(mutex);
+	    std::map<int, Connection *>::iterator i = connections.begin();
+	    while (i != connections.end()) {
+		Connection * conn = i->second;
+		if (!conn->busy && conn->idle_since < cutoff) {
+		    idle.push_back(conn);
+		    connections.erase(i++);
+		} else {
+		    ++i;
+		}
+	    }
+	}
+	vector<Connection *>::const_iterator j;
+	for (j = idle.begin(); j != idle.end(); ++j) {
+	    if ((*j)->server) (*j)->server->send_idle_timeout();
+	    if (verbose) cerr << "Connection timed out" << endl;
+	    delete *j;
+	}
+    }
+};
+
+void
+Connection::run()
+{
+    try {
+	if (!server) {
+	    server = new RemoteServer(state.pool, fd, fd,
+				      state.active_timeout,
+				      state.idle_timeout);
+	} else {
+	    do {
+		if (!server->run_one_message()) {
+		    state.close_connection(this);
+		    return;
+		}
+	    } while (server->message_pending());
+	}
+    } catch (const Xapian::NetworkTimeoutError &e) {
+	if (state.verbose)
+	    cerr << "Connection timed out: " << e.get_description() << endl;
+	state.close_connection(this);
+	return;
+    } catch (const Xapian::Error &e) {
+	cerr << "Got exception " << e.get_description() << endl;
+	state.close_connection(this);
+	return;
+    } catch (...) {
+	// ignore other exceptions
+	state.close_connection(this);
+	return;
+    }
+    state.wait_for_message(this);
+}
+
+}
+
+void
+RemoteTcpServer::run_threaded(unsigned threads)
+{
+    if (writable)
+	throw Xapian::InvalidOperationError("Threaded server mode is read-only");
+    if (threads == 0) threads = 1;
+
+    ThreadedServerState state(dbpaths, threads, active_timeout, idle_timeout,
+			      verbose);
+    state.epoll_fd = epoll_create(1024);
+    if (state.epoll_fd < 0)
+	throw Xapian::NetworkError("epoll_create failed", errno);
+
+    int listen_socket = get_listen_socket();
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_socket;
+    if (epoll_ctl(state.epoll_fd, EPOLL_CTL_ADD, listen_socket, &ev) < 0) {
+	int saved_errno = errno; // note down in case close hits an error
+	close(state.epoll_fd);
+	throw Xapian::NetworkError("epoll_ctl failed", saved_errno);
+    }
+
+    // The thread running the event loop doesn't run tasks, so we need one
+    // more than the number of workers.
+    ThreadPool workers(threads + 1);
+
+    // Check for idle connections at least once a second.
+    int wait_msecs = 1000;
+    if (idle_timeout > 0 && idle_timeout < 1.0)
+	wait_msecs = int(idle_timeout * 1000) + 1;
+
+    const int MAX_EVENTS = 64;
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+	int n = epoll_wait(state.epoll_fd, events, MAX_EVENTS, wait_msecs);
+	if (n < 0) {
+	    if (errno == EINTR) continue;
+	    int saved_errno = errno; // note down in case close hits an error
+	    close(state.epoll_fd);
+	    throw Xapian::NetworkError("epoll_wait failed", saved_errno);
+	}
+	for (int i = 0; i < n; ++i) {
+	    int fd = events[i].data.fd;
+	    Connection * conn;
+	    if (fd == listen_socket) {
+		try {
+		    int con_socket = TcpServer::accept_connection();
+		    conn = new Connection(state, con_socket);
+		    MutexLock lock(state.mutex);
+		    state.connections[con_socket] = conn;
+		} catch (const Xapian::Error &e) {
+		    // FIXME: better error handling.
+		    cerr << "Caught " << e.get_description() << endl;
+		    continue;
+		}
+	    } else {
+		MutexLock lock(state.mutex);
+		std::map<int, Connection *>::iterator c;
+		c = state.connections.find(fd);
+		// The connection may have timed out since epoll_wait()
+		// returned.
+		if (c == state.connections.end()) continue;
+		conn = c->second;
+		conn->busy = true;
+	    }
+	    workers.post(conn);
+	}
+	state.close_idle_connections();
+    }
+}
+
+#else
+
+void
+RemoteTcpServer::run_threaded(unsigned threads)
+{
+    (void)threads;
+    throw Xapian::UnimplementedError("Threaded server mode requires epoll and POSIX threads");
+}
+
+#endif
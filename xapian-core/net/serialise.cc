@@ -33,11 +33,20 @@
 #include "utils.h"
 #include "weightinternal.h"
 
+#include <algorithm>
+#include <new>
 #include <string>
 #include <cstring>
 
+#ifdef HAVE_ZLIB_H
+# include <zlib.h>
+#endif
+
 using namespace std;
 
+/// serialise_block() doesn't try to compress blocks smaller than this.
+static const size_t MIN_COMPRESS_SIZE = 64;
+
 size_t
 decode_length(const char ** p, const char *end, bool check_remaining)
 {
@@ -170,7 +179,7 @@ unserialise_stats(const string &s)
 }
 
 string
-serialise_mset(const Xapian::MSet &mset)
+serialise_mset_header(const Xapian::MSet &mset)
 {
     string result;
 
@@ -186,15 +195,6 @@ serialise_mset(const Xapian::MSet &mset)
 
     result += serialise_double(mset.internal->percent_factor);
 
-    result += encode_length(mset.size());
-    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
-	result += serialise_double(i.get_weight());
-	result += encode_length(*i);
-	result += encode_length(i.get_collapse_key().size());
-	result += i.get_collapse_key();
-	result += encode_length(i.get_collapse_count());
-    }
-
     const map<string, Xapian::MSet::Internal::TermFreqAndWeight> &termfreqandwts
 	= mset.internal->termfreqandwts;
 
@@ -210,7 +210,7 @@ serialise_mset(const Xapian::MSet &mset)
 }
 
 Xapian::MSet
-unserialise_mset(const char * p, const char * p_end)
+unserialise_mset_header(const char * p, const char * p_end)
 {
     Xapian::doccount firstitem = decode_length(&p, p_end, false);
     Xapian::doccount matches_lower_bound = decode_length(&p, p_end, false);
@@ -224,18 +224,6 @@ unserialise_mset(const char * p, const char * p_end)
 
     double percent_factor = unserialise_double(&p, p_end);
 
-    vector<Xapian::Internal::MSetItem> items;
-    size_t msize = decode_length(&p, p_end, false);
-    while (msize-- > 0) {
-	Xapian::weight wt = unserialise_double(&p, p_end);
-	Xapian::docid did = decode_length(&p, p_end, false);
-	size_t len = decode_length(&p, p_end, true);
-	string key(p, len);
-	p += len;
-	Xapian::doccount collapse_cnt = decode_length(&p, p_end, false);
-	items.push_back(Xapian::Internal::MSetItem(wt, did, key, collapse_cnt));
-    }
-
     map<string, Xapian::MSet::Internal::TermFreqAndWeight> terminfo;
     while (p != p_end) {
 	Xapian::MSet::Internal::TermFreqAndWeight tfaw;
@@ -247,6 +235,7 @@ unserialise_mset(const char * p, const char * p_end)
 	terminfo.insert(make_pair(term, tfaw));
     }
 
+    vector<Xapian::Internal::MSetItem> items;
     return Xapian::MSet(new Xapian::MSet::Internal(
 				       firstitem,
 				       matches_upper_bound,
@@ -259,6 +248,32 @@ unserialise_mset(const char * p, const char * p_end)
 				       items, terminfo, percent_factor));
 }
 
+string
+serialise_mset_item(const Xapian::Internal::MSetItem & item)
+{
+    string result = serialise_double(item.wt);
+    result += encode_length(item.did);
+    result += encode_length(item.collapse_key.size());
+    result += item.collapse_key;
+    result += encode_length(item.collapse_count);
+    return result;
+}
+
+void
+unserialise_mset_items(const char * p, const char * p_end,
+		       vector<Xapian::Internal::MSetItem> & items)
+{
+    while (p != p_end) {
+	Xapian::weight wt = unserialise_double(&p, p_end);
+	Xapian::docid did = decode_length(&p, p_end, false);
+	size_t len = decode_length(&p, p_end, true);
+	string key(p, len);
+	p += len;
+	Xapian::doccount collapse_cnt = decode_length(&p, p_end, false);
+	items.push_back(Xapian::Internal::MSetItem(wt, did, key, collapse_cnt));
+    }
+}
+
 string
 serialise_rset(const Xapian::RSet &rset)
 {
@@ -371,3 +386,99 @@ unserialise_document(const string &s)
     doc.set_data(string(p, p_end - p));
     return doc;
 }
+
+string
+serialise_block(const string & data, bool compress)
+{
+#ifdef HAVE_ZLIB_H
+    if (compress && data.size() >= MIN_COMPRESS_SIZE) {
+	string result(1, '\x01');
+	result += encode_length(data.size());
+	size_t header_len = result.size();
+	uLongf comp_len = compressBound(data.size());
+	result.resize(header_len + comp_len);
+	// We're trying to save network bandwidth, but without adding much
+	// latency, so favour speed over compression ratio.
+	int err = compress2(reinterpret_cast<Bytef *>(&result[header_len]),
+			    &comp_len,
+			    reinterpret_cast<const Bytef *>(data.data()),
+			    data.size(), Z_BEST_SPEED);
+	if (err == Z_MEM_ERROR) throw std::bad_alloc();
+	if (err == Z_OK && comp_len < data.size()) {
+	    result.resize(header_len + comp_len);
+	    return result;
+	}
+	// Compression failed or didn't help, so send the data as it is.
+    }
+#else
+    (void)compress;
+#endif
+    string result(1, '\0');
+    result += data;
+    return result;
+}
+
+void
+unserialise_block(const char * p, const char * p_end, string & data)
+{
+    if (p == p_end)
+	throw Xapian::NetworkError("Bad serialised block: no data");
+    char type = *p++;
+    if (type == '\0') {
+	data.assign(p, p_end - p);
+	return;
+    }
+    if (type != '\x01')
+	throw Xapian::NetworkError("Bad serialised block: unknown type");
+#ifdef HAVE_ZLIB_H
+    size_t len = decode_length(&p, p_end, false);
+    // zlib can't compress by more than a factor of about 1000, so reject
+    // lengths which can't be right rather than trying to allocate them.
+    if (len == 0 || len / 1032 > size_t(p_end - p))
+	throw Xapian::NetworkError("Bad serialised block: bad length");
+    data.resize(len);
+    uLongf uncomp_len = len;
+    int err = uncompress(reinterpret_cast<Bytef *>(&data[0]), &uncomp_len,
+			 reinterpret_cast<const Bytef *>(p), p_end - p);
+    if (err == Z_MEM_ERROR) throw std::bad_alloc();
+    if (err != Z_OK || uncomp_len != len)
+	throw Xapian::NetworkError("Bad serialised block: decompression failed");
+#else
+    throw Xapian::NetworkError("Received a compressed block, but zlib support isn't compiled in");
+#endif
+}
+
+bool
+block_compression_supported()
+{
+#ifdef HAVE_ZLIB_H
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+serialise_term_after(string & result, string & prev, const string & term)
+{
+    size_t reuse = 0;
+    size_t max_reuse = min(min(prev.size(), term.size()), size_t(255));
+    while (reuse < max_reuse && prev[reuse] == term[reuse]) ++reuse;
+    result += static_cast<char>(reuse);
+    result += encode_length(term.size() - reuse);
+    result.append(term, reuse, string::npos);
+    prev = term;
+}
+
+void
+unserialise_term_after(const char ** p, const char * p_end, string & term)
+{
+    if (*p == p_end)
+	throw Xapian::NetworkError("Bad serialised term: no data");
+    size_t reuse = static_cast<unsigned char>(*(*p)++);
+    if (reuse > term.size())
+	throw Xapian::NetworkError("Bad serialised term: bad prefix length");
+    size_t len = decode_length(p, p_end, true);
+    term.replace(reuse, string::npos, *p, len);
+    *p += len;
+}
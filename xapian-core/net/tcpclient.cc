@@ -37,7 +37,11 @@
 # include <netinet/in.h>
 # include <netinet/tcp.h>
 # include <sys/socket.h>
-# include "safesysselect.h"
+# ifdef HAVE_POLL
+#  include <poll.h>
+# else
+#  include "safesysselect.h"
+# endif
 #endif
 
 using namespace std;
@@ -116,6 +120,17 @@ TcpClient::open_socket(const std::string & hostname, int port,
 	}
 
 	// wait for input to be available.
+#ifdef HAVE_POLL
+	struct pollfd pfd;
+	pfd.fd = socketfd;
+	pfd.events = POLLOUT;
+
+	do {
+	    // FIXME: Reduce the timeout if we retry on EINTR.
+	    pfd.revents = 0;
+	    retval = poll(&pfd, 1, int(std::ceil(timeout_connect * 1000.0)));
+	} while (retval < 0 && errno == EINTR);
+#else
 	fd_set fdset;
 	FD_ZERO(&fdset);
 	FD_SET(socketfd, &fdset);
@@ -128,6 +143,7 @@ TcpClient::open_socket(const std::string & hostname, int port,
 
 	    retval = select(socketfd + 1, 0, &fdset, &fdset, &tv);
 	} while (retval < 0 && errno == EINTR);
+#endif
 
 	if (retval < 0) {
 	    int saved_errno = errno;
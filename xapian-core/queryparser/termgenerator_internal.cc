@@ -26,6 +26,7 @@
 #include <xapian/queryparser.h>
 #include <xapian/unicode.h>
 
+#include "phrasepairs.h"
 #include "stringutils.h"
 
 #include <limits>
@@ -240,7 +241,22 @@ endofterm:
 	if (stop_mode == STOPWORDS_IGNORE && (*stopper)(term)) continue;
 
 	if (with_positions) {
-	    doc.add_posting(prefix + term, ++termpos, wdf_inc);
+	    string posterm = prefix + term;
+	    doc.add_posting(posterm, ++termpos, wdf_inc);
+	    if (flags & FLAG_PHRASE_PAIRS) {
+		if (last_posterm.empty()) {
+		    // Mark the document as having pair terms.
+		    doc.add_term(PHRASE_PAIRS_MARKER, 0);
+		} else if (last_posterm_pos + 1 == termpos &&
+			   !phrase_pair_too_long(last_posterm, posterm)) {
+		    // The pair can match a phrase, so index it.  We use a wdf
+		    // of 0 so the document length isn't changed.
+		    doc.add_term(make_phrase_pair_term(last_posterm, posterm),
+				 0);
+		}
+		swap(last_posterm, posterm);
+		last_posterm_pos = termpos;
+	    }
 	} else {
 	    doc.add_term(prefix + term, wdf_inc);
 	}
@@ -257,7 +273,7 @@ endofterm:
 	    last_term = term;
 	}
 
-	if (!(*stopper)(term) && should_phone(term)) {
+	if ((!stopper || !(*stopper)(term)) && should_phone(term)) {
 	    if (!phonetic_language.empty()) {
 		string phon("P");
 		phon += prefix;
@@ -43,12 +43,18 @@ class TermGenerator::Internal : public Xapian::Internal::intrusive_base {
     TermGenerator::flags flags;
     WritableDatabase db;
 
+    /// The last term indexed with positional information.
+    std::string last_posterm;
+
+    /// The position of last_posterm.
+    termcount last_posterm_pos;
+
     std::map<std::string, std::string> spelling_prefixes;
     std::map<std::string, std::string> phonetic_prefixes;
 
   public:
     Internal() : stopper(NULL), termpos(0),
-	flags(TermGenerator::flags(0)) { }
+	flags(TermGenerator::flags(0)), last_posterm_pos(0) { }
     void index_text(Utf8Iterator itor,
 		    termcount weight,
 		    const std::string & prefix,
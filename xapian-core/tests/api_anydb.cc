@@ -31,6 +31,7 @@
 
 #include <xapian.h>
 #include "backendmanager_local.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "utils.h"
@@ -354,6 +355,117 @@ DEFINE_TESTCASE(multidb5, backend && !multi) {
     return true;
 }
 
+static Xapian::MSet
+get_mset_in_parallel(Xapian::Enquire & enquire,
+		     Xapian::doccount first, Xapian::doccount maxitems,
+		     Xapian::doccount check_at_least)
+{
+    enquire.set_match_threads(4);
+    Xapian::MSet mset = enquire.get_mset(first, maxitems, check_at_least);
+    enquire.set_match_threads(0);
+    return mset;
+}
+
+/// Check that matching sub-databases in parallel gives the same results.
+DEFINE_TESTCASE(multidb6, backend && !multi) {
+    // Include the same database twice so there are lots of equal weights,
+    // which need to be ordered by docid across the sub-databases.
+    Xapian::Database db(get_database("etext"));
+    db.add_database(get_database("apitest_simpledata"));
+    db.add_database(get_database("etext"));
+    Xapian::Enquire enquire(db);
+
+    static const Xapian::Query queries[] = {
+	Xapian::Query("the"),
+	query(Xapian::Query::OP_OR, "the", "prussian"),
+	query(Xapian::Query::OP_AND, "the", "of"),
+	query(Xapian::Query::OP_AND_NOT, "the", "prussian"),
+	query(Xapian::Query::OP_AND_MAYBE, "of", "prussian"),
+	query(Xapian::Query::OP_OR, "this", "word")
+    };
+
+    for (size_t i = 0; i != sizeof(queries) / sizeof(queries[0]); ++i) {
+	tout << queries[i] << endl;
+	enquire.set_query(queries[i]);
+	for (int sort = 0; sort != 3; ++sort) {
+	    if (sort == 0) {
+		enquire.set_sort_by_relevance();
+		enquire.set_weighting_scheme(Xapian::BM25Weight());
+	    } else if (sort == 1) {
+		enquire.set_sort_by_relevance();
+		enquire.set_weighting_scheme(Xapian::BoolWeight());
+	    } else {
+		enquire.set_weighting_scheme(Xapian::BM25Weight());
+		enquire.set_sort_by_value_then_relevance(1, true);
+	    }
+	    Xapian::doccount first, maxitems;
+	    for (first = 0; first < 30; first += 7) {
+		for (maxitems = 1; maxitems < 40; maxitems += 13) {
+		    Xapian::MSet mset1 = enquire.get_mset(first, maxitems);
+		    Xapian::MSet mset2 =
+			get_mset_in_parallel(enquire, first, maxitems, 0);
+		    TEST_EQUAL(mset1.size(), mset2.size());
+		    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+		    TEST_EQUAL_DOUBLE(mset1.get_max_possible(),
+				      mset2.get_max_possible());
+		    TEST_EQUAL_DOUBLE(mset1.get_max_attained(),
+				      mset2.get_max_attained());
+		    TEST_REL(mset2.get_matches_lower_bound(),<=,
+			     mset2.get_matches_estimated());
+		    TEST_REL(mset2.get_matches_estimated(),<=,
+			     mset2.get_matches_upper_bound());
+		    if (!mset1.empty()) {
+			TEST_EQUAL(mset1[0].get_percent(),
+				   mset2[0].get_percent());
+		    }
+
+		    // If we check all the matches, the counts must be exact.
+		    Xapian::doccount all = db.get_doccount();
+		    mset1 = enquire.get_mset(first, maxitems, all);
+		    mset2 = get_mset_in_parallel(enquire, first, maxitems, all);
+		    TEST(mset1 == mset2);
+		}
+	    }
+	}
+    }
+
+    return true;
+}
+
+static void
+make_multidb7_db(Xapian::WritableDatabase & db, const string &)
+{
+    // Enough documents that the posting lists span many blocks.
+    Xapian::Document doc;
+    for (Xapian::docid did = 1; did <= 20000; ++did) {
+	doc.clear_terms();
+	doc.add_term("all", did % 5 + 1);
+	doc.add_term("t" + str(did % 13), did % 3 + 1);
+	db.add_document(doc);
+    }
+}
+
+/// Check asking for parallel matching with the same sub-database repeated.
+DEFINE_TESTCASE(multidb7, generated && !multi && !remote) {
+    // The sub-databases share one Database::Internal, which mustn't be used
+    // in several threads at once, so these should be matched serially.
+    // Document lengths in an array can safely be read in several threads, so
+    // use the doclen postlist, which can't.
+    Xapian::Database subdb(get_database_path("multidb7", make_multidb7_db),
+			   Xapian::DB_NO_DOCLEN_ARRAY);
+    Xapian::Database db;
+    for (int i = 0; i != 4; ++i) db.add_database(subdb);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "t1", "t2"));
+    Xapian::doccount all = db.get_doccount();
+    Xapian::MSet mset1 = enquire.get_mset(0, 20, all);
+    for (int i = 0; i != 20; ++i) {
+	Xapian::MSet mset2 = get_mset_in_parallel(enquire, 0, 20, all);
+	TEST(mset1 == mset2);
+    }
+    return true;
+}
+
 // tests that when specifying maxitems to get_mset, no more than
 // that are returned.
 DEFINE_TESTCASE(msetmaxitems1, backend) {
@@ -1122,6 +1234,32 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     return true;
 }
 
+// Test that fetching documents from an MSet which doesn't start at the first
+// match reads the right documents, and that documents fetched in a batch
+// match those read individually.
+DEFINE_TESTCASE(fetchdocs2, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+
+    Xapian::MSet mset = enquire.get_mset(2, 10);
+    TEST(mset.size() >= 3);
+    mset.fetch(mset[1], mset.end());
+    mset.fetch();
+
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::Document doc = i.get_document();
+	Xapian::Document expected = db.get_document(*i);
+	TEST_EQUAL(doc.get_docid(), expected.get_docid());
+	TEST_EQUAL(doc.get_data(), expected.get_data());
+	TEST_NOT_EQUAL(doc.get_data(), "");
+	TEST_EQUAL(doc.values_count(), expected.values_count());
+	TEST_EQUAL(doc.termlist_count(), expected.termlist_count());
+    }
+
+    return true;
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -30,12 +30,20 @@
 #include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
+#include "unixcmds.h"
 #include "utils.h"
 
 #include "apitest.h"
 
 #include "safeunistd.h"
 
+#include <stdlib.h> // For setenv() or putenv()
+#include <vector>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 using namespace std;
 
 /// Regression test - lockfile should honour umask, was only user-readable.
@@ -358,13 +366,15 @@ DEFINE_TESTCASE(qpmemoryleak1, writable && !inmemory) {
     Xapian::Database database(get_writable_database_as_database());
     Xapian::QueryParser queryparser;
     queryparser.set_database(database);
+    // Blocks which the reader has already read at its revision may be served
+    // from the block cache even after they've been overwritten on disk, so
+    // commit enough changes to overwrite the revision before it first looks.
+    for (int k = 0; k < 3; ++k) {
+	wdb.add_document(doc);
+	wdb.commit();
+    }
     TEST_EXCEPTION(Xapian::DatabaseModifiedError,
-	for (int k = 0; k < 3; ++k) {
-	    wdb.add_document(doc);
-	    wdb.commit();
-	    (void)queryparser.parse_query("1", queryparser.FLAG_PARTIAL);
-	}
-    );
+	(void)queryparser.parse_query("1", queryparser.FLAG_PARTIAL));
 
     return true;
 }
@@ -637,6 +647,213 @@ DEFINE_TESTCASE(orcheck1, generated) {
     return true;
 }
 
+static void
+make_wand_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Enough documents that the posting lists of the common terms span
+    // several chunks, with the higher wdfs in some chunks but not others.
+    for (Xapian::docid did = 1; did <= 10000; ++did) {
+	Xapian::Document doc;
+	for (unsigned t = 0; t < 12; ++t) {
+	    if (did % (t + 1) != 0) continue;
+	    Xapian::termcount wdf = 1;
+	    if (did / 1000 == t % 3) wdf += (did * (t + 3)) % 29;
+	    doc.add_term("T" + str(t), wdf);
+	}
+	doc.add_term("pad", 1 + did % 13);
+	db.add_document(doc);
+    }
+}
+
+/// Check that pruning an OR of many terms doesn't change the top results.
+DEFINE_TESTCASE(wand1, generated) {
+    Xapian::Database db = get_database("wand1", make_wand_db);
+    Xapian::Enquire enq(db);
+    // Ranges of terms to OR together - T4 on its own and with T3 check that
+    // skipping chunks of postings gives the right answers, and the longer
+    // ranges use MultiOrPostList.
+    static const unsigned ranges[][2] = {
+	{ 4, 5 }, { 3, 5 }, { 4, 12 }, { 0, 12 }
+    };
+    static const Xapian::doccount sizes[] = { 1, 2, 3, 5, 10, 17, 100, 0 };
+    for (size_t r = 0; r != sizeof(ranges) / sizeof(ranges[0]); ++r) {
+	vector<Xapian::Query> terms;
+	for (unsigned t = ranges[r][0]; t != ranges[r][1]; ++t) {
+	    terms.push_back(Xapian::Query("T" + str(t)));
+	}
+	enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    terms.begin(), terms.end()));
+	tout << enq.get_query().get_description() << '\n';
+
+	Xapian::MSet msetall = enq.get_mset(0, db.get_doccount());
+	for (const Xapian::doccount * size = sizes; *size; ++size) {
+	    Xapian::MSet submset = enq.get_mset(0, *size);
+	    TEST_EQUAL(submset.size(), *size);
+	    TEST(mset_range_is_same(submset, 0, msetall, 0, submset.size()));
+	}
+    }
+    return true;
+}
+
+/// Run the checks for andskip1 on database @a db.
+static void
+check_andskip(const Xapian::Database & db)
+{
+    Xapian::Enquire enq(db);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+
+    // Term Tn indexes the documents whose docid is a multiple of n + 1, so
+    // these match the multiples of 3 * 5 * 7 = 105.
+    Xapian::Query q("T2");
+    q = Xapian::Query(Xapian::Query::OP_AND, q, Xapian::Query("T4"));
+    q = Xapian::Query(Xapian::Query::OP_AND, q, Xapian::Query("T6"));
+    enq.set_query(q);
+    enq.set_docid_order(enq.ASCENDING);
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    TEST_EQUAL(mset.size(), 10000 / 105);
+    Xapian::docid expect = 0;
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	expect += 105;
+	TEST_EQUAL(*i, expect);
+    }
+
+    // An OR under an AND gets asked to skip too: (T4 OR T6) AND T10 matches
+    // the multiples of 55 and 77.
+    q = Xapian::Query(Xapian::Query::OP_OR, Xapian::Query("T4"),
+		      Xapian::Query("T6"));
+    q = Xapian::Query(Xapian::Query::OP_AND, q, Xapian::Query("T10"));
+    enq.set_query(q);
+    mset = enq.get_mset(0, db.get_doccount());
+    Xapian::doccount count = 0;
+    for (Xapian::docid did = 1; did <= 10000; ++did) {
+	if (did % 55 == 0 || did % 77 == 0) {
+	    TEST_REL(count,<,mset.size());
+	    TEST_EQUAL(*mset[count], did);
+	    ++count;
+	}
+    }
+    TEST_EQUAL(mset.size(), count);
+}
+
+/// Check AND queries which skip between chunks give the right documents.
+DEFINE_TESTCASE(andskip1, generated) {
+    check_andskip(get_database("wand1", make_wand_db));
+    // Hinting which blocks will be read mustn't change the results.
+    check_andskip(Xapian::Database(get_database_path("wand1", make_wand_db),
+				   Xapian::DB_PREFETCH));
+    return true;
+}
+
+/// Check document lengths are right once they're read from an array.
+DEFINE_TESTCASE(doclenarray1, brass) {
+    Xapian::WritableDatabase db = get_named_writable_database("doclenarray1");
+    const string path = get_named_writable_database_path("doclenarray1");
+    const Xapian::docid N = 500;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("len", did % 37);
+	db.add_document(doc);
+    }
+    db.delete_document(3);
+    db.commit();
+
+    // Open two read-only databases, which will share the array.  Read the
+    // lengths several times, so that the array gets built part way through.
+    // A third database doesn't use the array, and should get the same
+    // lengths from the postlist.
+    Xapian::Database rodb1(path);
+    Xapian::Database rodb2(path);
+    Xapian::Database rodb3(path, Xapian::DB_NO_DOCLEN_ARRAY);
+    for (int pass = 0; pass != 3; ++pass) {
+	for (Xapian::docid did = 1; did <= N; ++did) {
+	    if (did == 3) {
+		TEST_EXCEPTION(Xapian::DocNotFoundError,
+			       rodb1.get_doclength(did));
+		continue;
+	    }
+	    TEST_EQUAL(rodb1.get_doclength(did), 1 + did % 37);
+	    TEST_EQUAL(rodb2.get_doclength(did), 1 + did % 37);
+	    TEST_EQUAL(rodb3.get_doclength(did), 1 + did % 37);
+	}
+	TEST_EXCEPTION(Xapian::DocNotFoundError, rodb1.get_doclength(N + 1));
+	TEST_EXCEPTION(Xapian::DocNotFoundError, rodb3.get_doclength(3));
+	TEST_EXCEPTION(Xapian::DocNotFoundError, rodb2.get_document(3));
+    }
+
+    // The leaf postlists should get the same lengths.
+    Xapian::PostingIterator p;
+    for (p = rodb1.postlist_begin("all"); p != rodb1.postlist_end("all"); ++p) {
+	TEST_EQUAL(p.get_doclength(), 1 + *p % 37);
+    }
+
+    // After a change, a reopened database must get the new lengths.
+    Xapian::Document doc;
+    doc.add_term("all", 7);
+    db.replace_document(5, doc);
+    db.add_document(doc);
+    db.commit();
+    TEST(rodb1.reopen());
+    TEST_EQUAL(rodb1.get_doclength(5), 7);
+    TEST_EQUAL(rodb1.get_doclength(N + 1), 7);
+    for (Xapian::docid did = 6; did <= N; ++did) {
+	TEST_EQUAL(rodb1.get_doclength(did), 1 + did % 37);
+    }
+    // The other database is still at the old revision.
+    TEST_EQUAL(rodb2.get_doclength(5), 1 + 5 % 37);
+    return true;
+}
+
+/// Check copies of a database which have diverged don't share an array.
+DEFINE_TESTCASE(doclenarray2, brass) {
+    const string path = get_named_writable_database_path("doclenarray2");
+    const string copy_path = path + "_copy";
+    const Xapian::docid N = 200;
+    {
+	Xapian::WritableDatabase db = get_named_writable_database("doclenarray2");
+	for (Xapian::docid did = 1; did <= N; ++did) {
+	    Xapian::Document doc;
+	    doc.add_term("all", did);
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+
+    // The copy has the same UUID, and after one more commit to each, both
+    // are at the same revision.
+    rm_rf(copy_path);
+    cp_R(path, copy_path);
+    Xapian::Document doc;
+    doc.add_term("all", 5);
+    {
+	Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+	db.replace_document(1, doc);
+	db.commit();
+    }
+    doc = Xapian::Document();
+    doc.add_term("all", 9);
+    {
+	Xapian::WritableDatabase db(copy_path, Xapian::DB_OPEN);
+	db.replace_document(1, doc);
+	db.commit();
+    }
+
+    Xapian::Database rodb1(path);
+    Xapian::Database rodb2(copy_path);
+    TEST_EQUAL(rodb1.get_uuid(), rodb2.get_uuid());
+    for (int pass = 0; pass != 3; ++pass) {
+	for (Xapian::docid did = 2; did <= N; ++did) {
+	    TEST_EQUAL(rodb1.get_doclength(did), did);
+	    TEST_EQUAL(rodb2.get_doclength(did), did);
+	}
+	TEST_EQUAL(rodb1.get_doclength(1), 5);
+	TEST_EQUAL(rodb2.get_doclength(1), 9);
+    }
+
+    rm_rf(copy_path);
+    return true;
+}
+
 /** Regression test for bug fixed in 1.2.1 and 1.0.21.
  *
  *  We failed to mark the Btree as unmodified after cancel().
@@ -741,3 +958,650 @@ DEFINE_TESTCASE(tradweight2, backend) {
     }
     return true;
 }
+
+/// Check that reading tables via mmap() works, including after reopen().
+DEFINE_TESTCASE(mmap1, brass || chert) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap1");
+    Xapian::Document doc;
+    for (int i = 0; i < 1000; ++i) {
+	doc.clear_terms();
+	doc.add_term("all");
+	doc.add_term("t" + str(i % 37));
+	doc.set_data(string(i % 100, 'x'));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db(get_named_writable_database_path("mmap1"),
+			Xapian::DB_READ_MMAP);
+
+    TEST_EQUAL(db.get_doccount(), 1000);
+    TEST_EQUAL(db.get_termfreq("all"), 1000);
+    TEST_EQUAL(db.get_termfreq("t3"), 27);
+    Xapian::docid did = 4;
+    for (Xapian::PostingIterator p = db.postlist_begin("t3");
+	 p != db.postlist_end("t3"); ++p) {
+	TEST_EQUAL(*p, did);
+	did += 37;
+    }
+    TEST_EQUAL(db.get_document(123).get_data(), string(22, 'x'));
+
+    // Make the tables grow enough that they need to be remapped.
+    for (int i = 0; i < 5000; ++i) {
+	doc.clear_terms();
+	doc.add_term("all");
+	doc.add_term("u" + str(i));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+    TEST(db.reopen());
+
+    TEST_EQUAL(db.get_doccount(), 6000);
+    TEST_EQUAL(db.get_termfreq("all"), 6000);
+    TEST_EQUAL(db.get_termfreq("u4321"), 1);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("t3"));
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 27);
+    Xapian::doccount count = 0;
+    for (Xapian::TermIterator t = db.allterms_begin("u");
+	 t != db.allterms_end("u"); ++t) {
+	++count;
+    }
+    TEST_EQUAL(count, 5000);
+    return true;
+}
+
+/** Check reading via mmap() while a writer overwrites the revision being read.
+ *
+ *  The reader must either see the revision it opened or throw
+ *  DatabaseModifiedError - it mustn't see blocks from the writer's revisions.
+ */
+DEFINE_TESTCASE(mmap2, brass || chert) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap2");
+    Xapian::Document doc;
+    for (int i = 0; i < 1000; ++i) {
+	doc.clear_terms();
+	doc.add_term("all");
+	doc.add_term("t" + str(i % 37));
+	doc.set_data("old" + str(i));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db(get_named_writable_database_path("mmap2"),
+			Xapian::DB_READ_MMAP);
+    // Position some cursors on blocks which the writer will free.
+    Xapian::PostingIterator p = db.postlist_begin("all");
+    Xapian::TermIterator t = db.allterms_begin("t");
+    TEST_EQUAL(*p, 1);
+    TEST_EQUAL(*t, "t0");
+
+    // Replace every document twice, so the blocks the reader's revision uses
+    // get reused.
+    for (int pass = 0; pass < 2; ++pass) {
+	for (Xapian::docid did = 1; did <= 1000; ++did) {
+	    doc.clear_terms();
+	    doc.add_term("new" + str(pass));
+	    doc.add_term("u" + str(did % 41));
+	    doc.set_data("new" + str(did));
+	    wdb.replace_document(did, doc);
+	}
+	wdb.commit();
+    }
+
+    try {
+	Xapian::docid did = 1;
+	while (++p != db.postlist_end("all")) {
+	    TEST_EQUAL(*p, ++did);
+	}
+	TEST_EQUAL(did, 1000);
+	Xapian::termcount count = 1;
+	while (++t != db.allterms_end("t")) {
+	    TEST_EQUAL((*t)[0], 't');
+	    ++count;
+	}
+	TEST_EQUAL(count, 37);
+	for (did = 1; did <= 1000; did += 7) {
+	    TEST_EQUAL(db.get_document(did).get_data(), "old" + str(did - 1));
+	}
+	TEST_EQUAL(db.get_termfreq("t3"), 27);
+    } catch (const Xapian::DatabaseModifiedError &) {
+	// This is fine - the reader noticed its revision was gone.
+    }
+
+    // After reopening, the reader should see the latest revision.
+    db.reopen();
+    TEST_EQUAL(db.get_termfreq("all"), 0);
+    TEST_EQUAL(db.get_termfreq("new1"), 1000);
+    TEST_EQUAL(db.get_document(123).get_data(), "new123");
+    return true;
+}
+
+/** Check reading via mmap() after a writer overwrites the database.
+ *
+ *  Overwriting truncates the table files, so the reader's mapping extends
+ *  past their end.  Reading it must throw an exception, as pread() would,
+ *  rather than raising SIGBUS.
+ */
+DEFINE_TESTCASE(mmap3, brass || chert) {
+    const string path = get_named_writable_database_path("mmap3");
+    {
+	Xapian::WritableDatabase wdb = get_named_writable_database("mmap3");
+	Xapian::Document doc;
+	for (int i = 0; i < 1000; ++i) {
+	    doc.clear_terms();
+	    doc.add_term("t" + str(i % 37));
+	    doc.set_data(string(i % 100, 'x'));
+	    wdb.add_document(doc);
+	}
+	wdb.commit();
+    }
+
+    Xapian::Database db(path, Xapian::DB_READ_MMAP);
+    TEST_EQUAL(db.get_document(1).get_data(), string());
+
+    Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE);
+    wdb.add_document(Xapian::Document());
+    wdb.commit();
+
+    bool threw = false;
+    try {
+	for (Xapian::docid did = 1000; did > 1; --did) {
+	    (void)db.get_document(did).get_data();
+	}
+    } catch (const Xapian::DatabaseError & e) {
+	tout << e.get_description() << endl;
+	threw = true;
+    }
+    TEST(threw);
+    return true;
+}
+
+static void
+set_small_flush_threshold(bool on)
+{
+#ifdef __WIN32__
+    _putenv_s("XAPIAN_FLUSH_THRESHOLD", on ? "100" : "0");
+#elif defined HAVE_SETENV
+    setenv("XAPIAN_FLUSH_THRESHOLD", on ? "100" : "0", 1);
+#else
+    // putenv() keeps the pointer it's passed, so use static strings.
+    putenv(const_cast<char*>(on ? "XAPIAN_FLUSH_THRESHOLD=100" :
+				  "XAPIAN_FLUSH_THRESHOLD=0"));
+#endif
+}
+
+static Xapian::WritableDatabase
+get_fresh_build_database(const string & name)
+{
+    const string path = get_named_writable_database_path(name);
+    // Use a small flush threshold so that several runs get written.
+    set_small_flush_threshold(true);
+    Xapian::WritableDatabase db;
+    try {
+	db = Xapian::Brass::open(path, Xapian::DB_CREATE_OR_OVERWRITE |
+				       Xapian::DB_FRESH_BUILD);
+    } catch (...) {
+	set_small_flush_threshold(false);
+	throw;
+    }
+    set_small_flush_threshold(false);
+    return db;
+}
+
+static void
+add_fresh_build_docs(Xapian::WritableDatabase & db,
+		     Xapian::docid first, Xapian::docid last)
+{
+    Xapian::Document doc;
+    for (Xapian::docid did = first; did <= last; ++did) {
+	doc.clear_terms();
+	doc.add_posting("all", did % 7 + 1);
+	doc.add_term("t" + str(did % 37), did % 3 + 1);
+	doc.set_data(str(did));
+	TEST_EQUAL(db.add_document(doc), did);
+    }
+}
+
+static void
+check_fresh_build_db(const Xapian::Database & db, Xapian::docid last)
+{
+    TEST_EQUAL(db.get_doccount(), last);
+    TEST_EQUAL(db.get_termfreq("all"), last);
+    TEST_EQUAL(db.get_collection_freq("all"), last);
+    Xapian::docid did = 3;
+    for (Xapian::PostingIterator p = db.postlist_begin("t3");
+	 p != db.postlist_end("t3"); ++p) {
+	TEST_EQUAL(*p, did);
+	TEST_EQUAL(p.get_wdf(), did % 3 + 1);
+	TEST_EQUAL(p.get_doclength(), did % 3 + 2);
+	did += 37;
+    }
+    TEST_REL(did,>,last);
+    TEST_EQUAL(db.get_termfreq("t3"), (last + 34) / 37);
+    for (did = 1; did <= last; did += 99) {
+	Xapian::PositionIterator pos = db.positionlist_begin(did, "all");
+	TEST(pos != db.positionlist_end(did, "all"));
+	TEST_EQUAL(*pos, did % 7 + 1);
+	TEST_EQUAL(db.get_document(did).get_data(), str(did));
+    }
+}
+
+/// Check building a new database in "fresh build" mode.
+DEFINE_TESTCASE(freshbuild1, brass) {
+    const string name = "freshbuild1";
+    Xapian::WritableDatabase db = get_fresh_build_database(name);
+    const string path = get_named_writable_database_path(name);
+    add_fresh_build_docs(db, 1, 1000);
+    // Each batch of 100 documents' postings should be written to a run,
+    // and nothing committed.
+    TEST(file_exists(path + "/postlist_run0.DB"));
+    TEST(file_exists(path + "/postlist_run9.DB"));
+    TEST_EQUAL(Xapian::Database(path).get_doccount(), 0);
+
+    // Committing merges the runs and deletes them.
+    db.commit();
+    TEST(!file_exists(path + "/postlist_run0.DB"));
+    TEST(!file_exists(path + "/postlist_run9.DB"));
+    check_fresh_build_db(Xapian::Database(path), 1000);
+
+    // Once committed, further changes are made in the usual way.
+    add_fresh_build_docs(db, 1001, 1250);
+    TEST(!file_exists(path + "/postlist_run0.DB"));
+    db.delete_document(1250);
+    db.commit();
+    Xapian::Database rodb(path);
+    TEST_EQUAL(rodb.get_lastdocid(), 1250);
+    check_fresh_build_db(rodb, 1249);
+    return true;
+}
+
+/// Check that reading postings during a fresh build merges the runs first.
+DEFINE_TESTCASE(freshbuild2, brass) {
+    const string name = "freshbuild2";
+    Xapian::WritableDatabase db = get_fresh_build_database(name);
+    const string path = get_named_writable_database_path(name);
+    add_fresh_build_docs(db, 1, 250);
+    TEST(file_exists(path + "/postlist_run1.DB"));
+    check_fresh_build_db(db, 250);
+    TEST(!file_exists(path + "/postlist_run0.DB"));
+
+    add_fresh_build_docs(db, 251, 500);
+    db.commit();
+    check_fresh_build_db(Xapian::Database(path), 500);
+
+    // Cancelling a transaction discards its runs.
+    db = get_fresh_build_database(name + "b");
+    db.begin_transaction(false);
+    add_fresh_build_docs(db, 1, 150);
+    TEST(file_exists(path + "b/postlist_run0.DB"));
+    db.cancel_transaction();
+    TEST(!file_exists(path + "b/postlist_run0.DB"));
+    add_fresh_build_docs(db, 1, 150);
+    db.commit();
+    check_fresh_build_db(Xapian::Database(path + "b"), 150);
+    return true;
+}
+
+/** Test merging MSets from several remote databases.
+ *
+ *  The MSet items are sent in batches and the matcher stops reading them
+ *  once it has enough, so check that unread items don't confuse subsequent
+ *  requests.
+ */
+DEFINE_TESTCASE(remotemset1, remote && writable) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    for (int i = 1; i <= 2000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(str(i));
+	doc.add_term("all", 1 + i % 7);
+	doc.add_term("k" + str(i % 5));
+	doc.add_value(0, str(i % 10));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db = get_writable_database_as_database();
+    db.add_database(get_writable_database_as_database());
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    Xapian::MSet all = enq.get_mset(0, 4000);
+    TEST_EQUAL(all.size(), 4000);
+
+    for (Xapian::doccount first = 0; first < 100; first += 30) {
+	Xapian::MSet mset = enq.get_mset(first, 10);
+	TEST(mset_range_is_same(mset, 0, all, first, 10));
+	TEST_EQUAL(mset.begin().get_document().get_data(),
+		   all[first].get_document().get_data());
+	TEST_EQUAL(db.get_termfreq("k1"), 800);
+    }
+
+    // Large enough that the items from each database are sent in several
+    // batches, not all of which are needed.
+    Xapian::MSet mset = enq.get_mset(0, 1000);
+    TEST(mset_range_is_same(mset, 0, all, 0, 1000));
+    TEST_EQUAL(mset.back().get_document().get_data(),
+	       all[999].get_document().get_data());
+
+    // Sorting by value needs all the items to be read.
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				Xapian::Query("k1"), Xapian::Query("k2")));
+    enq.set_sort_by_relevance_then_value(0, false);
+    all = enq.get_mset(0, 4000);
+    TEST_EQUAL(all.size(), 1600);
+    mset = enq.get_mset(100, 10);
+    TEST(mset_range_is_same(mset, 0, all, 100, 10));
+
+    return true;
+}
+
+#if defined HAVE_EPOLL_CREATE && defined HAVE_PTHREAD
+/// A client of the threaded server in remotethreads1.
+struct RemoteThreadsClient {
+    Xapian::Database db;
+
+    Xapian::doccount expected;
+
+    bool ok;
+};
+
+extern "C" {
+
+static void *
+run_remote_threads_client(void * arg)
+{
+    RemoteThreadsClient * client = static_cast<RemoteThreadsClient *>(arg);
+    try {
+	Xapian::Enquire enq(client->db);
+	enq.set_query(Xapian::Query("test"));
+	for (int i = 0; i != 20; ++i) {
+	    Xapian::MSet mset = enq.get_mset(0, 20);
+	    if (mset.size() != client->expected) return NULL;
+	}
+	client->ok = true;
+    } catch (...) {
+    }
+    return NULL;
+}
+
+}
+
+/// Run queries from all of @a clients at once.
+static bool
+run_remote_threads_clients(RemoteThreadsClient * clients, int n,
+			   Xapian::doccount expected)
+{
+    vector<pthread_t> threads(n);
+    for (int i = 0; i != n; ++i) {
+	clients[i].expected = expected;
+	clients[i].ok = false;
+	TEST(pthread_create(&threads[i], NULL, run_remote_threads_client,
+			    &clients[i]) == 0);
+    }
+    bool ok = true;
+    for (int i = 0; i != n; ++i) {
+	pthread_join(threads[i], NULL);
+	if (!clients[i].ok) ok = false;
+    }
+    return ok;
+}
+#endif
+
+/// Check several clients can use a threaded xapian-tcpsrv at once.
+DEFINE_TESTCASE(remotethreads1, remotetcp) {
+#if defined HAVE_EPOLL_CREATE && defined HAVE_PTHREAD
+    // The server reads the database directly, so build it locally.
+    string path = get_named_writable_database_path("remotethreads1");
+    Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE);
+    Xapian::Document doc;
+    doc.add_term("test");
+    for (int i = 0; i != 10; ++i) wdb.add_document(doc);
+    wdb.commit();
+
+    // More clients than threads, so the workers and the pool of databases
+    // have to be shared between connections.
+    const int N_CLIENTS = 6;
+    RemoteThreadsClient clients[N_CLIENTS];
+    for (int i = 0; i != N_CLIENTS; ++i) {
+	clients[i].db = get_threaded_remote_database(path, 2);
+    }
+    TEST(run_remote_threads_clients(clients, N_CLIENTS, 10));
+
+    // Clients which haven't reopened must still be served the revision they
+    // started with, even though the server's databases are shared.
+    wdb.add_document(doc);
+    wdb.commit();
+    TEST(run_remote_threads_clients(clients, N_CLIENTS, 10));
+
+    // After reopen() they should all see the new document, which means the
+    // databases released to the pool have been reopened.
+    for (int i = 0; i != N_CLIENTS; ++i) {
+	clients[i].db.reopen();
+    }
+    TEST(run_remote_threads_clients(clients, N_CLIENTS, 11));
+
+    // And so should a new client.
+    Xapian::Enquire enq(get_threaded_remote_database(path, 2));
+    enq.set_query(Xapian::Query("test"));
+    TEST_EQUAL(enq.get_mset(0, 20).size(), 11);
+    return true;
+#else
+    SKIP_TEST("Threaded server mode requires epoll and POSIX threads");
+#endif
+}
+
+static void
+check_postlist_batches(const Xapian::Database & db, const string & term)
+{
+    vector<Xapian::docid> all_dids;
+    vector<Xapian::termcount> all_wdfs, all_doclens;
+    Xapian::PostingIterator p;
+    for (p = db.postlist_begin(term); p != db.postlist_end(term); ++p) {
+	all_dids.push_back(*p);
+	all_wdfs.push_back(p.get_wdf());
+	all_doclens.push_back(p.get_doclength());
+    }
+    TEST_EQUAL(all_dids.size(), db.get_termfreq(term));
+
+    static const Xapian::doccount sizes[] = { 1, 7, 128, 1000 };
+    for (size_t k = 0; k != sizeof(sizes) / sizeof(sizes[0]); ++k) {
+	Xapian::doccount n = sizes[k];
+	tout << "term '" << term << "', batch size " << n << endl;
+	vector<Xapian::docid> dids(n);
+	vector<Xapian::termcount> wdfs(n), doclens(n);
+	size_t pos = 0;
+	p = db.postlist_begin(term);
+	while (true) {
+	    // Only ask for the wdfs and document lengths on some batches.
+	    bool want_wdfs = (pos / n) % 2 == 0;
+	    bool want_doclens = (pos / n) % 3 != 1;
+	    Xapian::doccount got;
+	    got = p.get_batch(n, &dids[0],
+			      want_wdfs ? &wdfs[0] : NULL,
+			      want_doclens ? &doclens[0] : NULL);
+	    TEST_REL(got,<=,n);
+	    TEST_REL(pos + got,<=,all_dids.size());
+	    for (Xapian::doccount i = 0; i != got; ++i) {
+		TEST_EQUAL(dids[i], all_dids[pos + i]);
+		if (want_wdfs) TEST_EQUAL(wdfs[i], all_wdfs[pos + i]);
+		if (want_doclens) TEST_EQUAL(doclens[i], all_doclens[pos + i]);
+	    }
+	    pos += got;
+	    if (got < n) break;
+	    // The iterator should be left at the next posting.
+	    if (pos < all_dids.size()) {
+		TEST(p != db.postlist_end(term));
+		TEST_EQUAL(*p, all_dids[pos]);
+	    }
+	}
+	TEST_EQUAL(pos, all_dids.size());
+	TEST(p == db.postlist_end(term));
+	TEST_EQUAL(p.get_batch(n, &dids[0]), 0);
+    }
+
+    // Check get_batch() works after skip_to().
+    if (all_dids.size() > 10) {
+	p = db.postlist_begin(term);
+	p.skip_to(all_dids[10]);
+	Xapian::docid did;
+	TEST_EQUAL(p.get_batch(1, &did), 1);
+	TEST_EQUAL(did, all_dids[10]);
+	TEST_EQUAL(*p, all_dids[11]);
+    }
+}
+
+/// Test PostingIterator::get_batch() matches reading postings one at a time.
+DEFINE_TESTCASE(postlistbatch1, writable) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    for (Xapian::doccount i = 1; i <= 3000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all", 1 + i % 13);
+	if (i % 3 == 0) doc.add_term("three", i);
+	if (i % 1000 == 1) doc.add_term("sparse");
+	for (Xapian::termcount j = 0; j != i % 5; ++j)
+	    doc.add_term("pad" + str(j));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    static const char * const terms[] = { "all", "three", "sparse", "", "nosuchterm" };
+    for (size_t k = 0; k != sizeof(terms) / sizeof(terms[0]); ++k) {
+	check_postlist_batches(wdb, terms[k]);
+    }
+
+    // Check with docids which aren't contiguous, and with changes which
+    // haven't been committed yet.
+    for (Xapian::docid did = 5; did < 3000; did += 11) {
+	wdb.delete_document(did);
+    }
+    Xapian::Document doc;
+    doc.add_term("all", 2);
+    doc.add_term("three", 3);
+    wdb.replace_document(9, doc);
+    wdb.add_document(doc);
+    for (size_t k = 0; k != sizeof(terms) / sizeof(terms[0]); ++k) {
+	check_postlist_batches(wdb, terms[k]);
+    }
+    wdb.commit();
+    for (size_t k = 0; k != sizeof(terms) / sizeof(terms[0]); ++k) {
+	check_postlist_batches(wdb, terms[k]);
+    }
+
+    return true;
+}
+
+/// Test documents too big to fit in a pipe or socket buffer.
+DEFINE_TESTCASE(largedoc1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    string data;
+    for (int i = 0; i != 300000; ++i) {
+	data += char('a' + i % 26);
+	if (i % 1000 == 999) data += str(i);
+    }
+    Xapian::Document doc;
+    doc.set_data(data);
+    for (int i = 0; i != 20000; ++i) {
+	doc.add_term("XTERM" + str(i));
+    }
+    Xapian::docid did = db.add_document(doc);
+    db.commit();
+
+    Xapian::Document got = db.get_document(did);
+    TEST(got.get_data() == data);
+    TEST_EQUAL(got.termlist_count(), 20000);
+    TEST_EQUAL(db.get_termfreq("XTERM12345"), 1);
+
+    // Replace it with a small document and check that a following message
+    // is read correctly.
+    db.replace_document(did, Xapian::Document());
+    db.commit();
+    TEST_EQUAL(db.get_document(did).get_data(), string());
+    TEST_EQUAL(db.get_termfreq("XTERM12345"), 0);
+    return true;
+}
+
+/// Test reading long postlists, termlists and allterms lists.
+DEFINE_TESTCASE(longlists1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    const Xapian::doccount N = 10000;
+    Xapian::Document bigdoc;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", 1 + did % 7);
+	if (did % 1000 == 0) doc.add_term("thousands");
+	doc.add_term("uniq" + str(did));
+	db.add_document(doc);
+	bigdoc.add_term("big" + str(did), did);
+    }
+    Xapian::docid bigdid = db.add_document(bigdoc);
+    db.commit();
+
+    // Read a whole postlist.
+    Xapian::PostingIterator p = db.postlist_begin("all");
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	TEST(p != db.postlist_end("all"));
+	TEST_EQUAL(*p, did);
+	TEST_EQUAL(p.get_wdf(), 1 + did % 7);
+	++p;
+    }
+    TEST(p == db.postlist_end("all"));
+
+    // Skip through a postlist, both within and a long way beyond what has
+    // been read so far.
+    p = db.postlist_begin("all");
+    TEST_EQUAL(*p, 1);
+    p.skip_to(3);
+    TEST_EQUAL(*p, 3);
+    p.skip_to(7000);
+    TEST_EQUAL(*p, 7000);
+    TEST_EQUAL(p.get_wdf(), 1 + 7000 % 7);
+    ++p;
+    TEST_EQUAL(*p, 7001);
+    p.skip_to(6000);
+    TEST_EQUAL(*p, 7001);
+    p.skip_to(N);
+    TEST_EQUAL(*p, N);
+    ++p;
+    TEST(p == db.postlist_end("all"));
+    p = db.postlist_begin("all");
+    p.skip_to(N + 1);
+    TEST(p == db.postlist_end("all"));
+
+    p = db.postlist_begin("thousands");
+    p.skip_to(2500);
+    TEST_EQUAL(*p, 3000);
+    p.skip_to(9001);
+    TEST_EQUAL(*p, 10000);
+    ++p;
+    TEST(p == db.postlist_end("thousands"));
+
+    // Read a long termlist.
+    Xapian::TermIterator t = db.termlist_begin(bigdid);
+    string prev;
+    Xapian::termcount count = 0;
+    while (t != db.termlist_end(bigdid)) {
+	TEST_REL(prev,<,*t);
+	TEST_EQUAL(t.get_wdf(), Xapian::termcount(atoi((*t).c_str() + 3)));
+	prev = *t;
+	++count;
+	++t;
+    }
+    TEST_EQUAL(count, N);
+
+    // Read a long allterms list.
+    t = db.allterms_begin("uniq");
+    prev.resize(0);
+    count = 0;
+    while (t != db.allterms_end("uniq")) {
+	TEST_REL(prev,<,*t);
+	TEST_STRINGS_EQUAL((*t).substr(0, 4), "uniq");
+	TEST_EQUAL(t.get_termfreq(), 1);
+	prev = *t;
+	++count;
+	++t;
+    }
+    TEST_EQUAL(count, N);
+
+    return true;
+}
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -81,3 +82,43 @@ DEFINE_TESTCASE(collapsekey5,backend) {
 
     return true;
 }
+
+/// Test collapsing where many kept items are displaced from the MSet.
+DEFINE_TESTCASE(collapsekey6,writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (unsigned i = 1; i <= 400; ++i) {
+	Xapian::Document doc;
+	// Later documents tend to get higher weights, so they keep displacing
+	// items with the same collapse key which are already in the MSet.
+	doc.add_term("w", i / 10 + (i * 7) % 5 + 1);
+	doc.add_term("pad", 50);
+	if (i % 11) doc.add_value(0, str(i % 23));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("w"));
+    for (int cutoff = 0; cutoff <= 60; cutoff += 60) {
+	enquire.set_cutoff(cutoff);
+	for (Xapian::doccount cmax = 1; cmax <= 3; ++cmax) {
+	    enquire.set_collapse_key(0, cmax);
+	    Xapian::MSet full = enquire.get_mset(0, db.get_doccount());
+	    const Xapian::doccount sizes[] = { 1, 5, 20, 50 };
+	    for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		tout << "cutoff " << cutoff << " cmax " << cmax
+		     << " size " << sizes[i] << endl;
+		Xapian::MSet mset = enquire.get_mset(0, sizes[i]);
+		TEST_EQUAL(mset.size(), min(sizes[i], full.size()));
+		Xapian::MSetIterator j = mset.begin();
+		Xapian::MSetIterator k = full.begin();
+		for ( ; j != mset.end(); ++j, ++k) {
+		    TEST_EQUAL(*j, *k);
+		    TEST_EQUAL(j.get_collapse_key(), k.get_collapse_key());
+		}
+	    }
+	}
+    }
+
+    return true;
+}
@@ -297,6 +297,300 @@ DEFINE_TESTCASE(compactmultichunks1, generated) {
     return true;
 }
 
+static void
+make_varied_postlists_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	// A dense term with varying wdf, a sparse term with irregular gaps,
+	// and a term with a large wdf in a single document.
+	doc.add_term("dense", did % 13 + 1);
+	if (did % 7 == 0 || did % 11 == 0) doc.add_term("sparse", did % 3 + 1);
+	if (did == 1234) doc.add_term("dense", 100000);
+	db.add_document(doc);
+    }
+    db.commit();
+}
+
+// Test that postlists in a compacted database read back correctly, including
+// skipping within them (brass uses a different encoding after compaction).
+DEFINE_TESTCASE(compactpostlists1, generated) {
+    string indbpath = get_database_path("compactpostlists1in",
+					make_varied_postlists_db, "");
+    string outdbpath = get_named_writable_database_path("compactpostlists1out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    compact.add_source(indbpath);
+    compact.compact();
+
+    Xapian::Database indb(indbpath);
+    Xapian::Database outdb(outdbpath);
+    dbcheck(outdb, outdb.get_doccount(), outdb.get_doccount());
+
+    const char * terms[] = { "dense", "sparse" };
+    for (size_t t = 0; t != sizeof(terms) / sizeof(terms[0]); ++t) {
+	const string term(terms[t]);
+	Xapian::PostingIterator i = indb.postlist_begin(term);
+	Xapian::PostingIterator o = outdb.postlist_begin(term);
+	while (i != indb.postlist_end(term)) {
+	    TEST(o != outdb.postlist_end(term));
+	    TEST_EQUAL(*i, *o);
+	    TEST_EQUAL(i.get_wdf(), o.get_wdf());
+	    ++i;
+	    ++o;
+	}
+	TEST(o == outdb.postlist_end(term));
+
+	for (Xapian::docid did = 1; did <= 3001; did += 97) {
+	    i = indb.postlist_begin(term);
+	    o = outdb.postlist_begin(term);
+	    i.skip_to(did);
+	    o.skip_to(did);
+	    if (i == indb.postlist_end(term)) {
+		TEST(o == outdb.postlist_end(term));
+		continue;
+	    }
+	    TEST(o != outdb.postlist_end(term));
+	    TEST_EQUAL(*i, *o);
+	    TEST_EQUAL(i.get_wdf(), o.get_wdf());
+	    // Skip a short way, which should stay within the current block.
+	    i.skip_to(*i + 3);
+	    o.skip_to(*o + 3);
+	    if (i == indb.postlist_end(term)) {
+		TEST(o == outdb.postlist_end(term));
+		continue;
+	    }
+	    TEST(o != outdb.postlist_end(term));
+	    TEST_EQUAL(*i, *o);
+	    TEST_EQUAL(i.get_wdf(), o.get_wdf());
+	}
+    }
+
+    return true;
+}
+
+// Test reading postlists from a compacted database with get_batch().
+DEFINE_TESTCASE(compactpostlists2, generated) {
+    string indbpath = get_database_path("compactpostlists2in",
+					make_varied_postlists_db, "");
+    string outdbpath = get_named_writable_database_path("compactpostlists2out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    compact.add_source(indbpath);
+    compact.compact();
+
+    Xapian::Database indb(indbpath);
+    Xapian::Database outdb(outdbpath);
+
+    const char * terms[] = { "dense", "sparse" };
+    for (size_t t = 0; t != sizeof(terms) / sizeof(terms[0]); ++t) {
+	const string term(terms[t]);
+	// Read in batches which don't line up with the packed blocks.
+	Xapian::docid dids[50];
+	Xapian::termcount wdfs[50], doclens[50];
+	Xapian::PostingIterator i = indb.postlist_begin(term);
+	Xapian::PostingIterator o = outdb.postlist_begin(term);
+	Xapian::doccount n;
+	while ((n = o.get_batch(50, dids, wdfs, doclens)) != 0) {
+	    for (Xapian::doccount k = 0; k != n; ++k) {
+		TEST(i != indb.postlist_end(term));
+		TEST_EQUAL(*i, dids[k]);
+		TEST_EQUAL(i.get_wdf(), wdfs[k]);
+		TEST_EQUAL(i.get_doclength(), doclens[k]);
+		++i;
+	    }
+	}
+	TEST(i == indb.postlist_end(term));
+	TEST(o == outdb.postlist_end(term));
+    }
+
+    return true;
+}
+
+static void
+make_many_terms_db(Xapian::WritableDatabase &db, const string & s)
+{
+    for (Xapian::docid did = 1; did <= 2000; ++did) {
+	Xapian::Document doc;
+	doc.set_data(s + str(did));
+	doc.add_posting("t" + str(did % 500), 1, did % 5 + 1);
+	doc.add_posting("common", 2);
+	doc.add_term(string(1, '\0') + str(did % 7));
+	doc.add_value(1, str(did % 37));
+	db.add_document(doc);
+    }
+    db.set_metadata("key", s);
+    db.commit();
+}
+
+// Test that compacting with several threads gives the same result as with
+// one.
+DEFINE_TESTCASE(compactthreads1, brass || chert) {
+    vector<string> inputs;
+    inputs.push_back(get_database_path("compactthreads1a",
+				       make_many_terms_db, "a"));
+    inputs.push_back(get_database_path("compactthreads1b",
+				       make_many_terms_db, "b"));
+
+    string outdbpath1 = get_named_writable_database_path("compactthreads1out1");
+    string outdbpath4 = get_named_writable_database_path("compactthreads1out4");
+    rm_rf(outdbpath1);
+    rm_rf(outdbpath4);
+
+    {
+	Xapian::Compactor compact;
+	compact.set_destdir(outdbpath1);
+	compact.add_source(inputs[0]);
+	compact.add_source(inputs[1]);
+	compact.compact();
+    }
+    {
+	Xapian::Compactor compact;
+	compact.set_threads(4);
+	compact.set_destdir(outdbpath4);
+	compact.add_source(inputs[0]);
+	compact.add_source(inputs[1]);
+	compact.compact();
+    }
+
+    Xapian::Database db1(outdbpath1);
+    Xapian::Database db4(outdbpath4);
+    TEST_EQUAL(db1.get_doccount(), 4000);
+    TEST_EQUAL(db4.get_doccount(), 4000);
+    dbcheck(db4, db4.get_doccount(), db4.get_doccount());
+    TEST_EQUAL(db4.get_metadata("key"), "a");
+    TEST_EQUAL(db4.get_value_freq(1), 4000);
+
+    Xapian::TermIterator t1 = db1.allterms_begin();
+    Xapian::TermIterator t4 = db4.allterms_begin();
+    while (t1 != db1.allterms_end()) {
+	TEST(t4 != db4.allterms_end());
+	TEST_EQUAL(*t1, *t4);
+	TEST_EQUAL(t1.get_termfreq(), t4.get_termfreq());
+	TEST_EQUAL(db1.get_collection_freq(*t1), db4.get_collection_freq(*t4));
+	Xapian::PostingIterator p1 = db1.postlist_begin(*t1);
+	Xapian::PostingIterator p4 = db4.postlist_begin(*t4);
+	while (p1 != db1.postlist_end(*t1)) {
+	    TEST(p4 != db4.postlist_end(*t4));
+	    TEST_EQUAL(*p1, *p4);
+	    TEST_EQUAL(p1.get_wdf(), p4.get_wdf());
+	    ++p1;
+	    ++p4;
+	}
+	TEST(p4 == db4.postlist_end(*t4));
+	++t1;
+	++t4;
+    }
+    TEST(t4 == db4.allterms_end());
+
+    for (Xapian::docid did = 1; did <= 4000; did += 111) {
+	TEST_EQUAL(db1.get_document(did).get_data(),
+		   db4.get_document(did).get_data());
+	TEST_EQUAL(db1.get_doclength(did), db4.get_doclength(did));
+    }
+
+    return true;
+}
+
+static string
+json_record(Xapian::docid did)
+{
+    string data = "{\"id\":";
+    data += str(did);
+    data += ",\"type\":\"article\",\"status\":\"published\",\"author\":"
+	    "{\"name\":\"author";
+    data += str(did % 17);
+    data += "\",\"email\":\"author";
+    data += str(did % 17);
+    data += "@example.org\"},\"tags\":[\"tag";
+    data += str(did % 5);
+    data += "\"]}";
+    return data;
+}
+
+static void
+make_json_records_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 2000; ++did) {
+	Xapian::Document doc;
+	doc.set_data(json_record(did));
+	doc.add_term("Q" + str(did));
+	doc.add_term("tag" + str(did % 5));
+	db.add_document(doc);
+    }
+    db.commit();
+}
+
+// Test that tags compressed using a trained dictionary read back correctly.
+DEFINE_TESTCASE(compactdictionary1, brass) {
+    string indbpath = get_database_path("compactdictionary1in",
+					make_json_records_db, "");
+    string outdbpath1 = get_named_writable_database_path("compactdictionary1out1");
+    string outdbpath2 = get_named_writable_database_path("compactdictionary1out2");
+    rm_rf(outdbpath1);
+    rm_rf(outdbpath2);
+
+    {
+	Xapian::Compactor compact;
+	compact.set_destdir(outdbpath1);
+	compact.add_source(indbpath);
+	compact.compact();
+    }
+
+    {
+	Xapian::Database db(outdbpath1);
+	dbcheck(db, 2000, 2000);
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    TEST_EQUAL(db.get_document(did).get_data(), json_record(did));
+	}
+    }
+
+    // Check that new tags are compressed compatibly.
+    {
+	Xapian::WritableDatabase db(outdbpath1, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.set_data(json_record(2001));
+	doc.add_term("Q2001");
+	db.replace_document(1, doc);
+	doc.set_data(json_record(2002));
+	doc.add_term("Q2002");
+	db.add_document(doc);
+	db.commit();
+    }
+
+    {
+	Xapian::Database db(outdbpath1);
+	dbcheck(db, 2001, 2001);
+	TEST_EQUAL(db.get_document(1).get_data(), json_record(2001));
+	TEST_EQUAL(db.get_document(2001).get_data(), json_record(2002));
+	TEST_EQUAL(db.get_document(2000).get_data(), json_record(2000));
+    }
+
+    // Compacting again has to recompress the tags with a new dictionary.
+    {
+	Xapian::Compactor compact;
+	compact.set_destdir(outdbpath2);
+	compact.add_source(outdbpath1);
+	compact.add_source(indbpath);
+	compact.compact();
+    }
+
+    Xapian::Database db(outdbpath2);
+    dbcheck(db, 4001, 4001);
+    TEST_EQUAL(db.get_document(1).get_data(), json_record(2001));
+    for (Xapian::docid did = 2; did <= 2000; ++did) {
+	TEST_EQUAL(db.get_document(did).get_data(), json_record(did));
+	TEST_EQUAL(db.get_document(did + 2001).get_data(), json_record(did));
+    }
+    TEST_EQUAL(db.get_document(2001).get_data(), json_record(2002));
+
+    return true;
+}
+
 // Test compacting from a stub database directory.
 DEFINE_TESTCASE(compactstub1, brass || chert) {
     const char * stubpath = ".stub/compactstub1";
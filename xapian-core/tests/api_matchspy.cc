@@ -346,3 +346,102 @@ DEFINE_TESTCASE(matchspy6, !backend)
 
     return true;
 }
+
+// Test sampling with ValueCountMatchSpy.
+DEFINE_TESTCASE(matchspy7, writable)
+{
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int c = 1; c <= 1000; ++c) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_value(0, str(c % 4));
+	doc.add_value(1, c <= 500 ? "early" : "late");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+
+    Xapian::doccount error;
+    {
+	// Without sampling, the estimates are exact.
+	Xapian::ValueCountMatchSpy spy(0);
+	enquire.add_matchspy(&spy);
+	enquire.get_mset(0, 10, 1000);
+	enquire.clear_matchspies();
+	TEST_EQUAL(spy.get_total(), 1000);
+	TEST_EQUAL(spy.get_sampled(), 1000);
+	TEST_EQUAL(values_to_repr(spy), "|0:250|1:250|2:250|3:250|");
+	TEST_EQUAL(spy.get_estimated_count("1", spy.get_total(), error), 250);
+	TEST_EQUAL(error, 0);
+	TEST_EQUAL(spy.get_estimated_count("4", spy.get_total(), error), 0);
+	TEST_EQUAL(error, 0);
+    }
+
+    {
+	// Tally every fifth document.
+	Xapian::ValueCountMatchSpy spy(0);
+	spy.set_sampling(5);
+	enquire.add_matchspy(&spy);
+	enquire.get_mset(0, 10, 1000);
+	enquire.clear_matchspies();
+	TEST_EQUAL(spy.get_total(), 1000);
+	TEST_EQUAL(spy.get_sampled(), 200);
+	TEST_EQUAL(values_to_repr(spy), "|0:50|1:50|2:50|3:50|");
+	TEST_EQUAL(spy.get_estimated_count("2", spy.get_total(), error), 250);
+	// 1.96 * sqrt(0.25 * 0.75 / 200 * 800 / 999) * 1000
+	TEST_EQUAL(error, 54);
+	// Scaling to the number of documents sampled gives the tally.
+	TEST_EQUAL(spy.get_estimated_count("2", 200, error), 50);
+	TEST_EQUAL(error, 0);
+    }
+
+    {
+	// Tally a random sample of 100 documents.
+	Xapian::ValueCountMatchSpy spy(0);
+	spy.set_sampling(1, 100);
+	enquire.add_matchspy(&spy);
+	enquire.get_mset(0, 10, 1000);
+	enquire.clear_matchspies();
+	TEST_EQUAL(spy.get_total(), 1000);
+	TEST_EQUAL(spy.get_sampled(), 100);
+	Xapian::doccount tallied = 0;
+	Xapian::TermIterator i;
+	for (i = spy.values_begin(); i != spy.values_end(); ++i) {
+	    tallied += i.get_termfreq();
+	}
+	TEST_EQUAL(tallied, 100);
+	Xapian::doccount est = spy.get_estimated_count("3", spy.get_total(),
+						       error);
+	TEST_REL(error, >, 54);
+	TEST_REL(error, <, 250);
+	TEST_REL(est, >=, 250 - error);
+	TEST_REL(est, <=, 250 + error);
+    }
+
+    {
+	// The sample should be spread over all the documents seen, not just
+	// the first ones in docid order.
+	Xapian::ValueCountMatchSpy spy(1);
+	spy.set_sampling(1, 100);
+	enquire.add_matchspy(&spy);
+	enquire.get_mset(0, 10, 1000);
+	enquire.clear_matchspies();
+	TEST_EQUAL(spy.get_sampled(), 100);
+	Xapian::doccount est = spy.get_estimated_count("late", spy.get_total(),
+						       error);
+	TEST_REL(est, >=, 500 - error);
+	TEST_REL(est, <=, 500 + error);
+    }
+
+    {
+	Xapian::ValueCountMatchSpy spy(0);
+	TEST_EXCEPTION(Xapian::InvalidArgumentError, spy.set_sampling(0));
+	// Nothing tallied yet.
+	TEST_EQUAL(spy.get_estimated_count("3", 1000, error), 0);
+	TEST_EQUAL(error, 1000);
+    }
+
+    return true;
+}
@@ -31,7 +31,9 @@
 #include "testsuite.h"
 #include "testutils.h"
 
+#include <cstdio>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -247,3 +249,75 @@ DEFINE_TESTCASE(valuerange4, backend) {
     Xapian::MSet mset = enq.get_mset(0, 20);
     return true;
 }
+
+/// Count documents matching @a query, and check against @a expected.
+static void
+check_value_query(const Xapian::Database & db, const Xapian::Query & query,
+		  Xapian::doccount expected)
+{
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    tout << query.get_description() << endl;
+    TEST_EQUAL(mset.size(), expected);
+}
+
+/// Test value range filters which can skip chunks of values.
+DEFINE_TESTCASE(valuerange6, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    // Mostly ascending dates, as for documents indexed in date order, with
+    // some documents having an unusually early or late date.
+    vector<string> dates;
+    for (Xapian::docid did = 1; did <= 5000; ++did) {
+	char buf[9];
+	unsigned day = did / 5;
+	if (did % 997 == 0) day = 0;
+	if (did % 1009 == 0) day = 9999;
+	sprintf(buf, "20%02u%02u%02u", 10 + day / 400, 1 + day / 31 % 12,
+		1 + day % 31);
+	Xapian::Document doc;
+	doc.add_value(0, buf);
+	if (did % 5 == 0) doc.add_term("five");
+	db.add_document(doc);
+	dates.push_back(buf);
+    }
+    db.commit();
+
+    const char * ranges[][2] = {
+	{ "20120101", "20120201" },
+	{ "20100101", "20100105" },
+	{ "20131231", "20991231" },
+	{ "20000101", "20100101" },
+	{ "20110505", "20110505" },
+	{ "3", "4" }
+    };
+    for (size_t i = 0; i != sizeof(ranges) / sizeof(ranges[0]); ++i) {
+	const string lo = ranges[i][0];
+	const string hi = ranges[i][1];
+	Xapian::doccount in_range = 0, in_range_five = 0;
+	Xapian::doccount ge = 0, le = 0;
+	for (size_t j = 0; j != dates.size(); ++j) {
+	    if (dates[j] >= lo) ++ge;
+	    if (dates[j] <= hi) ++le;
+	    if (dates[j] >= lo && dates[j] <= hi) {
+		++in_range;
+		if ((j + 1) % 5 == 0) ++in_range_five;
+	    }
+	}
+
+	Xapian::Query range(Xapian::Query::OP_VALUE_RANGE, 0, lo, hi);
+	check_value_query(db, range, in_range);
+	check_value_query(db, Xapian::Query(Xapian::Query::OP_VALUE_GE, 0, lo),
+			  ge);
+	check_value_query(db, Xapian::Query(Xapian::Query::OP_VALUE_LE, 0, hi),
+			  le);
+	// Use the range with a term so that skip_to() gets used.
+	check_value_query(db,
+			  Xapian::Query(Xapian::Query::OP_AND,
+					Xapian::Query("five"), range),
+			  in_range_five);
+    }
+
+    return true;
+}
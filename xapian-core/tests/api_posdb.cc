@@ -601,6 +601,170 @@ DEFINE_TESTCASE(poslist3, positional && writable) {
     return true;
 }
 
+/// Test long position lists, which brass stores in blocks with a skip index.
+DEFINE_TESTCASE(poslist4, positional && writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    Xapian::Document document;
+    for (Xapian::termpos p = 3; p <= 3000; p += 3) {
+	document.add_posting("foo", p);
+    }
+    document.add_posting("bar", 1);
+    document.add_posting("bar", 1501);
+    db.add_document(document);
+    db.commit();
+
+    Xapian::PositionIterator pl = db.positionlist_begin(1, "foo");
+    Xapian::PositionIterator pl_end = db.positionlist_end(1, "foo");
+    Xapian::termpos expected = 3;
+    while (pl != pl_end) {
+	TEST_EQUAL(*pl, expected);
+	expected += 3;
+	++pl;
+    }
+    TEST_EQUAL(expected, 3003);
+
+    // Skip forwards within a block, across several blocks, and off the end.
+    pl = db.positionlist_begin(1, "foo");
+    pl.skip_to(4);
+    TEST(pl != pl_end);
+    TEST_EQUAL(*pl, 6);
+    pl.skip_to(1500);
+    TEST(pl != pl_end);
+    TEST_EQUAL(*pl, 1500);
+    pl.skip_to(1501);
+    TEST(pl != pl_end);
+    TEST_EQUAL(*pl, 1503);
+    ++pl;
+    TEST(pl != pl_end);
+    TEST_EQUAL(*pl, 1506);
+    pl.skip_to(2999);
+    TEST(pl != pl_end);
+    TEST_EQUAL(*pl, 3000);
+    ++pl;
+    TEST(pl == pl_end);
+
+    pl = db.positionlist_begin(1, "foo");
+    pl.skip_to(3001);
+    TEST(pl == pl_end);
+
+    // "foo bar" only matches in the middle of foo's position list, while
+    // "bar foo" doesn't match at all.
+    Xapian::Enquire enquire(db);
+    Xapian::Query q(Xapian::Query::OP_PHRASE,
+		    Xapian::Query("foo"), Xapian::Query("bar"));
+    enquire.set_query(q);
+    TEST_EQUAL(enquire.get_mset(0, 10).size(), 1);
+
+    q = Xapian::Query(Xapian::Query::OP_PHRASE,
+		      Xapian::Query("bar"), Xapian::Query("foo"));
+    enquire.set_query(q);
+    TEST_EQUAL(enquire.get_mset(0, 10).size(), 0);
+
+    Xapian::TermIterator t = db.termlist_begin(1);
+    t.skip_to("foo");
+    try {
+	TEST_EQUAL(t.positionlist_count(), 1000);
+    } catch (const Xapian::UnimplementedError &) {
+	SKIP_TEST("TermList::positionlist_count() not yet implemented for this backend");
+    }
+
+    return true;
+}
+
+static Xapian::doccount
+count_phrase_matches(const Xapian::Database & db, const char ** words,
+		     size_t n)
+{
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+				    words, words + n));
+    return enquire.get_mset(0, 10).size();
+}
+
+/// Test phrase searches using terms from TermGenerator::FLAG_PHRASE_PAIRS.
+DEFINE_TESTCASE(phrasepairs1, positional && writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    Xapian::TermGenerator termgen;
+    termgen.set_flags(Xapian::TermGenerator::FLAG_PHRASE_PAIRS);
+    const char * texts[] = {
+	"the new york times",
+	"new times in york",
+	"york new times",
+	"times new york"
+    };
+    for (size_t i = 0; i != sizeof(texts) / sizeof(texts[0]); ++i) {
+	Xapian::Document doc;
+	termgen.set_document(doc);
+	termgen.index_text(texts[i]);
+	db.add_document(doc);
+    }
+    db.commit();
+
+    const char * q1[] = { "new", "york" };
+    const char * q2[] = { "new", "york", "times" };
+    const char * q3[] = { "york", "new", "times" };
+    const char * q4[] = { "times", "new" };
+    TEST_EQUAL(count_phrase_matches(db, q1, 2), 2);
+    TEST_EQUAL(count_phrase_matches(db, q2, 3), 1);
+    TEST_EQUAL(count_phrase_matches(db, q3, 3), 1);
+    TEST_EQUAL(count_phrase_matches(db, q4, 2), 1);
+
+    // The pair terms shouldn't affect the weights or the matching terms.
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_PHRASE, q1, q1 + 2));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 2);
+    Xapian::weight wt = mset[0].get_weight();
+    TEST_EQUAL(mset[0].get_percent(), 100);
+    Xapian::TermIterator t = enquire.get_matching_terms_begin(mset[0]);
+    TEST_EQUAL(*t, "new");
+    ++t;
+    TEST_EQUAL(*t, "york");
+    ++t;
+    TEST(t == enquire.get_matching_terms_end(mset[0]));
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_AND, q1, q1 + 2));
+    mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 4);
+    TEST_EQUAL_DOUBLE(mset[0].get_weight(), wt);
+
+    // A pair of long prefixed words would give a pair term longer than the
+    // backends allow, so it shouldn't be indexed - phrases including it need
+    // to check the positions instead.
+    string prefix = "X" + string(79, 'p');
+    string w1 = prefix + string(60, 'a');
+    string w2 = prefix + string(60, 'b');
+    string w3 = prefix + "c";
+    Xapian::Document longdoc;
+    termgen.set_document(longdoc);
+    termgen.index_text(string(60, 'a') + " " + string(60, 'b') + " c " +
+		       string(60, 'b') + " " + string(60, 'a'), 1, prefix);
+    db.add_document(longdoc);
+    db.commit();
+    const char * q5[] = { w1.c_str(), w2.c_str() };
+    const char * q6[] = { w1.c_str(), w2.c_str(), w3.c_str() };
+    const char * q7[] = { w3.c_str(), w2.c_str(), w1.c_str() };
+    const char * q8[] = { w2.c_str(), w3.c_str(), w1.c_str() };
+    TEST_EQUAL(count_phrase_matches(db, q5, 2), 1);
+    TEST_EQUAL(count_phrase_matches(db, q6, 3), 1);
+    TEST_EQUAL(count_phrase_matches(db, q7, 3), 1);
+    TEST_EQUAL(count_phrase_matches(db, q8, 3), 0);
+
+    // Add a document without pair terms - the positional information should
+    // now be used to find the matches.
+    Xapian::Document doc;
+    doc.add_posting("new", 1);
+    doc.add_posting("york", 2);
+    db.add_document(doc);
+    db.commit();
+    TEST_EQUAL(count_phrase_matches(db, q1, 2), 3);
+    TEST_EQUAL(count_phrase_matches(db, q2, 3), 1);
+    TEST_EQUAL(count_phrase_matches(db, q4, 2), 1);
+
+    return true;
+}
+
 // Regression test - in 0.9.4 (and many previous versions) you couldn't get a
 // PositionIterator from a TermIterator from Database::termlist_begin().
 //
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -234,3 +235,64 @@ DEFINE_TESTCASE(sortfunctorremote1,remote) {
     );
     return true;
 }
+
+/// Check the top of a value-sorted MSet matches the full sorted MSet.
+static void
+check_sorted_prefix(Xapian::Enquire & enquire)
+{
+    Xapian::MSet full = enquire.get_mset(0, 1000);
+    TEST(full.size() < 1000);
+    const Xapian::doccount firsts[] = { 0, 0, 5, 37 };
+    const Xapian::doccount sizes[] = { 1, 10, 10, 50 };
+    for (size_t i = 0; i != sizeof(firsts) / sizeof(firsts[0]); ++i) {
+	Xapian::MSet mset = enquire.get_mset(firsts[i], sizes[i]);
+	TEST_EQUAL(mset.size(), sizes[i]);
+	Xapian::MSetIterator j = mset.begin();
+	Xapian::MSetIterator k = full[firsts[i]];
+	for ( ; j != mset.end(); ++j, ++k) {
+	    TEST_EQUAL(*j, *k);
+	}
+    }
+}
+
+/// Test sorting by value when candidates are rejected without fetching them.
+DEFINE_TESTCASE(sortvalue2,writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (unsigned i = 1; i <= 300; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term((i % 3) ? "two" : "three", i % 7 + 1);
+	if (i % 13) {
+	    // Plenty of ties, and values which are prefixes of others.
+	    string v(str((i * 37) % 101));
+	    if (i % 5 == 0) v += '\0';
+	    doc.add_value(0, v);
+	}
+	doc.add_value(1, str(i % 4));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("all"),
+				    Xapian::Query("two")));
+    for (int reverse = 0; reverse <= 1; ++reverse) {
+	tout << "reverse = " << reverse << endl;
+	enquire.set_sort_by_value(0, reverse);
+	check_sorted_prefix(enquire);
+	enquire.set_sort_by_value_then_relevance(0, reverse);
+	check_sorted_prefix(enquire);
+	enquire.set_sort_by_relevance_then_value(0, reverse);
+	check_sorted_prefix(enquire);
+
+	// Candidates which sort below the lowest item may still need to be
+	// considered when collapsing.
+	enquire.set_collapse_key(1, 30);
+	enquire.set_sort_by_value(0, reverse);
+	check_sorted_prefix(enquire);
+	enquire.set_collapse_key(Xapian::BAD_VALUENO);
+    }
+
+    return true;
+}
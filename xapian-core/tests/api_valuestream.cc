@@ -25,6 +25,7 @@
 #include "api_valuestream.h"
 
 #include <xapian.h>
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -154,6 +155,87 @@ DEFINE_TESTCASE(valuestream3, backend) {
     return true;
 }
 
+/// Check value streams and value range filters on many values.
+static void
+check_valuestream(const Xapian::Database & db, Xapian::valueno slot,
+		  const string & lo, const string & hi)
+{
+    Xapian::doccount expected = 0;
+    Xapian::ValueIterator it = db.valuestream_begin(slot);
+    Xapian::PostingIterator p;
+    for (p = db.postlist_begin(string()); p != db.postlist_end(string()); ++p) {
+	Xapian::docid did = *p;
+	string value = db.get_document(did).get_value(slot);
+	if (value.empty()) continue;
+	TEST(it != db.valuestream_end(slot));
+	TEST_EQUAL(it.get_docid(), did);
+	TEST_EQUAL(*it, value);
+	if (value >= lo && value <= hi) ++expected;
+	++it;
+    }
+    TEST(it == db.valuestream_end(slot));
+
+    it = db.valuestream_begin(slot);
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); did += 7) {
+	it.skip_to(did);
+	if (it == db.valuestream_end(slot)) break;
+	TEST_EQUAL(*it, db.get_document(it.get_docid()).get_value(slot));
+    }
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_VALUE_RANGE,
+				    slot, lo, hi));
+    Xapian::MSet mset = enquire.get_mset(0, db.get_doccount());
+    TEST_EQUAL(mset.size(), expected);
+    for (Xapian::MSetIterator m = mset.begin(); m != mset.end(); ++m) {
+	string value = m.get_document().get_value(slot);
+	TEST_REL(value,>=,lo);
+	TEST_REL(value,<=,hi);
+    }
+}
+
+/// Test value streams where all the values are the same length.
+DEFINE_TESTCASE(valuestream4, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    for (Xapian::docid did = 1; did <= 2000; ++did) {
+	Xapian::Document doc;
+	// Fixed width values, as for dates.
+	doc.add_value(0, "2011" + str(1000 + did % 900));
+	// Values which are occasionally a different length.
+	if (did % 3 != 0)
+	    doc.add_value(1, str(did % 500 == 0 ? did * 1000 : did + 1000));
+	doc.add_term("foo");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    check_valuestream(db, 0, "20111100", "20111300");
+    check_valuestream(db, 1, "1500", "2500");
+
+    // Changing a value to a different length has to convert a packed chunk
+    // back to the usual encoding.
+    Xapian::Document doc = db.get_document(1234);
+    doc.add_value(0, "later");
+    db.replace_document(1234, doc);
+    db.delete_document(17);
+    db.delete_document(1500);
+    db.commit();
+
+    check_valuestream(db, 0, "20111100", "20111300");
+    check_valuestream(db, 0, "2011", "m");
+    check_valuestream(db, 1, "1500", "2500");
+
+    // And back again.
+    doc.add_value(0, "20111234");
+    db.replace_document(1234, doc);
+    db.commit();
+
+    check_valuestream(db, 0, "20111100", "20111300");
+
+    return true;
+}
+
 /** Check that valueweightsource handles last_docid of 0xffffffff.
  *
  *  The original implementation went into an infinite loop in this case.
@@ -30,6 +30,7 @@
 #include <xapian.h>
 
 #include "backendmanager.h" // For XAPIAN_BIN_PATH.
+#include "dbcheck.h"
 #include "omassert.h"
 #include "str.h"
 #include "testsuite.h"
@@ -1991,3 +1992,220 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+static void
+make_batch_document(Xapian::Document & doc, int i)
+{
+    doc.set_data("doc " + str(i));
+    doc.add_value(0, str(i % 17));
+    doc.add_term("all");
+    doc.add_term("mod" + str(i % 13), i % 4 + 1);
+    for (int j = 0; j < i % 9; ++j) {
+	doc.add_posting("w" + str((i * 7 + j) % 50), j + 1);
+    }
+}
+
+/// Test add_documents() gives the same result as calling add_document().
+DEFINE_TESTCASE(adddocuments1, writable) {
+    Xapian::WritableDatabase db1 = get_named_writable_database("adddocuments1a");
+    Xapian::WritableDatabase db2 = get_named_writable_database("adddocuments1b");
+
+    vector<Xapian::Document> docs;
+    TEST_EQUAL(db1.add_documents(docs, 4), 0);
+    for (int i = 0; i < 500; ++i) {
+	docs.push_back(Xapian::Document());
+	make_batch_document(docs.back(), i);
+	db2.add_document(docs.back());
+    }
+    TEST_EQUAL(db1.add_documents(docs, 4), 1);
+    db1.commit();
+    db2.commit();
+    // Adding documents read from a database should work too.
+    vector<Xapian::Document> copies;
+    for (Xapian::docid did = 1; did <= 100; ++did) {
+	copies.push_back(db2.get_document(did));
+    }
+    TEST_EQUAL(db1.add_documents(copies, 3), 501);
+    for (size_t i = 0; i != copies.size(); ++i) {
+	db2.add_document(copies[i]);
+    }
+    db1.commit();
+    db2.commit();
+
+    TEST_EQUAL(db1.get_doccount(), db2.get_doccount());
+    TEST_EQUAL(db1.get_avlength(), db2.get_avlength());
+    TEST_EQUAL(db1.get_value_freq(0), db2.get_value_freq(0));
+    Xapian::TermIterator t1 = db1.allterms_begin();
+    Xapian::TermIterator t2 = db2.allterms_begin();
+    for ( ; t1 != db1.allterms_end(); ++t1, ++t2) {
+	TEST(t2 != db2.allterms_end());
+	TEST_EQUAL(*t1, *t2);
+	TEST_EQUAL(t1.get_termfreq(), t2.get_termfreq());
+	TEST_EQUAL(db1.get_collection_freq(*t1), db2.get_collection_freq(*t2));
+	// This includes the positional information.
+	TEST_EQUAL(postlist_to_string(db1, *t1), postlist_to_string(db2, *t2));
+    }
+    TEST(t2 == db2.allterms_end());
+
+    for (Xapian::docid did = 1; did <= 600; did += 7) {
+	Xapian::Document d1 = db1.get_document(did);
+	Xapian::Document d2 = db2.get_document(did);
+	TEST_EQUAL(d1.get_data(), d2.get_data());
+	TEST_EQUAL(d1.get_value(0), d2.get_value(0));
+	TEST_EQUAL(d1.termlist_count(), d2.termlist_count());
+	Xapian::TermIterator i1 = d1.termlist_begin();
+	Xapian::TermIterator i2 = d2.termlist_begin();
+	for ( ; i1 != d1.termlist_end(); ++i1, ++i2) {
+	    TEST_EQUAL(*i1, *i2);
+	    TEST_EQUAL(i1.get_wdf(), i2.get_wdf());
+	}
+	TEST_EQUAL(db1.get_doclength(did), db2.get_doclength(did));
+    }
+
+    return true;
+}
+
+/// Test add_documents() with a document which can't be added.
+DEFINE_TESTCASE(adddocuments2, writable) {
+    // Inmemory doesn't impose a limit on term length.
+    SKIP_TEST_FOR_BACKEND("inmemory");
+
+    Xapian::WritableDatabase db = get_writable_database();
+
+    Xapian::Document doc;
+    doc.add_term("existing");
+    db.add_document(doc);
+    db.commit();
+
+    vector<Xapian::Document> docs;
+    for (int i = 0; i < 100; ++i) {
+	docs.push_back(Xapian::Document());
+	make_batch_document(docs.back(), i);
+    }
+    docs[57].add_term(string(1000, 'x'));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, db.add_documents(docs, 4));
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 1);
+    TEST(!db.term_exists("all"));
+
+    return true;
+}
+
+class AcceptAllDecider : public Xapian::MatchDecider {
+  public:
+    bool operator()(const Xapian::Document &) const { return true; }
+};
+
+/// Test Xapian::MSetCache.
+DEFINE_TESTCASE(msetcache1, brass || chert) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 0; i < 20; ++i) {
+	Xapian::Document doc;
+	doc.set_data(str(i));
+	doc.add_term("all", 1 + i % 3);
+	if (i % 2) doc.add_term("odd");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Database rodb = get_writable_database_as_database();
+    Xapian::MSetCache cache;
+    Xapian::Enquire enq(rodb);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				Xapian::Query("all"), Xapian::Query("odd")));
+    Xapian::MSet uncached = enq.get_mset(0, 10);
+
+    enq.set_cache(cache);
+    Xapian::MSet mset1 = enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_misses(), 1);
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.size(), 1);
+    TEST_REL(cache.get_memory_used(),>,0);
+    Xapian::MSet mset2 = enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_misses(), 1);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST(mset1 == uncached);
+    TEST(mset2 == uncached);
+    TEST_EQUAL(mset2.get_termfreq("odd"), 10);
+    TEST_EQUAL(mset2.get_termweight("odd"), uncached.get_termweight("odd"));
+    TEST_EQUAL(mset2.begin().get_percent(), uncached.begin().get_percent());
+    TEST_EQUAL(mset2.begin().get_document().get_data(),
+	       uncached.begin().get_document().get_data());
+
+    // Different parameters or settings shouldn't use the cached result.
+    Xapian::MSet mset3 = enq.get_mset(1, 10);
+    TEST(mset_range_is_same(mset3, 0, uncached, 1, 9));
+    enq.set_sort_by_value(0, true);
+    enq.get_mset(0, 10);
+    enq.set_sort_by_relevance();
+    TEST_EQUAL(cache.get_misses(), 3);
+    TEST_EQUAL(cache.get_hits(), 1);
+
+    // Another Enquire object for the same database can share the cache.
+    Xapian::Enquire enq2(rodb);
+    enq2.set_query(enq.get_query());
+    enq2.set_cache(cache);
+    TEST(enq2.get_mset(0, 10) == uncached);
+    TEST_EQUAL(cache.get_hits(), 2);
+
+    // Searches using a MatchDecider aren't cached.
+    AcceptAllDecider decider;
+    enq.get_mset(0, 10, 0, NULL, &decider);
+    TEST_EQUAL(cache.get_misses(), 3);
+    TEST_EQUAL(cache.get_hits(), 2);
+    TEST_EQUAL(cache.size(), 3);
+
+    // A new revision shouldn't use results cached for the old one.
+    Xapian::Document doc;
+    doc.add_term("odd", 100);
+    doc.set_data("new");
+    Xapian::docid new_did = db.add_document(doc);
+    db.commit();
+    rodb.reopen();
+    Xapian::MSet mset4 = enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_misses(), 4);
+    TEST_EQUAL(cache.size(), 1);
+    TEST_EQUAL(*mset4.begin(), new_did);
+    TEST_EQUAL(enq.get_mset(0, 10), mset4);
+    TEST_EQUAL(cache.get_hits(), 3);
+
+    // A WritableDatabase with no pending changes can use the cache...
+    Xapian::Enquire wenq(db);
+    wenq.set_query(enq.get_query());
+    wenq.set_cache(cache);
+    TEST_EQUAL(wenq.get_mset(0, 10), mset4);
+    TEST_EQUAL(cache.get_misses(), 5);
+    TEST_EQUAL(wenq.get_mset(0, 10), mset4);
+    TEST_EQUAL(cache.get_hits(), 4);
+
+    // ...but uncommitted changes are searched without changing the
+    // revision, so the cache mustn't be used while there are any.
+    doc.add_term("odd", 100);
+    Xapian::docid uncommitted_did = db.add_document(doc);
+    Xapian::MSet mset5 = wenq.get_mset(0, 10);
+    TEST_EQUAL(*mset5.begin(), uncommitted_did);
+    TEST_EQUAL(cache.get_hits(), 4);
+    TEST_EQUAL(cache.get_misses(), 5);
+    db.commit();
+    TEST_EQUAL(wenq.get_mset(0, 10), mset5);
+    TEST_EQUAL(cache.get_misses(), 6);
+
+    // Check that the memory limit is applied.
+    cache.set_max_memory(0);
+    TEST_EQUAL(cache.size(), 0);
+    TEST_EQUAL(cache.get_memory_used(), 0);
+    enq.get_mset(0, 10);
+    TEST_EQUAL(cache.size(), 0);
+
+    enq.unset_cache();
+    enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_misses(), 7);
+
+    cache.clear();
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.get_misses(), 0);
+    TEST_STRINGS_EQUAL(cache.get_description(),
+		       "Xapian::MSetCache(0 entries, 0/0 bytes, 0 hits, 0 misses)");
+
+    return true;
+}
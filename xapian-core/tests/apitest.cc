@@ -108,6 +108,12 @@ get_remote_database(const string &dbname, unsigned int timeout)
     return backendmanager->get_remote_database(dbnames, timeout);
 }
 
+Xapian::Database
+get_threaded_remote_database(const string &path, unsigned threads)
+{
+    return backendmanager->get_threaded_remote_database(path, threads);
+}
+
 Xapian::Database
 get_writable_database_as_database()
 {
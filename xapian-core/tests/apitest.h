@@ -51,6 +51,9 @@ std::string get_named_writable_database_path(const std::string &name);
 
 Xapian::Database get_remote_database(const std::string &db, unsigned timeout);
 
+Xapian::Database get_threaded_remote_database(const std::string &path,
+					      unsigned threads);
+
 Xapian::Database get_writable_database_as_database();
 
 Xapian::WritableDatabase get_writable_database_again();
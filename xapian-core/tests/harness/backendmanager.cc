@@ -315,6 +315,15 @@ BackendManager::get_remote_database(const vector<string> &, unsigned int)
     throw Xapian::InvalidOperationError(msg);
 }
 
+Xapian::Database
+BackendManager::get_threaded_remote_database(const string &, unsigned)
+{
+    string msg = "Backend ";
+    msg += get_dbtype();
+    msg += " doesn't support get_threaded_remote_database()";
+    throw Xapian::InvalidOperationError(msg);
+}
+
 Xapian::Database
 BackendManager::get_writable_database_as_database()
 {
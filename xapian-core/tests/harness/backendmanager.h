@@ -183,6 +183,13 @@ class BackendManager {
     /// Get a remote database instance with the specified timeout.
     virtual Xapian::Database get_remote_database(const std::vector<std::string> & files, unsigned int timeout);
 
+    /** Get a remote database from a server with a pool of @a threads threads.
+     *
+     *  The server for @a path is started by the first call and shared by
+     *  later ones, so several clients can be connected to it at once.
+     */
+    virtual Xapian::Database get_threaded_remote_database(const std::string & path, unsigned threads);
+
     /// Create a Database object for the last opened WritableDatabase.
     virtual Xapian::Database get_writable_database_as_database();
 
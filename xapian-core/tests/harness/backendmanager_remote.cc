@@ -67,6 +67,22 @@ BackendManagerRemote::get_writable_database_args(const std::string & name,
     return args;
 }
 
+std::string
+BackendManagerRemote::get_writable_database_path(const std::string & name)
+{
+#ifdef XAPIAN_HAS_BRASS_BACKEND
+    if (remote_type == "brass") {
+	return getwritedb_brass_path(name);
+    }
+#endif
+#ifdef XAPIAN_HAS_CHERT_BACKEND
+    if (remote_type == "chert") {
+	return getwritedb_chert_path(name);
+    }
+#endif
+    return BackendManager::get_writable_database_path(name);
+}
+
 std::string
 BackendManagerRemote::get_remote_database_args(const std::vector<std::string> & files,
 					       unsigned int timeout)
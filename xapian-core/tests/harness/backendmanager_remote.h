@@ -44,6 +44,9 @@ class BackendManagerRemote : public BackendManager {
   public:
     BackendManagerRemote(const std::string & remote_type_);
 
+    /// Get the path of a writable database instance.
+    std::string get_writable_database_path(const std::string & name);
+
     /// Get the args for opening a remote database indexing a single file.
     std::string get_writable_database_args(const std::string & name,
 					   const std::string & file);
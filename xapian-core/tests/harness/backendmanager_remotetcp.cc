@@ -79,6 +79,9 @@ struct pid_fd {
 
 static pid_fd pid_to_fd[16];
 
+// The threaded server doesn't exit by itself, so clean_up() has to kill it.
+static pid_t threaded_server_pid = 0;
+
 extern "C" {
 
 static void
@@ -103,7 +106,7 @@ on_SIGCHLD(int /*sig*/)
 }
 
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
@@ -111,10 +114,15 @@ launch_xapian_tcpsrv(const string & args)
     // if xapian-tcpsrv doesn't start listening successfully.
     signal(SIGCHLD, SIG_DFL);
 try_next_port:
-    string cmd = XAPIAN_TCPSRV" --one-shot --interface "LOCALHOST" --port " + str(port) + " " + args;
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface "LOCALHOST" --port " + str(port) + " " + args;
 #ifdef HAVE_VALGRIND
     if (RUNNING_ON_VALGRIND) cmd = "./runsrv " + cmd;
 #endif
+    // Exec the server from the shell so that the pid we get is the one to
+    // kill in clean_up().
+    if (!one_shot) cmd = "exec " + cmd;
     int fds[2];
     if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, fds) < 0) {
 	string msg("Couldn't create socketpair: ");
@@ -194,6 +202,8 @@ try_next_port:
     // its buffers.
     fclose(fh);
 
+    if (!one_shot) threaded_server_pid = child;
+
     // Find a slot to track the pid->fd mapping in.  If we can't find a slot
     // it just means we'll leak the fd, so don't worry about that too much.
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
@@ -349,6 +359,27 @@ BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
+Xapian::Database
+BackendManagerRemoteTcp::get_threaded_remote_database(const string & path,
+						      unsigned threads)
+{
+#ifdef HAVE_FORK
+    if (path != threaded_path) {
+	if (threaded_server_pid) {
+	    string msg("A threaded server is already running for ");
+	    msg += threaded_path;
+	    throw msg;
+	}
+	string args = "--threads " + str(threads) + " -t300000 " + path;
+	threaded_port = launch_xapian_tcpsrv(args, false);
+	threaded_path = path;
+    }
+    return Xapian::Remote::open(LOCALHOST, threaded_port);
+#else
+    return BackendManagerRemote::get_threaded_remote_database(path, threads);
+#endif
+}
+
 Xapian::Database
 BackendManagerRemoteTcp::get_writable_database_as_database()
 {
@@ -370,6 +401,10 @@ BackendManagerRemoteTcp::clean_up()
 {
 #ifdef HAVE_FORK
     signal(SIGCHLD, SIG_DFL);
+    if (threaded_server_pid) {
+	kill(threaded_server_pid, SIGTERM);
+	threaded_server_pid = 0;
+    }
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
 	pid_t child = pid_to_fd[i].pid;
 	if (child) {
@@ -386,4 +421,6 @@ BackendManagerRemoteTcp::clean_up()
 	}
     }
 #endif
+    threaded_path.resize(0);
+    threaded_port = 0;
 }
@@ -38,13 +38,19 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     /// The path of the last writable database used.
     std::string last_wdb_name;
 
+    /// The path served by the threaded server, if one is running.
+    std::string threaded_path;
+
+    /// The port the threaded server is listening on.
+    int threaded_port;
+
   private:
     /// Create a Xapian::Database object indexing multiple files.
     Xapian::Database do_get_database(const std::vector<std::string> & files);
 
   public:
     BackendManagerRemoteTcp(const std::string & remote_type_)
-	: BackendManagerRemote(remote_type_) { }
+	: BackendManagerRemote(remote_type_), threaded_port(0) { }
 
     ~BackendManagerRemoteTcp();
 
@@ -59,6 +65,10 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     Xapian::Database get_remote_database(const std::vector<std::string> & files,
 					 unsigned int timeout);
 
+    /// Create a Database from a threaded server, starting it if needed.
+    Xapian::Database get_threaded_remote_database(const std::string & path,
+						  unsigned threads);
+
     /// Create a Database object for the last opened WritableDatabase.
     Xapian::Database get_writable_database_as_database();
 
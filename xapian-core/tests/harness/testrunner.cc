@@ -59,9 +59,9 @@ static BackendProperties backend_properties[] = {
     { "multi_brass", "backend,positional,valuestats,multi" },
     { "multi_chert", "backend,positional,valuestats,multi" },
     { "remoteprog_brass", "backend,remote,transactions,positional,valuestats,writable,metadata" },
-    { "remotetcp_brass", "backend,remote,transactions,positional,valuestats,writable,metadata" },
+    { "remotetcp_brass", "backend,remote,transactions,positional,valuestats,writable,metadata,remotetcp" },
     { "remoteprog_chert", "backend,remote,transactions,positional,valuestats,writable,metadata" },
-    { "remotetcp_chert", "backend,remote,transactions,positional,valuestats,writable,metadata" },
+    { "remotetcp_chert", "backend,remote,transactions,positional,valuestats,writable,metadata,remotetcp" },
     { NULL, NULL }
 };
 
@@ -73,6 +73,7 @@ TestRunner::set_properties(const string & properties)
     // Clear the flags
     backend = false;
     remote = false;
+    remotetcp = false;
     transactions = false;
     positional = false;
     writable = false;
@@ -100,6 +101,8 @@ TestRunner::set_properties(const string & properties)
 	    backend = true;
 	else if (propname == "remote")
 	    remote = true;
+	else if (propname == "remotetcp")
+	    remotetcp = true;
 	else if (propname == "transactions")
 	    transactions = true;
 	else if (propname == "positional")
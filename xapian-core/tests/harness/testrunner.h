@@ -72,6 +72,9 @@ class TestRunner {
     /// True if a remote backend is in use.
     bool remote;
 
+    /// True if the backend is a remote backend using xapian-tcpsrv.
+    bool remotetcp;
+
     /// True if transactions are supported by the backend in use.
     bool transactions;
 
@@ -26,10 +26,12 @@
 #include <xapian.h>
 
 #include <cfloat>
+#include <cstring>
 #include "safeerrno.h"
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -42,6 +44,16 @@ using namespace std;
 #include "serialise.h"
 #include "serialise-double.h"
 #include "str.h"
+#include "unixcmds.h"
+#include "utils.h"
+
+#if defined XAPIAN_HAS_BRASS_BACKEND || defined XAPIAN_HAS_CHERT_BACKEND
+# include "../backends/blockcache.h"
+#endif
+
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+# include "databasepool.h"
+#endif
 
 static bool test_except1()
 {
@@ -457,6 +469,83 @@ static bool test_serialiseerror1()
 
     return true;
 }
+
+// Check serialisation of blocks of data.
+static bool test_serialiseblock1()
+{
+    static const char * const tests[] = {
+	"", "x", "short, so not compressed", NULL
+    };
+    string data;
+    for (const char * const * t = tests; true; ++t) {
+	if (*t) {
+	    data = *t;
+	} else {
+	    // Long and repetitive, so it should be compressed if we can.
+	    data.resize(0);
+	    for (int i = 0; i < 1000; ++i) data += "compress me ";
+	}
+	for (int compress = 0; compress != 2; ++compress) {
+	    string s = serialise_block(data, compress);
+	    if (compress && !*t && block_compression_supported()) {
+		TEST_REL(s.size(),<,data.size());
+	    } else {
+		TEST_EQUAL(s.size(), data.size() + 1);
+	    }
+	    string result("junk");
+	    unserialise_block(s.data(), s.data() + s.size(), result);
+	    TEST(result == data);
+	}
+	if (!*t) break;
+    }
+
+    // Check that corrupt data is rejected.
+    string s = serialise_block(data, true);
+    if (block_compression_supported()) {
+	s.resize(s.size() / 2);
+	TEST_EXCEPTION(Xapian::NetworkError,
+	    unserialise_block(s.data(), s.data() + s.size(), data));
+    }
+    TEST_EXCEPTION(Xapian::NetworkError,
+	unserialise_block(s.data(), s.data(), data));
+    s = "\x7fjunk";
+    TEST_EXCEPTION(Xapian::NetworkError,
+	unserialise_block(s.data(), s.data() + s.size(), data));
+
+    return true;
+}
+
+// Check serialisation of sorted lists of terms.
+static bool test_serialiseterms1()
+{
+    static const char * const terms[] = {
+	"", "a", "aardvark", "aardwolf", "b", "bb", "bbb", "c", NULL
+    };
+    string s, prev;
+    for (const char * const * t = terms; *t; ++t) {
+	serialise_term_after(s, prev, *t);
+	TEST_STRINGS_EQUAL(prev, *t);
+    }
+    // A term sharing a prefix of more than 255 bytes with the previous one.
+    string long1(300, 'x'), long2(long1 + "y");
+    serialise_term_after(s, prev, long1);
+    serialise_term_after(s, prev, long2);
+
+    const char * p = s.data();
+    const char * p_end = p + s.size();
+    string term;
+    for (const char * const * t = terms; *t; ++t) {
+	unserialise_term_after(&p, p_end, term);
+	TEST_STRINGS_EQUAL(term, *t);
+    }
+    unserialise_term_after(&p, p_end, term);
+    TEST_STRINGS_EQUAL(term, long1);
+    unserialise_term_after(&p, p_end, term);
+    TEST_STRINGS_EQUAL(term, long2);
+    TEST(p == p_end);
+
+    return true;
+}
 #endif
 
 // By default Sun's C++ compiler doesn't call the destructor on a
@@ -560,6 +649,152 @@ static bool test_pack_uint_preserving_sort1()
     return true;
 }
 
+#if defined XAPIAN_HAS_BRASS_BACKEND || defined XAPIAN_HAS_CHERT_BACKEND
+/// Test BlockCache lookups, hit counting, revision keying and eviction.
+static bool test_blockcache1()
+{
+    const size_t block_size = 1024;
+    // Room for 4 blocks per shard.
+    BlockCache cache(4 * block_size * BlockCache::SHARDS);
+    TEST_EQUAL(cache.get_used(), 0);
+
+    BlockCache::FileId file;
+    file.dev = 1;
+    file.ino = 42;
+    file.mtime = 1234567890;
+
+    unsigned char block[block_size], out[block_size];
+    memset(block, 'x', block_size);
+    block[0] = 7;
+
+    BlockCache::Key key(file, 3, 10);
+    TEST(!cache.lookup(key, out, block_size));
+    TEST_EQUAL(cache.get_misses(), 1);
+    cache.insert(key, block, block_size);
+    TEST_EQUAL(cache.get_used(), block_size);
+    TEST(cache.lookup(key, out, block_size));
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST(memcmp(block, out, block_size) == 0);
+
+    // A different revision, block number or file is a different key.
+    TEST(!cache.lookup(BlockCache::Key(file, 3, 11), out, block_size));
+    TEST(!cache.lookup(BlockCache::Key(file, 4, 10), out, block_size));
+    BlockCache::FileId file2 = file;
+    file2.mtime_nsec++;
+    TEST(!cache.lookup(BlockCache::Key(file2, 3, 10), out, block_size));
+    TEST_EQUAL(cache.get_misses(), 4);
+
+    // A lookup with the wrong block size must fail.
+    TEST(!cache.lookup(key, out, block_size / 2));
+
+    // Add lots of blocks and check we keep within the size limit.
+    for (unsigned n = 0; n != 1000; ++n) {
+	block[0] = n & 0xff;
+	cache.insert(BlockCache::Key(file, n, 20), block, block_size);
+	TEST_REL(cache.get_used(), <=, cache.get_size());
+    }
+    unsigned found = 0;
+    for (unsigned n = 0; n != 1000; ++n) {
+	if (cache.lookup(BlockCache::Key(file, n, 20), out, block_size)) {
+	    TEST_EQUAL(out[0], n & 0xff);
+	    ++found;
+	}
+    }
+    TEST_REL(found, >, 0);
+    TEST_REL(found, <=, 4 * BlockCache::SHARDS);
+
+    // Blocks from a file are discarded if it is recreated.
+    cache.invalidate_file(file2);
+    TEST_EQUAL(cache.get_used(), 0);
+
+    // A block bigger than a shard's share of the cache isn't cached.
+    cache.set_size(block_size);
+    cache.insert(key, block, block_size);
+    TEST_EQUAL(cache.get_used(), 0);
+
+    cache.set_size(4 * block_size * BlockCache::SHARDS);
+    cache.insert(key, block, block_size);
+    TEST_EQUAL(cache.get_used(), block_size);
+    cache.clear();
+    TEST_EQUAL(cache.get_used(), 0);
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.get_misses(), 0);
+    return true;
+}
+#endif
+
+#if defined XAPIAN_HAS_REMOTE_BACKEND && \
+    (defined XAPIAN_HAS_BRASS_BACKEND || defined XAPIAN_HAS_CHERT_BACKEND)
+/// Test DatabasePool reuses released databases and reopens them.
+static bool test_databasepool1()
+{
+#ifdef XAPIAN_HAS_BRASS_BACKEND
+    const string dir = ".brass";
+#else
+    const string dir = ".chert";
+#endif
+    (void)mkdir(dir, 0755);
+    const string path = dir + "/databasepool1";
+    rm_rf(path);
+#ifdef XAPIAN_HAS_BRASS_BACKEND
+    Xapian::WritableDatabase wdb = Xapian::Brass::open(path, Xapian::DB_CREATE);
+#else
+    Xapian::WritableDatabase wdb = Xapian::Chert::open(path, Xapian::DB_CREATE);
+#endif
+    wdb.add_document(Xapian::Document());
+    wdb.commit();
+
+    DatabasePool pool(vector<string>(1, path), 2);
+    string rev1;
+    Xapian::Database * db1 = pool.acquire(rev1, true);
+    TEST(!rev1.empty());
+    TEST_EQUAL(db1->get_doccount(), 1);
+    pool.release(db1, rev1);
+
+    // A released database is handed out again rather than a new one opened.
+    string rev = rev1;
+    Xapian::Database * db = pool.acquire(rev, false);
+    TEST(db == db1);
+    TEST(rev == rev1);
+
+    // But one in use isn't.
+    Xapian::Database * db2 = pool.acquire(rev, false);
+    TEST(db2 != db1);
+    pool.release(db2, rev1);
+    pool.release(db1, rev1);
+
+    wdb.add_document(Xapian::Document());
+    wdb.commit();
+
+    // Asking for the latest revision reopens the most recently released.
+    string rev2 = rev1;
+    db = pool.acquire(rev2, true);
+    TEST(db == db1);
+    TEST(rev2 != rev1);
+    TEST_EQUAL(db->get_doccount(), 2);
+
+    // A connection still reading the old revision gets the database which
+    // is still open at it.
+    rev = rev1;
+    Xapian::Database * old_db = pool.acquire(rev, false);
+    TEST(old_db == db2);
+    TEST_EQUAL(old_db->get_doccount(), 1);
+    pool.release(old_db, rev1);
+    pool.release(db, rev2);
+
+    // A pool with no database open at the old revision can't provide it.
+    DatabasePool new_pool(vector<string>(1, path), 2);
+    rev = rev1;
+    TEST_EXCEPTION(Xapian::DatabaseModifiedError, new_pool.acquire(rev, false));
+    // The database opened in the attempt is kept for the new revision.
+    rev = rev2;
+    db = new_pool.acquire(rev, false);
+    TEST_EQUAL(db->get_doccount(), 2);
+    new_pool.release(db, rev2);
+    return true;
+}
+#endif
+
 // ##################################################################
 // # End of actual tests					    #
 // ##################################################################
@@ -580,10 +815,19 @@ static const test_desc tests[] = {
     {"serialiselength2",	test_serialiselength2},
     {"serialisedoc1",		test_serialisedoc1},
     {"serialiseerror1",		test_serialiseerror1},
+    {"serialiseblock1",		test_serialiseblock1},
+    {"serialiseterms1",		test_serialiseterms1},
 #endif
     {"static_assert1",		test_static_assert1},
     {"strbool1",		test_strbool1},
     {"pack1",			test_pack_uint_preserving_sort1},
+#if defined XAPIAN_HAS_BRASS_BACKEND || defined XAPIAN_HAS_CHERT_BACKEND
+    {"blockcache1",		test_blockcache1},
+#endif
+#if defined XAPIAN_HAS_REMOTE_BACKEND && \
+    (defined XAPIAN_HAS_BRASS_BACKEND || defined XAPIAN_HAS_CHERT_BACKEND)
+    {"databasepool1",		test_databasepool1},
+#endif
     {0, 0}
 };
 
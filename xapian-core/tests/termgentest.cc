@@ -760,11 +760,61 @@ static bool test_tg_spell2()
     return true;
 }
 
+/// Test phrase pair term generation.
+static bool test_tg_pairs1()
+{
+    Xapian::TermGenerator termgen;
+    Xapian::Document doc;
+
+    termgen.set_document(doc);
+    termgen.set_flags(Xapian::TermGenerator::FLAG_PHRASE_PAIRS);
+
+    termgen.index_text("New York times");
+    termgen.index_text_without_positions("no pairs");
+    termgen.index_text("Times Square", 1, "XT");
+    // Pairs shouldn't span a gap in the term positions.
+    termgen.increase_termpos();
+    termgen.index_text("square meal");
+
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+	    "XTsquare[5] XTtimes[4] meal[107] new[1] no:1 pairs:1 "
+	    "square[106] times[3] york[2] \xff \xffXTtimes XTsquare "
+	    "\xffnew york \xffsquare meal \xfftimes XTtimes \xffyork times");
+
+    // A pair term which would be too long for the backends to store
+    // shouldn't be generated.
+    doc = Xapian::Document();
+    termgen.set_document(doc);
+    termgen.set_termpos(0);
+    string prefix = "X" + string(79, 'p');
+    termgen.index_text(string(60, 'a') + " " + string(60, 'b') + " c", 1,
+		       prefix);
+    Xapian::TermIterator t = doc.termlist_begin();
+    TEST_STRINGS_EQUAL(*t, prefix + string(60, 'a'));
+    t.skip_to("\xff");
+    TEST_STRINGS_EQUAL(*t, "\xff");
+    ++t;
+    TEST_STRINGS_EQUAL(*t, "\xff" + prefix + string(60, 'b') + " " +
+			   prefix + "c");
+    ++t;
+    TEST(t == doc.termlist_end());
+
+    // Without the flag, no pair terms should be generated.
+    doc = Xapian::Document();
+    termgen.set_document(doc);
+    termgen.set_flags(Xapian::TermGenerator::flags(0));
+    termgen.index_text("New York times");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc), "new[1] times[3] york[2]");
+
+    return true;
+}
+
 /// Test cases for the TermGenerator.
 static const test_desc tests[] = {
     TESTCASE(termgen1),
     TESTCASE(tg_spell1),
     TESTCASE(tg_spell2),
+    TESTCASE(tg_pairs1),
     END_OF_TESTCASES
 };
 
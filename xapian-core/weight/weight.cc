@@ -108,6 +108,29 @@ Weight::init_(const Internal & stats, Xapian::termcount query_length,
     init(factor);
 }
 
+Xapian::weight
+Weight::get_maxpart_for_wdf_(Xapian::termcount wdf_ub) const
+{
+    LOGCALL(MATCH, Xapian::weight, "Weight::get_maxpart_for_wdf_", wdf_ub);
+    if (!(stats_needed & WDF_MAX) || wdf_ub >= wdf_upper_bound_)
+	RETURN(get_maxpart());
+
+    // Subclasses calculate get_maxpart() from get_wdf_upper_bound(), so
+    // temporarily lower the bound.  Each leaf postlist has its own Weight
+    // object, so nothing else can see the change.
+    Xapian::termcount saved_wdf_upper_bound = wdf_upper_bound_;
+    wdf_upper_bound_ = wdf_ub;
+    Xapian::weight result;
+    try {
+	result = get_maxpart();
+    } catch (...) {
+	wdf_upper_bound_ = saved_wdf_upper_bound;
+	throw;
+    }
+    wdf_upper_bound_ = saved_wdf_upper_bound;
+    RETURN(result);
+}
+
 Weight::~Weight() { }
 
 string